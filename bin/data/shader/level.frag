@@ -0,0 +1,14 @@
+// Flat shaded from the face normal, which doesn't care whether the vertex normals are quantized
+//   glslangValidator -V level.frag -o level.frag.spv
+#version 450
+
+layout(location = 0) in vec3 mesh_position;
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    vec3 normal = normalize(cross(dFdx(mesh_position), dFdy(mesh_position)));
+    float light = 0.25 + 0.75 * abs(dot(normal, normalize(vec3(0.4, 0.8, 0.3))));
+    color = vec4(vec3(light), 1.0);
+}
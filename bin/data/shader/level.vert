@@ -0,0 +1,25 @@
+// The level, drawn through meshlet culling. Only the position attribute is bound, see level.frag.
+//   glslangValidator -V level.vert -o level.vert.spv
+#version 450
+
+// R16G16B16A16_UNORM (quantized) or R32G32B32_SFLOAT, ta_mesh_vertex_input_get location 0
+layout(location = 0) in vec4 position;
+
+// Written to the frame allocator every frame
+layout(set = 0, binding = 0) uniform View {
+    mat4 view_projection;
+} view;
+
+// ta_mesh_decode
+layout(push_constant) uniform Draw {
+    vec4 position_scale;
+    vec4 position_offset;
+} draw;
+
+layout(location = 0) out vec3 mesh_position;
+
+void main()
+{
+    mesh_position = draw.position_offset.xyz + position.xyz * draw.position_scale.xyz;
+    gl_Position = view.view_projection * vec4(mesh_position, 1.0);
+}
@@ -1,25 +1,557 @@
 #include "ta_timer.hpp"
 #include "ta_log.hpp"
-#include "vulkan/vulkan.h"
+#include "ta_present.hpp"
+#include "ta_deletion_queue.hpp"
+#include "ta_frame_alloc.hpp"
+#include "ta_descriptor.hpp"
+#include "ta_jobs.hpp"
+#include "ta_cmd_record.hpp"
+#include "ta_render_graph.hpp"
+#include "ta_gpu_profiler.hpp"
+#include "ta_pipeline_stats.hpp"
+#include "ta_pipeline_cache.hpp"
+#include "ta_spirv.hpp"
+#include "ta_shader.hpp"
+#include "ta_vk_dispatch.hpp"
+#include "ta_vk_debug.hpp"
+#include "ta_caps.hpp"
+#include "ta_bvh.hpp"
+#include "ta_bvh_dynamic.hpp"
+#include "ta_mesh.hpp"
+#include "ta_mesh_cook.hpp"
+#include "ta_mesh_simplify.hpp"
+#include "ta_mesh_tangent.hpp"
+#include "ta_meshlet.hpp"
+#include "ta_obj.hpp"
 #define SDL_MAIN_HANDLED
 #include "SDL/SDL.h"
 #include "SDL/SDL_vulkan.h"
 #include <algorithm>
 #include <cassert>
-
-#define QUERY_AVAILABLE_EXTENSIONS_AND_LAYERS
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #define UNUSED(x) (void)(x)
 
+#define MAX_FRAMES_IN_FLIGHT 2
+
+// Meshes in data/mesh, "--cook" turns <name>.obj into <name>.tmesh and the renderer only ever loads the latter
+static const char *mesh_names[] = { "prim_cube", "prim_sphere", "button", "chamber0001" };
+#define MESH_COUNT (sizeof(mesh_names) / sizeof(*mesh_names))
+// The level, drawn through meshlet culling
+#define MESH_LEVEL 3
+// Screen space error the level's LODs may add, in pixels
+#define LEVEL_LOD_PIXELS 1.0f
+// Stand-in camera's vertical field of view, radians
+#define CAMERA_FOV_Y 1.2f
+
+struct swap_chain_t {
+    VkSurfaceCapabilitiesKHR capabilities;
+    std::vector<VkSurfaceFormatKHR> formats;
+    std::vector<VkPresentModeKHR> present_modes;
+    VkSurfaceFormatKHR surface_format;
+    VkPresentModeKHR present_mode;
+    VkExtent2D extent;
+    VkSwapchainKHR swap_chain;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> views;
+};
+
+struct frame_t {
+    VkCommandBuffer command_buffer;
+    VkSemaphore image_available;
+    VkSemaphore render_finished;
+    VkFence in_flight;
+};
+
+// Creates the swap chain, or recreates it if one already exists (e.g. present policy changed or window resized).
+// The old swap chain is retired through the deletion queue once the current frame completes.
+static bool swap_chain_create(swap_chain_t &swap_chain, VkPhysicalDevice physical_device, VkDevice logical_device,
+    VkSurfaceKHR surface, ta_present_policy policy, uint32_t window_w, uint32_t window_h,
+    ta_deletion_queue &deletion_queue, uint64_t frame_number)
+{
+    VkResult err = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &swap_chain.capabilities);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query physical device surface capabitilities.\n", err);
+        return false;
+    }
+
+    if (swap_chain.capabilities.currentExtent.width != UINT32_MAX) {
+        swap_chain.extent = swap_chain.capabilities.currentExtent;
+    } else {
+        swap_chain.extent.width = std::max(swap_chain.capabilities.minImageExtent.width, std::min(swap_chain.capabilities.maxImageExtent.width, window_w));
+        swap_chain.extent.height = std::max(swap_chain.capabilities.minImageExtent.height, std::min(swap_chain.capabilities.maxImageExtent.height, window_h));
+    }
+
+    // https://vulkan-tutorial.com/en/Drawing_a_triangle/Presentation/Swap_chain
+    // Choosing the right settings for the swap chain
+    swap_chain.present_mode = ta_present_mode_select(policy, swap_chain.present_modes);
+    uint32_t swap_chain_image_count = ta_present_image_count(policy, swap_chain.capabilities);
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Present policy %s: mode %s, %u images\n", ta_present_policy_str(policy),
+        ta_present_mode_str(swap_chain.present_mode), swap_chain_image_count);
+
+    // NOTE: The clear pass clears the swap chain images directly, outside the level's render pass, which needs
+    // TRANSFER_DST
+    VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    assert((swap_chain.capabilities.supportedUsageFlags & image_usage) == image_usage);
+
+    VkSwapchainKHR old_swap_chain = swap_chain.swap_chain;
+
+    VkSwapchainCreateInfoKHR swap_chain_create_info = {};
+    swap_chain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swap_chain_create_info.surface = surface;
+    swap_chain_create_info.minImageCount = swap_chain_image_count;
+    swap_chain_create_info.imageFormat = swap_chain.surface_format.format;
+    swap_chain_create_info.imageColorSpace = swap_chain.surface_format.colorSpace;
+    swap_chain_create_info.imageExtent = swap_chain.extent;
+    swap_chain_create_info.imageArrayLayers = 1;
+    swap_chain_create_info.imageUsage = image_usage;
+    // NOTE: Assumes graphics_queue == present_queue, which we are currently
+    // guaranteeing by only having a single index and asserting when not found.
+    swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    swap_chain_create_info.preTransform = swap_chain.capabilities.currentTransform;
+    swap_chain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swap_chain_create_info.presentMode = swap_chain.present_mode;
+    // NOTE: May want to disable surface clipping if we do e.g. screenshots.
+    swap_chain_create_info.clipped = VK_TRUE;
+    // NOTE: This is used when recreating the swap chain, e.g. on window resize
+    swap_chain_create_info.oldSwapchain = old_swap_chain;
+
+    err = vkCreateSwapchainKHR(logical_device, &swap_chain_create_info, NULL, &swap_chain.swap_chain);
+    ta_deletion_queue_push(deletion_queue, DELETION_SWAPCHAIN, TA_VK_HANDLE(old_swap_chain), frame_number);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create swap chain.\n", err);
+        swap_chain.swap_chain = VK_NULL_HANDLE;
+        return false;
+    }
+
+    uint32_t image_count = 0;
+    vkGetSwapchainImagesKHR(logical_device, swap_chain.swap_chain, &image_count, NULL);
+    swap_chain.images.resize(image_count);
+    err = vkGetSwapchainImagesKHR(logical_device, swap_chain.swap_chain, &image_count, swap_chain.images.data());
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query swap chain images.\n", err);
+        return false;
+    }
+
+    for (VkImageView view : swap_chain.views) {
+        ta_deletion_queue_push(deletion_queue, DELETION_IMAGE_VIEW, TA_VK_HANDLE(view), frame_number);
+    }
+    swap_chain.views.assign(image_count, VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < image_count; ++i) {
+        VkImageViewCreateInfo view_create_info = {};
+        view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_create_info.image = swap_chain.images[i];
+        view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_create_info.format = swap_chain.surface_format.format;
+        view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_create_info.subresourceRange.levelCount = 1;
+        view_create_info.subresourceRange.layerCount = 1;
+        err = vkCreateImageView(logical_device, &view_create_info, NULL, &swap_chain.views[i]);
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create swap chain image view.\n", err);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Best depth format the device can render to. One of these two is always supported.
+static VkFormat depth_format_select(VkPhysicalDevice physical_device)
+{
+    VkFormatProperties properties = {};
+    vkGetPhysicalDeviceFormatProperties(physical_device, VK_FORMAT_D32_SFLOAT, &properties);
+    if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+        return VK_FORMAT_D32_SFLOAT;
+    }
+    return VK_FORMAT_X8_D24_UNORM_PACK32;
+}
+
+struct clear_pass_t {
+    ta_rg_resource target;
+    VkClearColorValue color;
+};
+
+// Layout transitions before and after are the render graph's problem
+static void clear_pass(VkCommandBuffer command_buffer, ta_render_graph &graph, ta_rg_pass pass, void *userdata)
+{
+    UNUSED(pass);
+    clear_pass_t &clear = *(clear_pass_t *)userdata;
+
+    VkImageSubresourceRange range = {};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.levelCount = 1;
+    range.layerCount = 1;
+    vkCmdClearColorImage(command_buffer, graph.resources[clear.target].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        &clear.color, 1, &range);
+}
+
+struct meshlet_cull_pass_t {
+    ta_meshlet_culler *culler;
+    const ta_mesh *mesh;
+    ta_meshlet_cull_constants constants;
+    std::vector<uint32_t> lods;     // per submesh, picked from the camera every frame
+};
+
+// The draw buffer isn't a graph resource, the culler handles its own barriers
+static void meshlet_cull_pass(VkCommandBuffer command_buffer, ta_render_graph &graph, ta_rg_pass pass,
+    void *userdata)
+{
+    UNUSED(graph);
+    UNUSED(pass);
+    meshlet_cull_pass_t &cull = *(meshlet_cull_pass_t *)userdata;
+    ta_meshlet_cull(*cull.culler, *cull.mesh, command_buffer, cull.constants, cull.lods.data());
+}
+
+struct level_pass_t {
+    VkDevice device;
+    ta_deletion_queue *deletion_queue;
+    uint64_t frame;
+    VkRenderPass render_pass;
+    ta_rg_resource color;
+    ta_rg_resource depth;
+    ta_shader_library *shaders;
+    ta_shader_pipeline_handle pipeline;     // TA_SHADER_INVALID until the level is loaded
+    ta_meshlet_culler *culler;
+    const ta_mesh *mesh;
+    const ta_meshlet_cull_constants *constants;
+    const std::vector<uint32_t> *lods;
+    float view_projection[16];
+    ta_frame_allocator *frame_allocator;
+    ta_descriptor_allocator *descriptors;
+    ta_jobs *jobs;
+    ta_cmd_recorder *recorder;          // NULL records inline
+    const ta_pipeline_stats *pipeline_stats;
+    // Set by level_pass for level_record
+    VkPipeline bound_pipeline;
+    const ta_spirv_layout *layout;
+    VkDescriptorSet view_set;
+    VkExtent2D extent;
+};
+
+// Color is loaded (the clear pass ran first) and left in COLOR_ATTACHMENT, the render graph does every transition
+// around the pass. That's also why there are no subpass dependencies.
+static VkRenderPass level_render_pass_create(VkDevice device, VkFormat color_format, VkFormat depth_format)
+{
+    VkAttachmentDescription attachments[2] = {};
+    attachments[0].format = color_format;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[1].format = depth_format;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference color_reference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference depth_reference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_reference;
+    subpass.pDepthStencilAttachment = &depth_reference;
+
+    VkRenderPassCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.attachmentCount = 2;
+    create_info.pAttachments = attachments;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    VkResult err = vkCreateRenderPass(device, &create_info, NULL, &render_pass);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create level render pass.\n", err);
+    }
+    return render_pass;
+}
+
+// Records submeshes [first, first + count) of the level. A secondary starts out with no state, so every chunk binds
+// everything itself.
+static void level_record(VkCommandBuffer command_buffer, uint32_t first, uint32_t count, void *userdata)
+{
+    const level_pass_t &level = *(const level_pass_t *)userdata;
+    VkViewport viewport = { 0.0f, 0.0f, (float)level.extent.width, (float)level.extent.height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, level.extent };
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, level.bound_pipeline);
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, level.layout->layout, 0, 1,
+        &level.view_set, 0, NULL);
+    ta_mesh_push_decode(*level.mesh, command_buffer, level.layout->layout, level.layout->push_constants.stageFlags,
+        0);
+    ta_mesh_bind(*level.mesh, command_buffer);
+    ta_meshlet_draw(*level.culler, *level.mesh, command_buffer, *level.constants, level.lods->data(), first, count);
+}
+
+// Draws the meshlets the cull pass kept (or culls on the CPU if it couldn't run) and the submeshes far enough away
+// for a simplified LOD. The submeshes are the draw list for the parallel recorder. The framebuffer is made every
+// frame and retired with it, the swap chain image it wraps changes every frame anyway.
+static void level_pass(VkCommandBuffer command_buffer, ta_render_graph &graph, ta_rg_pass pass, void *userdata)
+{
+    UNUSED(pass);
+    level_pass_t &level = *(level_pass_t *)userdata;
+    if (level.pipeline == TA_SHADER_INVALID || !level.mesh->buffer.buffer) {
+        return;
+    }
+    level.bound_pipeline = ta_shader_pipeline_get(*level.shaders, level.pipeline, &level.layout);
+    if (!level.bound_pipeline) {
+        return;
+    }
+
+    // The view projection is a uniform in this frame's slice of the frame allocator, one set for every chunk
+    ta_frame_alloc view = ta_frame_alloc_uniform(*level.frame_allocator, sizeof(level.view_projection));
+    if (!view.ptr) {
+        return;
+    }
+    memcpy(view.ptr, level.view_projection, sizeof(level.view_projection));
+    ta_descriptor_write view_write = {};
+    view_write.binding = 0;
+    view_write.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    view_write.buffer.buffer = view.buffer;
+    view_write.buffer.offset = view.offset;
+    view_write.buffer.range = sizeof(level.view_projection);
+    level.view_set = ta_descriptor_set_get(*level.descriptors, level.layout->sets[0], &view_write, 1, true);
+    if (!level.view_set) {
+        return;
+    }
+
+    const ta_rg_resource_desc &color = graph.resources[level.color];
+    const ta_rg_resource_desc &depth = graph.resources[level.depth];
+    // NOTE: The depth buffer is sized for the swap chain at startup, the window can't be resized
+    VkExtent2D extent = {
+        std::min(color.extent.width, depth.extent.width),
+        std::min(color.extent.height, depth.extent.height),
+    };
+    VkImageView attachments[2] = { color.view, depth.view };
+    VkFramebufferCreateInfo framebuffer_create_info = {};
+    framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_create_info.renderPass = level.render_pass;
+    framebuffer_create_info.attachmentCount = 2;
+    framebuffer_create_info.pAttachments = attachments;
+    framebuffer_create_info.width = extent.width;
+    framebuffer_create_info.height = extent.height;
+    framebuffer_create_info.layers = 1;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkResult err = vkCreateFramebuffer(level.device, &framebuffer_create_info, NULL, &framebuffer);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create level framebuffer.\n", err);
+        return;
+    }
+    ta_deletion_queue_push(*level.deletion_queue, DELETION_FRAMEBUFFER, TA_VK_HANDLE(framebuffer), level.frame);
+
+    VkClearValue clear_values[2] = {};
+    clear_values[1].depthStencil.depth = 1.0f;
+    VkRenderPassBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    begin_info.renderPass = level.render_pass;
+    begin_info.framebuffer = framebuffer;
+    begin_info.renderArea.extent = extent;
+    begin_info.clearValueCount = 2;
+    begin_info.pClearValues = clear_values;
+    level.extent = extent;
+    uint32_t submesh_count = (uint32_t)level.mesh->submeshes.size();
+    if (level.recorder) {
+        vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        VkCommandBufferInheritanceInfo inheritance = {};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = level.render_pass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = framebuffer;
+        ta_pipeline_stats_inheritance(*level.pipeline_stats, inheritance);
+        ta_cmd_record_parallel(*level.recorder, *level.jobs, command_buffer, inheritance, submesh_count,
+            level_record, &level);
+    } else {
+        vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        level_record(command_buffer, 0, submesh_count, &level);
+    }
+    vkCmdEndRenderPass(command_buffer);
+}
+
+// Stand-in camera until there's input for one: stands in the middle of a mesh and turns on the spot. Column major
+// view projection, right handed, Vulkan clip space (y down, depth 0..1).
+static void camera_turn(const ta_mesh_bounds &bounds, float yaw, float aspect, float view_projection[16],
+    float eye[3], float forward[3])
+{
+    const float z_near = 0.05f;
+    const float z_far = std::max(bounds.radius * 4.0f, 1.0f);
+    eye[0] = bounds.center[0];
+    eye[1] = bounds.center[1];
+    eye[2] = bounds.center[2];
+    forward[0] = cosf(yaw);
+    forward[1] = 0.0f;
+    forward[2] = sinf(yaw);
+    float side[3] = { -forward[2], 0.0f, forward[0] };   // forward x +y
+    float up[3] = { 0.0f, 1.0f, 0.0f };
+    float view[4][4] = {    // [row][column]
+        { side[0], side[1], side[2], -(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]) },
+        { up[0], up[1], up[2], -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]) },
+        { -forward[0], -forward[1], -forward[2], forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2] },
+        { 0.0f, 0.0f, 0.0f, 1.0f },
+    };
+    float focal = 1.0f / tanf(CAMERA_FOV_Y * 0.5f);
+    float projection[4][4] = {
+        { focal / aspect, 0.0f, 0.0f, 0.0f },
+        { 0.0f, -focal, 0.0f, 0.0f },
+        { 0.0f, 0.0f, z_far / (z_near - z_far), z_near * z_far / (z_near - z_far) },
+        { 0.0f, 0.0f, -1.0f, 0.0f },
+    };
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                sum += projection[row][k] * view[k][column];
+            }
+            view_projection[column * 4 + row] = sum;
+        }
+    }
+}
+
+// Stand-in props until there's a scene to load: every mesh but the level circles the middle of the level at half its
+// radius, spinning as it goes. 3x4 row major object to world, for ta_bvh_dynamic.
+static void prop_transform(const ta_mesh_bounds &level, uint32_t prop, float t, float transform[12])
+{
+    float orbit = t * 0.1f + 6.2831853f * prop / (MESH_COUNT - 1);
+    float spin = t;
+    float c = cosf(spin);
+    float s = sinf(spin);
+    float m[12] = {
+        c,    0.0f, s,    level.center[0] + cosf(orbit) * level.radius * 0.5f,
+        0.0f, 1.0f, 0.0f, level.center[1],
+        -s,   0.0f, c,    level.center[2] + sinf(orbit) * level.radius * 0.5f,
+    };
+    memcpy(transform, m, sizeof(m));
+}
+
 int main(int argc, char *argv[])
 {
-    UNUSED(argc);
-    UNUSED(argv);
     const uint32_t window_w = 1280;
     const uint32_t window_h = 720;
 
     ta_log_init_file(tg_debug_log, "log.txt", true, true, SRC_ALL, SRC_NONE);
 
+    // Present policy is chosen per deployment via "--present <policy>", and can be switched at runtime with F1-F3
+    ta_present_policy present_policy = PRESENT_POLICY_POWER_SAVING;
+    // Worker threads for parallel recording etc., "--threads <n>" overrides one per core
+    uint32_t worker_count = ta_jobs_default_worker_count();
+    // GPU timings are always collected and summarized on exit, "--gpu-trace" also logs every scope of every frame
+    bool gpu_trace = false;
+    // Per-pass pipeline statistics averaged over N frames via "--pipeline-stats <n>", shown in the window title
+    uint32_t pipeline_stats_frames = 0;
+    // SPIR-V is loaded from "--shaders <dir>", "--hot-reload" watches it and rebuilds pipelines when a shader changes
+    const char *shader_directory = "data/shader";
+    bool hot_reload = false;
+    // "--bench-dispatch" times command recording through the loader vs. straight into the driver at startup
+    bool bench_dispatch = false;
+    // Validation layer + messenger, on by default in debug builds. "--validation"/"--no-validation" override it per
+    // run (profile with it off), "--vk-mute <id>" silences a message ID from the start, F5 mutes the last one logged.
+#if _DEBUG
+    bool validation = true;
+#else
+    bool validation = false;
+#endif
+    std::vector<int32_t> muted_messages;
+    // "--caps-refresh" ignores the capability snapshot and enumerates (and logs) everything again
+    bool caps_refresh = false;
+    // "--bench-obj [triangles]" times the OBJ loader against tinyobj on the repo meshes and a synthetic mesh, then
+    // exits
+    uint32_t bench_obj_triangles = 0;
+    // "--bench-bvh [triangles]" times BVH builds and raycasts on the repo meshes and on the level tiled up to that
+    // many triangles, then exits
+    uint32_t bench_bvh_triangles = 0;
+    // "--bench-bvh-dynamic [props]" times refits, rebuilds and batched queries of the top level BVH over that many
+    // moving props, then exits
+    uint32_t bench_bvh_dynamic_props = 0;
+    // "--bench-tangent [triangles]" times tangent generation on the repo meshes and on the level tiled up to that
+    // many triangles, then exits
+    uint32_t bench_tangent_triangles = 0;
+    // "--test-render-graph" compiles a few render graphs without a device, checks the barriers they infer, then exits
+    bool test_render_graph = false;
+    // "--cook" runs the mesh cooker over data/mesh and exits. Vertices are quantized unless "--cook-float", meshes that
+    // don't fit "--cook-tolerance <position>,<normal degrees>,<uv>" are kept at full precision. LODs are simplified
+    // down to "--cook-lod-error <fraction of the bounding radius>", 0 for none.
+    bool cook = false;
+    ta_mesh_cook_options cook_options = {};
+    cook_options.vertex_format = MESH_VERTEX_QUANTIZED;
+    cook_options.tolerance.position = TA_MESH_QUANT_POSITION_TOLERANCE;
+    cook_options.tolerance.normal_degrees = TA_MESH_QUANT_NORMAL_TOLERANCE;
+    cook_options.tolerance.uv = TA_MESH_QUANT_UV_TOLERANCE;
+    cook_options.lod_error = TA_MESH_SIMPLIFY_ERROR;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--present") && i + 1 < argc) {
+            if (!ta_present_policy_parse(argv[++i], &present_policy)) {
+                ta_log_write(tg_debug_log, SRC_VULKAN, "Unknown present policy '%s', expected low_latency, "
+                    "power_saving or fifo_relaxed.\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            worker_count = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--gpu-trace")) {
+            gpu_trace = true;
+        } else if (!strcmp(argv[i], "--pipeline-stats") && i + 1 < argc) {
+            pipeline_stats_frames = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--shaders") && i + 1 < argc) {
+            shader_directory = argv[++i];
+        } else if (!strcmp(argv[i], "--hot-reload")) {
+            hot_reload = true;
+        } else if (!strcmp(argv[i], "--bench-dispatch")) {
+            bench_dispatch = true;
+        } else if (!strcmp(argv[i], "--validation")) {
+            validation = true;
+        } else if (!strcmp(argv[i], "--no-validation")) {
+            validation = false;
+        } else if (!strcmp(argv[i], "--caps-refresh")) {
+            caps_refresh = true;
+        } else if (!strcmp(argv[i], "--vk-mute") && i + 1 < argc) {
+            muted_messages.push_back((int32_t)strtoul(argv[++i], NULL, 0));
+        } else if (!strcmp(argv[i], "--cook")) {
+            cook = true;
+        } else if (!strcmp(argv[i], "--cook-float")) {
+            cook_options.vertex_format = MESH_VERTEX_FLOAT;
+        } else if (!strcmp(argv[i], "--cook-tolerance") && i + 1 < argc) {
+            ta_mesh_quant_tolerance &tolerance = cook_options.tolerance;
+            if (sscanf(argv[++i], "%f,%f,%f", &tolerance.position, &tolerance.normal_degrees, &tolerance.uv) != 3) {
+                ta_log_write(tg_debug_log, SRC_FILE, "Expected --cook-tolerance <position>,<normal degrees>,<uv>, "
+                    "got '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--cook-lod-error") && i + 1 < argc) {
+            cook_options.lod_error = (float)atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--bench-bvh")) {
+            bench_bvh_triangles = 1000000;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                bench_bvh_triangles = (uint32_t)atoi(argv[++i]);
+            }
+        } else if (!strcmp(argv[i], "--bench-bvh-dynamic")) {
+            bench_bvh_dynamic_props = 10000;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                bench_bvh_dynamic_props = (uint32_t)atoi(argv[++i]);
+            }
+        } else if (!strcmp(argv[i], "--bench-tangent")) {
+            bench_tangent_triangles = 2000000;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                bench_tangent_triangles = (uint32_t)atoi(argv[++i]);
+            }
+        } else if (!strcmp(argv[i], "--test-render-graph")) {
+            test_render_graph = true;
+        } else if (!strcmp(argv[i], "--bench-obj")) {
+            bench_obj_triangles = 2000000;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                bench_obj_triangles = (uint32_t)atoi(argv[++i]);
+            }
+        }
+    }
+
     // Create an SDL window that supports Vulkan rendering.
     ta_log_write(tg_debug_log, SRC_SDL, "Initializing SDL\n");
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
@@ -29,6 +561,44 @@ int main(int argc, char *argv[])
 
     ta_timer_init();
 
+    if (cook || bench_obj_triangles || bench_bvh_triangles || bench_bvh_dynamic_props || bench_tangent_triangles ||
+        test_render_graph) {
+        char obj_paths[MESH_COUNT][64] = {};
+        const char *obj_path_list[MESH_COUNT] = {};
+        for (uint32_t i = 0; i < MESH_COUNT; ++i) {
+            snprintf(obj_paths[i], sizeof(obj_paths[i]), "data/mesh/%s.obj", mesh_names[i]);
+            obj_path_list[i] = obj_paths[i];
+        }
+        ta_jobs offline_jobs = {};
+        ta_jobs_init(offline_jobs, worker_count);
+        bool ok = true;
+        if (cook) {
+            for (uint32_t i = 0; i < MESH_COUNT; ++i) {
+                char mesh_path[64] = {};
+                snprintf(mesh_path, sizeof(mesh_path), "data/mesh/%s.tmesh", mesh_names[i]);
+                ok &= ta_mesh_cook(obj_paths[i], mesh_path, cook_options, &offline_jobs);
+            }
+        }
+        if (bench_obj_triangles) {
+            ta_obj_benchmark(offline_jobs, obj_path_list, MESH_COUNT, bench_obj_triangles);
+        }
+        if (bench_bvh_triangles) {
+            ta_bvh_benchmark(offline_jobs, obj_path_list, MESH_COUNT, bench_bvh_triangles);
+        }
+        if (bench_bvh_dynamic_props) {
+            ta_bvh_dynamic_benchmark(offline_jobs, obj_path_list, MESH_COUNT, bench_bvh_dynamic_props);
+        }
+        if (bench_tangent_triangles) {
+            ta_mesh_tangent_benchmark(offline_jobs, obj_path_list, MESH_COUNT, bench_tangent_triangles);
+        }
+        if (test_render_graph) {
+            ok &= ta_render_graph_self_test(tg_debug_log);
+        }
+        ta_jobs_free(offline_jobs);
+        SDL_Quit();
+        return ok ? 0 : 1;
+    }
+
     ta_log_write(tg_debug_log, SRC_SDL, "Creating window\n");
     SDL_Window* window = SDL_CreateWindow("Vulkan Window", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, window_w,
         window_h, SDL_WINDOW_VULKAN);
@@ -37,58 +607,12 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    VkResult err = {};
-
-#ifdef QUERY_AVAILABLE_EXTENSIONS_AND_LAYERS
-    {
-        // Query available instance extensions
-        ta_log_write(tg_debug_log, SRC_VULKAN, "Querying available instance extensions\n");
-        std::vector<VkExtensionProperties> available_extensions;
-        {
-            uint32_t available_extensions_count = 0;
-            err = vkEnumerateInstanceExtensionProperties(NULL, &available_extensions_count, NULL);
-            if (err) {
-                ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query count of available instance extensions.\n", err);
-                return 1;
-            }
-
-            available_extensions.resize(available_extensions_count);
-            err = vkEnumerateInstanceExtensionProperties(NULL, &available_extensions_count, available_extensions.data());
-            if (err) {
-                ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available instance extensions.\n", err);
-                return 1;
-            }
-        }
-        ta_log_write(tg_debug_log, SRC_VULKAN, "Found %d available extensions:\n", available_extensions.size());
-        for (VkExtensionProperties &property : available_extensions) {
-            ta_log_write(tg_debug_log, SRC_VULKAN, "    %s\n", property.extensionName);
-        }
+    // SDL opened the Vulkan loader for the window, get everything else through it
+    if (!ta_vk_dispatch_init((PFN_vkGetInstanceProcAddr)SDL_Vulkan_GetVkGetInstanceProcAddr())) {
+        return 1;
     }
 
-    {
-        // Query available instance layers
-        ta_log_write(tg_debug_log, SRC_VULKAN, "Querying available instance layers\n");
-        std::vector <VkLayerProperties> available_layers;
-        {
-            uint32_t available_layers_count = 0;
-            err = vkEnumerateInstanceLayerProperties(&available_layers_count, NULL);
-            if (err) {
-                ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query count of available instance layers.\n", err);
-                return 1;
-            }
-            available_layers.resize(available_layers_count);
-            err = vkEnumerateInstanceLayerProperties(&available_layers_count, available_layers.data());
-            if (err) {
-                ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available instance layers.\n", err);
-                return 1;
-            }
-        }
-        ta_log_write(tg_debug_log, SRC_VULKAN, "Found %d available layers:\n", available_layers.size());
-        for (VkLayerProperties &layer : available_layers) {
-            ta_log_write(tg_debug_log, SRC_VULKAN, "    %s\n", layer.layerName);
-        }
-    }
-#endif
+    VkResult err = {};
 
     // Get WSI extensions from SDL (we can add more if we like - we just can't remove these)
     // "VK_KHR_surface"
@@ -108,13 +632,11 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Use validation layers if this is a debug build
+    // Validation layers are found through
     // HKEY_LOCAL_MACHINE\SOFTWARE\Khronos\Vulkan\ExplicitLayers
     // HKEY_LOCAL_MACHINE\SOFTWARE\Khronos\Vulkan\ImplicitLayers
+    // ta_vk_debug_init adds them below, along with VK_EXT_debug_utils
     std::vector<const char *> layers;
-#if _DEBUG
-    layers.push_back("VK_LAYER_KHRONOS_validation");
-#endif
 
     // VkApplicationInfo allows the programmer to specifiy some basic information about the
     // program, which can be useful for layers and tools to provide more debug information.
@@ -125,7 +647,11 @@ int main(int argc, char *argv[])
     appInfo.applicationVersion = VK_MAKE_VERSION(0, 1, 0);;
     appInfo.pEngineName = "RicoTech";
     appInfo.engineVersion = VK_MAKE_VERSION(0, 1, 0);;
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    // NOTE: Ask for 1.1 when the loader has it, we need vkGetPhysicalDeviceFeatures2 to query descriptor indexing.
+    // On a 1.0 loader the dispatch table's vkEnumerateInstanceVersion reports 1.0.
+    uint32_t instance_version = VK_API_VERSION_1_0;
+    vkEnumerateInstanceVersion(&instance_version);
+    appInfo.apiVersion = instance_version >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
 
     // VkInstanceCreateInfo is where the programmer specifies the layers and/or extensions that
     // are needed.
@@ -134,6 +660,8 @@ int main(int argc, char *argv[])
     instInfo.pNext = NULL;
     instInfo.flags = 0;
     instInfo.pApplicationInfo = &appInfo;
+    ta_vk_debug vk_debug = {};
+    ta_vk_debug_init(vk_debug, validation, layers, extensions, instInfo);
     instInfo.enabledExtensionCount = (uint32_t)extensions.size();
     instInfo.ppEnabledExtensionNames = extensions.data();
     instInfo.enabledLayerCount = (uint32_t)layers.size();
@@ -150,6 +678,11 @@ int main(int argc, char *argv[])
         ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create Vulkan instance.\n", err);
         return 1;
     }
+    ta_vk_dispatch_load_instance(instance);
+    ta_vk_debug_create(vk_debug, instance);
+    for (int32_t id : muted_messages) {
+        ta_vk_debug_mute(vk_debug, id, true);
+    }
 
     // Create a Vulkan surface for rendering
     ta_log_write(tg_debug_log, SRC_SDL, "Creating Vulkan surface\n");
@@ -159,180 +692,33 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-#define VK_VERSION_ARGS(ver) VK_VERSION_MAJOR(ver), VK_VERSION_MINOR(ver), VK_VERSION_PATCH(ver)
-
-    ta_log_write(tg_debug_log, SRC_VULKAN, "Querying avilable physical devices\n");
-    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
-    std::vector<VkPhysicalDevice> physical_devices;
-    {
-        uint32_t physical_devices_count = 0;
-        err = vkEnumeratePhysicalDevices(instance, &physical_devices_count, NULL);
-        if (err) {
-            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query count of available physical devices.\n", err);
-            return 1;
-        }
-        physical_devices.resize(physical_devices_count);
-        err = vkEnumeratePhysicalDevices(instance, &physical_devices_count, physical_devices.data());
-        if (err) {
-            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available physical devices.\n", err);
-            return 1;
-        }
+    // Capabilities come from a snapshot while the drivers stay the same, "--caps-refresh" forces a full enumeration
+    ta_caps caps = {};
+    if (!ta_caps_init(caps, instance, appInfo.apiVersion, "vk_caps.bin", caps_refresh)) {
+        return 1;
     }
-    ta_log_write(tg_debug_log, SRC_VULKAN, "Found %d available physical devices:\n", physical_devices.size());
+    ta_caps_report(caps, tg_debug_log);
 
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    const ta_caps_device *physical_device_caps = NULL;
     int queue_family_index = -1;
-    for (VkPhysicalDevice &device : physical_devices) {
-        VkPhysicalDeviceProperties device_properties = {};
-        vkGetPhysicalDeviceProperties(device, &device_properties);
-        const char *device_type = "<unknown>";
-        switch (device_properties.deviceType) {
-            case VK_PHYSICAL_DEVICE_TYPE_OTHER:
-                device_type = "OTHER";
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-                device_type = "INTEGRATED_GPU";
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-                device_type = "DISCRETE_GPU";
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
-                device_type = "VIRTUAL_GPU";
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_CPU :
-                device_type = "CPU";
-                break;
-        }
-        ta_log_write(tg_debug_log, SRC_VULKAN, "    Device Properties:\n");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        apiVersion      : %u.%u.%u\n", VK_VERSION_ARGS(device_properties.apiVersion));
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        driverVersion   : %u.%u.%u\n", VK_VERSION_ARGS(device_properties.driverVersion));
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        vendorID        : %u\n",       device_properties.vendorID);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        deviceID        : %u\n",       device_properties.deviceID);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        deviceName      : %s\n",       device_properties.deviceName);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        deviceType      : %d (%s)\n",  device_properties.deviceType, device_type);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        limits:\n");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            maxImageDimension1D                      : %u\n", device_properties.limits.maxImageDimension1D);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            maxImageDimension2D                      : %u\n", device_properties.limits.maxImageDimension2D);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            maxImageDimension3D                      : %u\n", device_properties.limits.maxImageDimension3D);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            TODO: Show the rest of the fields in device_properties.limits\n");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseProperties:\n");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            residencyStandard2DBlockShape            : %s\n", device_properties.sparseProperties.residencyStandard2DBlockShape            ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            residencyStandard2DMultisampleBlockShape : %s\n", device_properties.sparseProperties.residencyStandard2DMultisampleBlockShape ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            residencyStandard3DBlockShape            : %s\n", device_properties.sparseProperties.residencyStandard3DBlockShape            ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            residencyAlignedMipSize                  : %s\n", device_properties.sparseProperties.residencyAlignedMipSize                  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "            residencyNonResidentStrict               : %s\n", device_properties.sparseProperties.residencyNonResidentStrict               ? "True" : "False");
-
-        VkPhysicalDeviceFeatures device_features = {};
-        vkGetPhysicalDeviceFeatures(device, &device_features);
-        ta_log_write(tg_debug_log, SRC_VULKAN, "    Device Features:\n");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        robustBufferAccess                      : %s\n", device_features.robustBufferAccess                      ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        fullDrawIndexUint32                     : %s\n", device_features.fullDrawIndexUint32                     ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        imageCubeArray                          : %s\n", device_features.imageCubeArray                          ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        independentBlend                        : %s\n", device_features.independentBlend                        ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        geometryShader                          : %s\n", device_features.geometryShader                          ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        tessellationShader                      : %s\n", device_features.tessellationShader                      ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sampleRateShading                       : %s\n", device_features.sampleRateShading                       ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        dualSrcBlend                            : %s\n", device_features.dualSrcBlend                            ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        logicOp                                 : %s\n", device_features.logicOp                                 ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        multiDrawIndirect                       : %s\n", device_features.multiDrawIndirect                       ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        drawIndirectFirstInstance               : %s\n", device_features.drawIndirectFirstInstance               ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        depthBiasClamp                          : %s\n", device_features.depthBiasClamp                          ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        depthBiasClamp                          : %s\n", device_features.depthBiasClamp                          ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        fillModeNonSolid                        : %s\n", device_features.fillModeNonSolid                        ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        depthBounds                             : %s\n", device_features.depthBounds                             ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        wideLines                               : %s\n", device_features.wideLines                               ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        largePoints                             : %s\n", device_features.largePoints                             ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        alphaToOne                              : %s\n", device_features.alphaToOne                              ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        multiViewport                           : %s\n", device_features.multiViewport                           ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        samplerAnisotropy                       : %s\n", device_features.samplerAnisotropy                       ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        textureCompressionETC2                  : %s\n", device_features.textureCompressionETC2                  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        textureCompressionASTC_LDR              : %s\n", device_features.textureCompressionASTC_LDR              ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        textureCompressionBC                    : %s\n", device_features.textureCompressionBC                    ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        occlusionQueryPrecise                   : %s\n", device_features.occlusionQueryPrecise                   ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        pipelineStatisticsQuery                 : %s\n", device_features.pipelineStatisticsQuery                 ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        vertexPipelineStoresAndAtomics          : %s\n", device_features.vertexPipelineStoresAndAtomics          ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        fragmentStoresAndAtomics                : %s\n", device_features.fragmentStoresAndAtomics                ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderTessellationAndGeometryPointSize  : %s\n", device_features.shaderTessellationAndGeometryPointSize  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderImageGatherExtended               : %s\n", device_features.shaderImageGatherExtended               ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderStorageImageExtendedFormats       : %s\n", device_features.shaderStorageImageExtendedFormats       ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderStorageImageMultisample           : %s\n", device_features.shaderStorageImageMultisample           ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderStorageImageReadWithoutFormat     : %s\n", device_features.shaderStorageImageReadWithoutFormat     ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderStorageImageWriteWithoutFormat    : %s\n", device_features.shaderStorageImageWriteWithoutFormat    ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderUniformBufferArrayDynamicIndexing : %s\n", device_features.shaderUniformBufferArrayDynamicIndexing ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderSampledImageArrayDynamicIndexing  : %s\n", device_features.shaderSampledImageArrayDynamicIndexing  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderStorageBufferArrayDynamicIndexing : %s\n", device_features.shaderStorageBufferArrayDynamicIndexing ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderStorageImageArrayDynamicIndexing  : %s\n", device_features.shaderStorageImageArrayDynamicIndexing  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderClipDistance                      : %s\n", device_features.shaderClipDistance                      ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderCullDistance                      : %s\n", device_features.shaderCullDistance                      ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderFloat64                           : %s\n", device_features.shaderFloat64                           ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderInt64                             : %s\n", device_features.shaderInt64                             ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderInt16                             : %s\n", device_features.shaderInt16                             ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderResourceResidency                 : %s\n", device_features.shaderResourceResidency                 ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        shaderResourceMinLod                    : %s\n", device_features.shaderResourceMinLod                    ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseBinding                           : %s\n", device_features.sparseBinding                           ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidencyBuffer                   : %s\n", device_features.sparseResidencyBuffer                   ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidencyImage2D                  : %s\n", device_features.sparseResidencyImage2D                  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidencyImage3D                  : %s\n", device_features.sparseResidencyImage3D                  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidency2Samples                 : %s\n", device_features.sparseResidency2Samples                 ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidency4Samples                 : %s\n", device_features.sparseResidency4Samples                 ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidency8Samples                 : %s\n", device_features.sparseResidency8Samples                 ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidency16Samples                : %s\n", device_features.sparseResidency16Samples                ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        sparseResidencyAliased                  : %s\n", device_features.sparseResidencyAliased                  ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        variableMultisampleRate                 : %s\n", device_features.variableMultisampleRate                 ? "True" : "False");
-        ta_log_write(tg_debug_log, SRC_VULKAN, "        inheritedQueries                        : %s\n", device_features.inheritedQueries                        ? "True" : "False");
-
-        {
-            // Query available instance extensions
-            ta_log_write(tg_debug_log, SRC_VULKAN, "Querying available instance extensions\n");
-            std::vector <VkExtensionProperties> available_device_extensions;
-            {
-                uint32_t available_device_extensions_count = 0;
-                err = vkEnumerateDeviceExtensionProperties(device, NULL, &available_device_extensions_count, NULL);
-                if (err) {
-                    ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query count of available instance extensions.\n", err);
-                    return 1;
-                }
-                available_device_extensions.resize(available_device_extensions_count);
-                err = vkEnumerateDeviceExtensionProperties(device, NULL, &available_device_extensions_count, available_device_extensions.data());
-                if (err) {
-                    ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available instance extensions.\n", err);
-                    return 1;
-                }
-                //DLB_ASSERT(available_device_extensions_count < 32);  // Make sure we passed a big enough array
-            }
-            ta_log_write(tg_debug_log, SRC_VULKAN, "Found %d available device extensions:\n", available_device_extensions.size());
-            for (VkExtensionProperties &extension : available_device_extensions) {
-                if (!strcmp(extension.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
-                    physical_device = device;
-                }
-                ta_log_write(tg_debug_log, SRC_VULKAN, "    %s\n", extension.extensionName);
-            }
+    for (const ta_caps_device &device : caps.devices) {
+        if (ta_caps_device_extension(device, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+            physical_device = device.handle;
+            physical_device_caps = &device;
         }
 
-        uint32_t queue_family_property_count = 0;
-        std::vector <VkQueueFamilyProperties> queue_family_properties;
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_property_count, NULL);
-        queue_family_properties.resize(queue_family_property_count);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_property_count, queue_family_properties.data());
-
-        int i = 0;
-        for (VkQueueFamilyProperties &queue_family_property : queue_family_properties) {
-            ta_log_write(tg_debug_log, SRC_VULKAN, "    Found %d queues with flags:\n", queue_family_property.queueCount);
-            if (queue_family_property.queueFlags & VK_QUEUE_GRAPHICS_BIT      ) ta_log_write(tg_debug_log, SRC_VULKAN, "        %s\n", "GRAPHICS      ");
-            if (queue_family_property.queueFlags & VK_QUEUE_COMPUTE_BIT       ) ta_log_write(tg_debug_log, SRC_VULKAN, "        %s\n", "COMPUTE       ");
-            if (queue_family_property.queueFlags & VK_QUEUE_TRANSFER_BIT      ) ta_log_write(tg_debug_log, SRC_VULKAN, "        %s\n", "TRANSFER      ");
-            if (queue_family_property.queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) ta_log_write(tg_debug_log, SRC_VULKAN, "        %s\n", "SPARSE_BINDING");
-            if (queue_family_property.queueFlags & VK_QUEUE_PROTECTED_BIT     ) ta_log_write(tg_debug_log, SRC_VULKAN, "        %s\n", "PROTECTED_BIT ");
-
-            if (queue_family_property.queueFlags & VK_QUEUE_GRAPHICS_BIT && queue_family_index == -1) {
+        for (uint32_t i = 0; i < (uint32_t)device.queue_families.size(); ++i) {
+            if (device.queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT && queue_family_index == -1) {
                 VkBool32 present_supported = false;
-                err = vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_supported);
+                err = vkGetPhysicalDeviceSurfaceSupportKHR(device.handle, i, surface, &present_supported);
                 if (err) {
                     ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query physical device surface support.\n", err);
                     return 1;
                 }
                 if (present_supported) {
                     // NOTE(saidwho12): Doesn't work on NVIDIA DGX-2
-                    queue_family_index = i;
+                    queue_family_index = (int)i;
                 }
             }
         }
@@ -349,12 +735,48 @@ int main(int argc, char *argv[])
     queue_create_info.queueCount = 1;
     queue_create_info.pQueuePriorities = &queue_priority;
 
+    VkPhysicalDeviceProperties physical_device_properties = {};
+    vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
+    VkPhysicalDeviceMemoryProperties physical_device_memory_properties = {};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &physical_device_memory_properties);
+
     // TODO: Set device feature flags to VK_TRUE for features we want
     VkPhysicalDeviceFeatures device_features = {};
+    VkPhysicalDeviceFeatures supported_features = {};
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+    // Lets the meshlet culler's indirect draws go out in one call
+    device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    bool pipeline_stats_enabled = false;
+    if (pipeline_stats_frames) {
+        pipeline_stats_enabled = supported_features.pipelineStatisticsQuery == VK_TRUE;
+        if (pipeline_stats_enabled) {
+            device_features.pipelineStatisticsQuery = VK_TRUE;
+            // Lets passes recorded into secondaries run inside the statistics scopes
+            device_features.inheritedQueries = supported_features.inheritedQueries;
+        } else {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Pipeline statistics requested but not supported by the device.\n");
+        }
+    }
 
     std::vector<const char *> device_extensions;
     device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+    // Lets the GPU profiler put GPU timestamps on the CPU timeline exactly, instead of estimating from submit times
+    VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_DEVICE_EXT;
+    bool calibrated_timestamps = ta_caps_device_extension(*physical_device_caps,
+        VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) &&
+        ta_gpu_profiler_calibration_supported(physical_device, &host_time_domain);
+    if (calibrated_timestamps) {
+        device_extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
+
+    // Meshlet draws sized by the cull shader's count instead of one (possibly empty) draw per meshlet
+    bool draw_indirect_count = ta_caps_device_extension(*physical_device_caps,
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (draw_indirect_count) {
+        device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+
     // Create logical device
     VkDeviceCreateInfo device_create_info = {};
     device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -363,12 +785,9 @@ int main(int argc, char *argv[])
     device_create_info.pEnabledFeatures = &device_features;
     device_create_info.enabledExtensionCount = (uint32_t)device_extensions.size();
     device_create_info.ppEnabledExtensionNames = device_extensions.data();
-#if _DEBUG
+    // NOTE: Device layers are deprecated and ignored by current loaders, pass the instance's for older ones
     device_create_info.enabledLayerCount = (uint32_t)layers.size();
     device_create_info.ppEnabledLayerNames = layers.data();
-#else
-    createInfo.enabledLayerCount = 0;
-#endif
 
     VkDevice logical_device = VK_NULL_HANDLE;
     err = vkCreateDevice(physical_device, &device_create_info, NULL, &logical_device);
@@ -376,17 +795,13 @@ int main(int argc, char *argv[])
         ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create logical device.\n", err);
         return 1;
     }
+    ta_vk_dispatch_load_device(logical_device);
+    ta_vk_debug_set_device(vk_debug, logical_device);
 
     VkQueue queue = VK_NULL_HANDLE;
     vkGetDeviceQueue(logical_device, queue_family_index, 0, &queue);
 
-    struct swap_chain_t {
-        VkSurfaceCapabilitiesKHR capabilities;
-        std::vector<VkSurfaceFormatKHR> formats;
-        std::vector<VkPresentModeKHR> present_modes;
-        VkExtent2D extent;
-        VkSwapchainKHR swap_chain;
-    };
+
     struct swap_chain_t swap_chain = {};
 
     err = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &swap_chain.capabilities);
@@ -395,7 +810,6 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    VkSurfaceFormatKHR *surface_format = NULL;
     uint32_t swap_chain_format_count = 0;
     vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &swap_chain_format_count, NULL);
     assert(swap_chain_format_count);
@@ -405,105 +819,512 @@ int main(int argc, char *argv[])
         ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query physical device surface formats.\n", err);
         return 1;
     }
+    bool surface_format_found = false;
     for (VkSurfaceFormatKHR &format : swap_chain.formats) {
         if (format.format == VK_FORMAT_B8G8R8A8_UNORM &&
             format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
         {
-            surface_format = &format;
+            swap_chain.surface_format = format;
+            surface_format_found = true;
         }
     }
-    assert(surface_format);
+    assert(surface_format_found);
+
+    uint32_t swapchain_present_mode_count = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &swapchain_present_mode_count, NULL);
+    assert(swapchain_present_mode_count);
+    swap_chain.present_modes.resize(swapchain_present_mode_count);
+    err = vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &swapchain_present_mode_count, swap_chain.present_modes.data());
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query physical device surface present modes.\n", err);
+        return 1;
+    }
+
+    ta_deletion_queue deletion_queue = {};
+    ta_deletion_queue_init(deletion_queue, logical_device);
+
+    if (!swap_chain_create(swap_chain, physical_device, logical_device, surface, present_policy, window_w, window_h,
+        deletion_queue, 0))
+    {
+        return 1;
+    }
+
+    ta_log_write(tg_debug_log, SRC_VULKAN, "We got a swapchain bois.\n");
+
+    VkCommandPoolCreateInfo command_pool_create_info = {};
+    command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    command_pool_create_info.queueFamilyIndex = queue_family_index;
+
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    err = vkCreateCommandPool(logical_device, &command_pool_create_info, NULL, &command_pool);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create command pool.\n", err);
+        return 1;
+    }
+
+    if (bench_dispatch) {
+        ta_vk_dispatch_benchmark(instance, logical_device, command_pool, 1000000);
+    }
 
-    bool triple_buffer_try = true;
-    VkPresentModeKHR surface_present_mode = VK_PRESENT_MODE_FIFO_KHR;
-    if (triple_buffer_try) {
-        uint32_t swapchain_present_mode_count = 0;
-        vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &swapchain_present_mode_count, NULL);
-        assert(swapchain_present_mode_count);
-        swap_chain.present_modes.resize(swapchain_present_mode_count);
-        err = vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &swapchain_present_mode_count, swap_chain.present_modes.data());
+    struct frame_t frames[MAX_FRAMES_IN_FLIGHT] = {};
+    for (frame_t &frame : frames) {
+        VkCommandBufferAllocateInfo command_buffer_alloc_info = {};
+        command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_alloc_info.commandPool = command_pool;
+        command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        command_buffer_alloc_info.commandBufferCount = 1;
+        err = vkAllocateCommandBuffers(logical_device, &command_buffer_alloc_info, &frame.command_buffer);
         if (err) {
-            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query physical device surface present modes.\n", err);
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to allocate command buffer.\n", err);
             return 1;
         }
-        for (VkPresentModeKHR &mode : swap_chain.present_modes) {
-            if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                surface_present_mode = mode;
-            }
+
+        VkSemaphoreCreateInfo semaphore_create_info = {};
+        semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkFenceCreateInfo fence_create_info = {};
+        fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        if (vkCreateSemaphore(logical_device, &semaphore_create_info, NULL, &frame.image_available) ||
+            vkCreateSemaphore(logical_device, &semaphore_create_info, NULL, &frame.render_finished) ||
+            vkCreateFence(logical_device, &fence_create_info, NULL, &frame.in_flight))
+        {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to create frame synchronization objects.\n");
+            return 1;
         }
-        assert(VK_PRESENT_MODE_MAILBOX_KHR);
+
+        char name[32] = {};
+        int frame_index = (int)(&frame - frames);
+        snprintf(name, sizeof(name), "frame %d commands", frame_index);
+        ta_vk_debug_name(vk_debug, VK_OBJECT_TYPE_COMMAND_BUFFER, TA_VK_HANDLE(frame.command_buffer), name);
+        snprintf(name, sizeof(name), "frame %d image available", frame_index);
+        ta_vk_debug_name(vk_debug, VK_OBJECT_TYPE_SEMAPHORE, TA_VK_HANDLE(frame.image_available), name);
+        snprintf(name, sizeof(name), "frame %d render finished", frame_index);
+        ta_vk_debug_name(vk_debug, VK_OBJECT_TYPE_SEMAPHORE, TA_VK_HANDLE(frame.render_finished), name);
+        snprintf(name, sizeof(name), "frame %d in flight", frame_index);
+        ta_vk_debug_name(vk_debug, VK_OBJECT_TYPE_FENCE, TA_VK_HANDLE(frame.in_flight), name);
     }
 
-    if (swap_chain.capabilities.currentExtent.width != UINT32_MAX) {
-        swap_chain.extent = swap_chain.capabilities.currentExtent;
-    } else {
-        swap_chain.extent.width = std::max(swap_chain.capabilities.minImageExtent.width, std::min(swap_chain.capabilities.maxImageExtent.width, window_w));
-        swap_chain.extent.height = std::max(swap_chain.capabilities.minImageExtent.height, std::min(swap_chain.capabilities.maxImageExtent.height, window_h));
+    // Scratch memory for per-draw constants and dynamic geometry, reset every frame
+    ta_frame_allocator frame_allocator = {};
+    err = ta_frame_allocator_init(frame_allocator, logical_device, physical_device_properties,
+        physical_device_memory_properties, MAX_FRAMES_IN_FLIGHT, 256 * 1024);
+    if (err) {
+        return 1;
     }
 
-    // https://vulkan-tutorial.com/en/Drawing_a_triangle/Presentation/Swap_chain
-    // Choosing the right settings for the swap chain
+    ta_descriptor_layout_cache descriptor_layout_cache = {};
+    ta_descriptor_layout_cache_init(descriptor_layout_cache, logical_device);
+    ta_spirv_cache spirv_cache = {};
+    ta_spirv_cache_init(spirv_cache, logical_device, descriptor_layout_cache);
+    ta_descriptor_allocator descriptor_allocator = {};
+    ta_descriptor_allocator_init(descriptor_allocator, logical_device, MAX_FRAMES_IN_FLIGHT, 256);
+
+    ta_jobs jobs = {};
+    ta_jobs_init(jobs, worker_count);
 
-    uint32_t swap_chain_image_count = 2;
-    if (triple_buffer_try) {
-        swap_chain_image_count++;
+    ta_cmd_recorder cmd_recorder = {};
+    err = ta_cmd_recorder_init(cmd_recorder, logical_device, queue_family_index, jobs.worker_count + 1,
+        MAX_FRAMES_IN_FLIGHT);
+    if (err) {
+        return 1;
     }
-    assert(swap_chain_image_count >= swap_chain.capabilities.minImageCount);
-    if (swap_chain.capabilities.maxImageCount) {
-        swap_chain_image_count = std::min(swap_chain_image_count, swap_chain.capabilities.maxImageCount);
+
+    ta_pipeline_cache pipeline_cache = {};
+    err = ta_pipeline_cache_init(pipeline_cache, logical_device, jobs);
+    if (err) {
+        return 1;
     }
 
-    VkSwapchainCreateInfoKHR swap_chain_create_info = {};
-    swap_chain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    swap_chain_create_info.surface = surface;
-    swap_chain_create_info.minImageCount = swap_chain_image_count;
-    swap_chain_create_info.imageFormat = surface_format->format;
-    swap_chain_create_info.imageColorSpace = surface_format->colorSpace;
-    swap_chain_create_info.imageExtent = swap_chain.extent;
-    swap_chain_create_info.imageArrayLayers = 1;
-    swap_chain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    // NOTE: Assumes graphics_queue == present_queue, which we are currently
-    // guaranteeing by only having a single index and asserting when not found.
-    swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    swap_chain_create_info.preTransform = swap_chain.capabilities.currentTransform;
-    swap_chain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swap_chain_create_info.presentMode = surface_present_mode;
-    // NOTE: May want to disable surface clipping if we do e.g. screenshots.
-    swap_chain_create_info.clipped = VK_TRUE;
-    // NOTE: This is used when recreating the swap chain, e.g. on window resize
-    swap_chain_create_info.oldSwapchain = VK_NULL_HANDLE;
+    ta_shader_library shader_library = {};
+    ta_shader_library_init(shader_library, logical_device, shader_directory, spirv_cache, pipeline_cache, hot_reload);
 
-    err = vkCreateSwapchainKHR(logical_device, &swap_chain_create_info, NULL, &swap_chain.swap_chain);
+    VkQueueFamilyProperties queue_family_properties = {};
+    {
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, NULL);
+        std::vector<VkQueueFamilyProperties> families(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, families.data());
+        queue_family_properties = families[queue_family_index];
+    }
+
+    ta_gpu_profiler gpu_profiler = {};
+    gpu_profiler.trace = gpu_trace;
+    err = ta_gpu_profiler_init(gpu_profiler, logical_device, physical_device_properties, queue_family_properties,
+        MAX_FRAMES_IN_FLIGHT, calibrated_timestamps, host_time_domain);
     if (err) {
-        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create swap chain.\n", err);
         return 1;
     }
 
-    ta_log_write(tg_debug_log, SRC_VULKAN, "We got a swapchain bois.\n");
+    ta_pipeline_stats pipeline_stats = {};
+    err = ta_pipeline_stats_init(pipeline_stats, logical_device, pipeline_stats_enabled, MAX_FRAMES_IN_FLIGHT,
+        pipeline_stats_frames ? pipeline_stats_frames : 1);
+    if (err) {
+        return 1;
+    }
+
+    // Frame graph. Swap chain image is imported and rebound every frame, which doesn't trigger a recompile.
+    ta_render_graph render_graph = {};
+    ta_render_graph_init(render_graph);
+    clear_pass_t clear = {};
+    clear.target = ta_render_graph_import_image(render_graph, "backbuffer", swap_chain.surface_format.format,
+        VK_IMAGE_LAYOUT_UNDEFINED, RG_USAGE_PRESENT);
+    ta_rg_pass clear_pass_index = ta_render_graph_add_pass(render_graph, "clear", RG_PASS_TRANSFER, clear_pass,
+        &clear);
+    ta_render_graph_use(render_graph, clear_pass_index, clear.target, RG_USAGE_TRANSFER_DST);
+
+    // Meshlet culling for the level, the level pass draws whatever survives through ta_meshlet_draw
+    ta_meshlet_culler meshlet_culler = {};
+    ta_meshlet_culler_init(meshlet_culler, logical_device, physical_device_memory_properties, shader_library,
+        descriptor_allocator, draw_indirect_count, device_features.multiDrawIndirect == VK_TRUE);
+    meshlet_cull_pass_t meshlet_cull = {};
+    meshlet_cull.culler = &meshlet_culler;
+    ta_rg_pass meshlet_cull_pass_index = ta_render_graph_add_pass(render_graph, "meshlet cull", RG_PASS_COMPUTE,
+        meshlet_cull_pass, &meshlet_cull);
+    ta_render_graph_side_effects(render_graph, meshlet_cull_pass_index);
+
+    // The level itself, on top of the clear. Its pipeline is made once the level's vertex format is known.
+    VkFormat depth_format = depth_format_select(physical_device);
+    level_pass_t level = {};
+    level.device = logical_device;
+    level.deletion_queue = &deletion_queue;
+    level.render_pass = level_render_pass_create(logical_device, swap_chain.surface_format.format, depth_format);
+    if (!level.render_pass) {
+        return 1;
+    }
+    level.color = clear.target;
+    level.depth = ta_render_graph_create_image(render_graph, "depth", depth_format, swap_chain.extent);
+    level.shaders = &shader_library;
+    level.pipeline = TA_SHADER_INVALID;
+    level.culler = &meshlet_culler;
+    level.constants = &meshlet_cull.constants;
+    level.lods = &meshlet_cull.lods;
+    level.frame_allocator = &frame_allocator;
+    level.descriptors = &descriptor_allocator;
+    level.jobs = &jobs;
+    // NOTE: Secondaries can't be executed while the pass's statistics queries are active without inheritedQueries,
+    // the level is recorded inline then
+    if (!pipeline_stats_enabled || device_features.inheritedQueries) {
+        level.recorder = &cmd_recorder;
+    }
+    level.pipeline_stats = &pipeline_stats;
+    ta_shader_handle level_shaders[2] = {
+        ta_shader_load(shader_library, "level.vert.spv"),
+        ta_shader_load(shader_library, "level.frag.spv"),
+    };
+    if (level_shaders[0] == TA_SHADER_INVALID || level_shaders[1] == TA_SHADER_INVALID) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "No level shaders, the level won't be drawn.\n");
+    }
+    ta_rg_pass level_pass_index = ta_render_graph_add_pass(render_graph, "level", RG_PASS_GRAPHICS, level_pass,
+        &level);
+    ta_render_graph_use(render_graph, level_pass_index, level.color, RG_USAGE_COLOR_ATTACHMENT);
+    ta_render_graph_use(render_graph, level_pass_index, level.depth, RG_USAGE_DEPTH_ATTACHMENT);
+
+    ta_present_latency present_latency = {};
+    ta_present_latency_init(present_latency);
+
+    ta_mesh meshes[MESH_COUNT] = {};
+    meshlet_cull.mesh = &meshes[MESH_LEVEL];
+    level.mesh = &meshes[MESH_LEVEL];
+    // Mesh BVHs for raycasts and picking, placed in the world by a top level BVH. Proxies are tagged with their mesh.
+    ta_bvh mesh_bvhs[MESH_COUNT] = {};
+    ta_bvh_dynamic world = {};
+    ta_bvh_dynamic_init(world);
+    uint32_t world_proxies[MESH_COUNT];
+    std::fill(world_proxies, world_proxies + MESH_COUNT, TA_BVH_DYNAMIC_NONE);
+    uint32_t picked_mesh = TA_BVH_DYNAMIC_NONE;
 
     // Poll for user input
+    uint64_t frame_number = 0;
+    bool swap_chain_dirty = false;
     bool stillRunning = true;
     while(stillRunning) {
+        ta_present_policy requested_policy = present_policy;
         SDL_Event event = {};
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
                 case SDL_QUIT:
                     stillRunning = false;
                     break;
+                case SDL_KEYDOWN:
+                    // F1-F3 switch present policy at runtime so latency can be compared within a single run
+                    switch (event.key.keysym.sym) {
+                        case SDLK_F1: requested_policy = PRESENT_POLICY_LOW_LATENCY;  break;
+                        case SDLK_F2: requested_policy = PRESENT_POLICY_POWER_SAVING; break;
+                        case SDLK_F3: requested_policy = PRESENT_POLICY_FIFO_RELAXED; break;
+                        case SDLK_F5: {
+                            int32_t id = ta_vk_debug_last_id(vk_debug);
+                            if (id) {
+                                ta_vk_debug_mute(vk_debug, id, true);
+                            }
+                            break;
+                        }
+                    }
+                    ta_present_latency_input(present_latency, ta_timer_elapsed_ms());
+                    break;
+                case SDL_MOUSEBUTTONDOWN:
+                case SDL_MOUSEMOTION:
+                    ta_present_latency_input(present_latency, ta_timer_elapsed_ms());
+                    break;
                 default:
                     // Do nothing
                     break;
             }
         }
-        SDL_Delay(10);
+        if (!stillRunning) {
+            break;
+        }
+
+        if (requested_policy != present_policy) {
+            ta_present_latency_report(present_latency, tg_debug_log, present_policy);
+            present_policy = requested_policy;
+            swap_chain_dirty = true;
+        }
+        if (swap_chain_dirty) {
+            if (!swap_chain_create(swap_chain, physical_device, logical_device, surface, present_policy, window_w,
+                window_h, deletion_queue, frame_number))
+            {
+                return 1;
+            }
+            // Don't charge the recreate to the new policy's latency
+            present_latency.pending_input_ms = -1.0;
+            swap_chain_dirty = false;
+        }
+
+        frame_t &frame = frames[frame_number % MAX_FRAMES_IN_FLIGHT];
+        vkWaitForFences(logical_device, 1, &frame.in_flight, VK_TRUE, UINT64_MAX);
+
+        // Waiting on this slot's fence means every frame up to (frame_number - MAX_FRAMES_IN_FLIGHT) has completed
+        uint64_t frames_completed = 0;
+        if (frame_number + 1 > MAX_FRAMES_IN_FLIGHT) {
+            frames_completed = frame_number + 1 - MAX_FRAMES_IN_FLIGHT;
+        }
+        ta_deletion_queue_retire(deletion_queue, frames_completed);
+        err = ta_frame_allocator_begin_frame(frame_allocator, deletion_queue, frame_number);
+        if (err) {
+            return 1;
+        }
+        ta_descriptor_allocator_begin_frame(descriptor_allocator, frame_number);
+        ta_shader_library_begin_frame(shader_library, deletion_queue, frame_number);
+        ta_cmd_recorder_begin_frame(cmd_recorder, frame_number);
+
+        uint32_t image_index = 0;
+        err = vkAcquireNextImageKHR(logical_device, swap_chain.swap_chain, UINT64_MAX, frame.image_available,
+            VK_NULL_HANDLE, &image_index);
+        if (err == VK_ERROR_OUT_OF_DATE_KHR) {
+            swap_chain_dirty = true;
+            continue;
+        } else if (err && err != VK_SUBOPTIMAL_KHR) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to acquire swap chain image.\n", err);
+            return 1;
+        }
+        vkResetFences(logical_device, 1, &frame.in_flight);
+
+        if (ta_render_graph_compile(render_graph)) {
+            ta_render_graph_dump(render_graph, tg_debug_log);
+        }
+        err = ta_render_graph_realize(render_graph, logical_device, physical_device_memory_properties,
+            deletion_queue, frame_number);
+        if (err) {
+            return 1;
+        }
+        ta_render_graph_bind_image(render_graph, clear.target, swap_chain.images[image_index],
+            swap_chain.views[image_index], swap_chain.extent);
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkResetCommandBuffer(frame.command_buffer, 0);
+        vkBeginCommandBuffer(frame.command_buffer, &begin_info);
+        ta_gpu_profiler_begin_frame(gpu_profiler, frame.command_buffer, frame_number);
+        if (ta_pipeline_stats_begin_frame(pipeline_stats, frame.command_buffer, frame_number)) {
+            // No text rendering yet, so the "overlay" is the window title
+            char summary[256] = { 0 };
+            ta_pipeline_stats_summary(pipeline_stats, summary, sizeof(summary));
+            SDL_SetWindowTitle(window, summary);
+        }
+        // Cooked meshes are uploaded by the first frame, their staging buffers retire with it
+        if (frame_number == 0) {
+            for (uint32_t i = 0; i < MESH_COUNT; ++i) {
+                char mesh_path[64] = {};
+                snprintf(mesh_path, sizeof(mesh_path), "data/mesh/%s.tmesh", mesh_names[i]);
+                if (ta_mesh_load(meshes[i], mesh_path, logical_device, physical_device_memory_properties,
+                    frame.command_buffer, deletion_queue, frame_number))
+                {
+                    ta_log_write(tg_debug_log, SRC_FILE, "Mesh '%s' not loaded, run with --cook.\n", mesh_names[i]);
+                }
+            }
+            err = ta_meshlet_culler_reserve(meshlet_culler, (uint32_t)meshes[MESH_LEVEL].meshlets.size(),
+                deletion_queue, frame_number);
+            if (err) {
+                return 1;
+            }
+            // Position only, the fragment shader shades with the face normal
+            if (meshes[MESH_LEVEL].buffer.buffer && level_shaders[0] != TA_SHADER_INVALID &&
+                level_shaders[1] != TA_SHADER_INVALID)
+            {
+                ta_graphics_pipeline_desc desc = {};
+                ta_graphics_pipeline_desc_init(desc, VK_NULL_HANDLE, level.render_pass);
+                ta_mesh_vertex_input input =
+                    ta_mesh_vertex_input_get((ta_mesh_vertex_format)meshes[MESH_LEVEL].vertex_format);
+                desc.vertex_bindings.push_back(input.binding);
+                desc.vertex_attributes.push_back(input.attributes[0]);
+                level.pipeline = ta_shader_pipeline_graphics(shader_library, desc, level_shaders, 2, NULL);
+            }
+            // The level stays where it is, the props are moved every frame
+            for (uint32_t i = 0; i < MESH_COUNT; ++i) {
+                char mesh_path[64] = {};
+                snprintf(mesh_path, sizeof(mesh_path), "data/mesh/%s.tmesh", mesh_names[i]);
+                if (!ta_bvh_build_mesh(mesh_bvhs[i], mesh_path, &jobs)) {
+                    continue;
+                }
+                float transform[12] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+                if (i != MESH_LEVEL) {
+                    prop_transform(meshes[MESH_LEVEL].bounds, i, (float)ta_timer_elapsed_sec(), transform);
+                }
+                world_proxies[i] = ta_bvh_dynamic_add(world, mesh_bvhs[i], transform, i);
+            }
+            const ta_bvh &level_bvh = mesh_bvhs[MESH_LEVEL];
+            if (world_proxies[MESH_LEVEL] != TA_BVH_DYNAMIC_NONE) {
+                ta_log_write(tg_debug_log, SRC_FILE, "Level BVH: %u triangles, %u nodes (%u 4-wide), SAH %.1f, "
+                    "%.2fms\n", level_bvh.triangle_count, (uint32_t)level_bvh.nodes.size(),
+                    (uint32_t)level_bvh.nodes4.size(), level_bvh.sah_cost, level_bvh.build_ms);
+            }
+        }
+        {
+            float view_projection[16] = {};
+            float eye[3] = {};
+            float forward[3] = {};
+            camera_turn(meshes[MESH_LEVEL].bounds, (float)ta_timer_elapsed_sec() * 0.25f,
+                (float)swap_chain.extent.width / (float)std::max(swap_chain.extent.height, 1u), view_projection, eye,
+                forward);
+            meshlet_cull.constants = ta_meshlet_cull_setup(view_projection, eye);
+            const ta_mesh &level_mesh = meshes[MESH_LEVEL];
+            float lod_projection = ta_mesh_lod_projection(CAMERA_FOV_Y, (float)swap_chain.extent.height);
+            meshlet_cull.lods.resize(level_mesh.submeshes.size());
+            for (size_t i = 0; i < level_mesh.submeshes.size(); ++i) {
+                meshlet_cull.lods[i] = ta_mesh_lod_select(level_mesh.submeshes[i], eye, lod_projection,
+                    LEVEL_LOD_PIXELS);
+            }
+            memcpy(level.view_projection, view_projection, sizeof(level.view_projection));
+
+            // Props move, the world BVH refits around them, then picks whatever is straight ahead of the camera
+            for (uint32_t i = 0; i < MESH_COUNT; ++i) {
+                if (i != MESH_LEVEL && world_proxies[i] != TA_BVH_DYNAMIC_NONE) {
+                    float transform[12] = {};
+                    prop_transform(meshes[MESH_LEVEL].bounds, i, (float)ta_timer_elapsed_sec(), transform);
+                    ta_bvh_dynamic_move(world, world_proxies[i], transform);
+                }
+            }
+            ta_bvh_dynamic_update(world);
+            ta_bvh_ray pick_ray = {};
+            memcpy(pick_ray.origin, eye, sizeof(pick_ray.origin));
+            memcpy(pick_ray.direction, forward, sizeof(pick_ray.direction));
+            pick_ray.t_max = FLT_MAX;
+            ta_bvh_dynamic_hit pick = {};
+            ta_bvh_dynamic_raycast(world, &pick_ray, 1, &pick, NULL);
+            uint32_t hit_mesh = pick.proxy != TA_BVH_DYNAMIC_NONE ? world.proxies[pick.proxy].user :
+                TA_BVH_DYNAMIC_NONE;
+            if (hit_mesh != picked_mesh) {
+                picked_mesh = hit_mesh;
+                ta_log_write(tg_debug_log, SRC_FILE, "Looking at %s\n",
+                    hit_mesh != TA_BVH_DYNAMIC_NONE ? mesh_names[hit_mesh] : "nothing");
+            }
+        }
+        level.frame = frame_number;
+        uint32_t frame_scope = ta_gpu_profiler_scope_begin(gpu_profiler, frame.command_buffer, "frame");
+        float t = (float)ta_timer_elapsed_sec();
+        clear.color = { { 0.1f, 0.1f, 0.2f + 0.1f * sinf(t), 1.0f } };
+        ta_render_graph_execute(render_graph, frame.command_buffer, &gpu_profiler, &pipeline_stats, &vk_debug);
+        ta_gpu_profiler_scope_end(gpu_profiler, frame.command_buffer, frame_scope);
+        err = vkEndCommandBuffer(frame.command_buffer);
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to record command buffer.\n", err);
+            return 1;
+        }
+        ta_cmd_recorder_report(cmd_recorder);
+
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &frame.image_available;
+        submit_info.pWaitDstStageMask = &wait_stage;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &frame.command_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &frame.render_finished;
+        double submit_ms = ta_timer_elapsed_ms();
+        err = vkQueueSubmit(queue, 1, &submit_info, frame.in_flight);
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to submit command buffer.\n", err);
+            return 1;
+        }
+        ta_gpu_profiler_end_frame(gpu_profiler, submit_ms);
+        ta_pipeline_stats_end_frame(pipeline_stats);
+
+        VkPresentInfoKHR present_info = {};
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &frame.render_finished;
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &swap_chain.swap_chain;
+        present_info.pImageIndices = &image_index;
+        err = vkQueuePresentKHR(queue, &present_info);
+        ta_present_latency_presented(present_latency, present_policy, ta_timer_elapsed_ms());
+        if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR) {
+            swap_chain_dirty = true;
+        } else if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to present swap chain image.\n", err);
+            return 1;
+        }
+
+        frame_number++;
     }
 
-    // Clean up
-    vkDestroySwapchainKHR(logical_device, swap_chain.swap_chain, NULL);
+    ta_present_latency_report_all(present_latency, tg_debug_log);
+
+    // Clean up, in reverse order of creation. Everything owned by the device goes through the deletion queue, which
+    // is flushed once the device is idle, then the device itself, then instance-level objects, then SDL.
+    vkDeviceWaitIdle(logical_device);
+    ta_bvh_dynamic_free(world);
+    for (ta_bvh &bvh : mesh_bvhs) {
+        ta_bvh_free(bvh);
+    }
+    ta_meshlet_culler_free(meshlet_culler, deletion_queue, frame_number);
+    for (ta_mesh &mesh : meshes) {
+        ta_mesh_free(mesh, deletion_queue, frame_number);
+    }
+    ta_frame_allocator_free(frame_allocator, deletion_queue, frame_number);
+    ta_descriptor_allocator_free(descriptor_allocator, deletion_queue, frame_number);
+    ta_spirv_cache_free(spirv_cache, deletion_queue, frame_number);
+    ta_descriptor_layout_cache_free(descriptor_layout_cache);
+    ta_cmd_recorder_free(cmd_recorder, deletion_queue, frame_number);
+    ta_render_graph_free(render_graph, deletion_queue, frame_number);
+    ta_gpu_profiler_free(gpu_profiler, deletion_queue, frame_number);
+    ta_pipeline_stats_free(pipeline_stats, deletion_queue, frame_number);
+    ta_shader_library_free(shader_library, deletion_queue, frame_number);
+    ta_pipeline_cache_free(pipeline_cache, deletion_queue, frame_number);
+    for (frame_t &frame : frames) {
+        ta_deletion_queue_push(deletion_queue, DELETION_FENCE, TA_VK_HANDLE(frame.in_flight), frame_number);
+        ta_deletion_queue_push(deletion_queue, DELETION_SEMAPHORE, TA_VK_HANDLE(frame.render_finished), frame_number);
+        ta_deletion_queue_push(deletion_queue, DELETION_SEMAPHORE, TA_VK_HANDLE(frame.image_available), frame_number);
+    }
+    ta_deletion_queue_push(deletion_queue, DELETION_COMMAND_POOL, TA_VK_HANDLE(command_pool), frame_number);
+    ta_deletion_queue_push(deletion_queue, DELETION_RENDER_PASS, TA_VK_HANDLE(level.render_pass), frame_number);
+    for (VkImageView view : swap_chain.views) {
+        ta_deletion_queue_push(deletion_queue, DELETION_IMAGE_VIEW, TA_VK_HANDLE(view), frame_number);
+    }
+    ta_deletion_queue_push(deletion_queue, DELETION_SWAPCHAIN, TA_VK_HANDLE(swap_chain.swap_chain), frame_number);
+    ta_deletion_queue_free(deletion_queue);
+    ta_jobs_free(jobs);
+    vkDestroyDevice(logical_device, NULL);
     vkDestroySurfaceKHR(instance, surface, NULL);
+    ta_vk_debug_report(vk_debug, tg_debug_log);
+    ta_vk_debug_free(vk_debug);
+    vkDestroyInstance(instance, NULL);
     SDL_DestroyWindow(window);
     SDL_Quit();
-    vkDestroyDevice(logical_device, NULL);
-    vkDestroyInstance(instance, NULL);
+    ta_log_free(tg_debug_log);
     return 0;
 }
@@ -0,0 +1,952 @@
+#include "ta_bvh.hpp"
+#include "ta_log.hpp"
+#include "ta_mesh_cook.hpp"
+#include "ta_mesh_quant.hpp"
+#include "ta_obj.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <xmmintrin.h>
+
+#define BVH_NONE UINT32_MAX
+// Triangles per job for the bounds and top level binning passes
+#define BVH_CHUNK_TRIANGLES 65536
+
+static_assert(3 * TA_BVH_MAX_DEPTH + 1 <= TA_BVH_STACK_SIZE, "TA_BVH_STACK_SIZE too small for TA_BVH_MAX_DEPTH");
+
+typedef struct bvh_box {
+    float min[3];
+    float max[3];
+} bvh_box;
+
+// Triangle as seen by the builder. Partitioned in place as nodes are split, so every node's triangles are contiguous.
+typedef struct bvh_ref {
+    bvh_box  box;
+    float    centroid[3];
+    uint32_t triangle;
+} bvh_ref;
+
+typedef struct bvh_bins {
+    uint32_t bin_count;     // up to TA_BVH_BINS, fewer for small nodes
+    bvh_box  bounds[3][TA_BVH_BINS];
+    uint32_t count[3][TA_BVH_BINS];
+} bvh_bins;
+
+// Node as built. Children index the same array, except that a node with a task stands in for that task's root.
+typedef struct bvh_build_node {
+    bvh_box  bounds;
+    uint32_t begin;     // range of bvh_context::refs
+    uint32_t end;
+    uint32_t left;      // BVH_NONE for leaves
+    uint32_t right;
+    uint32_t task;
+} bvh_build_node;
+
+// Subtree built on its own by one job
+typedef struct bvh_task {
+    uint32_t                    begin;
+    uint32_t                    end;
+    bvh_box                     bounds;
+    uint32_t                    depth;
+    std::vector<bvh_build_node> nodes;
+} bvh_task;
+
+typedef struct bvh_context {
+    const float           *positions;
+    uint32_t              position_stride;
+    const uint32_t        *indices;
+    uint32_t              triangle_count;
+    ta_jobs               *jobs;
+    std::vector<bvh_ref>  refs;
+    std::vector<bvh_task> tasks;
+    std::vector<bvh_bins> chunk_bins;   // top level binning, one per chunk
+    // Current top level binning pass
+    uint32_t              bin_begin;
+    uint32_t              bin_end;
+    float                 bin_min[3];
+    float                 bin_scale[3];
+} bvh_context;
+
+static void bvh_box_empty(bvh_box &box)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = FLT_MAX;
+        box.max[axis] = -FLT_MAX;
+    }
+}
+
+static void bvh_box_merge(bvh_box &box, const bvh_box &other)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = std::min(box.min[axis], other.min[axis]);
+        box.max[axis] = std::max(box.max[axis], other.max[axis]);
+    }
+}
+
+// Half the surface area, which is all SAH needs
+static float bvh_box_area(const bvh_box &box)
+{
+    float dx = box.max[0] - box.min[0];
+    float dy = box.max[1] - box.min[1];
+    float dz = box.max[2] - box.min[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+        return 0.0f;
+    }
+    return dx * dy + dy * dz + dz * dx;
+}
+
+// SAH counts packets rather than triangles, testing 4 triangles costs about as much as testing one
+static float bvh_packets(uint32_t triangles)
+{
+    return (float)((triangles + TA_BVH_LEAF_TRIANGLES - 1) / TA_BVH_LEAF_TRIANGLES);
+}
+
+static const float *bvh_position(const bvh_context &ctx, uint32_t vertex)
+{
+    return (const float *)((const uint8_t *)ctx.positions + (size_t)vertex * ctx.position_stride);
+}
+
+static void bvh_bounds_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    bvh_context &ctx = *(bvh_context *)userdata;
+    uint32_t end = std::min((index + 1) * BVH_CHUNK_TRIANGLES, ctx.triangle_count);
+    for (uint32_t t = index * BVH_CHUNK_TRIANGLES; t < end; ++t) {
+        bvh_ref &ref = ctx.refs[t];
+        bvh_box &box = ref.box;
+        bvh_box_empty(box);
+        for (int corner = 0; corner < 3; ++corner) {
+            const float *p = bvh_position(ctx, ctx.indices[t * 3 + corner]);
+            for (int axis = 0; axis < 3; ++axis) {
+                box.min[axis] = std::min(box.min[axis], p[axis]);
+                box.max[axis] = std::max(box.max[axis], p[axis]);
+            }
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            ref.centroid[axis] = (box.min[axis] + box.max[axis]) * 0.5f;
+        }
+        ref.triangle = t;
+    }
+}
+
+static uint32_t bvh_bin_index(const bvh_ref &ref, int axis, const float min[3], const float scale[3],
+    uint32_t bin_count)
+{
+    uint32_t bin = (uint32_t)((ref.centroid[axis] - min[axis]) * scale[axis]);
+    return std::min(bin, bin_count - 1);
+}
+
+static void bvh_bin_range(const bvh_context &ctx, uint32_t begin, uint32_t end, const float min[3],
+    const float scale[3], uint32_t bin_count, bvh_bins &bins)
+{
+    bins.bin_count = bin_count;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (uint32_t bin = 0; bin < bin_count; ++bin) {
+            bvh_box_empty(bins.bounds[axis][bin]);
+            bins.count[axis][bin] = 0;
+        }
+    }
+    for (uint32_t i = begin; i < end; ++i) {
+        const bvh_ref &ref = ctx.refs[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            uint32_t bin = bvh_bin_index(ref, axis, min, scale, bin_count);
+            bvh_box_merge(bins.bounds[axis][bin], ref.box);
+            bins.count[axis][bin]++;
+        }
+    }
+}
+
+static void bvh_bin_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    bvh_context &ctx = *(bvh_context *)userdata;
+    uint32_t begin = ctx.bin_begin + index * BVH_CHUNK_TRIANGLES;
+    uint32_t end = std::min(begin + BVH_CHUNK_TRIANGLES, ctx.bin_end);
+    bvh_bin_range(ctx, begin, end, ctx.bin_min, ctx.bin_scale, TA_BVH_BINS, ctx.chunk_bins[index]);
+}
+
+static void bvh_range_bounds(const bvh_context &ctx, uint32_t begin, uint32_t end, bvh_box &bounds)
+{
+    bvh_box_empty(bounds);
+    for (uint32_t i = begin; i < end; ++i) {
+        bvh_box_merge(bounds, ctx.refs[i].box);
+    }
+}
+
+// Levels of median splits it takes to get a range down to leaves
+static uint32_t bvh_median_depth(uint32_t count)
+{
+    uint32_t depth = 0;
+    while (count > TA_BVH_LEAF_TRIANGLES) {
+        count = count / 2 + count % 2;
+        ++depth;
+    }
+    return depth;
+}
+
+// Halves a range along the longest axis of its centroids
+static uint32_t bvh_split_median(bvh_context &ctx, uint32_t begin, uint32_t end, const bvh_box &centroid_bounds,
+    bvh_box &left, bvh_box &right)
+{
+    int axis = 0;
+    for (int i = 1; i < 3; ++i) {
+        if (centroid_bounds.max[i] - centroid_bounds.min[i] > centroid_bounds.max[axis] - centroid_bounds.min[axis]) {
+            axis = i;
+        }
+    }
+    uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(&ctx.refs[begin], &ctx.refs[mid], &ctx.refs[begin] + (end - begin),
+        [axis](const bvh_ref &a, const bvh_ref &b) { return a.centroid[axis] < b.centroid[axis]; });
+    bvh_range_bounds(ctx, begin, mid, left);
+    bvh_range_bounds(ctx, mid, end, right);
+    return mid;
+}
+
+// Picks the cheapest binned SAH split of refs[begin, end) and partitions the range around it. Returns the first
+// triangle of the right half, or `begin` if the range is better off as a leaf. Big ranges are binned in parallel.
+// NOTE: Every node satisfies depth + bvh_median_depth(count) <= TA_BVH_MAX_DEPTH (the root does for any 32-bit
+// count). SAH splits that would break it for a child are replaced by a median split, which keeps it, so no leaf
+// ends up deeper than TA_BVH_MAX_DEPTH however degenerate the geometry and traversal stacks can't overflow.
+static uint32_t bvh_split(bvh_context &ctx, uint32_t begin, uint32_t end, const bvh_box &bounds, uint32_t depth,
+    bool parallel, bvh_box &left, bvh_box &right)
+{
+    uint32_t count = end - begin;
+    if (count <= 1) {
+        return begin;
+    }
+    bvh_box centroid_bounds = {};
+    bvh_box_empty(centroid_bounds);
+    for (uint32_t i = begin; i < end; ++i) {
+        const float *c = ctx.refs[i].centroid;
+        for (int axis = 0; axis < 3; ++axis) {
+            centroid_bounds.min[axis] = std::min(centroid_bounds.min[axis], c[axis]);
+            centroid_bounds.max[axis] = std::max(centroid_bounds.max[axis], c[axis]);
+        }
+    }
+    // NOTE: Small nodes get a bin per triangle or so, setting up and sweeping all of them would cost more than binning
+    uint32_t bin_count = std::min((uint32_t)TA_BVH_BINS, std::max(count, 4u));
+    float scale[3] = {};
+    bool flat = true;
+    for (int axis = 0; axis < 3; ++axis) {
+        float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+        scale[axis] = extent > 0.0f ? bin_count / extent : 0.0f;
+        flat &= scale[axis] == 0.0f;
+    }
+
+    int best_axis = -1;
+    uint32_t best_bin = 0;
+    float best_cost = FLT_MAX;
+    if (!flat) {
+        bvh_bins bins;
+        uint32_t chunk_count = (count + BVH_CHUNK_TRIANGLES - 1) / BVH_CHUNK_TRIANGLES;
+        if (parallel && ctx.jobs && chunk_count > 1 && bin_count == TA_BVH_BINS) {
+            ctx.bin_begin = begin;
+            ctx.bin_end = end;
+            memcpy(ctx.bin_min, centroid_bounds.min, sizeof(ctx.bin_min));
+            memcpy(ctx.bin_scale, scale, sizeof(ctx.bin_scale));
+            ctx.chunk_bins.resize(chunk_count);
+            ta_jobs_parallel_for(*ctx.jobs, chunk_count, bvh_bin_job, &ctx);
+            bins = ctx.chunk_bins[0];
+            for (uint32_t chunk = 1; chunk < chunk_count; ++chunk) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    for (uint32_t bin = 0; bin < TA_BVH_BINS; ++bin) {
+                        bvh_box_merge(bins.bounds[axis][bin], ctx.chunk_bins[chunk].bounds[axis][bin]);
+                        bins.count[axis][bin] += ctx.chunk_bins[chunk].count[axis][bin];
+                    }
+                }
+            }
+        } else {
+            bvh_bin_range(ctx, begin, end, centroid_bounds.min, scale, bin_count, bins);
+        }
+
+        // Sweep from the right collecting suffix boxes, then from the left evaluating every split plane
+        float inverse_area = 1.0f / std::max(bvh_box_area(bounds), FLT_MIN);
+        for (int axis = 0; axis < 3; ++axis) {
+            bvh_box right_box[TA_BVH_BINS];
+            uint32_t right_count[TA_BVH_BINS];
+            bvh_box box = {};
+            bvh_box_empty(box);
+            uint32_t sum = 0;
+            for (uint32_t bin = bin_count - 1; bin > 0; --bin) {
+                bvh_box_merge(box, bins.bounds[axis][bin]);
+                sum += bins.count[axis][bin];
+                right_box[bin] = box;
+                right_count[bin] = sum;
+            }
+            bvh_box_empty(box);
+            sum = 0;
+            for (uint32_t bin = 0; bin < bin_count - 1; ++bin) {
+                bvh_box_merge(box, bins.bounds[axis][bin]);
+                sum += bins.count[axis][bin];
+                if (!sum || !right_count[bin + 1]) {
+                    continue;
+                }
+                float cost = TA_BVH_TRAVERSAL_COST + TA_BVH_PACKET_COST * inverse_area * (bvh_box_area(box) *
+                    bvh_packets(sum) + bvh_box_area(right_box[bin + 1]) * bvh_packets(right_count[bin + 1]));
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = bin;
+                    left = box;
+                    right = right_box[bin + 1];
+                }
+            }
+        }
+    }
+
+    if (best_axis >= 0) {
+        if (count <= TA_BVH_LEAF_TRIANGLES && TA_BVH_PACKET_COST <= best_cost) {
+            return begin;
+        }
+        const float *min = centroid_bounds.min;
+        bvh_ref *split = std::partition(&ctx.refs[begin], &ctx.refs[begin] + count,
+            [best_axis, best_bin, min, &scale, bin_count](const bvh_ref &ref) {
+                return bvh_bin_index(ref, best_axis, min, scale, bin_count) <= best_bin;
+            });
+        uint32_t mid = (uint32_t)(split - &ctx.refs[0]);
+        if (depth + 1 + bvh_median_depth(std::max(mid - begin, end - mid)) > TA_BVH_MAX_DEPTH) {
+            return bvh_split_median(ctx, begin, end, centroid_bounds, left, right);
+        }
+        return mid;
+    }
+    // Every centroid in one spot, nothing for SAH to go on
+    if (count <= TA_BVH_LEAF_TRIANGLES) {
+        return begin;
+    }
+    uint32_t mid = begin + count / 2;
+    bvh_range_bounds(ctx, begin, mid, left);
+    bvh_range_bounds(ctx, mid, end, right);
+    return mid;
+}
+
+static uint32_t bvh_build_node_add(std::vector<bvh_build_node> &nodes, uint32_t begin, uint32_t end,
+    const bvh_box &bounds)
+{
+    bvh_build_node node = {};
+    node.bounds = bounds;
+    node.begin = begin;
+    node.end = end;
+    node.left = BVH_NONE;
+    node.right = BVH_NONE;
+    node.task = BVH_NONE;
+    nodes.push_back(node);
+    return (uint32_t)nodes.size() - 1;
+}
+
+static uint32_t bvh_build_recursive(bvh_context &ctx, std::vector<bvh_build_node> &nodes, uint32_t begin,
+    uint32_t end, const bvh_box &bounds, uint32_t depth)
+{
+    uint32_t index = bvh_build_node_add(nodes, begin, end, bounds);
+    bvh_box left = {};
+    bvh_box right = {};
+    uint32_t mid = bvh_split(ctx, begin, end, bounds, depth, false, left, right);
+    if (mid != begin) {
+        uint32_t left_index = bvh_build_recursive(ctx, nodes, begin, mid, left, depth + 1);
+        uint32_t right_index = bvh_build_recursive(ctx, nodes, mid, end, right, depth + 1);
+        nodes[index].left = left_index;
+        nodes[index].right = right_index;
+    }
+    return index;
+}
+
+// Splits serially (binning in parallel) until ranges are small enough to hand out as tasks
+static uint32_t bvh_build_top(bvh_context &ctx, std::vector<bvh_build_node> &nodes, uint32_t begin, uint32_t end,
+    const bvh_box &bounds, uint32_t depth)
+{
+    uint32_t index = bvh_build_node_add(nodes, begin, end, bounds);
+    bvh_box left = {};
+    bvh_box right = {};
+    uint32_t mid = begin;
+    if (end - begin > TA_BVH_TASK_TRIANGLES) {
+        mid = bvh_split(ctx, begin, end, bounds, depth, true, left, right);
+    }
+    if (mid == begin) {
+        bvh_task task = {};
+        task.begin = begin;
+        task.end = end;
+        task.bounds = bounds;
+        task.depth = depth;
+        nodes[index].task = (uint32_t)ctx.tasks.size();
+        ctx.tasks.push_back(task);
+        return index;
+    }
+    uint32_t left_index = bvh_build_top(ctx, nodes, begin, mid, left, depth + 1);
+    uint32_t right_index = bvh_build_top(ctx, nodes, mid, end, right, depth + 1);
+    nodes[index].left = left_index;
+    nodes[index].right = right_index;
+    return index;
+}
+
+static void bvh_task_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    bvh_context &ctx = *(bvh_context *)userdata;
+    bvh_task &task = ctx.tasks[index];
+    bvh_build_recursive(ctx, task.nodes, task.begin, task.end, task.bounds, task.depth);
+}
+
+static void bvh_packet_fill(const bvh_context &ctx, ta_bvh_packet &packet, uint32_t begin, uint32_t end)
+{
+    memset(&packet, 0, sizeof(packet));
+    for (uint32_t lane = 0; lane < end - begin; ++lane) {
+        uint32_t triangle = ctx.refs[begin + lane].triangle;
+        const float *a = bvh_position(ctx, ctx.indices[triangle * 3 + 0]);
+        const float *b = bvh_position(ctx, ctx.indices[triangle * 3 + 1]);
+        const float *c = bvh_position(ctx, ctx.indices[triangle * 3 + 2]);
+        for (int axis = 0; axis < 3; ++axis) {
+            packet.v0[axis][lane] = a[axis];
+            packet.e1[axis][lane] = b[axis] - a[axis];
+            packet.e2[axis][lane] = c[axis] - a[axis];
+        }
+        packet.triangle[lane] = triangle;
+    }
+}
+
+// Writes the build tree out depth first, left child right after its parent, leaves' triangles into packets
+static void bvh_flatten(const bvh_context &ctx, ta_bvh &bvh, const std::vector<bvh_build_node> &nodes,
+    uint32_t index, float inverse_root_area)
+{
+    const bvh_build_node &node = nodes[index];
+    if (node.task != BVH_NONE) {
+        bvh_flatten(ctx, bvh, ctx.tasks[node.task].nodes, 0, inverse_root_area);
+        return;
+    }
+    uint32_t out = (uint32_t)bvh.nodes.size();
+    ta_bvh_node flat = {};
+    memcpy(flat.min, node.bounds.min, sizeof(flat.min));
+    memcpy(flat.max, node.bounds.max, sizeof(flat.max));
+    bvh.nodes.push_back(flat);
+    float area = bvh_box_area(node.bounds) * inverse_root_area;
+    if (node.left == BVH_NONE) {
+        bvh.nodes[out].index = (uint32_t)bvh.packets.size();
+        bvh.nodes[out].count = node.end - node.begin;
+        bvh.packets.emplace_back();
+        bvh_packet_fill(ctx, bvh.packets.back(), node.begin, node.end);
+        bvh.sah_cost += area * TA_BVH_PACKET_COST;
+        return;
+    }
+    bvh.sah_cost += area * TA_BVH_TRAVERSAL_COST;
+    bvh_flatten(ctx, bvh, nodes, node.left, inverse_root_area);
+    bvh.nodes[out].index = (uint32_t)bvh.nodes.size();
+    bvh_flatten(ctx, bvh, nodes, node.right, inverse_root_area);
+}
+
+// Pulls up to 4 binary descendants into one wide node, always opening the inner child with the biggest area
+static uint32_t bvh_collapse(ta_bvh &bvh, uint32_t binary)
+{
+    uint32_t out = (uint32_t)bvh.nodes4.size();
+    ta_bvh_node4 wide = {};
+    for (int slot = 0; slot < 4; ++slot) {
+        wide.min_x[slot] = wide.min_y[slot] = wide.min_z[slot] = FLT_MAX;
+        wide.max_x[slot] = wide.max_y[slot] = wide.max_z[slot] = -FLT_MAX;
+    }
+    bvh.nodes4.push_back(wide);
+
+    uint32_t children[4] = { binary };
+    uint32_t child_count = 1;
+    if (!bvh.nodes[binary].count) {
+        children[0] = binary + 1;
+        children[1] = bvh.nodes[binary].index;
+        child_count = 2;
+    }
+    while (child_count < 4) {
+        int open = -1;
+        float open_area = -1.0f;
+        for (uint32_t i = 0; i < child_count; ++i) {
+            const ta_bvh_node &child = bvh.nodes[children[i]];
+            bvh_box box = {};
+            memcpy(box.min, child.min, sizeof(box.min));
+            memcpy(box.max, child.max, sizeof(box.max));
+            if (!child.count && bvh_box_area(box) > open_area) {
+                open = (int)i;
+                open_area = bvh_box_area(box);
+            }
+        }
+        if (open < 0) {
+            break;
+        }
+        uint32_t opened = children[open];
+        children[open] = opened + 1;
+        children[child_count++] = bvh.nodes[opened].index;
+    }
+
+    for (uint32_t slot = 0; slot < child_count; ++slot) {
+        const ta_bvh_node &child = bvh.nodes[children[slot]];
+        uint32_t index = child.count ? child.index : bvh_collapse(bvh, children[slot]);
+        ta_bvh_node4 &node = bvh.nodes4[out];
+        node.min_x[slot] = child.min[0];
+        node.min_y[slot] = child.min[1];
+        node.min_z[slot] = child.min[2];
+        node.max_x[slot] = child.max[0];
+        node.max_y[slot] = child.max[1];
+        node.max_z[slot] = child.max[2];
+        node.index[slot] = index;
+        node.count[slot] = child.count;
+    }
+    return out;
+}
+
+// Binned SAH over the triangles of an indexed mesh, position_stride is in bytes. With jobs, triangle bounds and the
+// binning of big nodes near the root run in parallel, and every subtree of at most TA_BVH_TASK_TRIANGLES is built
+// by its own job. The result doesn't depend on the number of threads.
+void ta_bvh_build(ta_bvh &bvh, const float *positions, uint32_t position_stride, const uint32_t *indices,
+    uint32_t triangle_count, ta_jobs *jobs)
+{
+    double start_ms = ta_timer_elapsed_ms();
+    ta_bvh_free(bvh);
+    bvh.triangle_count = triangle_count;
+    if (!triangle_count) {
+        return;
+    }
+
+    bvh_context ctx = {};
+    ctx.positions = positions;
+    ctx.position_stride = position_stride;
+    ctx.indices = indices;
+    ctx.triangle_count = triangle_count;
+    ctx.jobs = jobs;
+    ctx.refs.resize(triangle_count);
+    uint32_t chunk_count = (triangle_count + BVH_CHUNK_TRIANGLES - 1) / BVH_CHUNK_TRIANGLES;
+    if (jobs) {
+        ta_jobs_parallel_for(*jobs, chunk_count, bvh_bounds_job, &ctx);
+    } else {
+        for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+            bvh_bounds_job(&ctx, chunk, 0);
+        }
+    }
+    bvh_box bounds = {};
+    bvh_box_empty(bounds);
+    for (const bvh_ref &ref : ctx.refs) {
+        bvh_box_merge(bounds, ref.box);
+    }
+
+    std::vector<bvh_build_node> top;
+    bvh_build_top(ctx, top, 0, triangle_count, bounds, 0);
+    uint32_t task_count = (uint32_t)ctx.tasks.size();
+    if (jobs) {
+        ta_jobs_parallel_for(*jobs, task_count, bvh_task_job, &ctx);
+    } else {
+        for (uint32_t task = 0; task < task_count; ++task) {
+            bvh_task_job(&ctx, task, 0);
+        }
+    }
+
+    size_t node_count = 0;
+    for (const bvh_task &task : ctx.tasks) {
+        node_count += task.nodes.size();
+    }
+    bvh.nodes.reserve(node_count + top.size());
+    bvh.packets.reserve(node_count / 2 + 1);
+    bvh_flatten(ctx, bvh, top, 0, 1.0f / std::max(bvh_box_area(bounds), FLT_MIN));
+    bvh.nodes4.reserve(bvh.nodes.size() / 3 + 1);
+    bvh_collapse(bvh, 0);
+    bvh.task_count = task_count;
+    bvh.build_ms = ta_timer_elapsed_ms() - start_ms;
+}
+
+// Full detail triangles of a cooked mesh, positions decoded if quantized. The file is only open for the build.
+bool ta_bvh_build_mesh(ta_bvh &bvh, const char *path, ta_jobs *jobs)
+{
+    ta_mesh_file file = {};
+    if (!ta_mesh_file_open(file, path)) {
+        return false;
+    }
+    const ta_mesh_header &header = *file.header;
+    std::vector<float> positions((size_t)header.vertex_count * 3);
+    for (uint32_t i = 0; i < header.vertex_count; ++i) {
+        const uint8_t *vertex = file.vertices + (size_t)i * header.vertex_stride;
+        if (header.vertex_format == MESH_VERTEX_QUANTIZED) {
+            ta_mesh_vertex decoded = {};
+            ta_mesh_quant_vertex_decode(*(const ta_mesh_vertex_quantized *)vertex, header.decode, decoded);
+            memcpy(&positions[i * 3], decoded.position, sizeof(decoded.position));
+        } else {
+            memcpy(&positions[i * 3], ((const ta_mesh_vertex *)vertex)->position, sizeof(float) * 3);
+        }
+    }
+    std::vector<uint32_t> indices;
+    for (uint32_t s = 0; s < header.submesh_count; ++s) {
+        const ta_mesh_submesh &submesh = file.submeshes[s];
+        for (uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; ++i) {
+            indices.push_back(header.index_size == 2 ? ((const uint16_t *)file.indices)[i] :
+                ((const uint32_t *)file.indices)[i]);
+        }
+    }
+    ta_mesh_file_close(file);
+    ta_bvh_build(bvh, positions.data(), sizeof(float) * 3, indices.data(), (uint32_t)indices.size() / 3, jobs);
+    return true;
+}
+
+// Möller-Trumbore against all 4 lanes of a packet at once, both sides count
+static void bvh_packet_intersect(const ta_bvh_packet &packet, const __m128 origin[3], const __m128 direction[3],
+    ta_bvh_hit &hit)
+{
+    __m128 e1x = _mm_loadu_ps(packet.e1[0]);
+    __m128 e1y = _mm_loadu_ps(packet.e1[1]);
+    __m128 e1z = _mm_loadu_ps(packet.e1[2]);
+    __m128 e2x = _mm_loadu_ps(packet.e2[0]);
+    __m128 e2y = _mm_loadu_ps(packet.e2[1]);
+    __m128 e2z = _mm_loadu_ps(packet.e2[2]);
+    __m128 px = _mm_sub_ps(_mm_mul_ps(direction[1], e2z), _mm_mul_ps(direction[2], e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(direction[2], e2x), _mm_mul_ps(direction[0], e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(direction[0], e2y), _mm_mul_ps(direction[1], e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inverse_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    __m128 tx = _mm_sub_ps(origin[0], _mm_loadu_ps(packet.v0[0]));
+    __m128 ty = _mm_sub_ps(origin[1], _mm_loadu_ps(packet.v0[1]));
+    __m128 tz = _mm_sub_ps(origin[2], _mm_loadu_ps(packet.v0[2]));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)),
+        inverse_det);
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction[0], qx), _mm_mul_ps(direction[1], qy)),
+        _mm_mul_ps(direction[2], qz)), inverse_det);
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)),
+        inverse_det);
+
+    // NOTE: Padding lanes have det == 0, and NaNs from it fail every compare
+    __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_cmpneq_ps(det, zero);
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(hit.t)));
+    int bits = _mm_movemask_ps(mask);
+    if (!bits) {
+        return;
+    }
+    float ts[4];
+    float us[4];
+    float vs[4];
+    _mm_storeu_ps(ts, t);
+    _mm_storeu_ps(us, u);
+    _mm_storeu_ps(vs, v);
+    for (int lane = 0; lane < 4; ++lane) {
+        if ((bits & (1 << lane)) && ts[lane] < hit.t) {
+            hit.t = ts[lane];
+            hit.u = us[lane];
+            hit.v = vs[lane];
+            hit.triangle = packet.triangle[lane];
+        }
+    }
+}
+
+static void bvh_hit_init(const ta_bvh_ray &ray, ta_bvh_hit &hit)
+{
+    hit.t = ray.t_max;
+    hit.u = 0.0f;
+    hit.v = 0.0f;
+    hit.triangle = BVH_NONE;
+}
+
+static float bvh_inverse(float x)
+{
+    // NOTE: FLT_MAX instead of inf, so a zero times it is still zero
+    return x != 0.0f ? 1.0f / x : FLT_MAX;
+}
+
+// Closest hit within (0, t_max), tested 4 boxes and 4 triangles at a time. Children are visited near to far.
+bool ta_bvh_raycast(const ta_bvh &bvh, const ta_bvh_ray &ray, ta_bvh_hit &hit)
+{
+    bvh_hit_init(ray, hit);
+    if (bvh.nodes4.empty()) {
+        return false;
+    }
+    float inverse[3] = { bvh_inverse(ray.direction[0]), bvh_inverse(ray.direction[1]), bvh_inverse(ray.direction[2]) };
+    __m128 origin[3] = { _mm_set1_ps(ray.origin[0]), _mm_set1_ps(ray.origin[1]), _mm_set1_ps(ray.origin[2]) };
+    __m128 direction[3] = {
+        _mm_set1_ps(ray.direction[0]), _mm_set1_ps(ray.direction[1]), _mm_set1_ps(ray.direction[2])
+    };
+    __m128 inverse_direction[3] = { _mm_set1_ps(inverse[0]), _mm_set1_ps(inverse[1]), _mm_set1_ps(inverse[2]) };
+    // Per axis, the slab a ray enters through depends only on its direction. Empty slots (min > max) never hit.
+    size_t near_x = inverse[0] >= 0.0f ? offsetof(ta_bvh_node4, min_x) : offsetof(ta_bvh_node4, max_x);
+    size_t near_y = inverse[1] >= 0.0f ? offsetof(ta_bvh_node4, min_y) : offsetof(ta_bvh_node4, max_y);
+    size_t near_z = inverse[2] >= 0.0f ? offsetof(ta_bvh_node4, min_z) : offsetof(ta_bvh_node4, max_z);
+    size_t far_x = inverse[0] >= 0.0f ? offsetof(ta_bvh_node4, max_x) : offsetof(ta_bvh_node4, min_x);
+    size_t far_y = inverse[1] >= 0.0f ? offsetof(ta_bvh_node4, max_y) : offsetof(ta_bvh_node4, min_y);
+    size_t far_z = inverse[2] >= 0.0f ? offsetof(ta_bvh_node4, max_z) : offsetof(ta_bvh_node4, min_z);
+
+    uint32_t stack[TA_BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size) {
+        const ta_bvh_node4 &node = bvh.nodes4[stack[--stack_size]];
+        const uint8_t *base = (const uint8_t *)&node;
+        __m128 t_near = _mm_max_ps(
+            _mm_max_ps(
+                _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((const float *)(base + near_x)), origin[0]), inverse_direction[0]),
+                _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((const float *)(base + near_y)), origin[1]), inverse_direction[1])),
+            _mm_max_ps(
+                _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((const float *)(base + near_z)), origin[2]), inverse_direction[2]),
+                _mm_setzero_ps()));
+        __m128 t_far = _mm_min_ps(
+            _mm_min_ps(
+                _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((const float *)(base + far_x)), origin[0]), inverse_direction[0]),
+                _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((const float *)(base + far_y)), origin[1]), inverse_direction[1])),
+            _mm_min_ps(
+                _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((const float *)(base + far_z)), origin[2]), inverse_direction[2]),
+                _mm_set1_ps(hit.t)));
+        int bits = _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+        if (!bits) {
+            continue;
+        }
+        float distances[4];
+        _mm_storeu_ps(distances, t_near);
+
+        // Leaves right away, inner children onto the stack farthest first
+        uint32_t inner[4];
+        uint32_t inner_count = 0;
+        for (uint32_t slot = 0; slot < 4; ++slot) {
+            if (!(bits & (1 << slot))) {
+                continue;
+            }
+            if (node.count[slot]) {
+                bvh_packet_intersect(bvh.packets[node.index[slot]], origin, direction, hit);
+            } else {
+                inner[inner_count++] = slot;
+            }
+        }
+        for (uint32_t i = 1; i < inner_count; ++i) {
+            for (uint32_t j = i; j > 0 && distances[inner[j - 1]] < distances[inner[j]]; --j) {
+                std::swap(inner[j - 1], inner[j]);
+            }
+        }
+        assert(stack_size + inner_count <= TA_BVH_STACK_SIZE);
+        for (uint32_t i = 0; i < inner_count; ++i) {
+            stack[stack_size++] = node.index[inner[i]];
+        }
+    }
+    return hit.triangle != BVH_NONE;
+}
+
+static bool bvh_box_hit(const ta_bvh_node &node, const float origin[3], const float inverse[3], float t_max,
+    float &t_near)
+{
+    float t0 = 0.0f;
+    float t1 = t_max;
+    for (int axis = 0; axis < 3; ++axis) {
+        float a = (node.min[axis] - origin[axis]) * inverse[axis];
+        float b = (node.max[axis] - origin[axis]) * inverse[axis];
+        t0 = std::max(t0, std::min(a, b));
+        t1 = std::min(t1, std::max(a, b));
+    }
+    t_near = t0;
+    return t0 <= t1;
+}
+
+// Same query one box and one triangle at a time over the binary tree, as the baseline for the benchmark
+bool ta_bvh_raycast_binary(const ta_bvh &bvh, const ta_bvh_ray &ray, ta_bvh_hit &hit)
+{
+    bvh_hit_init(ray, hit);
+    if (bvh.nodes.empty()) {
+        return false;
+    }
+    float inverse[3] = { bvh_inverse(ray.direction[0]), bvh_inverse(ray.direction[1]), bvh_inverse(ray.direction[2]) };
+    float t_near = 0.0f;
+    if (!bvh_box_hit(bvh.nodes[0], ray.origin, inverse, hit.t, t_near)) {
+        return false;
+    }
+    uint32_t stack[TA_BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    uint32_t index = 0;
+    for (;;) {
+        const ta_bvh_node &node = bvh.nodes[index];
+        if (node.count) {
+            const ta_bvh_packet &packet = bvh.packets[node.index];
+            for (uint32_t lane = 0; lane < node.count; ++lane) {
+                float e1[3] = { packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane] };
+                float e2[3] = { packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane] };
+                const float *d = ray.direction;
+                float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+                float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+                if (det == 0.0f) {
+                    continue;
+                }
+                float inverse_det = 1.0f / det;
+                float s[3] = {
+                    ray.origin[0] - packet.v0[0][lane], ray.origin[1] - packet.v0[1][lane],
+                    ray.origin[2] - packet.v0[2][lane]
+                };
+                float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse_det;
+                float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+                float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverse_det;
+                float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse_det;
+                if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < hit.t) {
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    hit.triangle = packet.triangle[lane];
+                }
+            }
+        } else {
+            uint32_t left = index + 1;
+            uint32_t right = node.index;
+            float t_left = 0.0f;
+            float t_right = 0.0f;
+            bool hit_left = bvh_box_hit(bvh.nodes[left], ray.origin, inverse, hit.t, t_left);
+            bool hit_right = bvh_box_hit(bvh.nodes[right], ray.origin, inverse, hit.t, t_right);
+            if (hit_left && hit_right) {
+                if (t_right < t_left) {
+                    std::swap(left, right);
+                }
+                assert(stack_size < TA_BVH_STACK_SIZE);
+                stack[stack_size++] = right;
+                index = left;
+                continue;
+            }
+            if (hit_left || hit_right) {
+                index = hit_left ? left : right;
+                continue;
+            }
+        }
+        if (!stack_size) {
+            break;
+        }
+        index = stack[--stack_size];
+    }
+    return hit.triangle != BVH_NONE;
+}
+
+void ta_bvh_free(ta_bvh &bvh)
+{
+    std::vector<ta_bvh_node>().swap(bvh.nodes);
+    std::vector<ta_bvh_node4>().swap(bvh.nodes4);
+    std::vector<ta_bvh_packet>().swap(bvh.packets);
+    bvh.triangle_count = 0;
+    bvh.task_count = 0;
+    bvh.sah_cost = 0.0f;
+    bvh.build_ms = 0.0;
+}
+
+// xorshift32, so every run shoots the same rays
+static float bvh_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+static void bvh_benchmark_mesh(ta_jobs &jobs, const char *name, const ta_mesh_data &data)
+{
+    const int runs = 3;
+    const uint32_t ray_count = 1 << 18;
+    const float *positions = data.vertices[0].position;
+    const uint32_t stride = (uint32_t)sizeof(ta_mesh_vertex);
+    const uint32_t triangle_count = (uint32_t)data.indices.size() / 3;
+    ta_bvh bvh = {};
+    double single_ms = 0.0;
+    double parallel_ms = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        ta_bvh_build(bvh, positions, stride, data.indices.data(), triangle_count, NULL);
+        single_ms = run ? std::min(single_ms, bvh.build_ms) : bvh.build_ms;
+        ta_bvh_build(bvh, positions, stride, data.indices.data(), triangle_count, &jobs);
+        parallel_ms = run ? std::min(parallel_ms, bvh.build_ms) : bvh.build_ms;
+    }
+
+    // Rays from anywhere in the bounds in any direction
+    std::vector<ta_bvh_ray> rays(ray_count);
+    uint32_t state = 0x9e3779b9;
+    for (ta_bvh_ray &ray : rays) {
+        float z = bvh_random(state) * 2.0f - 1.0f;
+        float angle = bvh_random(state) * 6.2831853f;
+        float r = sqrtf(std::max(0.0f, 1.0f - z * z));
+        for (int axis = 0; axis < 3; ++axis) {
+            ray.origin[axis] = data.bounds.min[axis] + bvh_random(state) * (data.bounds.max[axis] -
+                data.bounds.min[axis]);
+        }
+        ray.direction[0] = r * cosf(angle);
+        ray.direction[1] = r * sinf(angle);
+        ray.direction[2] = z;
+        ray.t_max = FLT_MAX;
+    }
+    std::vector<ta_bvh_hit> hits(ray_count);
+    double start_ms = ta_timer_elapsed_ms();
+    for (uint32_t i = 0; i < ray_count; ++i) {
+        ta_bvh_raycast_binary(bvh, rays[i], hits[i]);
+    }
+    double binary_ms = ta_timer_elapsed_ms() - start_ms;
+    uint32_t hit_count = 0;
+    uint32_t mismatches = 0;
+    start_ms = ta_timer_elapsed_ms();
+    for (uint32_t i = 0; i < ray_count; ++i) {
+        ta_bvh_hit hit = {};
+        hit_count += ta_bvh_raycast(bvh, rays[i], hit);
+        mismatches += hit.triangle != hits[i].triangle && fabsf(hit.t - hits[i].t) > 1e-4f * hit.t;
+    }
+    double wide_ms = ta_timer_elapsed_ms() - start_ms;
+
+    ta_log_write(tg_debug_log, SRC_FILE, "%-24s %9u tris  build 1 thread %8.2fms  %u threads %8.2fms (%5.2fx, %u "
+        "tasks)  SAH %6.1f  rays binary %6.2fM/s  4-wide %6.2fM/s (%4.2fx)  %.0f%% hit\n", name, triangle_count,
+        single_ms, jobs.worker_count + 1, parallel_ms, parallel_ms > 0.0 ? single_ms / parallel_ms : 0.0,
+        bvh.task_count, bvh.sah_cost, ray_count / (binary_ms * 1000.0), ray_count / (wide_ms * 1000.0),
+        wide_ms > 0.0 ? binary_ms / wide_ms : 0.0, 100.0 * hit_count / ray_count);
+    if (mismatches) {
+        ta_log_write(tg_debug_log, SRC_FILE, "    MISMATCH: %u rays hit something else 4-wide\n", mismatches);
+    }
+    ta_bvh_free(bvh);
+}
+
+// Build (best of 3) and closest hit throughput (one thread, 256k random rays) on each mesh, then on the last one
+// (the level) tiled in a 3D grid until it has synthetic_triangles
+void ta_bvh_benchmark(ta_jobs &jobs, const char *const *paths, uint32_t path_count, uint32_t synthetic_triangles)
+{
+    ta_log_write(tg_debug_log, SRC_FILE, "BVH benchmark:\n");
+    ta_log_indent(tg_debug_log);
+    ta_mesh_data level = {};
+    for (uint32_t i = 0; i < path_count; ++i) {
+        ta_obj obj = {};
+        if (!ta_obj_load(obj, paths[i], &jobs)) {
+            continue;
+        }
+        ta_mesh_data data = {};
+        ta_mesh_cook_from_obj(data, obj);
+        if (data.indices.empty()) {
+            continue;
+        }
+        const char *name = strrchr(paths[i], '/');
+        bvh_benchmark_mesh(jobs, name ? name + 1 : paths[i], data);
+        if (i == path_count - 1) {
+            level = data;
+        }
+    }
+    if (synthetic_triangles && !level.indices.empty()) {
+        uint32_t triangles = (uint32_t)level.indices.size() / 3;
+        uint32_t side = (uint32_t)ceil(cbrt((double)synthetic_triangles / triangles));
+        float spacing[3] = {};
+        for (int axis = 0; axis < 3; ++axis) {
+            spacing[axis] = (level.bounds.max[axis] - level.bounds.min[axis]) * 1.1f;
+        }
+        ta_mesh_data scene = {};
+        scene.vertices.reserve(level.vertices.size() * side * side * side);
+        scene.indices.reserve(level.indices.size() * side * side * side);
+        for (uint32_t copy = 0; copy < side * side * side; ++copy) {
+            uint32_t cell[3] = { copy % side, copy / side % side, copy / (side * side) };
+            uint32_t base = (uint32_t)scene.vertices.size();
+            for (ta_mesh_vertex vertex : level.vertices) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    vertex.position[axis] += cell[axis] * spacing[axis];
+                }
+                scene.vertices.push_back(vertex);
+            }
+            for (uint32_t i = 0; i < triangles * 3; ++i) {
+                scene.indices.push_back(base + level.indices[i]);
+            }
+        }
+        ta_mesh_submesh submesh = {};
+        submesh.index_count = (uint32_t)scene.indices.size();
+        scene.submeshes.push_back(submesh);
+        ta_mesh_cook_bounds(scene);
+        const char *name = strrchr(paths[path_count - 1], '/');
+        char scene_name[64] = {};
+        snprintf(scene_name, sizeof(scene_name), "%s x%u", name ? name + 1 : paths[path_count - 1],
+            side * side * side);
+        bvh_benchmark_mesh(jobs, scene_name, scene);
+    }
+    ta_log_unindent(tg_debug_log);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "ta_jobs.hpp"
+#include <cstdint>
+#include <vector>
+
+// SAH bins per axis
+#define TA_BVH_BINS             16
+// Leaves hold up to one packet of triangles, intersected 4 at a time
+#define TA_BVH_LEAF_TRIANGLES   4
+// SAH costs of stepping into a node vs. testing a leaf's packet
+#define TA_BVH_TRAVERSAL_COST   1.0f
+#define TA_BVH_PACKET_COST      1.0f
+// Ranges at most this big are built as one job, bigger ones are split first (with parallel binning)
+#define TA_BVH_TASK_TRIANGLES   4096
+// Deepest leaf of the binary tree, nodes that would go past it split at the median instead of by SAH
+#define TA_BVH_MAX_DEPTH        40
+// Traversal stack, holds 3 entries per level of the 4-wide tree (which is no deeper than the binary one) plus the root
+#define TA_BVH_STACK_SIZE       128
+
+// Binary node, 32 bytes. Depth first order, so an inner node's left child is the next node.
+typedef struct ta_bvh_node {
+    float    min[3];
+    uint32_t index;     // leaf: packet, inner: right child
+    float    max[3];
+    uint32_t count;     // leaf: triangles in the packet, inner: 0
+} ta_bvh_node;
+
+// 4-wide node for SIMD traversal, 128 bytes, children's bounds stored per axis. Unused slots have an empty box.
+typedef struct ta_bvh_node4 {
+    float    min_x[4];
+    float    min_y[4];
+    float    min_z[4];
+    float    max_x[4];
+    float    max_y[4];
+    float    max_z[4];
+    uint32_t index[4];  // leaf: packet, inner: node
+    uint32_t count[4];  // leaf: triangles in the packet, inner: 0
+} ta_bvh_node4;
+
+// Up to 4 triangles as vertex + edges, lanes past the leaf's count are degenerate and never hit. 160 bytes.
+typedef struct ta_bvh_packet {
+    float    v0[3][4];
+    float    e1[3][4];
+    float    e2[3][4];
+    uint32_t triangle[4];
+} ta_bvh_packet;
+
+typedef struct ta_bvh_ray {
+    float origin[3];
+    float direction[3];     // needn't be normalized, t is in units of it
+    float t_max;
+} ta_bvh_ray;
+
+typedef struct ta_bvh_hit {
+    float    t;
+    float    u;
+    float    v;
+    uint32_t triangle;      // UINT32_MAX on a miss
+} ta_bvh_hit;
+
+// Triangle BVH over static geometry (the level), built once with binned SAH. Keeps the binary tree it was built as
+// and the same tree collapsed to 4-wide nodes, queries use the latter.
+typedef struct ta_bvh {
+    std::vector<ta_bvh_node>   nodes;
+    std::vector<ta_bvh_node4>  nodes4;
+    std::vector<ta_bvh_packet> packets;
+    uint32_t                   triangle_count;
+    // Stats
+    uint32_t                   task_count;
+    float                      sah_cost;
+    double                     build_ms;
+} ta_bvh;
+
+void ta_bvh_build                       (ta_bvh &bvh, const float *positions, uint32_t position_stride,
+                                         const uint32_t *indices, uint32_t triangle_count, ta_jobs *jobs);
+bool ta_bvh_build_mesh                  (ta_bvh &bvh, const char *path, ta_jobs *jobs);
+bool ta_bvh_raycast                     (const ta_bvh &bvh, const ta_bvh_ray &ray, ta_bvh_hit &hit);
+bool ta_bvh_raycast_binary              (const ta_bvh &bvh, const ta_bvh_ray &ray, ta_bvh_hit &hit);
+void ta_bvh_free                        (ta_bvh &bvh);
+void ta_bvh_benchmark                   (ta_jobs &jobs, const char *const *paths, uint32_t path_count,
+                                         uint32_t synthetic_triangles);
@@ -0,0 +1,960 @@
+#include "ta_bvh_dynamic.hpp"
+#include "ta_log.hpp"
+#include "ta_mesh_cook.hpp"
+#include "ta_obj.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#define DYN_NONE TA_BVH_DYNAMIC_NONE
+
+typedef struct dyn_entry {
+    uint32_t node;
+    float    t_near;
+} dyn_entry;
+
+typedef struct dyn_raycast_context {
+    const ta_bvh_dynamic *tree;
+    const ta_bvh_ray     *rays;
+    ta_bvh_dynamic_hit   *hits;
+    uint32_t             ray_count;
+} dyn_raycast_context;
+
+typedef struct dyn_overlap_context {
+    const ta_bvh_dynamic                     *tree;
+    const ta_bvh_aabb                        *boxes;
+    uint32_t                                 box_count;
+    std::vector<std::vector<ta_bvh_overlap>> batches;
+} dyn_overlap_context;
+
+static void dyn_box_empty(ta_bvh_aabb &box)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = FLT_MAX;
+        box.max[axis] = -FLT_MAX;
+    }
+}
+
+static void dyn_box_merge(ta_bvh_aabb &box, const ta_bvh_aabb &other)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = std::min(box.min[axis], other.min[axis]);
+        box.max[axis] = std::max(box.max[axis], other.max[axis]);
+    }
+}
+
+static ta_bvh_aabb dyn_box_union(const ta_bvh_aabb &a, const ta_bvh_aabb &b)
+{
+    ta_bvh_aabb box = a;
+    dyn_box_merge(box, b);
+    return box;
+}
+
+// Half the surface area, the SAH only ever compares them
+static float dyn_box_area(const ta_bvh_aabb &box)
+{
+    float extent[3] = {};
+    for (int axis = 0; axis < 3; ++axis) {
+        extent[axis] = std::max(box.max[axis] - box.min[axis], 0.0f);
+    }
+    return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+}
+
+static bool dyn_box_overlaps(const ta_bvh_aabb &a, const ta_bvh_aabb &b)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        if (a.min[axis] > b.max[axis] || b.min[axis] > a.max[axis]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool dyn_box_hit(const ta_bvh_aabb &box, const float origin[3], const float inverse[3], float t_max,
+    float &t_near)
+{
+    float t0 = 0.0f;
+    float t1 = t_max;
+    for (int axis = 0; axis < 3; ++axis) {
+        float a = (box.min[axis] - origin[axis]) * inverse[axis];
+        float b = (box.max[axis] - origin[axis]) * inverse[axis];
+        t0 = std::max(t0, std::min(a, b));
+        t1 = std::min(t1, std::max(a, b));
+    }
+    t_near = t0;
+    return t0 <= t1;
+}
+
+static float dyn_inverse(float x)
+{
+    // NOTE: FLT_MAX instead of inf, so a zero times it is still zero
+    return x != 0.0f ? 1.0f / x : FLT_MAX;
+}
+
+// World box of an object space box, per row: translation + the extremes of each column's contribution (Arvo)
+static void dyn_box_transform(const float transform[12], const float min[3], const float max[3], ta_bvh_aabb &box)
+{
+    for (int row = 0; row < 3; ++row) {
+        box.min[row] = box.max[row] = transform[row * 4 + 3];
+        for (int column = 0; column < 3; ++column) {
+            float a = transform[row * 4 + column] * min[column];
+            float b = transform[row * 4 + column] * max[column];
+            box.min[row] += std::min(a, b);
+            box.max[row] += std::max(a, b);
+        }
+    }
+}
+
+// Inverse of an affine 3x4. A singular transform gets all zeroes, which no ray hits.
+static void dyn_transform_invert(const float m[12], float inverse[12])
+{
+    float c00 = m[5] * m[10] - m[6] * m[9];
+    float c01 = m[6] * m[8] - m[4] * m[10];
+    float c02 = m[4] * m[9] - m[5] * m[8];
+    float det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+    memset(inverse, 0, 12 * sizeof(float));
+    if (fabsf(det) < FLT_MIN) {
+        return;
+    }
+    float s = 1.0f / det;
+    inverse[0] = c00 * s;
+    inverse[1] = (m[2] * m[9] - m[1] * m[10]) * s;
+    inverse[2] = (m[1] * m[6] - m[2] * m[5]) * s;
+    inverse[4] = c01 * s;
+    inverse[5] = (m[0] * m[10] - m[2] * m[8]) * s;
+    inverse[6] = (m[2] * m[4] - m[0] * m[6]) * s;
+    inverse[8] = c02 * s;
+    inverse[9] = (m[1] * m[8] - m[0] * m[9]) * s;
+    inverse[10] = (m[0] * m[5] - m[1] * m[4]) * s;
+    for (int row = 0; row < 3; ++row) {
+        const float *r = &inverse[row * 4];
+        inverse[row * 4 + 3] = -(r[0] * m[3] + r[1] * m[7] + r[2] * m[11]);
+    }
+}
+
+static bool dyn_is_leaf(const ta_bvh_dynamic_node &node)
+{
+    return node.children[0] == DYN_NONE;
+}
+
+// Freed nodes are leaves without a proxy
+static bool dyn_is_free(const ta_bvh_dynamic_node &node)
+{
+    return node.children[0] == DYN_NONE && node.proxy == DYN_NONE;
+}
+
+static bool dyn_is_degraded(const ta_bvh_dynamic_node &node)
+{
+    return !dyn_is_leaf(node) && dyn_box_area(node.box) > node.built_area * TA_BVH_DYNAMIC_DEGRADE;
+}
+
+static uint32_t dyn_node_alloc(ta_bvh_dynamic &tree)
+{
+    uint32_t index = 0;
+    if (!tree.free_nodes.empty()) {
+        index = tree.free_nodes.back();
+        tree.free_nodes.pop_back();
+    } else {
+        index = (uint32_t)tree.nodes.size();
+        tree.nodes.push_back({});
+    }
+    ta_bvh_dynamic_node &node = tree.nodes[index];
+    dyn_box_empty(node.box);
+    node.parent = DYN_NONE;
+    node.children[0] = DYN_NONE;
+    node.children[1] = DYN_NONE;
+    node.proxy = DYN_NONE;
+    node.built_area = 0.0f;
+    return index;
+}
+
+static void dyn_node_release(ta_bvh_dynamic &tree, uint32_t index)
+{
+    ta_bvh_dynamic_node &node = tree.nodes[index];
+    node.children[0] = DYN_NONE;
+    node.children[1] = DYN_NONE;
+    node.proxy = DYN_NONE;
+    tree.free_nodes.push_back(index);
+}
+
+// Points whatever referenced old_child (its parent, or the root) at new_child
+static void dyn_replace_child(ta_bvh_dynamic &tree, uint32_t parent, uint32_t old_child, uint32_t new_child)
+{
+    if (parent == DYN_NONE) {
+        tree.root = new_child;
+    } else {
+        ta_bvh_dynamic_node &node = tree.nodes[parent];
+        node.children[node.children[0] == old_child ? 0 : 1] = new_child;
+    }
+    tree.nodes[new_child].parent = parent;
+}
+
+// Recomputes boxes from index up to the root, stopping at the first one that didn't change. Nodes grown past their
+// built area are remembered for the next update.
+static void dyn_refit(ta_bvh_dynamic &tree, uint32_t index)
+{
+    while (index != DYN_NONE) {
+        ta_bvh_dynamic_node &node = tree.nodes[index];
+        ta_bvh_aabb box = dyn_box_union(tree.nodes[node.children[0]].box, tree.nodes[node.children[1]].box);
+        if (!memcmp(&box, &node.box, sizeof(box))) {
+            break;
+        }
+        node.box = box;
+        tree.refit_nodes++;
+        if (dyn_is_degraded(node)) {
+            tree.degraded.push_back(index);
+        }
+        index = node.parent;
+    }
+}
+
+// Picks the leaf's sibling greedily: go down while a child is a cheaper place to add it than pairing it with the node
+// itself, counting the area every ancestor grows by (the inherited cost)
+static void dyn_insert_leaf(ta_bvh_dynamic &tree, uint32_t leaf)
+{
+    if (tree.root == DYN_NONE) {
+        tree.root = leaf;
+        tree.nodes[leaf].parent = DYN_NONE;
+        return;
+    }
+    ta_bvh_aabb box = tree.nodes[leaf].box;
+    uint32_t index = tree.root;
+    while (!dyn_is_leaf(tree.nodes[index])) {
+        const ta_bvh_dynamic_node &node = tree.nodes[index];
+        float area = dyn_box_area(node.box);
+        float combined = dyn_box_area(dyn_box_union(node.box, box));
+        float cost = 2.0f * combined;
+        float inherited = 2.0f * (combined - area);
+        float child_cost[2] = {};
+        for (int i = 0; i < 2; ++i) {
+            const ta_bvh_dynamic_node &child = tree.nodes[node.children[i]];
+            float grown = dyn_box_area(dyn_box_union(child.box, box));
+            child_cost[i] = (dyn_is_leaf(child) ? grown : grown - dyn_box_area(child.box)) + inherited;
+        }
+        if (cost < child_cost[0] && cost < child_cost[1]) {
+            break;
+        }
+        index = node.children[child_cost[1] < child_cost[0] ? 1 : 0];
+    }
+
+    uint32_t sibling = index;
+    uint32_t old_parent = tree.nodes[sibling].parent;
+    uint32_t parent = dyn_node_alloc(tree);
+    ta_bvh_dynamic_node &node = tree.nodes[parent];
+    node.box = dyn_box_union(tree.nodes[sibling].box, box);
+    node.built_area = dyn_box_area(node.box);
+    node.children[0] = sibling;
+    node.children[1] = leaf;
+    dyn_replace_child(tree, old_parent, sibling, parent);
+    tree.nodes[sibling].parent = parent;
+    tree.nodes[leaf].parent = parent;
+    dyn_refit(tree, old_parent);
+}
+
+// Takes the leaf out and its parent with it, the sibling moves up in the parent's place
+static void dyn_remove_leaf(ta_bvh_dynamic &tree, uint32_t leaf)
+{
+    uint32_t parent = tree.nodes[leaf].parent;
+    if (parent == DYN_NONE) {
+        tree.root = DYN_NONE;
+        return;
+    }
+    const ta_bvh_dynamic_node &node = tree.nodes[parent];
+    uint32_t sibling = node.children[node.children[0] == leaf ? 1 : 0];
+    uint32_t grandparent = node.parent;
+    dyn_replace_child(tree, grandparent, parent, sibling);
+    dyn_node_release(tree, parent);
+    dyn_refit(tree, grandparent);
+}
+
+static void dyn_collect_leaves(ta_bvh_dynamic &tree, uint32_t index, std::vector<uint32_t> &leaves, bool release)
+{
+    std::vector<uint32_t> stack(1, index);
+    while (!stack.empty()) {
+        uint32_t current = stack.back();
+        stack.pop_back();
+        const ta_bvh_dynamic_node &node = tree.nodes[current];
+        if (dyn_is_leaf(node)) {
+            leaves.push_back(current);
+            continue;
+        }
+        stack.push_back(node.children[1]);
+        stack.push_back(node.children[0]);
+        if (release) {
+            dyn_node_release(tree, current);
+        }
+    }
+}
+
+static float dyn_centroid(const ta_bvh_dynamic &tree, uint32_t leaf, int axis)
+{
+    const ta_bvh_aabb &box = tree.nodes[leaf].box;
+    return (box.min[axis] + box.max[axis]) * 0.5f;
+}
+
+// Binned SAH over leaves [begin, end), one proxy per leaf. Returns the subtree's root.
+static uint32_t dyn_build(ta_bvh_dynamic &tree, std::vector<uint32_t> &leaves, uint32_t begin, uint32_t end,
+    uint32_t parent)
+{
+    if (end - begin == 1) {
+        tree.nodes[leaves[begin]].parent = parent;
+        return leaves[begin];
+    }
+    ta_bvh_aabb bounds = {};
+    ta_bvh_aabb centroids = {};
+    dyn_box_empty(bounds);
+    dyn_box_empty(centroids);
+    for (uint32_t i = begin; i < end; ++i) {
+        dyn_box_merge(bounds, tree.nodes[leaves[i]].box);
+        for (int axis = 0; axis < 3; ++axis) {
+            float c = dyn_centroid(tree, leaves[i], axis);
+            centroids.min[axis] = std::min(centroids.min[axis], c);
+            centroids.max[axis] = std::max(centroids.max[axis], c);
+        }
+    }
+
+    int best_axis = -1;
+    uint32_t best_bin = 0;
+    float best_cost = FLT_MAX;
+    uint32_t count = end - begin;
+    uint32_t bin_count = std::min((uint32_t)TA_BVH_BINS, std::max(count, 4u));
+    for (int axis = 0; axis < 3; ++axis) {
+        float extent = centroids.max[axis] - centroids.min[axis];
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float scale = bin_count / extent;
+        ta_bvh_aabb bin_boxes[TA_BVH_BINS];
+        uint32_t bin_counts[TA_BVH_BINS] = {};
+        for (uint32_t bin = 0; bin < bin_count; ++bin) {
+            dyn_box_empty(bin_boxes[bin]);
+        }
+        for (uint32_t i = begin; i < end; ++i) {
+            float offset = (dyn_centroid(tree, leaves[i], axis) - centroids.min[axis]) * scale;
+            uint32_t bin = std::min((uint32_t)offset, bin_count - 1);
+            dyn_box_merge(bin_boxes[bin], tree.nodes[leaves[i]].box);
+            bin_counts[bin]++;
+        }
+        // Sweep right to left for the right side's areas, then left to right for the costs
+        float right_area[TA_BVH_BINS] = {};
+        ta_bvh_aabb right = {};
+        dyn_box_empty(right);
+        for (uint32_t bin = bin_count - 1; bin > 0; --bin) {
+            dyn_box_merge(right, bin_boxes[bin]);
+            right_area[bin] = dyn_box_area(right);
+        }
+        ta_bvh_aabb left = {};
+        dyn_box_empty(left);
+        uint32_t left_count = 0;
+        for (uint32_t bin = 0; bin + 1 < bin_count; ++bin) {
+            dyn_box_merge(left, bin_boxes[bin]);
+            left_count += bin_counts[bin];
+            uint32_t right_count = count - left_count;
+            if (!left_count || !right_count) {
+                continue;
+            }
+            float cost = dyn_box_area(left) * left_count + right_area[bin + 1] * right_count;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = bin;
+            }
+        }
+    }
+
+    uint32_t middle = 0;
+    if (best_axis >= 0) {
+        float scale = bin_count / (centroids.max[best_axis] - centroids.min[best_axis]);
+        uint32_t *split = std::partition(leaves.data() + begin, leaves.data() + end, [&](uint32_t leaf) {
+            float offset = (dyn_centroid(tree, leaf, best_axis) - centroids.min[best_axis]) * scale;
+            return std::min((uint32_t)offset, bin_count - 1) <= best_bin;
+        });
+        middle = (uint32_t)(split - leaves.data());
+    } else {
+        // All centroids in one spot, any split is as good as any other
+        middle = begin + count / 2;
+    }
+
+    uint32_t index = dyn_node_alloc(tree);
+    uint32_t left_child = dyn_build(tree, leaves, begin, middle, index);
+    uint32_t right_child = dyn_build(tree, leaves, middle, end, index);
+    ta_bvh_dynamic_node &node = tree.nodes[index];
+    node.box = bounds;
+    node.built_area = dyn_box_area(bounds);
+    node.parent = parent;
+    node.children[0] = left_child;
+    node.children[1] = right_child;
+    return index;
+}
+
+// Replaces the inner nodes under index with a fresh SAH build over the same leaves. The subtree's box stays the same,
+// so nothing above needs a refit.
+static void dyn_rebuild_subtree(ta_bvh_dynamic &tree, uint32_t index, std::vector<uint32_t> &leaves)
+{
+    uint32_t parent = tree.nodes[index].parent;
+    leaves.clear();
+    dyn_collect_leaves(tree, index, leaves, true);
+    uint32_t root = dyn_build(tree, leaves, 0, (uint32_t)leaves.size(), parent);
+    dyn_replace_child(tree, parent, index, root);
+    tree.rebuilt_subtrees++;
+    tree.rebuilt_leaves += (uint32_t)leaves.size();
+}
+
+static void dyn_proxy_box(ta_bvh_proxy &proxy)
+{
+    if (proxy.blas->nodes.empty()) {
+        for (int axis = 0; axis < 3; ++axis) {
+            proxy.box.min[axis] = proxy.box.max[axis] = proxy.transform[axis * 4 + 3];
+        }
+        return;
+    }
+    const ta_bvh_node &root = proxy.blas->nodes[0];
+    dyn_box_transform(proxy.transform, root.min, root.max, proxy.box);
+}
+
+static uint32_t dyn_proxy_alloc(ta_bvh_dynamic &tree)
+{
+    uint32_t index = 0;
+    if (!tree.free_proxies.empty()) {
+        index = tree.free_proxies.back();
+        tree.free_proxies.pop_back();
+    } else {
+        index = (uint32_t)tree.proxies.size();
+        tree.proxies.push_back({});
+        tree.moved_flags.push_back(0);
+    }
+    tree.proxies[index] = {};
+    tree.moved_flags[index] = 0;
+    return index;
+}
+
+static uint32_t dyn_proxy_insert(ta_bvh_dynamic &tree, uint32_t proxy)
+{
+    uint32_t leaf = dyn_node_alloc(tree);
+    tree.nodes[leaf].box = tree.proxies[proxy].box;
+    tree.nodes[leaf].proxy = proxy;
+    tree.proxies[proxy].node = leaf;
+    dyn_insert_leaf(tree, leaf);
+    return proxy;
+}
+
+static void dyn_proxy_moved(ta_bvh_dynamic &tree, uint32_t proxy)
+{
+    if (!tree.moved_flags[proxy]) {
+        tree.moved_flags[proxy] = 1;
+        tree.moved.push_back(proxy);
+    }
+}
+
+void ta_bvh_dynamic_init(ta_bvh_dynamic &tree)
+{
+    ta_bvh_dynamic_free(tree);
+}
+
+// Adds an instance of a mesh BVH. The BLAS is borrowed and has to outlive the proxy.
+uint32_t ta_bvh_dynamic_add(ta_bvh_dynamic &tree, const ta_bvh &blas, const float transform[12], uint32_t user)
+{
+    uint32_t proxy = dyn_proxy_alloc(tree);
+    ta_bvh_proxy &p = tree.proxies[proxy];
+    p.blas = &blas;
+    memcpy(p.transform, transform, sizeof(p.transform));
+    dyn_transform_invert(p.transform, p.inverse);
+    p.user = user;
+    dyn_proxy_box(p);
+    return dyn_proxy_insert(tree, proxy);
+}
+
+uint32_t ta_bvh_dynamic_add_box(ta_bvh_dynamic &tree, const ta_bvh_aabb &box, uint32_t user)
+{
+    uint32_t proxy = dyn_proxy_alloc(tree);
+    ta_bvh_proxy &p = tree.proxies[proxy];
+    p.box = box;
+    p.transform[0] = p.transform[5] = p.transform[10] = 1.0f;
+    p.inverse[0] = p.inverse[5] = p.inverse[10] = 1.0f;
+    p.user = user;
+    return dyn_proxy_insert(tree, proxy);
+}
+
+// Moves take effect at the next ta_bvh_dynamic_update, queries in between see the proxy where it was
+void ta_bvh_dynamic_move(ta_bvh_dynamic &tree, uint32_t proxy, const float transform[12])
+{
+    ta_bvh_proxy &p = tree.proxies[proxy];
+    memcpy(p.transform, transform, sizeof(p.transform));
+    if (p.blas) {
+        dyn_proxy_box(p);
+    }
+    dyn_proxy_moved(tree, proxy);
+}
+
+void ta_bvh_dynamic_move_box(ta_bvh_dynamic &tree, uint32_t proxy, const ta_bvh_aabb &box)
+{
+    tree.proxies[proxy].box = box;
+    dyn_proxy_moved(tree, proxy);
+}
+
+void ta_bvh_dynamic_remove(ta_bvh_dynamic &tree, uint32_t proxy)
+{
+    ta_bvh_proxy &p = tree.proxies[proxy];
+    if (p.node == DYN_NONE) {
+        return;
+    }
+    dyn_remove_leaf(tree, p.node);
+    dyn_node_release(tree, p.node);
+    p.node = DYN_NONE;
+    p.blas = NULL;
+    tree.moved_flags[proxy] = 0;
+    tree.free_proxies.push_back(proxy);
+}
+
+// Refits the path of every proxy moved since the last update, O(moved * depth), then rebuilds the topmost subtree
+// above each node the refits (or inserts) grew past TA_BVH_DYNAMIC_DEGRADE times its built area
+void ta_bvh_dynamic_update(ta_bvh_dynamic &tree)
+{
+    tree.refit_nodes = 0;
+    tree.rebuilt_subtrees = 0;
+    tree.rebuilt_leaves = 0;
+    for (uint32_t proxy : tree.moved) {
+        ta_bvh_proxy &p = tree.proxies[proxy];
+        tree.moved_flags[proxy] = 0;
+        if (p.node == DYN_NONE) {
+            continue;
+        }
+        dyn_transform_invert(p.transform, p.inverse);
+        tree.nodes[p.node].box = p.box;
+        dyn_refit(tree, tree.nodes[p.node].parent);
+    }
+    tree.moved.clear();
+
+    // Freed (or since reused) nodes fail the checks below or lead to the same top as a live one
+    std::vector<uint32_t> tops;
+    for (uint32_t index : tree.degraded) {
+        if (dyn_is_free(tree.nodes[index]) || !dyn_is_degraded(tree.nodes[index])) {
+            continue;
+        }
+        uint32_t top = index;
+        for (uint32_t parent = tree.nodes[index].parent; parent != DYN_NONE; parent = tree.nodes[parent].parent) {
+            if (dyn_is_degraded(tree.nodes[parent])) {
+                top = parent;
+            }
+        }
+        tops.push_back(top);
+    }
+    tree.degraded.clear();
+    std::sort(tops.begin(), tops.end());
+    tops.erase(std::unique(tops.begin(), tops.end()), tops.end());
+    std::vector<uint32_t> leaves;
+    for (uint32_t top : tops) {
+        dyn_rebuild_subtree(tree, top, leaves);
+    }
+}
+
+// Whole tree from scratch with binned SAH, for loading a scene or when many proxies were added at once
+void ta_bvh_dynamic_rebuild(ta_bvh_dynamic &tree)
+{
+    ta_bvh_dynamic_update(tree);
+    if (tree.root == DYN_NONE) {
+        return;
+    }
+    std::vector<uint32_t> leaves;
+    dyn_rebuild_subtree(tree, tree.root, leaves);
+}
+
+// SAH cost of the tree relative to its root: every node's area over the root's, as each is one box test
+float ta_bvh_dynamic_sah(const ta_bvh_dynamic &tree)
+{
+    if (tree.root == DYN_NONE) {
+        return 0.0f;
+    }
+    float root_area = dyn_box_area(tree.nodes[tree.root].box);
+    if (root_area <= 0.0f) {
+        return 0.0f;
+    }
+    double cost = 0.0;
+    std::vector<uint32_t> stack(1, tree.root);
+    while (!stack.empty()) {
+        const ta_bvh_dynamic_node &node = tree.nodes[stack.back()];
+        stack.pop_back();
+        cost += dyn_box_area(node.box);
+        if (!dyn_is_leaf(node)) {
+            stack.push_back(node.children[0]);
+            stack.push_back(node.children[1]);
+        }
+    }
+    return (float)(cost / root_area);
+}
+
+// Closest hit over all proxies, children visited near to far. BLAS proxies take the ray into object space, which
+// keeps t as is (the direction isn't renormalized).
+static void dyn_raycast(const ta_bvh_dynamic &tree, const ta_bvh_ray &ray, ta_bvh_dynamic_hit &hit,
+    std::vector<dyn_entry> &stack)
+{
+    hit.t = ray.t_max;
+    hit.proxy = DYN_NONE;
+    hit.triangle = DYN_NONE;
+    hit.u = 0.0f;
+    hit.v = 0.0f;
+    if (tree.root == DYN_NONE) {
+        return;
+    }
+    float inverse[3] = { dyn_inverse(ray.direction[0]), dyn_inverse(ray.direction[1]), dyn_inverse(ray.direction[2]) };
+    float t_near = 0.0f;
+    if (!dyn_box_hit(tree.nodes[tree.root].box, ray.origin, inverse, hit.t, t_near)) {
+        return;
+    }
+    stack.clear();
+    stack.push_back({ tree.root, t_near });
+    while (!stack.empty()) {
+        dyn_entry entry = stack.back();
+        stack.pop_back();
+        if (entry.t_near > hit.t) {
+            continue;
+        }
+        const ta_bvh_dynamic_node &node = tree.nodes[entry.node];
+        if (dyn_is_leaf(node)) {
+            const ta_bvh_proxy &proxy = tree.proxies[node.proxy];
+            if (!proxy.blas) {
+                hit.t = entry.t_near;
+                hit.proxy = node.proxy;
+                hit.triangle = DYN_NONE;
+                continue;
+            }
+            const float *m = proxy.inverse;
+            ta_bvh_ray local = {};
+            for (int row = 0; row < 3; ++row) {
+                const float *r = &m[row * 4];
+                local.origin[row] = r[0] * ray.origin[0] + r[1] * ray.origin[1] + r[2] * ray.origin[2] + r[3];
+                local.direction[row] = r[0] * ray.direction[0] + r[1] * ray.direction[1] + r[2] * ray.direction[2];
+            }
+            local.t_max = hit.t;
+            ta_bvh_hit local_hit = {};
+            if (ta_bvh_raycast(*proxy.blas, local, local_hit) && local_hit.t < hit.t) {
+                hit.t = local_hit.t;
+                hit.proxy = node.proxy;
+                hit.triangle = local_hit.triangle;
+                hit.u = local_hit.u;
+                hit.v = local_hit.v;
+            }
+            continue;
+        }
+        float t[2] = {};
+        bool hits[2] = {};
+        for (int i = 0; i < 2; ++i) {
+            hits[i] = dyn_box_hit(tree.nodes[node.children[i]].box, ray.origin, inverse, hit.t, t[i]);
+        }
+        int first = t[1] < t[0] ? 1 : 0;
+        if (hits[first ^ 1]) {
+            stack.push_back({ node.children[first ^ 1], t[first ^ 1] });
+        }
+        if (hits[first]) {
+            stack.push_back({ node.children[first], t[first] });
+        }
+    }
+}
+
+static void dyn_raycast_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    const dyn_raycast_context &ctx = *(const dyn_raycast_context *)userdata;
+    uint32_t begin = index * TA_BVH_DYNAMIC_BATCH;
+    uint32_t end = std::min(begin + TA_BVH_DYNAMIC_BATCH, ctx.ray_count);
+    std::vector<dyn_entry> stack;
+    stack.reserve(64);
+    for (uint32_t i = begin; i < end; ++i) {
+        dyn_raycast(*ctx.tree, ctx.rays[i], ctx.hits[i], stack);
+    }
+}
+
+// Closest hit for each ray, TA_BVH_DYNAMIC_BATCH rays per job when jobs is given
+void ta_bvh_dynamic_raycast(const ta_bvh_dynamic &tree, const ta_bvh_ray *rays, uint32_t ray_count,
+    ta_bvh_dynamic_hit *hits, ta_jobs *jobs)
+{
+    dyn_raycast_context ctx = { &tree, rays, hits, ray_count };
+    uint32_t batch_count = (ray_count + TA_BVH_DYNAMIC_BATCH - 1) / TA_BVH_DYNAMIC_BATCH;
+    if (jobs && batch_count > 1) {
+        ta_jobs_parallel_for(*jobs, batch_count, dyn_raycast_job, &ctx);
+    } else {
+        for (uint32_t batch = 0; batch < batch_count; ++batch) {
+            dyn_raycast_job(&ctx, batch, 0);
+        }
+    }
+}
+
+static void dyn_overlap_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    dyn_overlap_context &ctx = *(dyn_overlap_context *)userdata;
+    const ta_bvh_dynamic &tree = *ctx.tree;
+    std::vector<ta_bvh_overlap> &overlaps = ctx.batches[index];
+    overlaps.clear();
+    if (tree.root == DYN_NONE) {
+        return;
+    }
+    uint32_t begin = index * TA_BVH_DYNAMIC_BATCH;
+    uint32_t end = std::min(begin + TA_BVH_DYNAMIC_BATCH, ctx.box_count);
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    for (uint32_t query = begin; query < end; ++query) {
+        const ta_bvh_aabb &box = ctx.boxes[query];
+        stack.assign(1, tree.root);
+        while (!stack.empty()) {
+            const ta_bvh_dynamic_node &node = tree.nodes[stack.back()];
+            stack.pop_back();
+            if (!dyn_box_overlaps(node.box, box)) {
+                continue;
+            }
+            if (dyn_is_leaf(node)) {
+                overlaps.push_back({ query, node.proxy });
+            } else {
+                stack.push_back(node.children[1]);
+                stack.push_back(node.children[0]);
+            }
+        }
+    }
+}
+
+// Every (box, proxy) pair that overlaps, appended to overlaps in query order. Batches collect their own pairs and
+// are joined in order, so the result doesn't depend on how the jobs ran.
+void ta_bvh_dynamic_overlap(const ta_bvh_dynamic &tree, const ta_bvh_aabb *boxes, uint32_t box_count,
+    std::vector<ta_bvh_overlap> &overlaps, ta_jobs *jobs)
+{
+    dyn_overlap_context ctx = {};
+    ctx.tree = &tree;
+    ctx.boxes = boxes;
+    ctx.box_count = box_count;
+    uint32_t batch_count = (box_count + TA_BVH_DYNAMIC_BATCH - 1) / TA_BVH_DYNAMIC_BATCH;
+    ctx.batches.resize(batch_count);
+    if (jobs && batch_count > 1) {
+        ta_jobs_parallel_for(*jobs, batch_count, dyn_overlap_job, &ctx);
+    } else {
+        for (uint32_t batch = 0; batch < batch_count; ++batch) {
+            dyn_overlap_job(&ctx, batch, 0);
+        }
+    }
+    for (const std::vector<ta_bvh_overlap> &batch : ctx.batches) {
+        overlaps.insert(overlaps.end(), batch.begin(), batch.end());
+    }
+}
+
+void ta_bvh_dynamic_free(ta_bvh_dynamic &tree)
+{
+    std::vector<ta_bvh_dynamic_node>().swap(tree.nodes);
+    std::vector<uint32_t>().swap(tree.free_nodes);
+    std::vector<ta_bvh_proxy>().swap(tree.proxies);
+    std::vector<uint32_t>().swap(tree.free_proxies);
+    std::vector<uint32_t>().swap(tree.moved);
+    std::vector<uint8_t>().swap(tree.moved_flags);
+    std::vector<uint32_t>().swap(tree.degraded);
+    tree.root = DYN_NONE;
+    tree.refit_nodes = 0;
+    tree.rebuilt_subtrees = 0;
+    tree.rebuilt_leaves = 0;
+}
+
+// xorshift32, so every run moves the same props and shoots the same rays
+static float dyn_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+// Rotation about y, then translation
+static void dyn_transform_set(float transform[12], float angle, const float position[3])
+{
+    float c = cosf(angle);
+    float s = sinf(angle);
+    float m[12] = {
+        c,    0.0f, s,    position[0],
+        0.0f, 1.0f, 0.0f, position[1],
+        -s,   0.0f, c,    position[2],
+    };
+    memcpy(transform, m, sizeof(m));
+}
+
+typedef struct dyn_benchmark_prop {
+    float position[3];
+    float angle;
+} dyn_benchmark_prop;
+
+// Props (every mesh but the last, the level) scattered on a grid, instance_count of them. Times incremental inserts
+// against one SAH rebuild, per frame updates with a tenth of the props moving, then batched raycasts and box queries
+// on one thread and on all of them, checked against testing every proxy.
+void ta_bvh_dynamic_benchmark(ta_jobs &jobs, const char *const *paths, uint32_t path_count, uint32_t instance_count)
+{
+    ta_log_write(tg_debug_log, SRC_FILE, "Dynamic BVH benchmark:\n");
+    ta_log_indent(tg_debug_log);
+    std::vector<ta_bvh> blases;
+    blases.reserve(path_count);
+    float spacing = 0.0f;
+    for (uint32_t i = 0; i + 1 < path_count; ++i) {
+        ta_obj obj = {};
+        if (!ta_obj_load(obj, paths[i], &jobs)) {
+            continue;
+        }
+        ta_mesh_data data = {};
+        ta_mesh_cook_from_obj(data, obj);
+        if (data.indices.empty()) {
+            continue;
+        }
+        blases.push_back({});
+        ta_bvh_build(blases.back(), data.vertices[0].position, (uint32_t)sizeof(ta_mesh_vertex), data.indices.data(),
+            (uint32_t)data.indices.size() / 3, &jobs);
+        spacing = std::max(spacing, 2.0f * data.bounds.radius);
+    }
+    if (blases.empty() || !instance_count) {
+        ta_log_unindent(tg_debug_log);
+        return;
+    }
+
+    const uint32_t frames = 60;
+    const uint32_t query_count = 1 << 16;
+    const uint32_t checked_count = 1024;
+    uint32_t side = (uint32_t)ceil(cbrt((double)instance_count));
+    float scene_size = side * spacing;
+    uint32_t state = 0x9e3779b9;
+    std::vector<dyn_benchmark_prop> props(instance_count);
+    for (uint32_t i = 0; i < instance_count; ++i) {
+        uint32_t cell[3] = { i % side, i / side % side, i / (side * side) };
+        for (int axis = 0; axis < 3; ++axis) {
+            props[i].position[axis] = (cell[axis] + dyn_random(state)) * spacing;
+        }
+        props[i].angle = dyn_random(state) * 6.2831853f;
+    }
+
+    ta_bvh_dynamic tree = {};
+    ta_bvh_dynamic_init(tree);
+    double start_ms = ta_timer_elapsed_ms();
+    for (uint32_t i = 0; i < instance_count; ++i) {
+        float transform[12] = {};
+        dyn_transform_set(transform, props[i].angle, props[i].position);
+        ta_bvh_dynamic_add(tree, blases[i % blases.size()], transform, i);
+    }
+    double insert_ms = ta_timer_elapsed_ms() - start_ms;
+    float insert_sah = ta_bvh_dynamic_sah(tree);
+    start_ms = ta_timer_elapsed_ms();
+    ta_bvh_dynamic_rebuild(tree);
+    double rebuild_ms = ta_timer_elapsed_ms() - start_ms;
+    float rebuild_sah = ta_bvh_dynamic_sah(tree);
+
+    // Random walk, each prop drifts a quarter of its cell per move
+    double update_ms = 0.0;
+    uint64_t refit_nodes = 0;
+    uint32_t rebuilt_subtrees = 0;
+    uint64_t rebuilt_leaves = 0;
+    uint32_t moved_count = std::max(instance_count / 10, 1u);
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        for (uint32_t i = 0; i < moved_count; ++i) {
+            uint32_t proxy = (uint32_t)(dyn_random(state) * instance_count) % instance_count;
+            dyn_benchmark_prop &prop = props[proxy];
+            for (int axis = 0; axis < 3; ++axis) {
+                prop.position[axis] += (dyn_random(state) - 0.5f) * 0.5f * spacing;
+            }
+            prop.angle += dyn_random(state) - 0.5f;
+            float transform[12] = {};
+            dyn_transform_set(transform, prop.angle, prop.position);
+            ta_bvh_dynamic_move(tree, proxy, transform);
+        }
+        start_ms = ta_timer_elapsed_ms();
+        ta_bvh_dynamic_update(tree);
+        update_ms += ta_timer_elapsed_ms() - start_ms;
+        refit_nodes += tree.refit_nodes;
+        rebuilt_subtrees += tree.rebuilt_subtrees;
+        rebuilt_leaves += tree.rebuilt_leaves;
+    }
+    float moved_sah = ta_bvh_dynamic_sah(tree);
+
+    ta_log_write(tg_debug_log, SRC_FILE, "%u props (%u meshes)  insert %8.2fms SAH %6.1f  rebuild %8.2fms SAH %6.1f  "
+        "update %u moved %7.3fms/frame, %6.0f nodes refit, %u subtrees (%.0f leaves) rebuilt over %u frames, "
+        "SAH %6.1f\n", instance_count, (uint32_t)blases.size(), insert_ms, insert_sah, rebuild_ms, rebuild_sah,
+        moved_count, update_ms / frames, (double)refit_nodes / frames, rebuilt_subtrees, (double)rebuilt_leaves,
+        frames, moved_sah);
+
+    // Rays from anywhere in the scene in any direction, boxes a prop's size
+    std::vector<ta_bvh_ray> rays(query_count);
+    std::vector<ta_bvh_aabb> boxes(query_count);
+    for (uint32_t i = 0; i < query_count; ++i) {
+        ta_bvh_ray &ray = rays[i];
+        float z = dyn_random(state) * 2.0f - 1.0f;
+        float angle = dyn_random(state) * 6.2831853f;
+        float r = sqrtf(std::max(0.0f, 1.0f - z * z));
+        for (int axis = 0; axis < 3; ++axis) {
+            ray.origin[axis] = dyn_random(state) * scene_size;
+            boxes[i].min[axis] = dyn_random(state) * scene_size;
+            boxes[i].max[axis] = boxes[i].min[axis] + spacing;
+        }
+        ray.direction[0] = r * cosf(angle);
+        ray.direction[1] = r * sinf(angle);
+        ray.direction[2] = z;
+        ray.t_max = FLT_MAX;
+    }
+    std::vector<ta_bvh_dynamic_hit> hits(query_count);
+    start_ms = ta_timer_elapsed_ms();
+    ta_bvh_dynamic_raycast(tree, rays.data(), query_count, hits.data(), NULL);
+    double ray_single_ms = ta_timer_elapsed_ms() - start_ms;
+    start_ms = ta_timer_elapsed_ms();
+    ta_bvh_dynamic_raycast(tree, rays.data(), query_count, hits.data(), &jobs);
+    double ray_parallel_ms = ta_timer_elapsed_ms() - start_ms;
+    std::vector<ta_bvh_overlap> overlaps;
+    start_ms = ta_timer_elapsed_ms();
+    ta_bvh_dynamic_overlap(tree, boxes.data(), query_count, overlaps, NULL);
+    double box_single_ms = ta_timer_elapsed_ms() - start_ms;
+    overlaps.clear();
+    start_ms = ta_timer_elapsed_ms();
+    ta_bvh_dynamic_overlap(tree, boxes.data(), query_count, overlaps, &jobs);
+    double box_parallel_ms = ta_timer_elapsed_ms() - start_ms;
+
+    uint32_t hit_count = 0;
+    for (const ta_bvh_dynamic_hit &hit : hits) {
+        hit_count += hit.proxy != DYN_NONE;
+    }
+    uint32_t ray_mismatches = 0;
+    uint32_t box_mismatches = 0;
+    uint32_t overlap = 0;
+    for (uint32_t i = 0; i < checked_count; ++i) {
+        float best = rays[i].t_max;
+        uint32_t box_count = 0;
+        for (uint32_t proxy = 0; proxy < instance_count; ++proxy) {
+            const ta_bvh_proxy &p = tree.proxies[proxy];
+            ta_bvh_ray local = {};
+            for (int row = 0; row < 3; ++row) {
+                const float *r = &p.inverse[row * 4];
+                local.origin[row] = r[0] * rays[i].origin[0] + r[1] * rays[i].origin[1] + r[2] * rays[i].origin[2] +
+                    r[3];
+                local.direction[row] = r[0] * rays[i].direction[0] + r[1] * rays[i].direction[1] +
+                    r[2] * rays[i].direction[2];
+            }
+            local.t_max = best;
+            ta_bvh_hit hit = {};
+            if (ta_bvh_raycast(*p.blas, local, hit)) {
+                best = std::min(best, hit.t);
+            }
+            box_count += dyn_box_overlaps(p.box, boxes[i]);
+        }
+        ray_mismatches += fabsf(best - hits[i].t) > 1e-4f * best;
+        uint32_t found = 0;
+        for (; overlap < overlaps.size() && overlaps[overlap].query == i; ++overlap) {
+            found++;
+        }
+        box_mismatches += found != box_count;
+    }
+
+    ta_log_write(tg_debug_log, SRC_FILE, "rays 1 thread %6.2fM/s  %u threads %6.2fM/s (%4.2fx)  %.0f%% hit  boxes 1 "
+        "thread %6.2fM/s  %u threads %6.2fM/s (%4.2fx)  %.1f props per box\n", query_count / (ray_single_ms * 1000.0),
+        jobs.worker_count + 1, query_count / (ray_parallel_ms * 1000.0),
+        ray_parallel_ms > 0.0 ? ray_single_ms / ray_parallel_ms : 0.0, 100.0 * hit_count / query_count,
+        query_count / (box_single_ms * 1000.0), jobs.worker_count + 1, query_count / (box_parallel_ms * 1000.0),
+        box_parallel_ms > 0.0 ? box_single_ms / box_parallel_ms : 0.0, (double)overlaps.size() / query_count);
+    if (ray_mismatches || box_mismatches) {
+        ta_log_write(tg_debug_log, SRC_FILE, "    MISMATCH: %u of %u rays, %u of %u boxes differ from testing every "
+            "proxy\n", ray_mismatches, checked_count, box_mismatches, checked_count);
+    }
+
+    ta_bvh_dynamic_free(tree);
+    for (ta_bvh &blas : blases) {
+        ta_bvh_free(blas);
+    }
+    ta_log_unindent(tg_debug_log);
+}
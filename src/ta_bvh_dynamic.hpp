@@ -0,0 +1,82 @@
+#pragma once
+#include "ta_bvh.hpp"
+#include "ta_jobs.hpp"
+#include <cstdint>
+#include <vector>
+
+#define TA_BVH_DYNAMIC_NONE     UINT32_MAX
+// A subtree is rebuilt with SAH once refits have grown its area past this multiple of what it was when built
+#define TA_BVH_DYNAMIC_DEGRADE  1.5f
+// Rays or boxes per job in batched queries
+#define TA_BVH_DYNAMIC_BATCH    256
+
+typedef struct ta_bvh_aabb {
+    float min[3];
+    float max[3];
+} ta_bvh_aabb;
+
+typedef struct ta_bvh_dynamic_node {
+    ta_bvh_aabb box;
+    uint32_t    parent;         // TA_BVH_DYNAMIC_NONE for the root
+    uint32_t    children[2];    // TA_BVH_DYNAMIC_NONE for leaves
+    uint32_t    proxy;          // leaves only
+    float       built_area;     // half surface area when this node was made, refits are measured against it
+} ta_bvh_dynamic_node;
+
+// Something that moves: a box, or a mesh BVH (the bottom level) placed by a transform
+typedef struct ta_bvh_proxy {
+    ta_bvh_aabb  box;               // world space
+    const ta_bvh *blas;             // NULL for a plain box
+    float        transform[12];     // object to world, 3x4 row major
+    float        inverse[12];       // world to object
+    uint32_t     node;              // leaf, TA_BVH_DYNAMIC_NONE while the proxy slot is free
+    uint32_t     user;
+} ta_bvh_proxy;
+
+typedef struct ta_bvh_dynamic_hit {
+    float    t;
+    uint32_t proxy;         // TA_BVH_DYNAMIC_NONE on a miss
+    uint32_t triangle;      // in the proxy's BLAS, TA_BVH_DYNAMIC_NONE for plain boxes
+    float    u;
+    float    v;
+} ta_bvh_dynamic_hit;
+
+typedef struct ta_bvh_overlap {
+    uint32_t query;
+    uint32_t proxy;
+} ta_bvh_overlap;
+
+// Top level BVH over moving proxies. Moves only mark proxies, ta_bvh_dynamic_update then refits each moved leaf's
+// path to the root and rebuilds whatever subtrees those refits degraded. ta_bvh_dynamic_init before use.
+typedef struct ta_bvh_dynamic {
+    std::vector<ta_bvh_dynamic_node> nodes;
+    std::vector<uint32_t>            free_nodes;
+    std::vector<ta_bvh_proxy>        proxies;
+    std::vector<uint32_t>            free_proxies;
+    std::vector<uint32_t>            moved;         // proxies, since the last update
+    std::vector<uint8_t>             moved_flags;   // per proxy
+    std::vector<uint32_t>            degraded;      // nodes grown past TA_BVH_DYNAMIC_DEGRADE, since the last update
+    uint32_t                         root;
+    // Stats of the last update
+    uint32_t                         refit_nodes;
+    uint32_t                         rebuilt_subtrees;
+    uint32_t                         rebuilt_leaves;
+} ta_bvh_dynamic;
+
+void ta_bvh_dynamic_init                (ta_bvh_dynamic &tree);
+uint32_t ta_bvh_dynamic_add             (ta_bvh_dynamic &tree, const ta_bvh &blas, const float transform[12],
+                                         uint32_t user);
+uint32_t ta_bvh_dynamic_add_box         (ta_bvh_dynamic &tree, const ta_bvh_aabb &box, uint32_t user);
+void ta_bvh_dynamic_move                (ta_bvh_dynamic &tree, uint32_t proxy, const float transform[12]);
+void ta_bvh_dynamic_move_box            (ta_bvh_dynamic &tree, uint32_t proxy, const ta_bvh_aabb &box);
+void ta_bvh_dynamic_remove              (ta_bvh_dynamic &tree, uint32_t proxy);
+void ta_bvh_dynamic_update              (ta_bvh_dynamic &tree);
+void ta_bvh_dynamic_rebuild             (ta_bvh_dynamic &tree);
+float ta_bvh_dynamic_sah                (const ta_bvh_dynamic &tree);
+void ta_bvh_dynamic_raycast             (const ta_bvh_dynamic &tree, const ta_bvh_ray *rays, uint32_t ray_count,
+                                         ta_bvh_dynamic_hit *hits, ta_jobs *jobs);
+void ta_bvh_dynamic_overlap             (const ta_bvh_dynamic &tree, const ta_bvh_aabb *boxes, uint32_t box_count,
+                                         std::vector<ta_bvh_overlap> &overlaps, ta_jobs *jobs);
+void ta_bvh_dynamic_free                (ta_bvh_dynamic &tree);
+void ta_bvh_dynamic_benchmark           (ta_jobs &jobs, const char *const *paths, uint32_t path_count,
+                                         uint32_t instance_count);
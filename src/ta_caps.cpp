@@ -0,0 +1,406 @@
+#include "ta_caps.hpp"
+#include "ta_timer.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#define TA_CAPS_MAGIC 0x50414354  // "TCAP"
+
+#define VK_VERSION_ARGS(ver) VK_VERSION_MAJOR(ver), VK_VERSION_MINOR(ver), VK_VERSION_PATCH(ver)
+
+typedef struct caps_device_key {
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t  uuid[VK_UUID_SIZE];
+} caps_device_key;
+
+typedef struct caps_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t struct_sizes;      // Vulkan structs are stored raw, catch a header update changing them
+    uint32_t instance_version;
+    uint32_t device_count;
+    uint32_t hits;
+    double   enumerate_ms;
+    double   saved_ms;
+} caps_header;
+
+static uint32_t caps_struct_sizes()
+{
+    return (uint32_t)(sizeof(VkExtensionProperties) ^ sizeof(VkLayerProperties) << 8 ^
+        sizeof(VkPhysicalDeviceFeatures) << 16 ^ sizeof(VkQueueFamilyProperties) << 24);
+}
+
+static caps_device_key caps_key(const ta_caps_device &device)
+{
+    caps_device_key key = {};
+    key.vendor_id = device.properties.vendorID;
+    key.device_id = device.properties.deviceID;
+    key.driver_version = device.properties.driverVersion;
+    memcpy(key.uuid, device.uuid, sizeof(key.uuid));
+    return key;
+}
+
+// The key: physical devices and their properties. Cheap, no extension or layer enumeration.
+static VkResult caps_query_key(ta_caps &caps, VkInstance instance)
+{
+    uint32_t count = 0;
+    VkResult err = vkEnumeratePhysicalDevices(instance, &count, NULL);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to query count of available physical devices.\n", err);
+        return err;
+    }
+    std::vector<VkPhysicalDevice> handles(count);
+    err = vkEnumeratePhysicalDevices(instance, &count, handles.data());
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available physical devices.\n", err);
+        return err;
+    }
+
+    caps.devices.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        ta_caps_device &device = caps.devices[i];
+        device.handle = handles[i];
+        vkGetPhysicalDeviceProperties(device.handle, &device.properties);
+        memcpy(device.uuid, device.properties.pipelineCacheUUID, sizeof(device.uuid));
+        if (caps.instance_version >= VK_API_VERSION_1_1 && device.properties.apiVersion >= VK_API_VERSION_1_1) {
+            VkPhysicalDeviceIDProperties id_properties = {};
+            id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties = {};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties.pNext = &id_properties;
+            vkGetPhysicalDeviceProperties2(device.handle, &properties);
+            memcpy(device.uuid, id_properties.deviceUUID, sizeof(device.uuid));
+        }
+    }
+    return VK_SUCCESS;
+}
+
+static VkResult caps_enumerate(ta_caps &caps)
+{
+    uint32_t count = 0;
+    VkResult err = vkEnumerateInstanceExtensionProperties(NULL, &count, NULL);
+    if (!err) {
+        caps.instance_extensions.resize(count);
+        err = vkEnumerateInstanceExtensionProperties(NULL, &count, caps.instance_extensions.data());
+    }
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available instance extensions.\n", err);
+        return err;
+    }
+
+    err = vkEnumerateInstanceLayerProperties(&count, NULL);
+    if (!err) {
+        caps.layers.resize(count);
+        err = vkEnumerateInstanceLayerProperties(&count, caps.layers.data());
+    }
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available instance layers.\n", err);
+        return err;
+    }
+
+    for (ta_caps_device &device : caps.devices) {
+        vkGetPhysicalDeviceFeatures(device.handle, &device.features);
+
+        err = vkEnumerateDeviceExtensionProperties(device.handle, NULL, &count, NULL);
+        if (!err) {
+            device.extensions.resize(count);
+            err = vkEnumerateDeviceExtensionProperties(device.handle, NULL, &count, device.extensions.data());
+        }
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to enumerate available device extensions.\n", err);
+            return err;
+        }
+
+        vkGetPhysicalDeviceQueueFamilyProperties(device.handle, &count, NULL);
+        device.queue_families.resize(count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device.handle, &count, device.queue_families.data());
+    }
+    return VK_SUCCESS;
+}
+
+template <typename T>
+static void caps_write_vector(FILE *file, const std::vector<T> &items)
+{
+    uint32_t count = (uint32_t)items.size();
+    fwrite(&count, sizeof(count), 1, file);
+    fwrite(items.data(), sizeof(T), count, file);
+}
+
+template <typename T>
+static bool caps_read_vector(FILE *file, std::vector<T> &items)
+{
+    uint32_t count = 0;
+    if (fread(&count, sizeof(count), 1, file) != 1 || count > 4096) {
+        return false;
+    }
+    items.resize(count);
+    return fread(items.data(), sizeof(T), count, file) == count;
+}
+
+static bool caps_save(const ta_caps &caps, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to open capability snapshot '%s' for writing.\n", path);
+        return false;
+    }
+
+    caps_header header = {};
+    header.magic = TA_CAPS_MAGIC;
+    header.version = TA_CAPS_SNAPSHOT_VERSION;
+    header.struct_sizes = caps_struct_sizes();
+    header.instance_version = caps.instance_version;
+    header.device_count = (uint32_t)caps.devices.size();
+    header.hits = caps.hits;
+    header.enumerate_ms = caps.enumerate_ms;
+    header.saved_ms = caps.saved_ms;
+    fwrite(&header, sizeof(header), 1, file);
+    for (const ta_caps_device &device : caps.devices) {
+        caps_device_key key = caps_key(device);
+        fwrite(&key, sizeof(key), 1, file);
+    }
+
+    caps_write_vector(file, caps.instance_extensions);
+    caps_write_vector(file, caps.layers);
+    for (const ta_caps_device &device : caps.devices) {
+        fwrite(&device.features, sizeof(device.features), 1, file);
+        caps_write_vector(file, device.extensions);
+        caps_write_vector(file, device.queue_families);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+    if (!ok) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to write capability snapshot '%s'.\n", path);
+    }
+    return ok;
+}
+
+// False if there's no snapshot, it's from another build, or the key doesn't match caps' live key
+static bool caps_load(ta_caps &caps, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    bool ok = false;
+    caps_header header = {};
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == TA_CAPS_MAGIC &&
+        header.version == TA_CAPS_SNAPSHOT_VERSION && header.struct_sizes == caps_struct_sizes() &&
+        header.instance_version == caps.instance_version && header.device_count == caps.devices.size())
+    {
+        ok = true;
+        for (const ta_caps_device &device : caps.devices) {
+            caps_device_key live = caps_key(device);
+            caps_device_key key = {};
+            if (fread(&key, sizeof(key), 1, file) != 1 || memcmp(&key, &live, sizeof(key))) {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    if (ok) {
+        ok = caps_read_vector(file, caps.instance_extensions) && caps_read_vector(file, caps.layers);
+        for (size_t i = 0; ok && i < caps.devices.size(); ++i) {
+            ta_caps_device &device = caps.devices[i];
+            ok = fread(&device.features, sizeof(device.features), 1, file) == 1 &&
+                caps_read_vector(file, device.extensions) && caps_read_vector(file, device.queue_families);
+        }
+        if (!ok) {
+            ta_log_write(tg_debug_log, SRC_FILE, "Capability snapshot '%s' is truncated, re-enumerating.\n", path);
+        }
+    }
+    fclose(file);
+
+    if (ok) {
+        caps.hits = header.hits;
+        caps.enumerate_ms = header.enumerate_ms;
+        caps.saved_ms = header.saved_ms;
+    }
+    return ok;
+}
+
+// Fills caps from the snapshot at snapshot_path if its key matches, otherwise enumerates everything, logs it and
+// writes a new snapshot. refresh forces the full enumeration.
+bool ta_caps_init(ta_caps &caps, VkInstance instance, uint32_t instance_version, const char *snapshot_path,
+    bool refresh)
+{
+    double start_ms = ta_timer_elapsed_ms();
+    caps.instance_version = instance_version;
+    if (caps_query_key(caps, instance)) {
+        return false;
+    }
+
+    if (!refresh && caps_load(caps, snapshot_path)) {
+        caps.from_snapshot = true;
+        caps.startup_ms = ta_timer_elapsed_ms() - start_ms;
+        caps.hits++;
+        caps.saved_ms += caps.enumerate_ms - caps.startup_ms;
+        // Only the stats changed, but they have to survive to the next launch
+        caps_save(caps, snapshot_path);
+        return true;
+    }
+
+    if (caps_enumerate(caps)) {
+        return false;
+    }
+    ta_caps_log(caps, tg_debug_log);
+    caps.from_snapshot = false;
+    caps.startup_ms = ta_timer_elapsed_ms() - start_ms;
+    caps.enumerate_ms = caps.startup_ms;
+    caps.hits = 0;
+    caps.saved_ms = 0.0;
+    caps_save(caps, snapshot_path);
+    return true;
+}
+
+bool ta_caps_device_extension(const ta_caps_device &device, const char *name)
+{
+    for (const VkExtensionProperties &extension : device.extensions) {
+        if (!strcmp(extension.extensionName, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Everything, the way startup used to log it on every launch
+void ta_caps_log(const ta_caps &caps, ta_log &log)
+{
+    ta_log_write(log, SRC_VULKAN, "Instance version %u.%u.%u\n", VK_VERSION_ARGS(caps.instance_version));
+    ta_log_write(log, SRC_VULKAN, "Found %u available extensions:\n", (uint32_t)caps.instance_extensions.size());
+    for (const VkExtensionProperties &property : caps.instance_extensions) {
+        ta_log_write(log, SRC_VULKAN, "    %s\n", property.extensionName);
+    }
+    ta_log_write(log, SRC_VULKAN, "Found %u available layers:\n", (uint32_t)caps.layers.size());
+    for (const VkLayerProperties &layer : caps.layers) {
+        ta_log_write(log, SRC_VULKAN, "    %s\n", layer.layerName);
+    }
+
+    ta_log_write(log, SRC_VULKAN, "Found %u available physical devices:\n", (uint32_t)caps.devices.size());
+    for (const ta_caps_device &device : caps.devices) {
+        const char *device_type = "<unknown>";
+        switch (device.properties.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+                device_type = "OTHER";
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                device_type = "INTEGRATED_GPU";
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                device_type = "DISCRETE_GPU";
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                device_type = "VIRTUAL_GPU";
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU :
+                device_type = "CPU";
+                break;
+        }
+        ta_log_write(log, SRC_VULKAN, "    Device Properties:\n");
+        ta_log_write(log, SRC_VULKAN, "        apiVersion      : %u.%u.%u\n", VK_VERSION_ARGS(device.properties.apiVersion));
+        ta_log_write(log, SRC_VULKAN, "        driverVersion   : %u.%u.%u\n", VK_VERSION_ARGS(device.properties.driverVersion));
+        ta_log_write(log, SRC_VULKAN, "        vendorID        : %u\n",       device.properties.vendorID);
+        ta_log_write(log, SRC_VULKAN, "        deviceID        : %u\n",       device.properties.deviceID);
+        ta_log_write(log, SRC_VULKAN, "        deviceName      : %s\n",       device.properties.deviceName);
+        ta_log_write(log, SRC_VULKAN, "        deviceType      : %d (%s)\n",  device.properties.deviceType, device_type);
+        ta_log_write(log, SRC_VULKAN, "        limits:\n");
+        ta_log_write(log, SRC_VULKAN, "            maxImageDimension1D                      : %u\n", device.properties.limits.maxImageDimension1D);
+        ta_log_write(log, SRC_VULKAN, "            maxImageDimension2D                      : %u\n", device.properties.limits.maxImageDimension2D);
+        ta_log_write(log, SRC_VULKAN, "            maxImageDimension3D                      : %u\n", device.properties.limits.maxImageDimension3D);
+        ta_log_write(log, SRC_VULKAN, "            TODO: Show the rest of the fields in device.properties.limits\n");
+        ta_log_write(log, SRC_VULKAN, "        sparseProperties:\n");
+        ta_log_write(log, SRC_VULKAN, "            residencyStandard2DBlockShape            : %s\n", device.properties.sparseProperties.residencyStandard2DBlockShape            ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "            residencyStandard2DMultisampleBlockShape : %s\n", device.properties.sparseProperties.residencyStandard2DMultisampleBlockShape ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "            residencyStandard3DBlockShape            : %s\n", device.properties.sparseProperties.residencyStandard3DBlockShape            ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "            residencyAlignedMipSize                  : %s\n", device.properties.sparseProperties.residencyAlignedMipSize                  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "            residencyNonResidentStrict               : %s\n", device.properties.sparseProperties.residencyNonResidentStrict               ? "True" : "False");
+
+        ta_log_write(log, SRC_VULKAN, "    Device Features:\n");
+        ta_log_write(log, SRC_VULKAN, "        robustBufferAccess                      : %s\n", device.features.robustBufferAccess                      ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        fullDrawIndexUint32                     : %s\n", device.features.fullDrawIndexUint32                     ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        imageCubeArray                          : %s\n", device.features.imageCubeArray                          ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        independentBlend                        : %s\n", device.features.independentBlend                        ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        geometryShader                          : %s\n", device.features.geometryShader                          ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        tessellationShader                      : %s\n", device.features.tessellationShader                      ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sampleRateShading                       : %s\n", device.features.sampleRateShading                       ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        dualSrcBlend                            : %s\n", device.features.dualSrcBlend                            ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        logicOp                                 : %s\n", device.features.logicOp                                 ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        multiDrawIndirect                       : %s\n", device.features.multiDrawIndirect                       ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        drawIndirectFirstInstance               : %s\n", device.features.drawIndirectFirstInstance               ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        depthBiasClamp                          : %s\n", device.features.depthBiasClamp                          ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        depthBiasClamp                          : %s\n", device.features.depthBiasClamp                          ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        fillModeNonSolid                        : %s\n", device.features.fillModeNonSolid                        ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        depthBounds                             : %s\n", device.features.depthBounds                             ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        wideLines                               : %s\n", device.features.wideLines                               ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        largePoints                             : %s\n", device.features.largePoints                             ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        alphaToOne                              : %s\n", device.features.alphaToOne                              ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        multiViewport                           : %s\n", device.features.multiViewport                           ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        samplerAnisotropy                       : %s\n", device.features.samplerAnisotropy                       ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        textureCompressionETC2                  : %s\n", device.features.textureCompressionETC2                  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        textureCompressionASTC_LDR              : %s\n", device.features.textureCompressionASTC_LDR              ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        textureCompressionBC                    : %s\n", device.features.textureCompressionBC                    ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        occlusionQueryPrecise                   : %s\n", device.features.occlusionQueryPrecise                   ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        pipelineStatisticsQuery                 : %s\n", device.features.pipelineStatisticsQuery                 ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        vertexPipelineStoresAndAtomics          : %s\n", device.features.vertexPipelineStoresAndAtomics          ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        fragmentStoresAndAtomics                : %s\n", device.features.fragmentStoresAndAtomics                ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderTessellationAndGeometryPointSize  : %s\n", device.features.shaderTessellationAndGeometryPointSize  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderImageGatherExtended               : %s\n", device.features.shaderImageGatherExtended               ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderStorageImageExtendedFormats       : %s\n", device.features.shaderStorageImageExtendedFormats       ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderStorageImageMultisample           : %s\n", device.features.shaderStorageImageMultisample           ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderStorageImageReadWithoutFormat     : %s\n", device.features.shaderStorageImageReadWithoutFormat     ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderStorageImageWriteWithoutFormat    : %s\n", device.features.shaderStorageImageWriteWithoutFormat    ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderUniformBufferArrayDynamicIndexing : %s\n", device.features.shaderUniformBufferArrayDynamicIndexing ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderSampledImageArrayDynamicIndexing  : %s\n", device.features.shaderSampledImageArrayDynamicIndexing  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderStorageBufferArrayDynamicIndexing : %s\n", device.features.shaderStorageBufferArrayDynamicIndexing ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderStorageImageArrayDynamicIndexing  : %s\n", device.features.shaderStorageImageArrayDynamicIndexing  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderClipDistance                      : %s\n", device.features.shaderClipDistance                      ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderCullDistance                      : %s\n", device.features.shaderCullDistance                      ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderFloat64                           : %s\n", device.features.shaderFloat64                           ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderInt64                             : %s\n", device.features.shaderInt64                             ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderInt16                             : %s\n", device.features.shaderInt16                             ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderResourceResidency                 : %s\n", device.features.shaderResourceResidency                 ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        shaderResourceMinLod                    : %s\n", device.features.shaderResourceMinLod                    ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseBinding                           : %s\n", device.features.sparseBinding                           ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidencyBuffer                   : %s\n", device.features.sparseResidencyBuffer                   ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidencyImage2D                  : %s\n", device.features.sparseResidencyImage2D                  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidencyImage3D                  : %s\n", device.features.sparseResidencyImage3D                  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidency2Samples                 : %s\n", device.features.sparseResidency2Samples                 ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidency4Samples                 : %s\n", device.features.sparseResidency4Samples                 ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidency8Samples                 : %s\n", device.features.sparseResidency8Samples                 ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidency16Samples                : %s\n", device.features.sparseResidency16Samples                ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        sparseResidencyAliased                  : %s\n", device.features.sparseResidencyAliased                  ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        variableMultisampleRate                 : %s\n", device.features.variableMultisampleRate                 ? "True" : "False");
+        ta_log_write(log, SRC_VULKAN, "        inheritedQueries                        : %s\n", device.features.inheritedQueries                        ? "True" : "False");
+
+        ta_log_write(log, SRC_VULKAN, "Found %u available device extensions:\n",
+            (uint32_t)device.extensions.size());
+        for (const VkExtensionProperties &extension : device.extensions) {
+            ta_log_write(log, SRC_VULKAN, "    %s\n", extension.extensionName);
+        }
+
+        for (const VkQueueFamilyProperties &queue_family_property : device.queue_families) {
+            ta_log_write(log, SRC_VULKAN, "    Found %d queues with flags:\n", queue_family_property.queueCount);
+            if (queue_family_property.queueFlags & VK_QUEUE_GRAPHICS_BIT      ) ta_log_write(log, SRC_VULKAN, "        %s\n", "GRAPHICS      ");
+            if (queue_family_property.queueFlags & VK_QUEUE_COMPUTE_BIT       ) ta_log_write(log, SRC_VULKAN, "        %s\n", "COMPUTE       ");
+            if (queue_family_property.queueFlags & VK_QUEUE_TRANSFER_BIT      ) ta_log_write(log, SRC_VULKAN, "        %s\n", "TRANSFER      ");
+            if (queue_family_property.queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) ta_log_write(log, SRC_VULKAN, "        %s\n", "SPARSE_BINDING");
+            if (queue_family_property.queueFlags & VK_QUEUE_PROTECTED_BIT     ) ta_log_write(log, SRC_VULKAN, "        %s\n", "PROTECTED_BIT ");
+        }
+    }
+}
+
+void ta_caps_report(const ta_caps &caps, ta_log &log)
+{
+    if (caps.from_snapshot) {
+        ta_log_write(log, SRC_VULKAN, "Capabilities from snapshot in %.2fms (full enumeration %.2fms), saved %.2fms "
+            "this launch, %.2fms over %u launches\n", caps.startup_ms, caps.enumerate_ms,
+            caps.enumerate_ms - caps.startup_ms, caps.saved_ms, caps.hits);
+    } else {
+        ta_log_write(log, SRC_VULKAN, "Capabilities enumerated in %.2fms, snapshot written\n", caps.startup_ms);
+    }
+}
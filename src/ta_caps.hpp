@@ -0,0 +1,41 @@
+#pragma once
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <vector>
+
+// Bump when the snapshot layout changes
+#define TA_CAPS_SNAPSHOT_VERSION 1
+
+typedef struct ta_caps_device {
+    VkPhysicalDevice                     handle;        // live, not part of the snapshot
+    VkPhysicalDeviceProperties           properties;
+    uint8_t                              uuid[VK_UUID_SIZE];   // deviceUUID, pipelineCacheUUID without 1.1
+    VkPhysicalDeviceFeatures             features;
+    std::vector<VkExtensionProperties>   extensions;
+    std::vector<VkQueueFamilyProperties> queue_families;
+} ta_caps_device;
+
+// Startup capability queries: instance extensions and layers, and every physical device's properties, features,
+// extensions and queue families. Enumerating (and logging) all of it is a noticeable chunk of startup, so the results
+// are kept in a snapshot file keyed by the loader version and each device's driver version + UUID. Launches with an
+// unchanged key only read the key and load the snapshot.
+// NOTE: Surface support depends on the window, it's never part of the snapshot.
+typedef struct ta_caps {
+    uint32_t                           instance_version;
+    std::vector<VkExtensionProperties> instance_extensions;
+    std::vector<VkLayerProperties>     layers;
+    std::vector<ta_caps_device>        devices;        // vkEnumeratePhysicalDevices order
+    // Stats
+    bool                               from_snapshot;
+    double                             startup_ms;     // this launch: key + load, or key + full enumeration
+    double                             enumerate_ms;   // last full enumeration, kept in the snapshot
+    uint32_t                           hits;           // launches served by the snapshot since it was written
+    double                             saved_ms;       // total over those launches
+} ta_caps;
+
+bool ta_caps_init                       (ta_caps &caps, VkInstance instance, uint32_t instance_version,
+                                         const char *snapshot_path, bool refresh);
+bool ta_caps_device_extension           (const ta_caps_device &device, const char *name);
+void ta_caps_log                        (const ta_caps &caps, ta_log &log);
+void ta_caps_report                     (const ta_caps &caps, ta_log &log);
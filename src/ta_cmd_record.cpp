@@ -0,0 +1,177 @@
+#include "ta_cmd_record.hpp"
+#include "ta_log.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cassert>
+
+VkResult ta_cmd_recorder_init(ta_cmd_recorder &recorder, VkDevice device, uint32_t queue_family_index,
+    uint32_t thread_count, uint32_t frames_in_flight)
+{
+    assert(thread_count);
+    assert(frames_in_flight);
+    recorder.device = device;
+    recorder.current = 0;
+    recorder.min_draws_per_chunk = 64;
+    recorder.frames_recorded = 0;
+    recorder.threads.clear();
+    recorder.threads.resize(thread_count);
+
+    VkCommandPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_create_info.queueFamilyIndex = queue_family_index;
+
+    for (ta_cmd_record_thread &thread : recorder.threads) {
+        thread.frames.resize(frames_in_flight);
+        for (ta_cmd_record_frame &frame : thread.frames) {
+            VkResult err = vkCreateCommandPool(device, &pool_create_info, NULL, &frame.pool);
+            if (err) {
+                ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create recording command pool.\n", err);
+                return err;
+            }
+        }
+    }
+    return VK_SUCCESS;
+}
+
+// Call once per frame, after the frame slot's fence has been waited on
+void ta_cmd_recorder_begin_frame(ta_cmd_recorder &recorder, uint64_t frame_number)
+{
+    recorder.current = (uint32_t)(frame_number % recorder.threads[0].frames.size());
+    for (ta_cmd_record_thread &thread : recorder.threads) {
+        ta_cmd_record_frame &frame = thread.frames[recorder.current];
+        if (frame.used) {
+            vkResetCommandPool(recorder.device, frame.pool, 0);
+            frame.used = 0;
+        }
+        thread.record_ms = 0.0;
+        thread.draws = 0;
+    }
+}
+
+static VkCommandBuffer cmd_record_secondary_next(ta_cmd_recorder &recorder, uint32_t worker)
+{
+    ta_cmd_record_frame &frame = recorder.threads[worker].frames[recorder.current];
+    if (frame.used == frame.buffers.size()) {
+        VkCommandBufferAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = frame.pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocate_info.commandBufferCount = 1;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        if (vkAllocateCommandBuffers(recorder.device, &allocate_info, &command_buffer)) {
+            return VK_NULL_HANDLE;
+        }
+        frame.buffers.push_back(command_buffer);
+    }
+    return frame.buffers[frame.used++];
+}
+
+typedef struct cmd_record_batch {
+    ta_cmd_recorder                         *recorder;
+    const VkCommandBufferInheritanceInfo    *inheritance;
+    ta_cmd_record_fn                        fn;
+    void                                    *userdata;
+    uint32_t                                draw_count;
+    uint32_t                                chunk_size;
+} cmd_record_batch;
+
+static void cmd_record_chunk(void *userdata, uint32_t index, uint32_t worker)
+{
+    cmd_record_batch &batch = *(cmd_record_batch *)userdata;
+    ta_cmd_recorder &recorder = *batch.recorder;
+    ta_cmd_record_thread &thread = recorder.threads[worker];
+    double start_ms = ta_timer_elapsed_ms();
+
+    uint32_t first = index * batch.chunk_size;
+    uint32_t count = std::min(batch.chunk_size, batch.draw_count - first);
+
+    VkCommandBuffer command_buffer = cmd_record_secondary_next(recorder, worker);
+    recorder.chunk_buffers[index] = command_buffer;
+    if (command_buffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (batch.inheritance->renderPass != VK_NULL_HANDLE) {
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+    begin_info.pInheritanceInfo = batch.inheritance;
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    batch.fn(command_buffer, first, count, batch.userdata);
+    if (vkEndCommandBuffer(command_buffer)) {
+        recorder.chunk_buffers[index] = VK_NULL_HANDLE;
+    }
+
+    thread.record_ms += ta_timer_elapsed_ms() - start_ms;
+    thread.draws += count;
+}
+
+// Records draw_count draws into secondaries across the job pool and executes them in the primary, in order. If the
+// inheritance info has a render pass, the primary must be inside it with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+VkResult ta_cmd_record_parallel(ta_cmd_recorder &recorder, ta_jobs &jobs, VkCommandBuffer primary,
+    const VkCommandBufferInheritanceInfo &inheritance, uint32_t draw_count, ta_cmd_record_fn fn, void *userdata)
+{
+    if (!draw_count) {
+        return VK_SUCCESS;
+    }
+    assert(jobs.worker_count < recorder.threads.size());
+
+    // A few chunks per thread so a slow chunk doesn't leave the others idle at the end, but never so small that
+    // the vkBegin/EndCommandBuffer overhead dominates
+    uint32_t thread_count = jobs.worker_count + 1;
+    uint32_t chunk_count = std::max(1u, std::min(thread_count * 4, draw_count / recorder.min_draws_per_chunk));
+    uint32_t chunk_size = (draw_count + chunk_count - 1) / chunk_count;
+    chunk_count = (draw_count + chunk_size - 1) / chunk_size;
+
+    cmd_record_batch batch = {};
+    batch.recorder = &recorder;
+    batch.inheritance = &inheritance;
+    batch.fn = fn;
+    batch.userdata = userdata;
+    batch.draw_count = draw_count;
+    batch.chunk_size = chunk_size;
+
+    recorder.chunk_buffers.assign(chunk_count, VK_NULL_HANDLE);
+    ta_jobs_parallel_for(jobs, chunk_count, cmd_record_chunk, &batch);
+
+    for (VkCommandBuffer command_buffer : recorder.chunk_buffers) {
+        if (command_buffer == VK_NULL_HANDLE) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to record secondary command buffer.\n");
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+    }
+    vkCmdExecuteCommands(primary, chunk_count, recorder.chunk_buffers.data());
+    return VK_SUCCESS;
+}
+
+// Accumulates the current frame into the run totals. Call once per frame after recording is done.
+void ta_cmd_recorder_report(ta_cmd_recorder &recorder)
+{
+    for (ta_cmd_record_thread &thread : recorder.threads) {
+        thread.total_record_ms += thread.record_ms;
+        thread.total_draws += thread.draws;
+    }
+    recorder.frames_recorded++;
+}
+
+void ta_cmd_recorder_free(ta_cmd_recorder &recorder, ta_deletion_queue &deletion_queue, uint64_t frame_number)
+{
+    for (size_t i = 0; i < recorder.threads.size(); ++i) {
+        ta_cmd_record_thread &thread = recorder.threads[i];
+        if (recorder.frames_recorded) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Recording thread %zu: %.3fms/frame, %.1f draws/frame\n", i,
+                thread.total_record_ms / recorder.frames_recorded,
+                (double)thread.total_draws / recorder.frames_recorded);
+        }
+        // Command buffers are freed along with their pool
+        for (ta_cmd_record_frame &frame : thread.frames) {
+            ta_deletion_queue_push(deletion_queue, DELETION_COMMAND_POOL, TA_VK_HANDLE(frame.pool), frame_number);
+            frame.pool = VK_NULL_HANDLE;
+            frame.buffers.clear();
+        }
+    }
+    recorder.threads.clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_jobs.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <vector>
+
+// Records draws [first, first + count) of the caller's draw list into a secondary command buffer. Called from
+// worker threads, so it must only touch per-draw data and the command buffer it's given.
+typedef void (*ta_cmd_record_fn)(VkCommandBuffer command_buffer, uint32_t first, uint32_t count, void *userdata);
+
+typedef struct ta_cmd_record_frame {
+    VkCommandPool                pool;
+    std::vector<VkCommandBuffer> buffers;   // secondaries allocated from pool, reused every time the slot comes around
+    uint32_t                     used;
+} ta_cmd_record_frame;
+
+typedef struct ta_cmd_record_thread {
+    std::vector<ta_cmd_record_frame> frames;    // one command pool per frame in flight
+    double   record_ms;                         // time spent recording during the current frame
+    uint32_t draws;                             // draws recorded during the current frame
+    double   total_record_ms;                   // stats across the whole run
+    uint64_t total_draws;
+} ta_cmd_record_thread;
+
+// Parallel command recording. Command pools are externally synchronized, so every thread in the job pool gets its
+// own pool per frame in flight, reset in one call when the slot comes around again. A draw list is split into
+// chunks, each chunk is recorded into its own secondary command buffer by whichever worker picks it up, and the
+// secondaries are executed in the primary in chunk order, so the result is identical to recording serially.
+typedef struct ta_cmd_recorder {
+    VkDevice device;
+    uint32_t current;                               // frame slot being recorded
+    uint32_t min_draws_per_chunk;                   // below this, splitting costs more than it saves
+    std::vector<ta_cmd_record_thread> threads;      // indexed by ta_jobs worker index, 0 = calling thread
+    std::vector<VkCommandBuffer> chunk_buffers;     // scratch, secondaries in chunk order
+    uint64_t frames_recorded;
+} ta_cmd_recorder;
+
+VkResult ta_cmd_recorder_init           (ta_cmd_recorder &recorder, VkDevice device, uint32_t queue_family_index,
+                                         uint32_t thread_count, uint32_t frames_in_flight);
+void ta_cmd_recorder_begin_frame        (ta_cmd_recorder &recorder, uint64_t frame_number);
+VkResult ta_cmd_record_parallel         (ta_cmd_recorder &recorder, ta_jobs &jobs, VkCommandBuffer primary,
+                                         const VkCommandBufferInheritanceInfo &inheritance, uint32_t draw_count,
+                                         ta_cmd_record_fn fn, void *userdata);
+void ta_cmd_recorder_report             (ta_cmd_recorder &recorder);
+void ta_cmd_recorder_free               (ta_cmd_recorder &recorder, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame_number);
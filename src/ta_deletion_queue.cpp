@@ -0,0 +1,111 @@
+#include "ta_deletion_queue.hpp"
+#include <algorithm>
+#include <cassert>
+
+const char *ta_deletion_type_str(ta_deletion_type type) {
+    switch (type) {
+        case DELETION_BUFFER:                return "Buffer";
+        case DELETION_BUFFER_VIEW:           return "BufferView";
+        case DELETION_IMAGE:                 return "Image";
+        case DELETION_IMAGE_VIEW:            return "ImageView";
+        case DELETION_SAMPLER:               return "Sampler";
+        case DELETION_MEMORY:                return "DeviceMemory";
+        case DELETION_SHADER_MODULE:         return "ShaderModule";
+        case DELETION_PIPELINE:              return "Pipeline";
+        case DELETION_PIPELINE_LAYOUT:       return "PipelineLayout";
+        case DELETION_RENDER_PASS:           return "RenderPass";
+        case DELETION_FRAMEBUFFER:           return "Framebuffer";
+        case DELETION_DESCRIPTOR_SET_LAYOUT: return "DescriptorSetLayout";
+        case DELETION_DESCRIPTOR_POOL:       return "DescriptorPool";
+        case DELETION_QUERY_POOL:            return "QueryPool";
+        case DELETION_COMMAND_POOL:          return "CommandPool";
+        case DELETION_SEMAPHORE:             return "Semaphore";
+        case DELETION_FENCE:                 return "Fence";
+        case DELETION_SWAPCHAIN:             return "Swapchain";
+        default:                             return "UNKNOWN";
+    }
+}
+
+void ta_deletion_queue_init(ta_deletion_queue &queue, VkDevice device)
+{
+    assert(device != VK_NULL_HANDLE);
+    queue.device = device;
+    queue.entries.clear();
+    queue.last_frame = 0;
+    queue.destroyed_count = 0;
+    queue.peak_pending = 0;
+}
+
+void ta_deletion_queue_push(ta_deletion_queue &queue, ta_deletion_type type, uint64_t handle, uint64_t frame)
+{
+    assert(type < DELETION_TYPE_COUNT);
+    if (!handle) {
+        return;
+    }
+
+    // NOTE: Tagging with an older frame than something already queued would break the sorted order. Holding on to
+    // the handle a little longer than necessary is always safe, so just bump it.
+    frame = std::max(frame, queue.last_frame);
+    queue.last_frame = frame;
+
+    ta_deletion_entry entry = {};
+    entry.type = type;
+    entry.handle = handle;
+    entry.frame = frame;
+    queue.entries.push_back(entry);
+    queue.peak_pending = std::max(queue.peak_pending, queue.entries.size());
+}
+
+static void deletion_entry_destroy(VkDevice device, const ta_deletion_entry &entry)
+{
+    switch (entry.type) {
+        case DELETION_BUFFER:                vkDestroyBuffer(device, (VkBuffer)entry.handle, NULL); break;
+        case DELETION_BUFFER_VIEW:           vkDestroyBufferView(device, (VkBufferView)entry.handle, NULL); break;
+        case DELETION_IMAGE:                 vkDestroyImage(device, (VkImage)entry.handle, NULL); break;
+        case DELETION_IMAGE_VIEW:            vkDestroyImageView(device, (VkImageView)entry.handle, NULL); break;
+        case DELETION_SAMPLER:               vkDestroySampler(device, (VkSampler)entry.handle, NULL); break;
+        case DELETION_MEMORY:                vkFreeMemory(device, (VkDeviceMemory)entry.handle, NULL); break;
+        case DELETION_SHADER_MODULE:         vkDestroyShaderModule(device, (VkShaderModule)entry.handle, NULL); break;
+        case DELETION_PIPELINE:              vkDestroyPipeline(device, (VkPipeline)entry.handle, NULL); break;
+        case DELETION_PIPELINE_LAYOUT:       vkDestroyPipelineLayout(device, (VkPipelineLayout)entry.handle, NULL); break;
+        case DELETION_RENDER_PASS:           vkDestroyRenderPass(device, (VkRenderPass)entry.handle, NULL); break;
+        case DELETION_FRAMEBUFFER:           vkDestroyFramebuffer(device, (VkFramebuffer)entry.handle, NULL); break;
+        case DELETION_DESCRIPTOR_SET_LAYOUT: vkDestroyDescriptorSetLayout(device, (VkDescriptorSetLayout)entry.handle, NULL); break;
+        case DELETION_DESCRIPTOR_POOL:       vkDestroyDescriptorPool(device, (VkDescriptorPool)entry.handle, NULL); break;
+        case DELETION_QUERY_POOL:            vkDestroyQueryPool(device, (VkQueryPool)entry.handle, NULL); break;
+        case DELETION_COMMAND_POOL:          vkDestroyCommandPool(device, (VkCommandPool)entry.handle, NULL); break;
+        case DELETION_SEMAPHORE:             vkDestroySemaphore(device, (VkSemaphore)entry.handle, NULL); break;
+        case DELETION_FENCE:                 vkDestroyFence(device, (VkFence)entry.handle, NULL); break;
+        case DELETION_SWAPCHAIN:             vkDestroySwapchainKHR(device, (VkSwapchainKHR)entry.handle, NULL); break;
+        default: assert(!"Unknown deletion type");
+    }
+}
+
+// Destroys every entry whose frame is < frames_completed, i.e. the GPU has signaled that frame's fence. Call once per
+// frame after waiting on the frame slot's fence; this never waits on the device itself.
+void ta_deletion_queue_retire(ta_deletion_queue &queue, uint64_t frames_completed)
+{
+    while (!queue.entries.empty() && queue.entries.front().frame < frames_completed) {
+        deletion_entry_destroy(queue.device, queue.entries.front());
+        queue.entries.pop_front();
+        queue.destroyed_count++;
+    }
+}
+
+// Destroys everything regardless of frame. Caller must make sure the device is idle (e.g. at shutdown).
+void ta_deletion_queue_flush(ta_deletion_queue &queue)
+{
+    for (const ta_deletion_entry &entry : queue.entries) {
+        deletion_entry_destroy(queue.device, entry);
+        queue.destroyed_count++;
+    }
+    queue.entries.clear();
+}
+
+void ta_deletion_queue_free(ta_deletion_queue &queue)
+{
+    ta_deletion_queue_flush(queue);
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Deletion queue: destroyed %llu handles, peak pending %zu\n",
+        (unsigned long long)queue.destroyed_count, queue.peak_pending);
+    queue.device = VK_NULL_HANDLE;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <deque>
+
+typedef enum ta_deletion_type {
+    DELETION_BUFFER,
+    DELETION_BUFFER_VIEW,
+    DELETION_IMAGE,
+    DELETION_IMAGE_VIEW,
+    DELETION_SAMPLER,
+    DELETION_MEMORY,
+    DELETION_SHADER_MODULE,
+    DELETION_PIPELINE,
+    DELETION_PIPELINE_LAYOUT,
+    DELETION_RENDER_PASS,
+    DELETION_FRAMEBUFFER,
+    DELETION_DESCRIPTOR_SET_LAYOUT,
+    DELETION_DESCRIPTOR_POOL,
+    DELETION_QUERY_POOL,
+    DELETION_COMMAND_POOL,
+    DELETION_SEMAPHORE,
+    DELETION_FENCE,
+    DELETION_SWAPCHAIN,
+    DELETION_TYPE_COUNT
+} ta_deletion_type;
+
+typedef struct ta_deletion_entry {
+    ta_deletion_type type;
+    uint64_t handle;        // non-dispatchable handles are 64-bit on every platform
+    uint64_t frame;         // last frame that (may have) used the handle
+} ta_deletion_entry;
+
+// Defers destruction of Vulkan objects until the GPU is done with them. Every entry is tagged with the frame number
+// that last used it and is destroyed once that frame's fence has been observed signaled. Frames retire in order on
+// our single queue, so entries are kept in frame order and retired from the front in batches.
+typedef struct ta_deletion_queue {
+    VkDevice device;
+    std::deque<ta_deletion_entry> entries;
+    uint64_t last_frame;        // highest frame pushed so far, keeps entries sorted
+    uint64_t destroyed_count;   // total number of handles destroyed (stats)
+    size_t   peak_pending;      // high-water mark of entries waiting on the GPU (stats)
+} ta_deletion_queue;
+
+#define TA_VK_HANDLE(handle) ((uint64_t)(handle))
+
+const char *ta_deletion_type_str    (ta_deletion_type type);
+
+void ta_deletion_queue_init         (ta_deletion_queue &queue, VkDevice device);
+void ta_deletion_queue_push         (ta_deletion_queue &queue, ta_deletion_type type, uint64_t handle, uint64_t frame);
+void ta_deletion_queue_retire       (ta_deletion_queue &queue, uint64_t frames_completed);
+void ta_deletion_queue_flush        (ta_deletion_queue &queue);
+void ta_deletion_queue_free         (ta_deletion_queue &queue);
@@ -0,0 +1,331 @@
+#include "ta_descriptor.hpp"
+#include "ta_hash.hpp"
+#include "ta_log.hpp"
+#include <algorithm>
+#include <cassert>
+
+static bool binding_less(const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b)
+{
+    return a.binding < b.binding;
+}
+
+static bool binding_equal(const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b)
+{
+    return a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount &&
+        a.stageFlags == b.stageFlags && !a.pImmutableSamplers == !b.pImmutableSamplers;
+}
+
+// Immutable samplers of every binding that has them, so layouts compare by sampler handle rather than by wherever
+// the caller happened to keep its array
+static void binding_samplers(const std::vector<VkDescriptorSetLayoutBinding> &bindings, std::vector<VkSampler> &out)
+{
+    for (const VkDescriptorSetLayoutBinding &binding : bindings) {
+        if (binding.pImmutableSamplers) {
+            out.insert(out.end(), binding.pImmutableSamplers, binding.pImmutableSamplers + binding.descriptorCount);
+        }
+    }
+}
+
+void ta_descriptor_layout_cache_init(ta_descriptor_layout_cache &cache, VkDevice device)
+{
+    cache.device = device;
+    cache.layouts.clear();
+    cache.hits = 0;
+    cache.misses = 0;
+}
+
+VkDescriptorSetLayout ta_descriptor_layout_get(ta_descriptor_layout_cache &cache,
+    const VkDescriptorSetLayoutBinding *bindings, uint32_t binding_count, VkDescriptorSetLayoutCreateFlags flags)
+{
+    // Binding order in the create info doesn't matter to Vulkan, so don't let it matter to the cache either
+    std::vector<VkDescriptorSetLayoutBinding> sorted(bindings, bindings + binding_count);
+    std::sort(sorted.begin(), sorted.end(), binding_less);
+    std::vector<VkSampler> samplers;
+    binding_samplers(sorted, samplers);
+
+    uint64_t hash = ta_hash_u64(TA_HASH_SEED, flags);
+    for (const VkDescriptorSetLayoutBinding &binding : sorted) {
+        hash = ta_hash_u64(hash, binding.binding);
+        hash = ta_hash_u64(hash, binding.descriptorType);
+        hash = ta_hash_u64(hash, binding.descriptorCount);
+        hash = ta_hash_u64(hash, binding.stageFlags);
+        hash = ta_hash_u64(hash, binding.pImmutableSamplers != NULL);
+    }
+    for (VkSampler sampler : samplers) {
+        hash = ta_hash_u64(hash, TA_VK_HANDLE(sampler));
+    }
+
+    std::vector<ta_descriptor_layout_entry> &chain = cache.layouts[hash];
+    for (const ta_descriptor_layout_entry &entry : chain) {
+        if (entry.flags == flags && entry.bindings.size() == sorted.size() && entry.samplers == samplers &&
+            std::equal(sorted.begin(), sorted.end(), entry.bindings.begin(), binding_equal))
+        {
+            cache.hits++;
+            return entry.layout;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.flags = flags;
+    create_info.bindingCount = (uint32_t)sorted.size();
+    create_info.pBindings = sorted.data();
+
+    ta_descriptor_layout_entry entry = {};
+    VkResult err = vkCreateDescriptorSetLayout(cache.device, &create_info, NULL, &entry.layout);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create descriptor set layout.\n", err);
+        return VK_NULL_HANDLE;
+    }
+    entry.flags = flags;
+    entry.bindings = sorted;
+    entry.samplers = samplers;
+    chain.push_back(entry);
+    // The caller's sampler arrays needn't outlive this call, the cached bindings point at the entry's own copy
+    ta_descriptor_layout_entry &cached = chain.back();
+    const VkSampler *sampler = cached.samplers.data();
+    for (VkDescriptorSetLayoutBinding &binding : cached.bindings) {
+        if (binding.pImmutableSamplers) {
+            binding.pImmutableSamplers = sampler;
+            sampler += binding.descriptorCount;
+        }
+    }
+    cache.misses++;
+    return cached.layout;
+}
+
+void ta_descriptor_layout_cache_free(ta_descriptor_layout_cache &cache)
+{
+    // NOTE: Layouts are only needed to create pipelines and allocate sets, never by in-flight command buffers, so
+    // these can go right away.
+    for (auto &chain : cache.layouts) {
+        for (ta_descriptor_layout_entry &entry : chain.second) {
+            vkDestroyDescriptorSetLayout(cache.device, entry.layout, NULL);
+        }
+    }
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Descriptor layout cache: %u layouts, %u hits\n", cache.misses,
+        cache.hits);
+    cache.layouts.clear();
+}
+
+void ta_descriptor_allocator_init(ta_descriptor_allocator &allocator, VkDevice device, uint32_t frames_in_flight,
+    uint32_t sets_per_pool)
+{
+    assert(frames_in_flight);
+    assert(sets_per_pool);
+    allocator.device = device;
+    allocator.sets_per_pool = sets_per_pool;
+    allocator.free_pools.clear();
+    allocator.frames.clear();
+    allocator.frames.resize(frames_in_flight);
+    allocator.current = 0;
+    allocator.pools_created = 0;
+    allocator.sets_allocated = 0;
+    allocator.set_cache_hits = 0;
+}
+
+static VkDescriptorPool descriptor_pool_create(ta_descriptor_allocator &allocator)
+{
+    // Rough guess at the mix of descriptors per set. A pool that runs out of one type just gets swapped for a new
+    // one, so this only affects how often that happens.
+    struct { VkDescriptorType type; float per_set; } ratios[] = {
+        { VK_DESCRIPTOR_TYPE_SAMPLER,                0.5f },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          4.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   1.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         2.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+        { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       0.5f },
+    };
+
+    VkDescriptorPoolSize pool_sizes[sizeof(ratios) / sizeof(ratios[0])] = {};
+    for (size_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); ++i) {
+        pool_sizes[i].type = ratios[i].type;
+        pool_sizes[i].descriptorCount = std::max(1u, (uint32_t)(ratios[i].per_set * allocator.sets_per_pool));
+    }
+
+    VkDescriptorPoolCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    create_info.maxSets = allocator.sets_per_pool;
+    create_info.poolSizeCount = (uint32_t)(sizeof(pool_sizes) / sizeof(pool_sizes[0]));
+    create_info.pPoolSizes = pool_sizes;
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkResult err = vkCreateDescriptorPool(allocator.device, &create_info, NULL, &pool);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create descriptor pool.\n", err);
+        return VK_NULL_HANDLE;
+    }
+    allocator.pools_created++;
+    return pool;
+}
+
+static VkDescriptorPool descriptor_pool_next(ta_descriptor_allocator &allocator)
+{
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (!allocator.free_pools.empty()) {
+        pool = allocator.free_pools.back();
+        allocator.free_pools.pop_back();
+    } else {
+        pool = descriptor_pool_create(allocator);
+    }
+    if (pool != VK_NULL_HANDLE) {
+        allocator.frames[allocator.current].used_pools.push_back(pool);
+    }
+    return pool;
+}
+
+// Call once per frame, after the frame slot's fence has been waited on
+void ta_descriptor_allocator_begin_frame(ta_descriptor_allocator &allocator, uint64_t frame_number)
+{
+    allocator.current = (uint32_t)(frame_number % allocator.frames.size());
+    ta_descriptor_frame &frame = allocator.frames[allocator.current];
+    for (VkDescriptorPool pool : frame.used_pools) {
+        vkResetDescriptorPool(allocator.device, pool, 0);
+        allocator.free_pools.push_back(pool);
+    }
+    frame.used_pools.clear();
+    frame.set_cache.clear();
+}
+
+// Allocates a set that is valid until this frame slot comes around again
+VkResult ta_descriptor_allocate(ta_descriptor_allocator &allocator, VkDescriptorSetLayout layout,
+    VkDescriptorSet *set)
+{
+    ta_descriptor_frame &frame = allocator.frames[allocator.current];
+    VkDescriptorPool pool = frame.used_pools.empty() ? descriptor_pool_next(allocator) : frame.used_pools.back();
+    if (pool == VK_NULL_HANDLE) {
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &layout;
+
+    VkResult err = vkAllocateDescriptorSets(allocator.device, &allocate_info, set);
+    if (err == VK_ERROR_OUT_OF_POOL_MEMORY || err == VK_ERROR_FRAGMENTED_POOL) {
+        // Current pool is full, retry once with a fresh one. Failing on an empty pool means the layout needs more
+        // descriptors than a whole pool has, which is a bug in sets_per_pool/ratios rather than something to retry.
+        allocate_info.descriptorPool = descriptor_pool_next(allocator);
+        if (allocate_info.descriptorPool == VK_NULL_HANDLE) {
+            return VK_ERROR_OUT_OF_POOL_MEMORY;
+        }
+        err = vkAllocateDescriptorSets(allocator.device, &allocate_info, set);
+    }
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to allocate descriptor set.\n", err);
+        return err;
+    }
+    allocator.sets_allocated++;
+    return VK_SUCCESS;
+}
+
+static uint64_t descriptor_writes_hash(VkDescriptorSetLayout layout, const ta_descriptor_write *writes,
+    uint32_t write_count)
+{
+    uint64_t hash = ta_hash_u64(TA_HASH_SEED, (uint64_t)layout);
+    for (uint32_t i = 0; i < write_count; ++i) {
+        const ta_descriptor_write &write = writes[i];
+        hash = ta_hash_u64(hash, write.binding);
+        hash = ta_hash_u64(hash, write.type);
+        hash = ta_hash_u64(hash, (uint64_t)write.buffer.buffer);
+        hash = ta_hash_u64(hash, write.buffer.offset);
+        hash = ta_hash_u64(hash, write.buffer.range);
+        hash = ta_hash_u64(hash, (uint64_t)write.image.sampler);
+        hash = ta_hash_u64(hash, (uint64_t)write.image.imageView);
+        hash = ta_hash_u64(hash, write.image.imageLayout);
+    }
+    return hash;
+}
+
+static bool descriptor_write_equal(const ta_descriptor_write &a, const ta_descriptor_write &b)
+{
+    return a.binding == b.binding && a.type == b.type && a.buffer.buffer == b.buffer.buffer &&
+        a.buffer.offset == b.buffer.offset && a.buffer.range == b.buffer.range && a.image.sampler == b.image.sampler &&
+        a.image.imageView == b.image.imageView && a.image.imageLayout == b.image.imageLayout;
+}
+
+static bool descriptor_type_is_image(VkDescriptorType type)
+{
+    return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+        type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+        type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+// Allocates and fills in a set for this frame. With use_cache, an identical request (same layout, same resources)
+// earlier in the same frame returns the set that was already written instead of allocating a new one.
+VkDescriptorSet ta_descriptor_set_get(ta_descriptor_allocator &allocator, VkDescriptorSetLayout layout,
+    const ta_descriptor_write *writes, uint32_t write_count, bool use_cache)
+{
+    ta_descriptor_frame &frame = allocator.frames[allocator.current];
+    uint64_t hash = 0;
+    if (use_cache) {
+        hash = descriptor_writes_hash(layout, writes, write_count);
+        auto cached = frame.set_cache.find(hash);
+        if (cached != frame.set_cache.end()) {
+            for (const ta_descriptor_set_entry &entry : cached->second) {
+                if (entry.layout == layout && entry.writes.size() == write_count &&
+                    std::equal(writes, writes + write_count, entry.writes.begin(), descriptor_write_equal))
+                {
+                    allocator.set_cache_hits++;
+                    return entry.set;
+                }
+            }
+        }
+    }
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (ta_descriptor_allocate(allocator, layout, &set)) {
+        return VK_NULL_HANDLE;
+    }
+
+    std::vector<VkWriteDescriptorSet> vk_writes(write_count);
+    for (uint32_t i = 0; i < write_count; ++i) {
+        VkWriteDescriptorSet &vk_write = vk_writes[i];
+        vk_write = {};
+        vk_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        vk_write.dstSet = set;
+        vk_write.dstBinding = writes[i].binding;
+        vk_write.descriptorCount = 1;
+        vk_write.descriptorType = writes[i].type;
+        if (descriptor_type_is_image(writes[i].type)) {
+            vk_write.pImageInfo = &writes[i].image;
+        } else {
+            vk_write.pBufferInfo = &writes[i].buffer;
+        }
+    }
+    vkUpdateDescriptorSets(allocator.device, write_count, vk_writes.data(), 0, NULL);
+
+    if (use_cache) {
+        ta_descriptor_set_entry entry = {};
+        entry.layout = layout;
+        entry.writes.assign(writes, writes + write_count);
+        entry.set = set;
+        frame.set_cache[hash].push_back(entry);
+    }
+    return set;
+}
+
+void ta_descriptor_allocator_free(ta_descriptor_allocator &allocator, ta_deletion_queue &deletion_queue,
+    uint64_t frame_number)
+{
+    for (ta_descriptor_frame &frame : allocator.frames) {
+        for (VkDescriptorPool pool : frame.used_pools) {
+            ta_deletion_queue_push(deletion_queue, DELETION_DESCRIPTOR_POOL, TA_VK_HANDLE(pool), frame_number);
+        }
+        frame.used_pools.clear();
+        frame.set_cache.clear();
+    }
+    for (VkDescriptorPool pool : allocator.free_pools) {
+        ta_deletion_queue_push(deletion_queue, DELETION_DESCRIPTOR_POOL, TA_VK_HANDLE(pool), frame_number);
+    }
+    allocator.free_pools.clear();
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Descriptor allocator: %u pools, %u sets allocated, %u set cache hits\n",
+        allocator.pools_created, allocator.sets_allocated, allocator.set_cache_hits);
+}
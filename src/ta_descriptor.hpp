@@ -0,0 +1,72 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+typedef struct ta_descriptor_layout_entry {
+    VkDescriptorSetLayoutCreateFlags flags;
+    std::vector<VkDescriptorSetLayoutBinding> bindings;     // sorted by binding, immutable samplers point into samplers
+    std::vector<VkSampler> samplers;                        // every binding's immutable samplers, in binding order
+    VkDescriptorSetLayout layout;
+} ta_descriptor_layout_entry;
+
+// Deduplicates descriptor set layouts by a hash of their (sorted) bindings. Layouts live until the cache is freed.
+typedef struct ta_descriptor_layout_cache {
+    VkDevice device;
+    std::unordered_map<uint64_t, std::vector<ta_descriptor_layout_entry>> layouts;     // hash -> collision chain
+    uint32_t hits;
+    uint32_t misses;
+} ta_descriptor_layout_cache;
+
+// One resource bound to one binding of a set. Which of buffer/image is used depends on type.
+typedef struct ta_descriptor_write {
+    uint32_t               binding;
+    VkDescriptorType       type;
+    VkDescriptorBufferInfo buffer;
+    VkDescriptorImageInfo  image;
+} ta_descriptor_write;
+
+typedef struct ta_descriptor_set_entry {
+    VkDescriptorSetLayout layout;
+    std::vector<ta_descriptor_write> writes;
+    VkDescriptorSet set;
+} ta_descriptor_set_entry;
+
+typedef struct ta_descriptor_frame {
+    std::vector<VkDescriptorPool> used_pools;   // pools handed out to this frame, back() is current
+    // hash(layout, writes) -> collision chain, cleared every frame
+    std::unordered_map<uint64_t, std::vector<ta_descriptor_set_entry>> set_cache;
+} ta_descriptor_frame;
+
+// Growable list of descriptor pools, recycled per frame in flight. Sets are never freed individually: once a frame
+// slot's fence has been waited on, every pool that frame allocated from is reset in one call and goes back on the
+// free list. Running out of space in a pool (OUT_OF_POOL_MEMORY / FRAGMENTED_POOL) just moves on to the next one.
+typedef struct ta_descriptor_allocator {
+    VkDevice device;
+    uint32_t sets_per_pool;
+    std::vector<VkDescriptorPool> free_pools;
+    std::vector<ta_descriptor_frame> frames;
+    uint32_t current;
+    // Stats
+    uint32_t pools_created;
+    uint32_t sets_allocated;
+    uint32_t set_cache_hits;
+} ta_descriptor_allocator;
+
+void ta_descriptor_layout_cache_init    (ta_descriptor_layout_cache &cache, VkDevice device);
+VkDescriptorSetLayout ta_descriptor_layout_get(ta_descriptor_layout_cache &cache,
+                                         const VkDescriptorSetLayoutBinding *bindings, uint32_t binding_count,
+                                         VkDescriptorSetLayoutCreateFlags flags);
+void ta_descriptor_layout_cache_free    (ta_descriptor_layout_cache &cache);
+
+void ta_descriptor_allocator_init       (ta_descriptor_allocator &allocator, VkDevice device,
+                                         uint32_t frames_in_flight, uint32_t sets_per_pool);
+void ta_descriptor_allocator_begin_frame(ta_descriptor_allocator &allocator, uint64_t frame_number);
+VkResult ta_descriptor_allocate         (ta_descriptor_allocator &allocator, VkDescriptorSetLayout layout,
+                                         VkDescriptorSet *set);
+VkDescriptorSet ta_descriptor_set_get   (ta_descriptor_allocator &allocator, VkDescriptorSetLayout layout,
+                                         const ta_descriptor_write *writes, uint32_t write_count, bool use_cache);
+void ta_descriptor_allocator_free       (ta_descriptor_allocator &allocator, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame_number);
@@ -0,0 +1,104 @@
+#include "ta_file_map.hpp"
+#include "ta_log.hpp"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+bool ta_file_map_open(ta_file_map &map, const char *path)
+{
+    map = {};
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to open '%s'.\n", (uint32_t)GetLastError(), path);
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size)) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to query size of '%s'.\n", (uint32_t)GetLastError(), path);
+        CloseHandle(file);
+        return false;
+    }
+    map.file = file;
+    if (!size.QuadPart) {
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!data) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to map '%s'.\n", (uint32_t)GetLastError(), path);
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        map.file = NULL;
+        return false;
+    }
+    map.mapping = mapping;
+    map.data = (const uint8_t *)data;
+    map.size = (size_t)size.QuadPart;
+    return true;
+}
+
+void ta_file_map_close(ta_file_map &map)
+{
+    if (map.data) {
+        UnmapViewOfFile(map.data);
+    }
+    if (map.mapping) {
+        CloseHandle(map.mapping);
+    }
+    if (map.file) {
+        CloseHandle(map.file);
+    }
+    map = {};
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+bool ta_file_map_open(ta_file_map &map, const char *path)
+{
+    map = {};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to open '%s'.\n", (uint32_t)errno, path);
+        return false;
+    }
+    struct stat info = {};
+    if (fstat(fd, &info)) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to query size of '%s'.\n", (uint32_t)errno, path);
+        close(fd);
+        return false;
+    }
+    if (!info.st_size) {
+        close(fd);
+        return true;
+    }
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // NOTE: The mapping keeps the file alive, the fd isn't needed anymore
+    close(fd);
+    if (data == MAP_FAILED) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to map '%s'.\n", (uint32_t)errno, path);
+        return false;
+    }
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    map.data = (const uint8_t *)data;
+    map.size = (size_t)info.st_size;
+    return true;
+}
+
+void ta_file_map_close(ta_file_map &map)
+{
+    if (map.data) {
+        munmap((void *)map.data, map.size);
+    }
+    map = {};
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file. An empty file maps to data == NULL, size == 0.
+typedef struct ta_file_map {
+    const uint8_t *data;
+    size_t        size;
+    void          *file;        // HANDLE, Windows only
+    void          *mapping;     // HANDLE, Windows only
+} ta_file_map;
+
+bool ta_file_map_open   (ta_file_map &map, const char *path);
+void ta_file_map_close  (ta_file_map &map);
@@ -0,0 +1,171 @@
+#include "ta_file_watch.hpp"
+#include "ta_log.hpp"
+#include <cassert>
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef struct ta_file_watch_os {
+    HANDLE     directory;
+    OVERLAPPED overlapped;
+    bool       issued;              // a read is outstanding, overlapped + buffer belong to the kernel
+    DWORD      buffer[16 * 1024];   // FILE_NOTIFY_INFORMATION needs DWORD alignment
+} ta_file_watch_os;
+
+static bool file_watch_issue(ta_file_watch &watch)
+{
+    DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+    if (!ReadDirectoryChangesW(watch.os->directory, watch.os->buffer, sizeof(watch.os->buffer), FALSE, filter, NULL,
+        &watch.os->overlapped, NULL)) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to watch '%s'.\n", (uint32_t)GetLastError(),
+            watch.directory.c_str());
+        watch.os->issued = false;
+        return false;
+    }
+    watch.os->issued = true;
+    return true;
+}
+#elif __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+
+typedef struct ta_file_watch_os {
+    int fd;
+    int wd;
+} ta_file_watch_os;
+#endif
+
+bool ta_file_watch_init(ta_file_watch &watch, const char *directory)
+{
+    watch.directory = directory;
+    watch.os = NULL;
+
+#if _WIN32
+    ta_file_watch_os *os = new ta_file_watch_os();
+    os->directory = CreateFileA(directory, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (os->directory == INVALID_HANDLE_VALUE) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%u] Failed to open '%s' for watching.\n", (uint32_t)GetLastError(),
+            directory);
+        delete os;
+        return false;
+    }
+    os->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    watch.os = os;
+    if (!os->overlapped.hEvent || !file_watch_issue(watch)) {
+        ta_file_watch_free(watch);
+        return false;
+    }
+#elif __linux__
+    ta_file_watch_os *os = new ta_file_watch_os();
+    os->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    os->wd = os->fd < 0 ? -1 : inotify_add_watch(os->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (os->wd < 0) {
+        ta_log_write(tg_debug_log, SRC_FILE, "[%d] Failed to watch '%s'.\n", errno, directory);
+        if (os->fd >= 0) {
+            close(os->fd);
+        }
+        delete os;
+        return false;
+    }
+    watch.os = os;
+#else
+    ta_log_write(tg_debug_log, SRC_FILE, "File watching isn't supported on this platform.\n");
+    return false;
+#endif
+
+    ta_log_write(tg_debug_log, SRC_FILE, "Watching '%s' for changes\n", directory);
+    return true;
+}
+
+// Appends the names (relative to the directory) of files written or renamed into it since the last poll. Names can
+// repeat. Returns false if the OS dropped events, in which case anything could have changed.
+bool ta_file_watch_poll(ta_file_watch &watch, std::vector<std::string> &changed)
+{
+    if (!watch.os) {
+        return true;
+    }
+
+    bool complete = true;
+#if _WIN32
+    while (watch.os->issued) {
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(watch.os->directory, &watch.os->overlapped, &bytes, FALSE)) {
+            if (GetLastError() == ERROR_IO_INCOMPLETE) {
+                break;
+            }
+            // ERROR_NOTIFY_ENUM_DIR (buffer overflowed) or worse, either way the change list is gone
+            complete = false;
+            bytes = 0;
+        } else if (!bytes) {
+            complete = false;
+        }
+        const uint8_t *cursor = (const uint8_t *)watch.os->buffer;
+        while (bytes) {
+            const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)cursor;
+            if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED ||
+                info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+                int wide_length = (int)(info->FileNameLength / sizeof(WCHAR));
+                char name[MAX_PATH];
+                int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, wide_length, name, sizeof(name) - 1,
+                    NULL, NULL);
+                if (length > 0) {
+                    changed.push_back(std::string(name, (size_t)length));
+                }
+            }
+            if (!info->NextEntryOffset) {
+                break;
+            }
+            cursor += info->NextEntryOffset;
+        }
+        ResetEvent(watch.os->overlapped.hEvent);
+        if (!file_watch_issue(watch)) {
+            break;
+        }
+    }
+#elif __linux__
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        ssize_t bytes = read(watch.os->fd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            // EAGAIN, nothing left to read
+            break;
+        }
+        for (char *cursor = buffer; cursor < buffer + bytes;) {
+            const struct inotify_event *event = (const struct inotify_event *)cursor;
+            if (event->mask & IN_Q_OVERFLOW) {
+                complete = false;
+            } else if (event->len) {
+                changed.push_back(event->name);
+            }
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+    return complete;
+}
+
+void ta_file_watch_free(ta_file_watch &watch)
+{
+    if (!watch.os) {
+        return;
+    }
+#if _WIN32
+    if (watch.os->issued) {
+        CancelIo(watch.os->directory);
+        // Wait for the cancel so the kernel is done with our buffer before it's freed
+        DWORD bytes = 0;
+        GetOverlappedResult(watch.os->directory, &watch.os->overlapped, &bytes, TRUE);
+    }
+    if (watch.os->overlapped.hEvent) {
+        CloseHandle(watch.os->overlapped.hEvent);
+    }
+    CloseHandle(watch.os->directory);
+#elif __linux__
+    close(watch.os->fd);
+#endif
+    delete watch.os;
+    watch.os = NULL;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct ta_file_watch_os;
+
+// Non-recursive change notifications for one directory: ReadDirectoryChangesW on Windows, inotify on Linux. Polled,
+// never blocks.
+typedef struct ta_file_watch {
+    std::string             directory;
+    struct ta_file_watch_os *os;
+} ta_file_watch;
+
+bool ta_file_watch_init     (ta_file_watch &watch, const char *directory);
+bool ta_file_watch_poll     (ta_file_watch &watch, std::vector<std::string> &changed);
+void ta_file_watch_free     (ta_file_watch &watch);
@@ -0,0 +1,153 @@
+#include "ta_frame_alloc.hpp"
+#include "ta_log.hpp"
+#include <algorithm>
+#include <cassert>
+
+#define FRAME_ALLOC_USAGE (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | \
+    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    assert(alignment && !(alignment & (alignment - 1)));
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static VkResult frame_alloc_block_create(ta_frame_allocator &allocator, ta_vk_buffer &block, VkDeviceSize size)
+{
+    // NOTE: Host coherent so we never have to flush. Would be nice to try DEVICE_LOCAL | HOST_VISIBLE (BAR memory)
+    // first on discrete GPUs, but that heap is tiny on most drivers.
+    VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkResult err = ta_vk_buffer_create(block, allocator.device, allocator.memory_properties, size, allocator.usage,
+        flags);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create frame allocator block (%llu bytes).\n", err,
+            (unsigned long long)size);
+    }
+    return err;
+}
+
+VkResult ta_frame_allocator_init(ta_frame_allocator &allocator, VkDevice device,
+    const VkPhysicalDeviceProperties &device_properties, const VkPhysicalDeviceMemoryProperties &memory_properties,
+    uint32_t frames_in_flight, VkDeviceSize block_size)
+{
+    assert(frames_in_flight);
+    allocator.device = device;
+    allocator.memory_properties = memory_properties;
+    allocator.usage = FRAME_ALLOC_USAGE;
+    allocator.uniform_alignment = std::max((VkDeviceSize)16, device_properties.limits.minUniformBufferOffsetAlignment);
+    allocator.storage_alignment = std::max((VkDeviceSize)16, device_properties.limits.minStorageBufferOffsetAlignment);
+    allocator.block_size = block_size;
+    allocator.high_water = 0;
+    allocator.current = 0;
+    allocator.slots.clear();
+    allocator.slots.resize(frames_in_flight);
+
+    for (ta_frame_alloc_slot &slot : allocator.slots) {
+        slot.blocks.resize(1);
+        VkResult err = frame_alloc_block_create(allocator, slot.blocks[0], block_size);
+        if (err) {
+            return err;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+// Call once per frame, after the frame slot's fence has been waited on. If the bigger block can't be created the
+// slot keeps its old chain, which still works (it just chains again), and the error is returned.
+VkResult ta_frame_allocator_begin_frame(ta_frame_allocator &allocator, ta_deletion_queue &deletion_queue,
+    uint64_t frame_number)
+{
+    allocator.current = (uint32_t)(frame_number % allocator.slots.size());
+    ta_frame_alloc_slot &slot = allocator.slots[allocator.current];
+
+    if (slot.used > allocator.high_water) {
+        allocator.high_water = slot.used;
+        ta_log_write(tg_debug_log, SRC_VULKAN, "Frame allocator: new high-water mark %llu bytes (frame %llu)\n",
+            (unsigned long long)allocator.high_water, (unsigned long long)slot.frame);
+    }
+
+    // Overflowed last time around. Replace the chain with a single block big enough for the high-water mark, so
+    // dynamic offsets all land in one buffer again.
+    VkResult err = VK_SUCCESS;
+    if (slot.blocks.size() > 1 || slot.blocks[0].size < allocator.high_water) {
+        while (allocator.block_size < allocator.high_water) {
+            allocator.block_size *= 2;
+        }
+        ta_vk_buffer replacement = {};
+        err = frame_alloc_block_create(allocator, replacement, allocator.block_size);
+        if (!err) {
+            for (ta_vk_buffer &block : slot.blocks) {
+                ta_vk_buffer_destroy(block, deletion_queue, slot.frame);
+            }
+            slot.blocks.resize(1);
+            slot.blocks[0] = replacement;
+        }
+    }
+
+    slot.block = 0;
+    slot.offset = 0;
+    slot.used = 0;
+    slot.frame = frame_number;
+    return err;
+}
+
+ta_frame_alloc ta_frame_allocator_alloc(ta_frame_allocator &allocator, VkDeviceSize size, VkDeviceSize alignment)
+{
+    assert(size);
+    ta_frame_alloc_slot &slot = allocator.slots[allocator.current];
+    ta_vk_buffer *block = &slot.blocks[slot.block];
+
+    VkDeviceSize offset = align_up(slot.offset, alignment);
+    if (offset + size > block->size) {
+        // Overflow, chain another block for the rest of this frame. Sized generously so we don't chain again.
+        VkDeviceSize new_size = std::max(allocator.block_size, align_up(size, alignment)) * 2;
+        slot.blocks.emplace_back();
+        slot.block = (uint32_t)slot.blocks.size() - 1;
+        block = &slot.blocks[slot.block];
+        if (frame_alloc_block_create(allocator, *block, new_size)) {
+            slot.blocks.pop_back();
+            slot.block--;
+            return {};
+        }
+        slot.offset = 0;
+        offset = 0;
+    }
+
+    slot.used += (offset - slot.offset) + size;
+    slot.offset = offset + size;
+    assert(offset <= UINT32_MAX);  // Dynamic offsets are 32-bit
+
+    ta_frame_alloc alloc = {};
+    alloc.buffer = block->buffer;
+    alloc.offset = offset;
+    alloc.ptr = (uint8_t *)block->mapped + offset;
+    return alloc;
+}
+
+ta_frame_alloc ta_frame_alloc_uniform(ta_frame_allocator &allocator, VkDeviceSize size)
+{
+    return ta_frame_allocator_alloc(allocator, size, allocator.uniform_alignment);
+}
+
+ta_frame_alloc ta_frame_alloc_storage(ta_frame_allocator &allocator, VkDeviceSize size)
+{
+    return ta_frame_allocator_alloc(allocator, size, allocator.storage_alignment);
+}
+
+ta_frame_alloc ta_frame_alloc_vertex(ta_frame_allocator &allocator, VkDeviceSize size)
+{
+    return ta_frame_allocator_alloc(allocator, size, 16);
+}
+
+void ta_frame_allocator_free(ta_frame_allocator &allocator, ta_deletion_queue &deletion_queue, uint64_t frame_number)
+{
+    for (ta_frame_alloc_slot &slot : allocator.slots) {
+        allocator.high_water = std::max(allocator.high_water, slot.used);
+        for (ta_vk_buffer &block : slot.blocks) {
+            ta_vk_buffer_destroy(block, deletion_queue, frame_number);
+        }
+    }
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Frame allocator: high-water mark %llu bytes, block size %llu bytes\n",
+        (unsigned long long)allocator.high_water, (unsigned long long)allocator.block_size);
+    allocator.slots.clear();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "ta_vk_buffer.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <vector>
+
+typedef struct ta_frame_alloc_slot {
+    std::vector<ta_vk_buffer> blocks;   // blocks[0] is the steady-state block, the rest are overflow from this frame
+    uint32_t     block;                 // index of the block we're currently bumping in
+    VkDeviceSize offset;                // bump pointer into blocks[block]
+    VkDeviceSize used;                  // bytes handed out this frame, including alignment padding
+    uint64_t     frame;                 // frame number the slot was last used for
+} ta_frame_alloc_slot;
+
+// Persistently mapped bump allocator for per-frame scratch data (uniforms, storage, dynamic vertices). There is one
+// slot per frame in flight; a slot is only reset once its fence has been waited on, so resetting is O(1) and nothing
+// is ever freed individually. Allocations that don't fit chain an overflow block, and the next time the slot comes
+// around it is reallocated as a single block big enough for the high-water mark.
+typedef struct ta_frame_allocator {
+    VkDevice                         device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkBufferUsageFlags               usage;
+    VkDeviceSize                     uniform_alignment;     // minUniformBufferOffsetAlignment
+    VkDeviceSize                     storage_alignment;     // minStorageBufferOffsetAlignment
+    VkDeviceSize                     block_size;            // size of new blocks, grows with the high-water mark
+    VkDeviceSize                     high_water;            // most bytes used by any single frame
+    uint32_t                         current;               // slot for the frame being recorded
+    std::vector<ta_frame_alloc_slot> slots;
+} ta_frame_allocator;
+
+typedef struct ta_frame_alloc {
+    VkBuffer     buffer;    // buffer to bind, stable for the whole frame unless we overflowed
+    VkDeviceSize offset;    // offset into buffer, valid as a dynamic offset for uniform/storage allocations
+    void         *ptr;      // mapped pointer to write the data to
+} ta_frame_alloc;
+
+VkResult ta_frame_allocator_init        (ta_frame_allocator &allocator, VkDevice device,
+                                         const VkPhysicalDeviceProperties &device_properties,
+                                         const VkPhysicalDeviceMemoryProperties &memory_properties,
+                                         uint32_t frames_in_flight, VkDeviceSize block_size);
+VkResult ta_frame_allocator_begin_frame (ta_frame_allocator &allocator, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame_number);
+ta_frame_alloc ta_frame_allocator_alloc (ta_frame_allocator &allocator, VkDeviceSize size, VkDeviceSize alignment);
+ta_frame_alloc ta_frame_alloc_uniform   (ta_frame_allocator &allocator, VkDeviceSize size);
+ta_frame_alloc ta_frame_alloc_storage   (ta_frame_allocator &allocator, VkDeviceSize size);
+ta_frame_alloc ta_frame_alloc_vertex    (ta_frame_allocator &allocator, VkDeviceSize size);
+void ta_frame_allocator_free            (ta_frame_allocator &allocator, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame_number);
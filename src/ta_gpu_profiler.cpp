@@ -0,0 +1,271 @@
+#include "ta_gpu_profiler.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cassert>
+
+#define GPU_PROFILER_QUERY_COUNT (TA_GPU_PROFILER_MAX_SCOPES * 2)
+// Clocks drift apart slowly (ppm), recalibrating once a second is plenty
+#define GPU_PROFILER_CALIBRATION_INTERVAL_MS 1000.0
+
+// The host domain has to be the clock SDL_GetPerformanceCounter reads, so ta_timer_counter_to_ms can convert it:
+// QueryPerformanceCounter on Windows, clock_gettime(CLOCK_MONOTONIC_RAW) (ns) elsewhere.
+bool ta_gpu_profiler_calibration_supported(VkPhysicalDevice physical_device, VkTimeDomainEXT *host_domain)
+{
+    assert(host_domain);
+    if (!vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) {
+        return false;
+    }
+
+    uint32_t domain_count = 0;
+    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physical_device, &domain_count, NULL);
+    std::vector<VkTimeDomainEXT> domains(domain_count);
+    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physical_device, &domain_count, domains.data());
+
+#if _WIN32
+    VkTimeDomainEXT preferred = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+    VkTimeDomainEXT preferred = VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_EXT;
+#endif
+    bool device_domain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+    bool host = std::find(domains.begin(), domains.end(), preferred) != domains.end();
+    if (device_domain && host) {
+        *host_domain = preferred;
+        return true;
+    }
+    return false;
+}
+
+VkResult ta_gpu_profiler_init(ta_gpu_profiler &profiler, VkDevice device,
+    const VkPhysicalDeviceProperties &device_properties, const VkQueueFamilyProperties &queue_family_properties,
+    uint32_t frames_in_flight, bool calibrated, VkTimeDomainEXT host_domain)
+{
+    assert(frames_in_flight);
+    profiler.device = device;
+    profiler.current = 0;
+    profiler.depth = 0;
+    profiler.slots.clear();
+    profiler.stats.clear();
+    profiler.gpu_offset_ms = 0.0;
+    profiler.gpu_offset_valid = false;
+    profiler.calibrated_ms = 0.0;
+    profiler.frames_dropped = 0;
+    profiler.calibrated = false;
+    profiler.host_domain = host_domain;
+
+    uint32_t valid_bits = queue_family_properties.timestampValidBits;
+    profiler.enabled = valid_bits != 0;
+    if (!profiler.enabled) {
+        ta_log_write(tg_debug_log, SRC_GPU, "Queue doesn't support timestamps, GPU profiler disabled.\n");
+        return VK_SUCCESS;
+    }
+    profiler.timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+    profiler.period_ns = device_properties.limits.timestampPeriod;
+    profiler.results.resize(GPU_PROFILER_QUERY_COUNT);
+
+    profiler.slots.resize(frames_in_flight);
+    for (ta_gpu_profiler_slot &slot : profiler.slots) {
+        slot.scopes.reserve(TA_GPU_PROFILER_MAX_SCOPES);
+
+        VkQueryPoolCreateInfo query_pool_create_info = {};
+        query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_pool_create_info.queryCount = GPU_PROFILER_QUERY_COUNT;
+        VkResult err = vkCreateQueryPool(device, &query_pool_create_info, NULL, &slot.query_pool);
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_GPU, "[%u] Failed to create timestamp query pool.\n", err);
+            return err;
+        }
+    }
+
+    // NOTE: Loaded with the device table, NULL unless VK_EXT_calibrated_timestamps was enabled
+    profiler.calibrated = calibrated && vkGetCalibratedTimestampsEXT;
+    ta_log_write(tg_debug_log, SRC_GPU, "GPU profiler: %u valid timestamp bits, %.3fns per tick, %s clocks\n",
+        valid_bits, profiler.period_ns, profiler.calibrated ? "calibrated" : "estimated");
+    return VK_SUCCESS;
+}
+
+static double gpu_ticks_to_ms(const ta_gpu_profiler &profiler, uint64_t ticks)
+{
+    return (double)(ticks & profiler.timestamp_mask) * profiler.period_ns / 1000000.0;
+}
+
+static void gpu_profiler_calibrate(ta_gpu_profiler &profiler)
+{
+    VkCalibratedTimestampInfoEXT infos[2] = {};
+    infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[1].timeDomain = profiler.host_domain;
+
+    uint64_t timestamps[2] = {};
+    uint64_t max_deviation = 0;
+    VkResult err = vkGetCalibratedTimestampsEXT(profiler.device, 2, infos, timestamps, &max_deviation);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_GPU, "[%u] Failed to get calibrated timestamps.\n", err);
+        return;
+    }
+
+    double gpu_ms = gpu_ticks_to_ms(profiler, timestamps[0]);
+    double host_ms = ta_timer_counter_to_ms(timestamps[1]);
+    profiler.gpu_offset_ms = host_ms - gpu_ms;
+    profiler.gpu_offset_valid = true;
+    profiler.calibrated_ms = ta_timer_elapsed_ms();
+}
+
+static void gpu_profiler_stats_add(ta_gpu_profiler &profiler, const std::string &name, double ms)
+{
+    ta_gpu_scope_stats *stats = NULL;
+    for (ta_gpu_scope_stats &existing : profiler.stats) {
+        if (existing.name == name) {
+            stats = &existing;
+            break;
+        }
+    }
+    if (!stats) {
+        profiler.stats.push_back({ name, 0, 0.0, 0.0, 0.0 });
+        stats = &profiler.stats.back();
+    }
+    if (!stats->count || ms < stats->min_ms) stats->min_ms = ms;
+    if (!stats->count || ms > stats->max_ms) stats->max_ms = ms;
+    stats->total_ms += ms;
+    stats->count++;
+}
+
+static void gpu_profiler_read(ta_gpu_profiler &profiler, ta_gpu_profiler_slot &slot)
+{
+    uint32_t query_count = (uint32_t)slot.scopes.size() * 2;
+    if (!query_count) {
+        return;
+    }
+
+    // No WAIT_BIT. The slot's fence has been waited on so these should be ready; if a driver disagrees we'd rather
+    // lose the frame than stall on it.
+    VkResult err = vkGetQueryPoolResults(profiler.device, slot.query_pool, 0, query_count,
+        query_count * sizeof(uint64_t), profiler.results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (err == VK_NOT_READY) {
+        profiler.frames_dropped++;
+        return;
+    } else if (err) {
+        ta_log_write(tg_debug_log, SRC_GPU, "[%u] Failed to read timestamp queries.\n", err);
+        return;
+    }
+
+    // Without calibration: the first timestamp can't be earlier than the submit, so submit - first is a lower bound
+    // on the offset. Keep the tightest bound we've seen.
+    if (!profiler.calibrated) {
+        double candidate_ms = slot.submit_ms - gpu_ticks_to_ms(profiler, profiler.results[slot.scopes[0].query]);
+        if (!profiler.gpu_offset_valid || candidate_ms > profiler.gpu_offset_ms) {
+            profiler.gpu_offset_ms = candidate_ms;
+            profiler.gpu_offset_valid = true;
+        }
+    }
+
+    for (const ta_gpu_scope &scope : slot.scopes) {
+        if (!scope.closed) {
+            continue;
+        }
+        double start_ms = gpu_ticks_to_ms(profiler, profiler.results[scope.query]) + profiler.gpu_offset_ms;
+        double end_ms = gpu_ticks_to_ms(profiler, profiler.results[scope.query + 1]) + profiler.gpu_offset_ms;
+        gpu_profiler_stats_add(profiler, scope.name, end_ms - start_ms);
+        if (profiler.trace) {
+            ta_log_timed_region_write(tg_debug_log, SRC_GPU, scope.name.c_str(), scope.depth, start_ms, end_ms);
+        }
+    }
+}
+
+// Call right after vkBeginCommandBuffer, once this frame slot's fence has been waited on. Reads back whatever the slot
+// recorded last time around, then resets its queries.
+void ta_gpu_profiler_begin_frame(ta_gpu_profiler &profiler, VkCommandBuffer command_buffer, uint64_t frame_number)
+{
+    if (!profiler.enabled) {
+        return;
+    }
+
+    profiler.current = (uint32_t)(frame_number % profiler.slots.size());
+    ta_gpu_profiler_slot &slot = profiler.slots[profiler.current];
+    if (slot.pending) {
+        gpu_profiler_read(profiler, slot);
+        slot.pending = false;
+    }
+    slot.scopes.clear();
+    slot.frame = frame_number;
+    profiler.depth = 0;
+
+    vkCmdResetQueryPool(command_buffer, slot.query_pool, 0, GPU_PROFILER_QUERY_COUNT);
+
+    if (profiler.calibrated &&
+        (!profiler.gpu_offset_valid ||
+         ta_timer_elapsed_ms() - profiler.calibrated_ms > GPU_PROFILER_CALIBRATION_INTERVAL_MS))
+    {
+        gpu_profiler_calibrate(profiler);
+    }
+}
+
+// Scopes may nest. Returns TA_GPU_SCOPE_INVALID (safe to pass to scope_end) if profiling is off or we're out of
+// queries for this frame.
+uint32_t ta_gpu_profiler_scope_begin(ta_gpu_profiler &profiler, VkCommandBuffer command_buffer, const char *name)
+{
+    assert(name);
+    if (!profiler.enabled) {
+        return TA_GPU_SCOPE_INVALID;
+    }
+    ta_gpu_profiler_slot &slot = profiler.slots[profiler.current];
+    if (slot.scopes.size() >= TA_GPU_PROFILER_MAX_SCOPES) {
+        return TA_GPU_SCOPE_INVALID;
+    }
+
+    ta_gpu_scope scope = {};
+    scope.name = name;
+    scope.depth = profiler.depth++;
+    scope.query = (uint32_t)slot.scopes.size() * 2;
+    slot.scopes.push_back(scope);
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.query_pool, scope.query);
+    return (uint32_t)slot.scopes.size() - 1;
+}
+
+void ta_gpu_profiler_scope_end(ta_gpu_profiler &profiler, VkCommandBuffer command_buffer, uint32_t scope)
+{
+    if (scope == TA_GPU_SCOPE_INVALID) {
+        return;
+    }
+    ta_gpu_profiler_slot &slot = profiler.slots[profiler.current];
+    assert(scope < slot.scopes.size());
+    assert(!slot.scopes[scope].closed);
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.query_pool,
+        slot.scopes[scope].query + 1);
+    slot.scopes[scope].closed = true;
+    profiler.depth--;
+}
+
+// Call after vkQueueSubmit
+void ta_gpu_profiler_end_frame(ta_gpu_profiler &profiler, double submit_ms)
+{
+    if (!profiler.enabled) {
+        return;
+    }
+    ta_gpu_profiler_slot &slot = profiler.slots[profiler.current];
+    assert(!profiler.depth);
+    slot.submit_ms = submit_ms;
+    slot.pending = true;
+}
+
+void ta_gpu_profiler_free(ta_gpu_profiler &profiler, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    for (const ta_gpu_scope_stats &stats : profiler.stats) {
+        ta_log_write(tg_debug_log, SRC_GPU, "GPU '%s': frames %u, avg %.3fms, min %.3fms, max %.3fms\n",
+            stats.name.c_str(), stats.count, stats.total_ms / stats.count, stats.min_ms, stats.max_ms);
+    }
+    if (profiler.frames_dropped) {
+        ta_log_write(tg_debug_log, SRC_GPU, "GPU profiler: %llu frames dropped (queries not ready)\n",
+            (unsigned long long)profiler.frames_dropped);
+    }
+
+    for (ta_gpu_profiler_slot &slot : profiler.slots) {
+        ta_deletion_queue_push(deletion_queue, DELETION_QUERY_POOL, TA_VK_HANDLE(slot.query_pool), frame);
+    }
+    profiler.slots.clear();
+    profiler.stats.clear();
+    profiler.enabled = false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TA_GPU_PROFILER_MAX_SCOPES 64
+#define TA_GPU_SCOPE_INVALID UINT32_MAX
+
+typedef struct ta_gpu_scope {
+    std::string name;
+    uint32_t    depth;
+    uint32_t    query;      // begin timestamp, end is query + 1
+    bool        closed;
+} ta_gpu_scope;
+
+// One per frame in flight. Queries are only read back once the frame's fence has been waited on, so readback never
+// stalls.
+typedef struct ta_gpu_profiler_slot {
+    VkQueryPool               query_pool;
+    std::vector<ta_gpu_scope> scopes;
+    uint64_t                  frame;
+    double                    submit_ms;    // CPU time the frame was submitted, for uncalibrated clock alignment
+    bool                      pending;      // results not read back yet
+} ta_gpu_profiler_slot;
+
+// Running totals per scope name, reported on free
+typedef struct ta_gpu_scope_stats {
+    std::string name;
+    uint32_t    count;
+    double      total_ms;
+    double      min_ms;
+    double      max_ms;
+} ta_gpu_scope_stats;
+
+// GPU timestamp profiler. Scopes are converted to the ta_timer_elapsed_ms timeline and written to the log as timed
+// regions (SRC_GPU), so CPU and GPU work read as one timeline. With VK_EXT_calibrated_timestamps the GPU->CPU offset
+// comes from the driver; without it we fall back to the tightest bound from "GPU can't start before submit".
+typedef struct ta_gpu_profiler {
+    VkDevice                           device;
+    bool                               enabled;         // false if the queue can't do timestamps
+    bool                               trace;           // write every scope of every frame to the log
+    double                             period_ns;       // VkPhysicalDeviceLimits::timestampPeriod
+    uint64_t                           timestamp_mask;  // from the queue family's timestampValidBits
+    uint32_t                           current;
+    uint32_t                           depth;
+    std::vector<ta_gpu_profiler_slot>  slots;
+    std::vector<uint64_t>              results;
+    std::vector<ta_gpu_scope_stats>    stats;
+    // Clock calibration
+    bool                               calibrated;      // VK_EXT_calibrated_timestamps enabled
+    VkTimeDomainEXT                    host_domain;
+    double                             gpu_offset_ms;   // cpu_ms = gpu_ms + gpu_offset_ms
+    bool                               gpu_offset_valid;
+    double                             calibrated_ms;   // CPU time of the last calibration
+    uint64_t                           frames_dropped;  // results weren't available when we came back for them
+} ta_gpu_profiler;
+
+bool ta_gpu_profiler_calibration_supported  (VkPhysicalDevice physical_device, VkTimeDomainEXT *host_domain);
+VkResult ta_gpu_profiler_init               (ta_gpu_profiler &profiler, VkDevice device,
+                                             const VkPhysicalDeviceProperties &device_properties,
+                                             const VkQueueFamilyProperties &queue_family_properties,
+                                             uint32_t frames_in_flight, bool calibrated, VkTimeDomainEXT host_domain);
+void ta_gpu_profiler_begin_frame            (ta_gpu_profiler &profiler, VkCommandBuffer command_buffer,
+                                             uint64_t frame_number);
+uint32_t ta_gpu_profiler_scope_begin        (ta_gpu_profiler &profiler, VkCommandBuffer command_buffer,
+                                             const char *name);
+void ta_gpu_profiler_scope_end              (ta_gpu_profiler &profiler, VkCommandBuffer command_buffer, uint32_t scope);
+void ta_gpu_profiler_end_frame              (ta_gpu_profiler &profiler, double submit_ms);
+void ta_gpu_profiler_free                   (ta_gpu_profiler &profiler, ta_deletion_queue &deletion_queue,
+                                             uint64_t frame);
@@ -0,0 +1,25 @@
+#include "ta_hash.hpp"
+#include <cstring>
+
+#define FNV_PRIME 0x100000001b3ull
+
+uint64_t ta_hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t ta_hash_u64(uint64_t hash, uint64_t value)
+{
+    return ta_hash_bytes(hash, &value, sizeof(value));
+}
+
+// Includes the terminator, so "ab" + "c" and "a" + "bc" hash differently when chained
+uint64_t ta_hash_str(uint64_t hash, const char *str)
+{
+    return ta_hash_bytes(hash, str, strlen(str) + 1);
+}
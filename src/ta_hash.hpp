@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a. Not cryptographic, just cheap and good enough for cache keys. Chain calls by passing the previous
+// result back in, starting from TA_HASH_SEED.
+#define TA_HASH_SEED 0xcbf29ce484222325ull
+
+uint64_t ta_hash_bytes  (uint64_t hash, const void *data, size_t size);
+uint64_t ta_hash_u64    (uint64_t hash, uint64_t value);
+uint64_t ta_hash_str    (uint64_t hash, const char *str);
@@ -0,0 +1,167 @@
+#include "ta_jobs.hpp"
+#include "SDL/SDL_cpuinfo.h"
+#include "SDL/SDL_mutex.h"
+#include "SDL/SDL_thread.h"
+#include <algorithm>
+#include <cassert>
+
+// One thread per core, minus the main thread, clamped to what the log can keep track of
+uint32_t ta_jobs_default_worker_count()
+{
+    int cpu_count = SDL_GetCPUCount();
+    uint32_t worker_count = cpu_count > 1 ? (uint32_t)cpu_count - 1 : 0;
+    return std::min(worker_count, (uint32_t)TA_JOBS_MAX_WORKERS);
+}
+
+// NOTE: Must be called with jobs.mutex held
+static void jobs_run_one(ta_jobs &jobs, const ta_job &job, uint32_t worker)
+{
+    SDL_UnlockMutex(jobs.mutex);
+    job.batch->fn(job.batch->userdata, job.index, worker);
+    SDL_LockMutex(jobs.mutex);
+
+    assert(job.batch->remaining);
+    job.batch->remaining--;
+    if (!job.batch->remaining) {
+        SDL_CondBroadcast(jobs.done);
+    }
+}
+
+static int jobs_worker_thread(void *data)
+{
+    ta_jobs_worker *worker = (ta_jobs_worker *)data;
+    ta_jobs &jobs = *worker->jobs;
+
+    SDL_LockMutex(jobs.mutex);
+    for (;;) {
+        while (jobs.queue.empty() && jobs.background.empty() && !jobs.quit) {
+            SDL_CondWait(jobs.wake, jobs.mutex);
+        }
+        if (jobs.quit) {
+            break;
+        }
+        // Someone may be blocked in parallel_for waiting on the regular queue, background work can wait
+        if (!jobs.queue.empty()) {
+            ta_job job = jobs.queue.front();
+            jobs.queue.pop_front();
+            jobs_run_one(jobs, job, worker->index);
+        } else {
+            ta_job_batch background = jobs.background.front();
+            jobs.background.pop_front();
+            SDL_UnlockMutex(jobs.mutex);
+            background.fn(background.userdata, 0, worker->index);
+            SDL_LockMutex(jobs.mutex);
+        }
+    }
+    SDL_UnlockMutex(jobs.mutex);
+    return 0;
+}
+
+void ta_jobs_init(ta_jobs &jobs, uint32_t worker_count)
+{
+    jobs.worker_count = std::min(worker_count, (uint32_t)TA_JOBS_MAX_WORKERS);
+    jobs.mutex = SDL_CreateMutex();
+    jobs.wake = SDL_CreateCond();
+    jobs.done = SDL_CreateCond();
+    jobs.queue.clear();
+    jobs.background.clear();
+    jobs.quit = false;
+    assert(jobs.mutex && jobs.wake && jobs.done);
+
+    for (uint32_t i = 0; i < jobs.worker_count; ++i) {
+        jobs.workers[i].jobs = &jobs;
+        jobs.workers[i].index = i + 1;
+        jobs.threads[i] = SDL_CreateThread(jobs_worker_thread, "ta_jobs_worker", &jobs.workers[i]);
+        if (!jobs.threads[i]) {
+            ta_log_write(tg_debug_log, SRC_SDL, "Failed to create worker thread: %s\n", SDL_GetError());
+            jobs.worker_count = i;
+            break;
+        }
+    }
+    ta_log_write(tg_debug_log, SRC_SDL, "Job system started with %u worker threads\n", jobs.worker_count);
+}
+
+// Runs fn for every index in [0, count) across the pool and blocks until all of them are done. The calling thread
+// works on the batch too (as worker 0) instead of just sleeping.
+void ta_jobs_parallel_for(ta_jobs &jobs, uint32_t count, ta_job_fn fn, void *userdata)
+{
+    if (!count) {
+        return;
+    }
+    if (!jobs.worker_count || count == 1) {
+        for (uint32_t i = 0; i < count; ++i) {
+            fn(userdata, i, 0);
+        }
+        return;
+    }
+
+    ta_job_batch batch = {};
+    batch.fn = fn;
+    batch.userdata = userdata;
+    batch.remaining = count;
+
+    SDL_LockMutex(jobs.mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        ta_job job = {};
+        job.batch = &batch;
+        job.index = i;
+        jobs.queue.push_back(job);
+    }
+    SDL_CondBroadcast(jobs.wake);
+
+    while (batch.remaining) {
+        // Help out with our own batch while there's any of it left in the queue, otherwise wait for the stragglers
+        auto own = std::find_if(jobs.queue.begin(), jobs.queue.end(),
+            [&batch](const ta_job &job) { return job.batch == &batch; });
+        if (own != jobs.queue.end()) {
+            ta_job job = *own;
+            jobs.queue.erase(own);
+            jobs_run_one(jobs, job, 0);
+        } else {
+            SDL_CondWait(jobs.done, jobs.mutex);
+        }
+    }
+    SDL_UnlockMutex(jobs.mutex);
+}
+
+// Queues fn to run once on some worker thread and returns immediately. Nothing tracks completion, fn has to signal
+// that itself. Low priority: parallel_for batches always go first. Background jobs still queued at ta_jobs_free are
+// dropped, so owners should wait for their outstanding jobs before then.
+// NOTE: With no worker threads this just runs fn inline.
+void ta_jobs_background(ta_jobs &jobs, ta_job_fn fn, void *userdata)
+{
+    if (!jobs.worker_count) {
+        fn(userdata, 0, 0);
+        return;
+    }
+
+    ta_job_batch background = {};
+    background.fn = fn;
+    background.userdata = userdata;
+    background.remaining = 1;
+
+    SDL_LockMutex(jobs.mutex);
+    jobs.background.push_back(background);
+    SDL_CondSignal(jobs.wake);
+    SDL_UnlockMutex(jobs.mutex);
+}
+
+void ta_jobs_free(ta_jobs &jobs)
+{
+    SDL_LockMutex(jobs.mutex);
+    jobs.quit = true;
+    SDL_CondBroadcast(jobs.wake);
+    SDL_UnlockMutex(jobs.mutex);
+
+    for (uint32_t i = 0; i < jobs.worker_count; ++i) {
+        SDL_WaitThread(jobs.threads[i], NULL);
+        jobs.threads[i] = NULL;
+    }
+    jobs.worker_count = 0;
+    SDL_DestroyCond(jobs.done);
+    SDL_DestroyCond(jobs.wake);
+    SDL_DestroyMutex(jobs.mutex);
+    jobs.done = NULL;
+    jobs.wake = NULL;
+    jobs.mutex = NULL;
+}
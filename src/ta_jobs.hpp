@@ -0,0 +1,49 @@
+#pragma once
+#include "ta_log.hpp"
+#include <cstdint>
+#include <deque>
+
+typedef struct SDL_Thread SDL_Thread;
+typedef struct SDL_mutex SDL_mutex;
+typedef struct SDL_cond SDL_cond;
+
+// Every thread that logs needs a slot in the log's thread table, including the calling thread
+#define TA_JOBS_MAX_WORKERS (MAX_THREADS - 1)
+
+// index: which item of the batch to run, worker: 0 for the calling thread, 1..worker_count for pool threads. Worker
+// is stable for the lifetime of the pool, so it can index per-thread resources (e.g. command pools).
+typedef void (*ta_job_fn)(void *userdata, uint32_t index, uint32_t worker);
+
+typedef struct ta_job_batch {
+    ta_job_fn fn;
+    void      *userdata;
+    uint32_t  remaining;    // jobs not finished yet, protected by ta_jobs::mutex
+} ta_job_batch;
+
+typedef struct ta_job {
+    ta_job_batch *batch;
+    uint32_t     index;
+} ta_job;
+
+typedef struct ta_jobs_worker {
+    struct ta_jobs *jobs;
+    uint32_t       index;
+} ta_jobs_worker;
+
+typedef struct ta_jobs {
+    uint32_t           worker_count;
+    SDL_Thread         *threads[TA_JOBS_MAX_WORKERS];
+    ta_jobs_worker     workers[TA_JOBS_MAX_WORKERS];
+    SDL_mutex          *mutex;
+    SDL_cond           *wake;       // signaled when jobs are queued or on quit
+    SDL_cond           *done;       // signaled when a batch finishes
+    std::deque<ta_job> queue;
+    std::deque<ta_job_batch> background;    // fire-and-forget, only picked up when queue is empty
+    bool               quit;
+} ta_jobs;
+
+uint32_t ta_jobs_default_worker_count   ();
+void ta_jobs_init                       (ta_jobs &jobs, uint32_t worker_count);
+void ta_jobs_parallel_for               (ta_jobs &jobs, uint32_t count, ta_job_fn fn, void *userdata);
+void ta_jobs_background                 (ta_jobs &jobs, ta_job_fn fn, void *userdata);
+void ta_jobs_free                       (ta_jobs &jobs);
@@ -1,9 +1,12 @@
 #include "ta_log.hpp"
 #include "ta_timer.hpp"
+#include "SDL/SDL_mutex.h"
+#include "SDL/SDL_thread.h"
 #include <cassert>
 #include <string>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 
 #define TA_LOG_MAX_LINE_LENGTH 1024
@@ -14,11 +17,24 @@ const char *ta_log_source_str(ta_log_source src) {
     switch(src) {
         case SRC_SDL:       return "SDL";
         case SRC_VULKAN:    return "Vulkan";
+        case SRC_GPU:       return "GPU";
+        case SRC_FILE:      return "File";
         case SRC_DEBUG:     return "Debug";
         default:            return "UNKNOWN";
     }
 }
 
+const char *ta_log_level_str(ta_log_level level) {
+    switch(level) {
+        case LEVEL_DEBUG:   return "DEBUG";
+        case LEVEL_INFO:    return "INFO";
+        case LEVEL_WARN:    return "WARN";
+        case LEVEL_ERROR:   return "ERROR";
+        case LEVEL_FATAL:   return "FATAL";
+        default:            return "UNKNOWN";
+    }
+}
+
 void ta_log_init(ta_log &log, FILE *stream, bool flush, bool echo_stdout, uint32_t src_include,
     uint32_t src_exclude)
 {
@@ -28,8 +44,9 @@ void ta_log_init(ta_log &log, FILE *stream, bool flush, bool echo_stdout, uint32
     log.echo_stdout = echo_stdout;
     log.src_include = src_include;
     log.src_exclude = src_exclude;
-    //log.mutex = SDL_CreateMutex();
-    //assert(log.mutex);
+    log.level_filter = LEVEL_ALL;
+    log.mutex = SDL_CreateMutex();
+    assert(log.mutex);
     log.show_timestamps = true;
 
     TA_LOCK(log.mutex);
@@ -57,8 +74,9 @@ void ta_log_flush(ta_log &log)
 
 static ta_log_thread_state *log_get_or_create_thread_state(ta_log &log, ta_thread_id thread_id)
 {
-    //assert(thread_id);
+    assert(thread_id);
 
+    TA_LOCK(log.mutex);
     ta_log_thread_state *state = 0;
     for (int i = 0; i < MAX_THREADS; ++i) {
         if (log.thread_states[i].thread_id == thread_id) {
@@ -70,6 +88,7 @@ static ta_log_thread_state *log_get_or_create_thread_state(ta_log &log, ta_threa
             break;
         }
     }
+    TA_UNLOCK(log.mutex);
     if (!state) {
         assert(!"Thread table is full. Do clean-up or increase MAX_THREADS");
     }
@@ -90,14 +109,14 @@ static ta_log_thread_state *log_get_thread_state(ta_log &log, ta_thread_id threa
 
 void ta_log_indent(ta_log &log)
 {
-    ta_thread_id thread_id = 0; //SDL_ThreadID();
+    ta_thread_id thread_id = (ta_thread_id)SDL_ThreadID();
     ta_log_thread_state *state = log_get_or_create_thread_state(log, thread_id);
     state->indent++;
 }
 
 void ta_log_unindent(ta_log &log)
 {
-    ta_thread_id thread_id = 0; //SDL_ThreadID();
+    ta_thread_id thread_id = (ta_thread_id)SDL_ThreadID();
     ta_log_thread_state *state = log_get_thread_state(log, thread_id);
     if (state && state->indent) {
         state->indent--;
@@ -123,7 +142,7 @@ static void ta_log_write_timestamp(ta_log &log, ta_log_source src)
     double elapsed_ms = ta_timer_elapsed_ms();
     double elapsed_sec = elapsed_ms / 1000;
 
-    ta_thread_id thread_id = 0; //SDL_ThreadID();
+    ta_thread_id thread_id = (ta_thread_id)SDL_ThreadID();
 
     static char buffer[TA_LOG_MAX_LINE_LENGTH] = { 0 };
     int len = snprintf(buffer, sizeof(buffer), "[%s][%5u][%10s][%8.3fs] ", timestamp, thread_id, ta_log_source_str(src),
@@ -151,39 +170,65 @@ static void ta_log_write_timestamp(ta_log &log, ta_log_source src)
     }
 }
 
-void ta_log_write(ta_log &log, ta_log_source src, const char *fmt, ...)
+static void log_vwrite(ta_log &log, ta_log_source src, const char *prefix, const char *fmt, va_list args)
 {
-    if (log.src_include & src && !(log.src_exclude & src)) {
-        TA_LOCK(log.mutex);
-        ta_log_write_timestamp(log, src);
-
-        ta_thread_id thread_id = 0; //SDL_ThreadID();
-        ta_log_thread_state *state = log_get_thread_state(log, thread_id);
-        if (state) {
-            for (int i = 0; i < state->indent; ++i) {
-                fprintf(log.stream, "    ");
-            }
+    TA_LOCK(log.mutex);
+    ta_log_write_timestamp(log, src);
+
+    ta_thread_id thread_id = (ta_thread_id)SDL_ThreadID();
+    ta_log_thread_state *state = log_get_thread_state(log, thread_id);
+    if (state) {
+        for (int i = 0; i < state->indent; ++i) {
+            fprintf(log.stream, "    ");
         }
+    }
+    if (prefix) {
+        fprintf(log.stream, "%s: ", prefix);
+    }
+
+    // NOTE: A va_list can only be walked once, echo from a copy
+    va_list echo_args;
+    va_copy(echo_args, args);
+    vfprintf(log.stream, fmt, args);
+    if (log.echo_stdout) {
+        if (prefix) {
+            fprintf(stdout, "%s: ", prefix);
+        }
+        vfprintf(stdout, fmt, echo_args);
+    }
+    va_end(echo_args);
 
+    if (log.flush) {
+        ta_log_flush(log);
+    }
+    TA_UNLOCK(log.mutex);
+}
+
+void ta_log_write(ta_log &log, ta_log_source src, const char *fmt, ...)
+{
+    if (log.src_include & src && !(log.src_exclude & src)) {
         va_list args = {};
         va_start(args, fmt);
-        vfprintf(log.stream, fmt, args);
-        if (log.echo_stdout) {
-            vfprintf(stdout, fmt, args);
-        }
+        log_vwrite(log, src, NULL, fmt, args);
         va_end(args);
+    }
+}
 
-        if (log.flush) {
-            ta_log_flush(log);
-        }
-        TA_UNLOCK(log.mutex);
+// Same as ta_log_write, but filtered by log.level_filter and prefixed with the level
+void ta_log_write_level(ta_log &log, ta_log_source src, ta_log_level level, const char *fmt, ...)
+{
+    if (log.src_include & src && !(log.src_exclude & src) && (log.level_filter & level)) {
+        va_list args = {};
+        va_start(args, fmt);
+        log_vwrite(log, src, ta_log_level_str(level), fmt, args);
+        va_end(args);
     }
 }
 
 // NOTE: Lifetime of name must be at least as long as it takes to call ta_log_timed_region_end()
 void ta_log_timed_region_start(ta_log &log, ta_log_source src, std::string name)
 {
-    ta_thread_id thread_id = {}; //SDL_ThreadID();
+    ta_thread_id thread_id = (ta_thread_id)SDL_ThreadID();
     ta_log_thread_state *state = log_get_or_create_thread_state(log, thread_id);
 
     ta_log_timed_region region = { 0 };
@@ -197,7 +242,7 @@ void ta_log_timed_region_start(ta_log &log, ta_log_source src, std::string name)
 
 void ta_log_timed_region_end(ta_log &log, std::string name)
 {
-    ta_thread_id thread_id = {}; //SDL_ThreadID();
+    ta_thread_id thread_id = (ta_thread_id)SDL_ThreadID();
     ta_log_thread_state *state = log_get_or_create_thread_state(log, thread_id);
 
     bool found = false;
@@ -209,6 +254,18 @@ void ta_log_timed_region_end(ta_log &log, std::string name)
     }
 }
 
+// Writes a region that was timed somewhere else (e.g. on the GPU) after the fact. start_ms/end_ms are on the
+// ta_timer_elapsed_ms timeline, so these line up with START/END lines from regular timed regions.
+void ta_log_timed_region_write(ta_log &log, ta_log_source src, const char *name, int depth, double start_ms,
+    double end_ms)
+{
+    char indent[64] = { 0 };
+    for (int i = 0; i < depth && i < (int)sizeof(indent) / 4 - 1; ++i) {
+        memcpy(indent + i * 4, "    ", 4);
+    }
+    ta_log_write(log, src, "%sREGION %s [%8.3fs, %7.3fms]\n", indent, name, start_ms / 1000, end_ms - start_ms);
+}
+
 void ta_log_free(ta_log &log)
 {
     ta_log_flush(log);
@@ -216,7 +273,8 @@ void ta_log_free(ta_log &log)
         fclose(log.stream);
     }
     if (log.mutex) {
-        //SDL_DestroyMutex(log.mutex);
+        SDL_DestroyMutex((SDL_mutex *)log.mutex);
+        log.mutex = 0;
     }
     // TODO: Flush all timed regions on log close? For now, just assume app does that correctly
     //for (int i = 0; i < MAX_THREADS; ++i) {
@@ -9,8 +9,8 @@ typedef enum ta_log_source {
     SRC_NONE       = 0x00000000,
     SRC_SDL        = 0x00000001,
     SRC_VULKAN     = 0x00000002,
-    //SRC_PLACEHOLDER = 0x00000004,
-    //SRC_PLACEHOLDER = 0x00000008,
+    SRC_GPU        = 0x00000004,
+    SRC_FILE       = 0x00000008,
     //SRC_PLACEHOLDER = 0x00000010,
     //SRC_PLACEHOLDER = 0x00000020,
     //SRC_PLACEHOLDER = 0x00000040,
@@ -42,7 +42,7 @@ typedef enum ta_log_source {
     //        | SRC_RENDER | SRC_RIGID_BODY | SRC_SCENE | SRC_SHADER | SRC_SYSTEM | SRC_TEXTURE | SRC_WINDOW
 } ta_log_source;
 
-// TODO: Actually use this
+// Only ta_log_write_level filters by level, plain ta_log_write always writes
 typedef enum ta_log_level {
     LEVEL_NONE  = 0x00000000,
     LEVEL_DEBUG = 0x00000001,
@@ -50,14 +50,15 @@ typedef enum ta_log_level {
     LEVEL_WARN  = 0x00000004,
     LEVEL_ERROR = 0x00000008,
     LEVEL_FATAL = 0x00000010,
+    LEVEL_ALL   = 0x0000001f,
 } ta_log_level;
 
 // NOTE: I don't expect lock/unlock to ever error, but if it's a real thing that
-// happens I'll refactor this to handle it better.
-//#define TA_LOCK(mutex) assert(!SDL_LockMutex(mutex))
-//#define TA_UNLOCK(mutex) assert(!SDL_UnlockMutex(mutex))
-#define TA_LOCK(mutex)
-#define TA_UNLOCK(mutex)
+// happens I'll refactor this to handle it better. Don't wrap these in assert(), they'd
+// compile out in release.
+// NOTE: SDL mutexes are recursive, which log_get_or_create_thread_state relies on.
+#define TA_LOCK(mutex) SDL_LockMutex((SDL_mutex *)(mutex))
+#define TA_UNLOCK(mutex) SDL_UnlockMutex((SDL_mutex *)(mutex))
 #define MAX_THREADS 8
 
 //typedef SDL_threadID ta_thread_id;
@@ -82,8 +83,8 @@ typedef struct ta_log {
     bool        echo_stdout;      // if true, echo all log writes to stdout
     uint32_t    src_include;      // log source bitmap, 1 = log this source
     uint32_t    src_exclude;      // log source bitmap, 1 = exclude this source (overrides include)
-    uint32_t    level_filter;     // TODO(unused): log level filter
-    void        *mutex;           // TODO(unused): was SDL_mutex when I was testing threading
+    uint32_t    level_filter;     // log level bitmap, 1 = log this level
+    void        *mutex;           // SDL_mutex, guards the stream and thread table
     bool        show_timestamps;  // if true, write timestamps before each line
     ta_log_thread_state thread_states[MAX_THREADS];
 } ta_log;
@@ -91,6 +92,7 @@ typedef struct ta_log {
 extern ta_log tg_debug_log;
 
 const char *ta_log_source_str(ta_log_source src);
+const char *ta_log_level_str(ta_log_level level);
 
 void ta_log_init                (ta_log &log, FILE *stream, bool flush, bool echo_stdout, bool echo_console, uint32_t src_include, uint32_t src_exclude);
 void ta_log_init_file           (ta_log &log, std::string filename, bool flush, bool echo_stdout, uint32_t src_include, uint32_t src_exclude);
@@ -98,6 +100,8 @@ void ta_log_flush               (ta_log &log);
 void ta_log_indent              (ta_log &log);
 void ta_log_unindent            (ta_log &log);
 void ta_log_write               (ta_log &log, ta_log_source src, const char *fmt, ...);
-void ta_log_timed_region_start  (ta_log &log, ta_log_source src, const char *name, size_t name_len);
-void ta_log_timed_region_end    (ta_log &log, const char *name, size_t name_len);
+void ta_log_write_level         (ta_log &log, ta_log_source src, ta_log_level level, const char *fmt, ...);
+void ta_log_timed_region_start  (ta_log &log, ta_log_source src, std::string name);
+void ta_log_timed_region_end    (ta_log &log, std::string name);
+void ta_log_timed_region_write  (ta_log &log, ta_log_source src, const char *name, int depth, double start_ms, double end_ms);
 void ta_log_free                (ta_log &log);
\ No newline at end of file
@@ -0,0 +1,304 @@
+#include "ta_mesh.hpp"
+#include "ta_log.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+uint32_t ta_mesh_vertex_stride(ta_mesh_vertex_format format)
+{
+    switch (format) {
+        case MESH_VERTEX_FLOAT:     return sizeof(ta_mesh_vertex);
+        case MESH_VERTEX_QUANTIZED: return sizeof(ta_mesh_vertex_quantized);
+        default:                    return 0;
+    }
+}
+
+ta_mesh_vertex_input ta_mesh_vertex_input_get(ta_mesh_vertex_format format)
+{
+    ta_mesh_vertex_input input = {};
+    input.binding.binding = 0;
+    input.binding.stride = ta_mesh_vertex_stride(format);
+    input.binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    for (uint32_t i = 0; i < 4; ++i) {
+        input.attributes[i].location = i;
+        input.attributes[i].binding = 0;
+    }
+    if (format == MESH_VERTEX_QUANTIZED) {
+        input.attributes[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        input.attributes[0].offset = offsetof(ta_mesh_vertex_quantized, position);
+        input.attributes[1].format = VK_FORMAT_R16G16_SNORM;
+        input.attributes[1].offset = offsetof(ta_mesh_vertex_quantized, normal);
+        input.attributes[2].format = VK_FORMAT_R16G16_SNORM;
+        input.attributes[2].offset = offsetof(ta_mesh_vertex_quantized, tangent);
+        input.attributes[3].format = VK_FORMAT_R16G16_SFLOAT;
+        input.attributes[3].offset = offsetof(ta_mesh_vertex_quantized, uv);
+    } else {
+        input.attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        input.attributes[0].offset = offsetof(ta_mesh_vertex, position);
+        input.attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        input.attributes[1].offset = offsetof(ta_mesh_vertex, normal);
+        input.attributes[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        input.attributes[2].offset = offsetof(ta_mesh_vertex, tangent);
+        input.attributes[3].format = VK_FORMAT_R32G32_SFLOAT;
+        input.attributes[3].offset = offsetof(ta_mesh_vertex, uv);
+    }
+    return input;
+}
+
+static bool mesh_section_valid(const ta_file_map &map, uint64_t offset, uint64_t bytes)
+{
+    return offset % TA_MESH_ALIGNMENT == 0 && offset <= map.size && bytes <= map.size - offset;
+}
+
+// One pass with no early out, so it vectorizes. Offsets are TA_MESH_ALIGNMENT aligned, the casts are fine.
+static uint32_t mesh_max_index(const uint8_t *indices, uint32_t index_size, uint32_t count)
+{
+    uint32_t max_index = 0;
+    if (index_size == 2) {
+        const uint16_t *indices16 = (const uint16_t *)indices;
+        for (uint32_t i = 0; i < count; ++i) {
+            max_index = std::max(max_index, (uint32_t)indices16[i]);
+        }
+    } else {
+        const uint32_t *indices32 = (const uint32_t *)indices;
+        for (uint32_t i = 0; i < count; ++i) {
+            max_index = std::max(max_index, indices32[i]);
+        }
+    }
+    return max_index;
+}
+
+// Maps the file and checks the header against the structs we were built with. The file is only read by the upload,
+// the mapping can be closed as soon as that's recorded.
+bool ta_mesh_file_open(ta_mesh_file &file, const char *path)
+{
+    file = {};
+    if (!ta_file_map_open(file.map, path)) {
+        return false;
+    }
+
+    const ta_file_map &map = file.map;
+    const ta_mesh_header *header = (const ta_mesh_header *)map.data;
+    const char *error = NULL;
+    if (map.size < sizeof(ta_mesh_header) || header->magic != TA_MESH_MAGIC) {
+        error = "not a cooked mesh";
+    } else if (header->version != TA_MESH_VERSION || header->header_size != sizeof(ta_mesh_header)) {
+        error = "cooked by a different version, cook it again";
+    } else if (header->file_size != map.size) {
+        error = "truncated";
+    } else if (!ta_mesh_vertex_stride((ta_mesh_vertex_format)header->vertex_format) ||
+        header->vertex_stride != ta_mesh_vertex_stride((ta_mesh_vertex_format)header->vertex_format) ||
+        (header->index_size != 2 && header->index_size != 4) ||
+        header->vertex_bytes != (uint64_t)header->vertex_count * header->vertex_stride ||
+        header->index_bytes != (uint64_t)header->index_count * header->index_size)
+    {
+        error = "unknown vertex or index format";
+    } else if (!mesh_section_valid(map, header->submesh_offset, header->submesh_count * sizeof(ta_mesh_submesh)) ||
+        !mesh_section_valid(map, header->material_offset, header->material_count * sizeof(ta_mesh_material)) ||
+        !mesh_section_valid(map, header->vertex_offset, header->vertex_bytes) ||
+        !mesh_section_valid(map, header->index_offset, header->index_bytes) ||
+        !mesh_section_valid(map, header->meshlet_offset, header->meshlet_count * sizeof(ta_mesh_meshlet)) ||
+        !mesh_section_valid(map, header->meshlet_vertex_offset, header->meshlet_vertex_count * sizeof(uint32_t)) ||
+        !mesh_section_valid(map, header->meshlet_triangle_offset, header->index_count) ||
+        header->index_offset < header->vertex_offset + header->vertex_bytes ||
+        header->meshlet_offset < header->index_offset + header->index_bytes)
+    {
+        error = "section out of bounds";
+    }
+    if (error) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to open mesh '%s', %s.\n", path, error);
+        ta_mesh_file_close(file);
+        return false;
+    }
+
+    file.header = header;
+    file.submeshes = (const ta_mesh_submesh *)(map.data + header->submesh_offset);
+    file.materials = (const ta_mesh_material *)(map.data + header->material_offset);
+    file.vertices = map.data + header->vertex_offset;
+    file.indices = map.data + header->index_offset;
+    file.meshlets = (const ta_mesh_meshlet *)(map.data + header->meshlet_offset);
+    for (uint32_t i = 0; i < header->submesh_count; ++i) {
+        const ta_mesh_submesh &submesh = file.submeshes[i];
+        if ((uint64_t)submesh.first_index + submesh.index_count > header->index_count ||
+            (header->material_count && submesh.material >= header->material_count) ||
+            (uint64_t)submesh.first_meshlet + submesh.meshlet_count > header->meshlet_count ||
+            !submesh.lod_count || submesh.lod_count > TA_MESH_MAX_LODS)
+        {
+            ta_log_write(tg_debug_log, SRC_FILE, "Failed to open mesh '%s', submesh %u out of range.\n", path, i);
+            ta_mesh_file_close(file);
+            return false;
+        }
+        for (uint32_t lod = 0; lod < submesh.lod_count; ++lod) {
+            if ((uint64_t)submesh.lods[lod].first_index + submesh.lods[lod].index_count > header->index_count) {
+                ta_log_write(tg_debug_log, SRC_FILE, "Failed to open mesh '%s', submesh %u LOD %u out of range.\n",
+                    path, i, lod);
+                ta_mesh_file_close(file);
+                return false;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < header->meshlet_count; ++i) {
+        const ta_mesh_meshlet &meshlet = file.meshlets[i];
+        if ((uint64_t)meshlet.first_index + meshlet.triangle_count * 3ull > header->index_count ||
+            (uint64_t)meshlet.vertex_offset + meshlet.vertex_count > header->meshlet_vertex_count)
+        {
+            ta_log_write(tg_debug_log, SRC_FILE, "Failed to open mesh '%s', meshlet %u out of range.\n", path, i);
+            ta_mesh_file_close(file);
+            return false;
+        }
+    }
+    // Indices (and meshlet vertex lists) go straight to the GPU, one past the end reads outside the vertex buffer
+    if ((header->index_count &&
+            mesh_max_index(file.indices, header->index_size, header->index_count) >= header->vertex_count) ||
+        (header->meshlet_vertex_count &&
+            mesh_max_index(map.data + header->meshlet_vertex_offset, 4, header->meshlet_vertex_count) >=
+            header->vertex_count))
+    {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to open mesh '%s', index out of range of its %u vertices.\n",
+            path, header->vertex_count);
+        ta_mesh_file_close(file);
+        return false;
+    }
+    return true;
+}
+
+void ta_mesh_file_close(ta_mesh_file &file)
+{
+    ta_file_map_close(file.map);
+    file = {};
+}
+
+// Creates the device local buffer and records one copy into it from a staging buffer holding the file's GPU payload,
+// which is a single memcpy out of the mapping. The staging buffer is released with `frame`, so command_buffer
+// must be submitted as (or before) that frame.
+VkResult ta_mesh_upload(ta_mesh &mesh, const ta_mesh_file &file, VkDevice device,
+    const VkPhysicalDeviceMemoryProperties &memory_properties, VkCommandBuffer command_buffer,
+    ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    const ta_mesh_header &header = *file.header;
+    mesh = {};
+    mesh.vertex_offset = 0;
+    mesh.index_offset = header.index_offset - header.vertex_offset;
+    mesh.meshlet_offset = header.meshlet_offset - header.vertex_offset;
+    mesh.meshlet_vertex_offset = header.meshlet_vertex_offset - header.vertex_offset;
+    mesh.meshlet_triangle_offset = header.meshlet_triangle_offset - header.vertex_offset;
+    mesh.index_type = header.index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    mesh.vertex_format = header.vertex_format;
+    mesh.vertex_stride = header.vertex_stride;
+    mesh.vertex_count = header.vertex_count;
+    mesh.index_count = header.index_count;
+    mesh.bounds = header.bounds;
+    mesh.decode = header.decode;
+    mesh.submeshes.assign(file.submeshes, file.submeshes + header.submesh_count);
+    mesh.materials.assign(file.materials, file.materials + header.material_count);
+    mesh.meshlets.assign(file.meshlets, file.meshlets + header.meshlet_count);
+
+    VkDeviceSize size = header.file_size - header.vertex_offset;
+    if (!size) {
+        return VK_SUCCESS;
+    }
+
+    ta_vk_buffer staging = {};
+    VkResult err = ta_vk_buffer_create(staging, device, memory_properties, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create mesh staging buffer.\n", err);
+        return err;
+    }
+    err = ta_vk_buffer_create(mesh.buffer, device, memory_properties, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create mesh buffer.\n", err);
+        ta_vk_buffer_destroy(staging, deletion_queue, frame);
+        return err;
+    }
+
+    memcpy(staging.mapped, file.vertices, (size_t)size);
+
+    VkBufferCopy region = {};
+    region.size = size;
+    vkCmdCopyBuffer(command_buffer, staging.buffer, mesh.buffer.buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+        VK_ACCESS_SHADER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = mesh.buffer.buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+
+    ta_vk_buffer_destroy(staging, deletion_queue, frame);
+    return VK_SUCCESS;
+}
+
+// One mmap, one memcpy, one copy command. No parsing, no per-vertex work.
+VkResult ta_mesh_load(ta_mesh &mesh, const char *path, VkDevice device,
+    const VkPhysicalDeviceMemoryProperties &memory_properties, VkCommandBuffer command_buffer,
+    ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    ta_mesh_file file = {};
+    if (!ta_mesh_file_open(file, path)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    VkResult err = ta_mesh_upload(mesh, file, device, memory_properties, command_buffer, deletion_queue, frame);
+    ta_mesh_file_close(file);
+    return err;
+}
+
+void ta_mesh_bind(const ta_mesh &mesh, VkCommandBuffer command_buffer)
+{
+    assert(mesh.buffer.buffer);
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh.buffer.buffer, &mesh.vertex_offset);
+    vkCmdBindIndexBuffer(command_buffer, mesh.buffer.buffer, mesh.index_offset, mesh.index_type);
+}
+
+// Pixels one mesh unit covers at distance 1, for ta_mesh_lod_select
+float ta_mesh_lod_projection(float fov_y, float viewport_height)
+{
+    return viewport_height / (2.0f * tanf(fov_y * 0.5f));
+}
+
+// Coarsest LOD whose error projects to at most threshold_pixels on screen, measured at the point of the submesh's
+// bounding sphere closest to the camera. Inside the sphere that's always full detail.
+uint32_t ta_mesh_lod_select(const ta_mesh_submesh &submesh, const float camera_position[3], float projection,
+    float threshold_pixels)
+{
+    float dx = camera_position[0] - submesh.bounds.center[0];
+    float dy = camera_position[1] - submesh.bounds.center[1];
+    float dz = camera_position[2] - submesh.bounds.center[2];
+    float distance = sqrtf(dx * dx + dy * dy + dz * dz) - submesh.bounds.radius;
+    uint32_t lod = 0;
+    while (lod + 1 < submesh.lod_count && submesh.lods[lod + 1].error * projection <= threshold_pixels * distance) {
+        lod++;
+    }
+    return lod;
+}
+
+// Mesh has to be bound (ta_mesh_bind)
+void ta_mesh_draw_submesh(const ta_mesh &mesh, VkCommandBuffer command_buffer, uint32_t submesh, uint32_t lod)
+{
+    assert(submesh < mesh.submeshes.size() && lod < mesh.submeshes[submesh].lod_count);
+    const ta_mesh_lod &range = mesh.submeshes[submesh].lods[lod];
+    vkCmdDrawIndexed(command_buffer, range.index_count, 1, range.first_index, 0, 0);
+}
+
+void ta_mesh_push_decode(const ta_mesh &mesh, VkCommandBuffer command_buffer, VkPipelineLayout layout,
+    VkShaderStageFlags stages, uint32_t offset)
+{
+    vkCmdPushConstants(command_buffer, layout, stages, offset, sizeof(mesh.decode), &mesh.decode);
+}
+
+void ta_mesh_free(ta_mesh &mesh, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    if (mesh.buffer.buffer) {
+        ta_vk_buffer_destroy(mesh.buffer, deletion_queue, frame);
+    }
+    mesh = {};
+}
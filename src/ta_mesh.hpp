@@ -0,0 +1,184 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_file_map.hpp"
+#include "ta_vk_buffer.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <vector>
+
+// Cooked mesh file, written by ta_mesh_cook. Bump the version whenever any of the structs below change.
+#define TA_MESH_MAGIC       0x48534d54  // "TMSH"
+#define TA_MESH_VERSION     4
+// Every section starts on this boundary, so the GPU payload can be copied (or mapped) straight into a buffer and
+// every section in it is a valid storage buffer offset (minStorageBufferOffsetAlignment is at most 256)
+#define TA_MESH_ALIGNMENT   256
+#define TA_MESH_NAME_LENGTH 64
+// Full detail plus up to 4 simplified levels
+#define TA_MESH_MAX_LODS    5
+
+typedef enum ta_mesh_vertex_format {
+    MESH_VERTEX_FLOAT,      // ta_mesh_vertex
+    MESH_VERTEX_QUANTIZED,  // ta_mesh_vertex_quantized
+} ta_mesh_vertex_format;
+
+// Interleaved full precision vertex, 48 bytes
+typedef struct ta_mesh_vertex {
+    float position[3];
+    float normal[3];
+    float tangent[4];       // xyz + handedness in w, all zero until tangents are generated
+    float uv[2];
+} ta_mesh_vertex;
+
+// Quantized vertex, 20 bytes. See ta_mesh_quant for the encodings.
+typedef struct ta_mesh_vertex_quantized {
+    uint16_t position[4];   // R16G16B16A16_UNORM, xyz against the mesh AABB (ta_mesh_decode), w tangent handedness
+    int16_t  normal[2];     // R16G16_SNORM, octahedral
+    int16_t  tangent[2];    // R16G16_SNORM, octahedral
+    uint16_t uv[2];         // R16G16_SFLOAT
+} ta_mesh_vertex_quantized;
+
+// Vertex shader push constants turning the vertex's position attribute back into mesh space:
+//   position = position_offset.xyz + attribute.xyz * position_scale.xyz
+//   handedness = attribute.w * 2 - 1 (quantized only)
+// Identity for MESH_VERTEX_FLOAT, so both formats can share a shader.
+typedef struct ta_mesh_decode {
+    float position_scale[4];
+    float position_offset[4];
+} ta_mesh_decode;
+
+typedef struct ta_mesh_bounds {
+    float min[3];
+    float max[3];
+    float center[3];        // bounding sphere
+    float radius;
+} ta_mesh_bounds;
+
+// Level of detail of a submesh, another range of the same index buffer over the same vertices
+typedef struct ta_mesh_lod {
+    uint32_t first_index;
+    uint32_t index_count;
+    float    error;             // how far the surface may have moved from full detail, mesh units
+} ta_mesh_lod;
+
+// Range of the index buffer drawn with one material. Indices are absolute (no vertexOffset needed).
+typedef struct ta_mesh_submesh {
+    char           name[TA_MESH_NAME_LENGTH];
+    uint32_t       first_index;     // full detail, same as lods[0]
+    uint32_t       index_count;
+    uint32_t       material;        // slot in the material table
+    uint32_t       first_meshlet;   // the full detail range split into meshlets, in order
+    uint32_t       meshlet_count;
+    uint32_t       lod_count;       // at least 1
+    ta_mesh_lod    lods[TA_MESH_MAX_LODS];  // increasing error and decreasing triangle count
+    ta_mesh_bounds bounds;
+} ta_mesh_submesh;
+
+// Cluster of at most TA_MESHLET_MAX_VERTICES / TA_MESHLET_MAX_TRIANGLES, built by ta_meshlet. Its triangles are a
+// contiguous range of the index buffer, so a meshlet is also a plain indexed draw. 48 bytes, read as-is by the cull
+// shader (std430: vec4 sphere, vec4 cone, uvec4).
+typedef struct ta_mesh_meshlet {
+    float    center[3];         // bounding sphere
+    float    radius;
+    float    cone_axis[3];      // average facing of the triangles
+    float    cone_cutoff;       // sin of the cone's half angle, 1 if the triangles face too many ways to ever cull
+    uint32_t first_index;
+    uint32_t triangle_count;
+    uint32_t vertex_offset;     // into the meshlet vertex table
+    uint32_t vertex_count;
+} ta_mesh_meshlet;
+
+typedef struct ta_mesh_material {
+    char name[TA_MESH_NAME_LENGTH];     // usemtl name, bound to an actual material at runtime
+} ta_mesh_material;
+
+// File layout, all offsets from the start of the file and TA_MESH_ALIGNMENT aligned:
+//   header | submeshes | materials | vertices | indices | meshlets | meshlet vertices | meshlet triangles
+// [vertex_offset, file_size) is the whole GPU payload. Every submesh's full detail range comes first in the index
+// buffer, simplified LODs after. For mesh shaders, meshlet vertices are uint32 vertex indices (each meshlet's at its
+// vertex_offset) and meshlet triangles are uint8 indices into those, one per index buffer entry (zero for LODs), so
+// a meshlet's local triangles start at byte first_index.
+typedef struct ta_mesh_header {
+    uint32_t       magic;
+    uint32_t       version;
+    uint32_t       header_size;         // sizeof(ta_mesh_header), catches a mismatched struct on either side
+    uint32_t       vertex_format;       // ta_mesh_vertex_format
+    uint32_t       vertex_stride;
+    uint32_t       vertex_count;
+    uint32_t       index_size;          // 2 or 4
+    uint32_t       index_count;
+    uint32_t       submesh_count;
+    uint32_t       material_count;
+    uint32_t       meshlet_count;
+    uint32_t       meshlet_vertex_count;
+    uint64_t       submesh_offset;
+    uint64_t       material_offset;
+    uint64_t       vertex_offset;
+    uint64_t       vertex_bytes;
+    uint64_t       index_offset;
+    uint64_t       index_bytes;
+    uint64_t       meshlet_offset;
+    uint64_t       meshlet_vertex_offset;
+    uint64_t       meshlet_triangle_offset;     // index_count bytes
+    uint64_t       file_size;
+    ta_mesh_bounds bounds;
+    ta_mesh_decode decode;
+} ta_mesh_header;
+
+// A cooked mesh file mapped into memory. Everything points into the mapping, nothing is copied or converted.
+typedef struct ta_mesh_file {
+    ta_file_map            map;
+    const ta_mesh_header   *header;
+    const ta_mesh_submesh  *submeshes;
+    const ta_mesh_material *materials;
+    const uint8_t          *vertices;
+    const uint8_t          *indices;
+    const ta_mesh_meshlet  *meshlets;
+} ta_mesh_file;
+
+// GPU side. Vertices, indices and meshlets share one device local buffer.
+typedef struct ta_mesh {
+    ta_vk_buffer                  buffer;
+    VkDeviceSize                  vertex_offset;
+    VkDeviceSize                  index_offset;
+    VkDeviceSize                  meshlet_offset;
+    VkDeviceSize                  meshlet_vertex_offset;
+    VkDeviceSize                  meshlet_triangle_offset;
+    VkIndexType                   index_type;
+    uint32_t                      vertex_format;
+    uint32_t                      vertex_stride;
+    uint32_t                      vertex_count;
+    uint32_t                      index_count;
+    ta_mesh_bounds                bounds;
+    ta_mesh_decode                decode;
+    std::vector<ta_mesh_submesh>  submeshes;
+    std::vector<ta_mesh_material> materials;
+    std::vector<ta_mesh_meshlet>  meshlets;     // CPU copy for culling when the GPU can't
+} ta_mesh;
+
+// Vertex input for a vertex format: binding 0, locations 0-3 are position, normal, tangent, uv
+typedef struct ta_mesh_vertex_input {
+    VkVertexInputBindingDescription   binding;
+    VkVertexInputAttributeDescription attributes[4];
+} ta_mesh_vertex_input;
+
+uint32_t ta_mesh_vertex_stride          (ta_mesh_vertex_format format);
+ta_mesh_vertex_input ta_mesh_vertex_input_get(ta_mesh_vertex_format format);
+bool ta_mesh_file_open                  (ta_mesh_file &file, const char *path);
+void ta_mesh_file_close                 (ta_mesh_file &file);
+VkResult ta_mesh_upload                 (ta_mesh &mesh, const ta_mesh_file &file, VkDevice device,
+                                         const VkPhysicalDeviceMemoryProperties &memory_properties,
+                                         VkCommandBuffer command_buffer, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame);
+VkResult ta_mesh_load                   (ta_mesh &mesh, const char *path, VkDevice device,
+                                         const VkPhysicalDeviceMemoryProperties &memory_properties,
+                                         VkCommandBuffer command_buffer, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame);
+void ta_mesh_bind                       (const ta_mesh &mesh, VkCommandBuffer command_buffer);
+float ta_mesh_lod_projection            (float fov_y, float viewport_height);
+uint32_t ta_mesh_lod_select             (const ta_mesh_submesh &submesh, const float camera_position[3],
+                                         float projection, float threshold_pixels);
+void ta_mesh_draw_submesh               (const ta_mesh &mesh, VkCommandBuffer command_buffer, uint32_t submesh,
+                                         uint32_t lod);
+void ta_mesh_push_decode                (const ta_mesh &mesh, VkCommandBuffer command_buffer, VkPipelineLayout layout,
+                                         VkShaderStageFlags stages, uint32_t offset);
+void ta_mesh_free                       (ta_mesh &mesh, ta_deletion_queue &deletion_queue, uint64_t frame);
@@ -0,0 +1,378 @@
+#include "ta_mesh_cook.hpp"
+#include "ta_log.hpp"
+#include "ta_mesh_opt.hpp"
+#include "ta_mesh_simplify.hpp"
+#include "ta_mesh_tangent.hpp"
+#include "ta_meshlet.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static void mesh_cook_name(char (&dst)[TA_MESH_NAME_LENGTH], const std::string &src)
+{
+    size_t length = std::min(src.size(), (size_t)TA_MESH_NAME_LENGTH - 1);
+    memset(dst, 0, sizeof(dst));
+    memcpy(dst, src.data(), length);
+}
+
+static void mesh_cook_face_normal(const ta_obj &obj, const ta_obj_index *corners, float normal[3])
+{
+    const float *a = &obj.positions[(size_t)corners[0].v * 3];
+    const float *b = &obj.positions[(size_t)corners[1].v * 3];
+    const float *c = &obj.positions[(size_t)corners[2].v * 3];
+    float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    normal[0] *= scale;
+    normal[1] *= scale;
+    normal[2] *= scale;
+}
+
+// Hash table slots per corner, at most half full
+#define MESH_COOK_WELD_LOAD 2
+#define MESH_COOK_WELD_EMPTY UINT32_MAX
+
+// NOTE: Not ta_hash, FNV's byte loop would be most of the weld. Murmur3's finalizer over the packed key.
+static uint32_t mesh_cook_weld_hash(const ta_obj_index &key)
+{
+    uint64_t h = ((uint64_t)(uint32_t)key.v * 0x9e3779b97f4a7c15ull) ^ ((uint64_t)(uint32_t)key.vt << 32) ^
+        (uint32_t)key.vn;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+static void mesh_cook_vertex(const ta_obj &obj, const ta_obj_index &corner, const float face_normal[3],
+    ta_mesh_vertex &vertex)
+{
+    vertex = {};
+    memcpy(vertex.position, &obj.positions[(size_t)corner.v * 3], sizeof(vertex.position));
+    if (corner.vn != TA_OBJ_NONE) {
+        memcpy(vertex.normal, &obj.normals[(size_t)corner.vn * 3], sizeof(vertex.normal));
+    } else {
+        memcpy(vertex.normal, face_normal, sizeof(vertex.normal));
+    }
+    if (corner.vt != TA_OBJ_NONE) {
+        vertex.uv[0] = obj.texcoords[(size_t)corner.vt * 2];
+        vertex.uv[1] = 1.0f - obj.texcoords[(size_t)corner.vt * 2 + 1];
+    }
+}
+
+// Welds triangle corners with the same (v, vt, vn) into one vertex, through an open addressing (linear probing)
+// table sized up front from the corner count. One pass, and the table, key and vertex arrays are the only
+// allocations, so it's linear in the corner count with nothing allocated per vertex.
+// Corners without a normal get the face normal and are never welded across faces, texcoords default to (0, 0).
+// NOTE: OBJ texcoords have v pointing up, flipped here to Vulkan's top-left origin.
+void ta_mesh_cook_from_obj(ta_mesh_data &data, const ta_obj &obj)
+{
+    data = {};
+    const size_t corner_count = obj.indices.size();
+    uint32_t capacity = 16;
+    while (capacity < corner_count * MESH_COOK_WELD_LOAD) {
+        capacity *= 2;
+    }
+    const uint32_t mask = capacity - 1;
+    std::vector<uint32_t> table(capacity, MESH_COOK_WELD_EMPTY);
+    std::vector<ta_obj_index> keys;     // per unique vertex
+    keys.reserve(corner_count);
+    data.vertices.reserve(corner_count);
+    data.indices.resize(corner_count);
+    data.corner_count = (uint32_t)corner_count;
+
+    for (size_t triangle = 0; triangle < corner_count / 3; ++triangle) {
+        const ta_obj_index *corners = &obj.indices[triangle * 3];
+        float face_normal[3] = {};
+        if (corners[0].vn == TA_OBJ_NONE || corners[1].vn == TA_OBJ_NONE || corners[2].vn == TA_OBJ_NONE) {
+            mesh_cook_face_normal(obj, corners, face_normal);
+        }
+        for (size_t i = 0; i < 3; ++i) {
+            ta_obj_index key = corners[i];
+            if (key.vn == TA_OBJ_NONE) {
+                // Face normal, only shared within this triangle
+                key.vn = -2 - (int32_t)triangle;
+            }
+            uint32_t slot = mesh_cook_weld_hash(key) & mask;
+            uint32_t vertex = table[slot];
+            while (vertex != MESH_COOK_WELD_EMPTY) {
+                const ta_obj_index &other = keys[vertex];
+                if (other.v == key.v && other.vt == key.vt && other.vn == key.vn) {
+                    break;
+                }
+                slot = (slot + 1) & mask;
+                vertex = table[slot];
+            }
+            if (vertex == MESH_COOK_WELD_EMPTY) {
+                vertex = (uint32_t)data.vertices.size();
+                table[slot] = vertex;
+                keys.push_back(key);
+                data.vertices.emplace_back();
+                mesh_cook_vertex(obj, corners[i], face_normal, data.vertices.back());
+            }
+            data.indices[triangle * 3 + i] = vertex;
+        }
+    }
+
+    // One material slot per distinct usemtl name, groups without one share the "" slot
+    for (const ta_obj_group &group : obj.groups) {
+        uint32_t material = 0;
+        while (material < data.materials.size() &&
+            strncmp(data.materials[material].name, group.material.c_str(), TA_MESH_NAME_LENGTH - 1))
+        {
+            material++;
+        }
+        if (material == data.materials.size()) {
+            ta_mesh_material slot = {};
+            mesh_cook_name(slot.name, group.material);
+            data.materials.push_back(slot);
+        }
+
+        ta_mesh_submesh submesh = {};
+        mesh_cook_name(submesh.name, group.name);
+        submesh.first_index = group.first_triangle * 3;
+        submesh.index_count = group.triangle_count * 3;
+        submesh.material = material;
+        submesh.lod_count = 1;
+        submesh.lods[0].first_index = submesh.first_index;
+        submesh.lods[0].index_count = submesh.index_count;
+        data.submeshes.push_back(submesh);
+    }
+    ta_mesh_cook_bounds(data);
+}
+
+static void mesh_cook_bounds_range(const ta_mesh_data &data, uint32_t first_index, uint32_t index_count,
+    ta_mesh_bounds &bounds)
+{
+    bounds = {};
+    if (!index_count) {
+        return;
+    }
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t i = first_index; i < first_index + index_count; ++i) {
+        const float *position = data.vertices[data.indices[i]].position;
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], position[axis]);
+            max[axis] = std::max(max[axis], position[axis]);
+        }
+    }
+    // Sphere around the box center, not minimal but never looser than the box's own
+    float radius_squared = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        bounds.min[axis] = min[axis];
+        bounds.max[axis] = max[axis];
+        bounds.center[axis] = (min[axis] + max[axis]) * 0.5f;
+    }
+    for (uint32_t i = first_index; i < first_index + index_count; ++i) {
+        const float *position = data.vertices[data.indices[i]].position;
+        float dx = position[0] - bounds.center[0];
+        float dy = position[1] - bounds.center[1];
+        float dz = position[2] - bounds.center[2];
+        radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+    }
+    bounds.radius = sqrtf(radius_squared);
+}
+
+void ta_mesh_cook_bounds(ta_mesh_data &data)
+{
+    for (ta_mesh_submesh &submesh : data.submeshes) {
+        mesh_cook_bounds_range(data, submesh.first_index, submesh.index_count, submesh.bounds);
+    }
+    mesh_cook_bounds_range(data, 0, (uint32_t)data.indices.size(), data.bounds);
+}
+
+// Must run last, the quantized copy isn't kept up to date by the other stages. Keeps full precision (and returns
+// false) if the error is over tolerance.
+bool ta_mesh_cook_quantize(ta_mesh_data &data, const ta_mesh_quant_tolerance &tolerance)
+{
+    bool ok = ta_mesh_quantize(data.vertices, data.bounds, tolerance, data.quantized, data.decode, data.quant_error);
+    if (!ok) {
+        data.quantized.clear();
+    }
+    return ok;
+}
+
+static uint64_t mesh_cook_align(uint64_t offset)
+{
+    return (offset + TA_MESH_ALIGNMENT - 1) & ~(uint64_t)(TA_MESH_ALIGNMENT - 1);
+}
+
+static void mesh_cook_pad(FILE *file, uint64_t &offset, uint64_t target)
+{
+    static const uint8_t zeros[TA_MESH_ALIGNMENT] = {};
+    assert(target >= offset && target - offset <= TA_MESH_ALIGNMENT);
+    fwrite(zeros, 1, (size_t)(target - offset), file);
+    offset = target;
+}
+
+static void mesh_cook_section(FILE *file, uint64_t &offset, const void *data, uint64_t bytes)
+{
+    if (bytes) {
+        fwrite(data, 1, (size_t)bytes, file);
+    }
+    offset += bytes;
+}
+
+// Indices are narrowed to 16 bits whenever every vertex fits, 0xffff is left alone for primitive restart. Meshlets
+// have to have been built.
+bool ta_mesh_cook_write(const ta_mesh_data &data, const char *path)
+{
+    assert(data.meshlet_triangles.size() == data.indices.size());
+    ta_mesh_header header = {};
+    header.magic = TA_MESH_MAGIC;
+    header.version = TA_MESH_VERSION;
+    header.header_size = sizeof(ta_mesh_header);
+    header.vertex_format = data.quantized.empty() ? MESH_VERTEX_FLOAT : MESH_VERTEX_QUANTIZED;
+    header.vertex_stride = ta_mesh_vertex_stride((ta_mesh_vertex_format)header.vertex_format);
+    header.vertex_count = (uint32_t)data.vertices.size();
+    header.index_size = data.vertices.size() < 0xffff ? 2 : 4;
+    header.index_count = (uint32_t)data.indices.size();
+    header.submesh_count = (uint32_t)data.submeshes.size();
+    header.material_count = (uint32_t)data.materials.size();
+    header.meshlet_count = (uint32_t)data.meshlets.size();
+    header.meshlet_vertex_count = (uint32_t)data.meshlet_vertices.size();
+    header.submesh_offset = mesh_cook_align(sizeof(ta_mesh_header));
+    header.material_offset = mesh_cook_align(header.submesh_offset + header.submesh_count * sizeof(ta_mesh_submesh));
+    header.vertex_offset = mesh_cook_align(header.material_offset +
+        header.material_count * sizeof(ta_mesh_material));
+    header.vertex_bytes = (uint64_t)header.vertex_count * header.vertex_stride;
+    header.index_offset = mesh_cook_align(header.vertex_offset + header.vertex_bytes);
+    header.index_bytes = (uint64_t)header.index_count * header.index_size;
+    header.meshlet_offset = mesh_cook_align(header.index_offset + header.index_bytes);
+    header.meshlet_vertex_offset = mesh_cook_align(header.meshlet_offset +
+        header.meshlet_count * sizeof(ta_mesh_meshlet));
+    header.meshlet_triangle_offset = mesh_cook_align(header.meshlet_vertex_offset +
+        header.meshlet_vertex_count * sizeof(uint32_t));
+    header.file_size = mesh_cook_align(header.meshlet_triangle_offset + header.index_count);
+    header.bounds = data.bounds;
+    if (data.quantized.empty()) {
+        header.decode.position_scale[0] = 1.0f;
+        header.decode.position_scale[1] = 1.0f;
+        header.decode.position_scale[2] = 1.0f;
+    } else {
+        header.decode = data.decode;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to open mesh '%s' for writing.\n", path);
+        return false;
+    }
+
+    uint64_t offset = 0;
+    mesh_cook_section(file, offset, &header, sizeof(header));
+    mesh_cook_pad(file, offset, header.submesh_offset);
+    mesh_cook_section(file, offset, data.submeshes.data(), header.submesh_count * sizeof(ta_mesh_submesh));
+    mesh_cook_pad(file, offset, header.material_offset);
+    mesh_cook_section(file, offset, data.materials.data(), header.material_count * sizeof(ta_mesh_material));
+    mesh_cook_pad(file, offset, header.vertex_offset);
+    if (data.quantized.empty()) {
+        mesh_cook_section(file, offset, data.vertices.data(), header.vertex_bytes);
+    } else {
+        mesh_cook_section(file, offset, data.quantized.data(), header.vertex_bytes);
+    }
+    mesh_cook_pad(file, offset, header.index_offset);
+    if (header.index_size == 2) {
+        std::vector<uint16_t> narrow(data.indices.begin(), data.indices.end());
+        mesh_cook_section(file, offset, narrow.data(), header.index_bytes);
+    } else {
+        mesh_cook_section(file, offset, data.indices.data(), header.index_bytes);
+    }
+    mesh_cook_pad(file, offset, header.meshlet_offset);
+    mesh_cook_section(file, offset, data.meshlets.data(), header.meshlet_count * sizeof(ta_mesh_meshlet));
+    mesh_cook_pad(file, offset, header.meshlet_vertex_offset);
+    mesh_cook_section(file, offset, data.meshlet_vertices.data(), header.meshlet_vertex_count * sizeof(uint32_t));
+    mesh_cook_pad(file, offset, header.meshlet_triangle_offset);
+    mesh_cook_section(file, offset, data.meshlet_triangles.data(), header.index_count);
+    mesh_cook_pad(file, offset, header.file_size);
+
+    bool ok = !ferror(file);
+    fclose(file);
+    if (!ok) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to write mesh '%s'.\n", path);
+    }
+    return ok;
+}
+
+// Offline: OBJ in, welded, given tangents, optimized, simplified into LODs and split into meshlets, cooked mesh out
+bool ta_mesh_cook(const char *obj_path, const char *mesh_path, const ta_mesh_cook_options &options,
+    ta_jobs *jobs)
+{
+    double start_ms = ta_timer_elapsed_ms();
+    ta_obj obj = {};
+    if (!ta_obj_load(obj, obj_path, jobs)) {
+        return false;
+    }
+
+    ta_mesh_data data = {};
+    ta_mesh_cook_from_obj(data, obj);
+    ta_mesh_tangent_stats tangents = ta_mesh_tangents(data, jobs);
+    ta_mesh_opt_stats opt = ta_mesh_optimize(data);
+    ta_mesh_simplify_stats lods = {};
+    if (options.lod_error > 0.0f) {
+        lods = ta_mesh_simplify(data, options.lod_error);
+    }
+    ta_meshlet_stats meshlets = ta_meshlet_build(data);
+    bool quantized = false;
+    if (options.vertex_format == MESH_VERTEX_QUANTIZED) {
+        quantized = ta_mesh_cook_quantize(data, options.tolerance);
+        if (!quantized) {
+            ta_log_write_level(tg_debug_log, SRC_FILE, LEVEL_WARN, "'%s' kept at full precision, quantization error "
+                "over tolerance: position %g, normal %.3f deg, tangent %.3f deg, uv %g\n", obj_path,
+                data.quant_error.position, data.quant_error.normal_degrees, data.quant_error.tangent_degrees,
+                data.quant_error.uv);
+        }
+    }
+    if (!ta_mesh_cook_write(data, mesh_path)) {
+        return false;
+    }
+
+    uint32_t vertex_count = (uint32_t)data.vertices.size();
+    uint32_t triangle_count = 0;
+    for (const ta_mesh_submesh &submesh : data.submeshes) {
+        triangle_count += submesh.index_count / 3;
+    }
+    ta_log_write(tg_debug_log, SRC_FILE, "Cooked '%s' -> '%s': %u triangles, %u submeshes, %u materials, %.2fms\n",
+        obj_path, mesh_path, triangle_count, (uint32_t)data.submeshes.size(),
+        (uint32_t)data.materials.size(), ta_timer_elapsed_ms() - start_ms);
+    uint32_t welded_count = vertex_count - tangents.split_vertices;
+    ta_log_write(tg_debug_log, SRC_FILE, "    welded %u corners into %u vertices (%.1f%% fewer), %u-bit indices\n",
+        data.corner_count, welded_count, data.corner_count ? 100.0 * (data.corner_count - welded_count) /
+        data.corner_count : 0.0, vertex_count < 0xffff ? 16 : 32);
+    ta_log_write(tg_debug_log, SRC_FILE, "    tangents in %.2fms, %u vertices split to differ in tangent, %u triangles "
+        "without UV area\n", tangents.ms, tangents.split_vertices, tangents.no_uv_area);
+    ta_log_write(tg_debug_log, SRC_FILE, "    FIFO %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %u overdraw clusters%s\n",
+        TA_MESH_OPT_CACHE_SIZE, opt.before.acmr, opt.after.acmr, opt.before.atvr, opt.after.atvr, opt.clusters,
+        opt.overdraw_skipped ? " (skipped for some submeshes)" : "");
+    ta_log_write(tg_debug_log, SRC_FILE, "    %u meshlets, %.1f triangles and %.1f vertices each, %u backface "
+        "cullable\n", meshlets.meshlets, meshlets.triangles_per_meshlet, meshlets.vertices_per_meshlet,
+        meshlets.cone_cullable);
+    if (lods.lod_count > 1) {
+        char levels[128] = {};
+        int length = 0;
+        for (uint32_t lod = 1; lod < lods.lod_count; ++lod) {
+            length += snprintf(levels + length, sizeof(levels) - length, " -> %u (%.2f%%)", lods.triangles[lod],
+                data.bounds.radius > 0.0f ? 100.0f * lods.error[lod] / data.bounds.radius : 0.0f);
+        }
+        ta_log_write(tg_debug_log, SRC_FILE, "    %u LODs, triangles %u%s, error as %% of radius\n", lods.lod_count,
+            lods.triangles[0], levels);
+    }
+    if (quantized) {
+        ta_log_write(tg_debug_log, SRC_FILE, "    quantized %u -> %u bytes per vertex (%.2fx), max error: position %g, "
+            "normal %.3f deg, tangent %.3f deg, uv %g\n", (uint32_t)sizeof(ta_mesh_vertex),
+            (uint32_t)sizeof(ta_mesh_vertex_quantized), (double)sizeof(ta_mesh_vertex) /
+            sizeof(ta_mesh_vertex_quantized), data.quant_error.position, data.quant_error.normal_degrees,
+            data.quant_error.tangent_degrees, data.quant_error.uv);
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "ta_jobs.hpp"
+#include "ta_mesh.hpp"
+#include "ta_mesh_quant.hpp"
+#include "ta_obj.hpp"
+#include <cstdint>
+#include <vector>
+
+// Cooker side mesh: full precision vertices and 32-bit indices, whatever ends up in the file is decided by
+// ta_mesh_cook_write. Submesh index ranges and bounds are kept up to date by every stage.
+typedef struct ta_mesh_data {
+    std::vector<ta_mesh_vertex>   vertices;
+    std::vector<uint32_t>         indices;
+    std::vector<ta_mesh_submesh>  submeshes;
+    std::vector<ta_mesh_material> materials;
+    ta_mesh_bounds                bounds;
+    // Built by ta_meshlet_build after the index order is final
+    std::vector<ta_mesh_meshlet>  meshlets;
+    std::vector<uint32_t>         meshlet_vertices;
+    std::vector<uint8_t>          meshlet_triangles;    // one per index, local to the index's meshlet
+    // Written instead of vertices when not empty, see ta_mesh_cook_quantize
+    std::vector<ta_mesh_vertex_quantized> quantized;
+    ta_mesh_decode                decode;
+    // Stats
+    uint32_t                      corner_count;     // triangle corners in the source, i.e. vertices before welding
+    ta_mesh_quant_error           quant_error;
+} ta_mesh_data;
+
+typedef struct ta_mesh_cook_options {
+    ta_mesh_vertex_format   vertex_format;
+    ta_mesh_quant_tolerance tolerance;      // MESH_VERTEX_QUANTIZED falls back to MESH_VERTEX_FLOAT past this
+    float                   lod_error;      // coarsest LOD's error as a fraction of the bounding radius, 0 for none
+} ta_mesh_cook_options;
+
+void ta_mesh_cook_from_obj              (ta_mesh_data &data, const ta_obj &obj);
+void ta_mesh_cook_bounds                (ta_mesh_data &data);
+bool ta_mesh_cook_quantize              (ta_mesh_data &data, const ta_mesh_quant_tolerance &tolerance);
+bool ta_mesh_cook_write                 (const ta_mesh_data &data, const char *path);
+bool ta_mesh_cook                       (const char *obj_path, const char *mesh_path,
+                                         const ta_mesh_cook_options &options, ta_jobs *jobs);
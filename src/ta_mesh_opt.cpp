@@ -0,0 +1,379 @@
+#include "ta_mesh_opt.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// Forsyth's "Linear-Speed Vertex Cache Optimisation" with his constants. It scores against an LRU cache of this
+// size, which orders well for any FIFO up to about that size too.
+#define OPT_FORSYTH_CACHE_SIZE      32
+#define OPT_FORSYTH_DECAY_POWER     1.5f
+#define OPT_FORSYTH_LAST_TRIANGLE   0.75f
+#define OPT_FORSYTH_VALENCE_SCALE   2.0f
+#define OPT_FORSYTH_VALENCE_POWER   0.5f
+// Valence scores past this are all but identical, they're clamped so the table stays small
+#define OPT_FORSYTH_MAX_VALENCE     32
+#define OPT_NONE                    UINT32_MAX
+
+typedef struct opt_forsyth_tables {
+    float cache[OPT_FORSYTH_CACHE_SIZE];
+    float valence[OPT_FORSYTH_MAX_VALENCE + 1];
+} opt_forsyth_tables;
+
+static opt_forsyth_tables opt_forsyth_tables_make()
+{
+    opt_forsyth_tables tables = {};
+    for (uint32_t i = 0; i < OPT_FORSYTH_CACHE_SIZE; ++i) {
+        if (i < 3) {
+            // The last triangle's vertices get a fixed score, so it doesn't matter in which order they were added
+            tables.cache[i] = OPT_FORSYTH_LAST_TRIANGLE;
+        } else {
+            float scale = 1.0f / (OPT_FORSYTH_CACHE_SIZE - 3);
+            tables.cache[i] = powf(1.0f - (i - 3) * scale, OPT_FORSYTH_DECAY_POWER);
+        }
+    }
+    for (uint32_t i = 1; i <= OPT_FORSYTH_MAX_VALENCE; ++i) {
+        tables.valence[i] = OPT_FORSYTH_VALENCE_SCALE * powf((float)i, -OPT_FORSYTH_VALENCE_POWER);
+    }
+    return tables;
+}
+
+static float opt_forsyth_score(const opt_forsyth_tables &tables, uint32_t cache_position, uint32_t remaining)
+{
+    if (!remaining) {
+        return -1.0f;
+    }
+    float score = tables.valence[std::min(remaining, (uint32_t)OPT_FORSYTH_MAX_VALENCE)];
+    if (cache_position < OPT_FORSYTH_CACHE_SIZE) {
+        score += tables.cache[cache_position];
+    }
+    return score;
+}
+
+// Greedy: always emit the best scoring triangle among those touching the simulated cache, which is linear because
+// only the cached vertices' triangles are ever rescored. When nothing in the cache has triangles left, it continues
+// from the first triangle that hasn't been emitted yet.
+void ta_mesh_opt_vertex_cache(uint32_t *indices, size_t index_count, uint32_t vertex_count)
+{
+    const uint32_t triangle_count = (uint32_t)(index_count / 3);
+    if (triangle_count < 2) {
+        return;
+    }
+    static const opt_forsyth_tables tables = opt_forsyth_tables_make();
+
+    // Triangles using each vertex, live ones are adjacency[offsets[v], offsets[v] + remaining[v])
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (size_t i = 0; i < index_count; ++i) {
+        remaining[indices[i]]++;
+    }
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+        remaining[v] = 0;
+    }
+    std::vector<uint32_t> adjacency(index_count);
+    for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+        for (uint32_t i = 0; i < 3; ++i) {
+            uint32_t v = indices[triangle * 3 + i];
+            adjacency[offsets[v] + remaining[v]++] = triangle;
+        }
+    }
+
+    std::vector<uint32_t> cache_position(vertex_count, OPT_NONE);
+    std::vector<float> vertex_score(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        vertex_score[v] = opt_forsyth_score(tables, OPT_NONE, remaining[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+        const uint32_t *corners = &indices[triangle * 3];
+        triangle_score[triangle] = vertex_score[corners[0]] + vertex_score[corners[1]] + vertex_score[corners[2]];
+    }
+
+    std::vector<uint32_t> output(index_count);
+    uint32_t cache[OPT_FORSYTH_CACHE_SIZE + 3] = {};
+    uint32_t cache_count = 0;
+    uint32_t cursor = 0;
+    uint32_t best = OPT_NONE;
+    for (uint32_t emit = 0; emit < triangle_count; ++emit) {
+        if (best == OPT_NONE) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const uint32_t corners[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+        memcpy(&output[emit * 3], corners, sizeof(corners));
+        emitted[best] = 1;
+        for (uint32_t v : corners) {
+            uint32_t *live = &adjacency[offsets[v]];
+            uint32_t *last = live + remaining[v] - 1;
+            *std::find(live, last, best) = *last;
+            remaining[v]--;
+        }
+
+        // Emitted vertices move to the front, everything else shifts back and may fall out
+        uint32_t next_cache[OPT_FORSYTH_CACHE_SIZE + 3];
+        uint32_t next_count = 0;
+        for (uint32_t v : corners) {
+            next_cache[next_count++] = v;
+        }
+        for (uint32_t i = 0; i < cache_count; ++i) {
+            uint32_t v = cache[i];
+            if (v != corners[0] && v != corners[1] && v != corners[2]) {
+                next_cache[next_count++] = v;
+            }
+        }
+        for (uint32_t i = 0; i < next_count; ++i) {
+            uint32_t v = next_cache[i];
+            cache_position[v] = i < OPT_FORSYTH_CACHE_SIZE ? i : OPT_NONE;
+            vertex_score[v] = opt_forsyth_score(tables, cache_position[v], remaining[v]);
+        }
+
+        best = OPT_NONE;
+        float best_score = -1.0f;
+        for (uint32_t i = 0; i < next_count; ++i) {
+            uint32_t v = next_cache[i];
+            for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; ++j) {
+                uint32_t triangle = adjacency[j];
+                const uint32_t *tri = &indices[triangle * 3];
+                float score = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+                triangle_score[triangle] = score;
+                if (score > best_score) {
+                    best_score = score;
+                    best = triangle;
+                }
+            }
+        }
+
+        cache_count = std::min(next_count, (uint32_t)OPT_FORSYTH_CACHE_SIZE);
+        memcpy(cache, next_cache, cache_count * sizeof(*cache));
+    }
+    memcpy(indices, output.data(), index_count * sizeof(*indices));
+}
+
+// FIFO cache simulated with timestamps: a vertex is cached if it missed within the last cache_size misses
+typedef struct opt_fifo {
+    std::vector<uint32_t> stamp;
+    uint32_t              time;
+    uint32_t              size;
+} opt_fifo;
+
+static void opt_fifo_init(opt_fifo &fifo, uint32_t vertex_count, uint32_t cache_size)
+{
+    fifo.stamp.assign(vertex_count, 0);
+    fifo.size = cache_size;
+    fifo.time = cache_size + 1;
+}
+
+static void opt_fifo_flush(opt_fifo &fifo)
+{
+    fifo.time += fifo.size + 1;
+}
+
+static uint32_t opt_fifo_triangle(opt_fifo &fifo, const uint32_t *corners)
+{
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < 3; ++i) {
+        if (fifo.time - fifo.stamp[corners[i]] > fifo.size) {
+            fifo.stamp[corners[i]] = fifo.time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+ta_mesh_cache_stats ta_mesh_opt_cache_stats(const uint32_t *indices, size_t index_count, uint32_t vertex_count,
+    uint32_t cache_size)
+{
+    ta_mesh_cache_stats stats = {};
+    if (index_count < 3) {
+        return stats;
+    }
+    opt_fifo fifo = {};
+    opt_fifo_init(fifo, vertex_count, cache_size);
+    uint32_t misses = 0;
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        misses += opt_fifo_triangle(fifo, &indices[i]);
+    }
+    uint32_t referenced = 0;
+    for (uint32_t stamp : fifo.stamp) {
+        referenced += stamp != 0;
+    }
+    stats.acmr = (float)misses / (float)(index_count / 3);
+    stats.atvr = (float)misses / (float)referenced;
+    return stats;
+}
+
+typedef struct opt_cluster {
+    uint32_t first_triangle;
+    uint32_t triangle_count;
+    float    sort_key;
+} opt_cluster;
+
+// Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw". Takes a cache optimized order,
+// cuts it into clusters and sorts them so outward facing clusters far from the center (which tend to occlude the
+// rest) are drawn first. Clusters are cut where the cache starts cold anyway (all three vertices miss), then again
+// wherever a cluster's own ACMR is already within TA_MESH_OPT_OVERDRAW_SLACK of its whole run, so reordering the
+// clusters costs a bounded amount of cache efficiency. Returns the cluster count.
+uint32_t ta_mesh_opt_overdraw(uint32_t *indices, size_t index_count, const ta_mesh_vertex *vertices,
+    uint32_t vertex_count)
+{
+    const uint32_t triangle_count = (uint32_t)(index_count / 3);
+    if (triangle_count < 2) {
+        return triangle_count;
+    }
+
+    opt_fifo fifo = {};
+    opt_fifo_init(fifo, vertex_count, TA_MESH_OPT_CACHE_SIZE);
+    std::vector<uint32_t> hard;
+    for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+        if (opt_fifo_triangle(fifo, &indices[triangle * 3]) == 3) {
+            hard.push_back(triangle);
+        }
+    }
+    hard.push_back(triangle_count);
+
+    std::vector<opt_cluster> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        const uint32_t begin = hard[h];
+        const uint32_t end = hard[h + 1];
+        opt_fifo_flush(fifo);
+        uint32_t misses = 0;
+        for (uint32_t triangle = begin; triangle < end; ++triangle) {
+            misses += opt_fifo_triangle(fifo, &indices[triangle * 3]);
+        }
+        const float threshold = (float)misses / (float)(end - begin) * TA_MESH_OPT_OVERDRAW_SLACK;
+
+        opt_fifo_flush(fifo);
+        opt_cluster cluster = { begin, 0, 0.0f };
+        misses = 0;
+        for (uint32_t triangle = begin; triangle < end; ++triangle) {
+            misses += opt_fifo_triangle(fifo, &indices[triangle * 3]);
+            cluster.triangle_count++;
+            if (triangle + 1 < end && (float)misses <= threshold * cluster.triangle_count) {
+                clusters.push_back(cluster);
+                cluster = { triangle + 1, 0, 0.0f };
+                misses = 0;
+                opt_fifo_flush(fifo);
+            }
+        }
+        clusters.push_back(cluster);
+    }
+
+    // Area weighted centroids and normals
+    float mesh_centroid[3] = {};
+    float mesh_area = 0.0f;
+    std::vector<float> cluster_data(clusters.size() * 7, 0.0f);   // centroid * area, normal * 2 area, area
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        float *data = &cluster_data[c * 7];
+        const opt_cluster &cluster = clusters[c];
+        for (uint32_t triangle = cluster.first_triangle; triangle < cluster.first_triangle + cluster.triangle_count;
+            ++triangle)
+        {
+            const float *a = vertices[indices[triangle * 3]].position;
+            const float *b = vertices[indices[triangle * 3 + 1]].position;
+            const float *c3 = vertices[indices[triangle * 3 + 2]].position;
+            float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float ac[3] = { c3[0] - a[0], c3[1] - a[1], c3[2] - a[2] };
+            float normal[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2],
+                ab[0] * ac[1] - ab[1] * ac[0] };
+            float area = 0.5f * sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int axis = 0; axis < 3; ++axis) {
+                data[axis] += (a[axis] + b[axis] + c3[axis]) * (1.0f / 3.0f) * area;
+                data[3 + axis] += normal[axis];
+            }
+            data[6] += area;
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            mesh_centroid[axis] += data[axis];
+        }
+        mesh_area += data[6];
+    }
+    if (mesh_area <= 0.0f) {
+        return (uint32_t)clusters.size();
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        mesh_centroid[axis] /= mesh_area;
+    }
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        const float *data = &cluster_data[c * 7];
+        if (data[6] <= 0.0f) {
+            continue;
+        }
+        float length = sqrtf(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+        float dot = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            dot += (data[axis] / data[6] - mesh_centroid[axis]) * data[3 + axis];
+        }
+        clusters[c].sort_key = length > 0.0f ? dot / length : 0.0f;
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const opt_cluster &a, const opt_cluster &b) {
+        return a.sort_key > b.sort_key;
+    });
+    std::vector<uint32_t> sorted;
+    sorted.reserve(index_count);
+    for (const opt_cluster &cluster : clusters) {
+        const uint32_t *first = &indices[cluster.first_triangle * 3];
+        sorted.insert(sorted.end(), first, first + cluster.triangle_count * 3);
+    }
+    memcpy(indices, sorted.data(), index_count * sizeof(*indices));
+    return (uint32_t)clusters.size();
+}
+
+// Renumbers vertices in order of first use so fetches walk the vertex buffer forward, and drops unreferenced ones
+void ta_mesh_opt_vertex_fetch(ta_mesh_data &data)
+{
+    std::vector<uint32_t> remap(data.vertices.size(), OPT_NONE);
+    uint32_t next = 0;
+    for (uint32_t &index : data.indices) {
+        if (remap[index] == OPT_NONE) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    std::vector<ta_mesh_vertex> vertices(next);
+    for (size_t v = 0; v < data.vertices.size(); ++v) {
+        if (remap[v] != OPT_NONE) {
+            vertices[remap[v]] = data.vertices[v];
+        }
+    }
+    data.vertices.swap(vertices);
+}
+
+// Vertex cache then overdraw order within each submesh (ranges and materials stay put), then vertex fetch order
+// over the whole buffer
+ta_mesh_opt_stats ta_mesh_optimize(ta_mesh_data &data)
+{
+    ta_mesh_opt_stats stats = {};
+    const uint32_t vertex_count = (uint32_t)data.vertices.size();
+    stats.before = ta_mesh_opt_cache_stats(data.indices.data(), data.indices.size(), vertex_count,
+        TA_MESH_OPT_CACHE_SIZE);
+
+    std::vector<uint32_t> cache_order;
+    for (const ta_mesh_submesh &submesh : data.submeshes) {
+        uint32_t *indices = &data.indices[submesh.first_index];
+        ta_mesh_opt_vertex_cache(indices, submesh.index_count, vertex_count);
+        cache_order.assign(indices, indices + submesh.index_count);
+        float cache_acmr = ta_mesh_opt_cache_stats(indices, submesh.index_count, vertex_count,
+            TA_MESH_OPT_CACHE_SIZE).acmr;
+
+        uint32_t clusters = ta_mesh_opt_overdraw(indices, submesh.index_count, data.vertices.data(), vertex_count);
+        float overdraw_acmr = ta_mesh_opt_cache_stats(indices, submesh.index_count, vertex_count,
+            TA_MESH_OPT_CACHE_SIZE).acmr;
+        if (overdraw_acmr > cache_acmr * TA_MESH_OPT_OVERDRAW_SLACK) {
+            memcpy(indices, cache_order.data(), submesh.index_count * sizeof(*indices));
+            stats.overdraw_skipped++;
+        } else {
+            stats.clusters += clusters;
+        }
+    }
+
+    ta_mesh_opt_vertex_fetch(data);
+    stats.after = ta_mesh_opt_cache_stats(data.indices.data(), data.indices.size(), (uint32_t)data.vertices.size(),
+        TA_MESH_OPT_CACHE_SIZE);
+    return stats;
+}
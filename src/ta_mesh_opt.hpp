@@ -0,0 +1,29 @@
+#pragma once
+#include "ta_mesh_cook.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Post-transform cache the stats are measured against. FIFO, which is what most hardware actually has.
+#define TA_MESH_OPT_CACHE_SIZE      16
+// Overdraw ordering is dropped for a submesh if it would make the ACMR worse than this times the cache ordered one
+#define TA_MESH_OPT_OVERDRAW_SLACK  1.05f
+
+typedef struct ta_mesh_cache_stats {
+    float acmr;         // average cache miss ratio, transformed vertices per triangle (0.5 is ideal, 3 is worst)
+    float atvr;         // average transform to vertex ratio, transformed vertices per vertex (1 is ideal)
+} ta_mesh_cache_stats;
+
+typedef struct ta_mesh_opt_stats {
+    ta_mesh_cache_stats before;
+    ta_mesh_cache_stats after;
+    uint32_t            clusters;           // overdraw clusters sorted, over all submeshes
+    uint32_t            overdraw_skipped;   // submeshes where the overdraw order cost too much cache
+} ta_mesh_opt_stats;
+
+ta_mesh_cache_stats ta_mesh_opt_cache_stats (const uint32_t *indices, size_t index_count, uint32_t vertex_count,
+                                             uint32_t cache_size);
+void ta_mesh_opt_vertex_cache               (uint32_t *indices, size_t index_count, uint32_t vertex_count);
+uint32_t ta_mesh_opt_overdraw               (uint32_t *indices, size_t index_count, const ta_mesh_vertex *vertices,
+                                             uint32_t vertex_count);
+void ta_mesh_opt_vertex_fetch               (ta_mesh_data &data);
+ta_mesh_opt_stats ta_mesh_optimize          (ta_mesh_data &data);
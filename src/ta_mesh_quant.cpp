@@ -0,0 +1,215 @@
+#include "ta_mesh_quant.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define QUANT_RADIANS_TO_DEGREES 57.29577951f
+
+// float -> IEEE half with round to nearest even. Done by hand rather than F16C so the cooker doesn't depend on it.
+uint16_t ta_mesh_quant_half(float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent == 0xff) {
+        // Inf stays inf, NaN stays (quiet) NaN
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    int32_t half_exponent = (int32_t)exponent - 127 + 15;
+    if (half_exponent >= 31) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (half_exponent <= 0) {
+        // Denormal (or zero), the implicit bit becomes explicit and the rest is shifted out
+        if (half_exponent < -10) {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - half_exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    // Rounding up may carry into the exponent, which is the right answer (up to and including inf)
+    uint32_t half = ((uint32_t)half_exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (uint16_t)(sign | half);
+}
+
+float ta_mesh_quant_half_decode(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    if (!exponent) {
+        float value = ldexpf((float)mantissa, -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits = sign | (mantissa << 13);
+    if (exponent == 31) {
+        bits |= 0x7f800000;
+    } else {
+        bits |= (exponent + 112) << 23;
+    }
+    float value = 0.0f;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static float quant_sign(float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Same as the GPU's SNORM conversion
+void ta_mesh_quant_octahedral_decode(const int16_t encoded[2], float vector[3])
+{
+    float x = std::max((float)encoded[0] / 32767.0f, -1.0f);
+    float y = std::max((float)encoded[1] / 32767.0f, -1.0f);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = sqrtf(x * x + y * y + z * z);
+    vector[0] = x / length;
+    vector[1] = y / length;
+    vector[2] = z / length;
+}
+
+// Octahedral unit vector, 2x SNORM16. Of the four codes around the projected point, keeps the one that decodes
+// closest to the input, which roughly halves the worst case error of plain rounding. A zero vector encodes as +Z.
+void ta_mesh_quant_octahedral(const float vector[3], int16_t encoded[2])
+{
+    float l1 = fabsf(vector[0]) + fabsf(vector[1]) + fabsf(vector[2]);
+    encoded[0] = 0;
+    encoded[1] = 0;
+    if (l1 <= 0.0f) {
+        return;
+    }
+    float x = vector[0] / l1;
+    float y = vector[1] / l1;
+    if (vector[2] < 0.0f) {
+        float folded_x = (1.0f - fabsf(y)) * quant_sign(x);
+        y = (1.0f - fabsf(x)) * quant_sign(y);
+        x = folded_x;
+    }
+
+    float length = sqrtf(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+    float base_x = floorf(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f);
+    float base_y = floorf(std::min(std::max(y, -1.0f), 1.0f) * 32767.0f);
+    float best_dot = -2.0f;
+    for (int i = 0; i < 4; ++i) {
+        int16_t candidate[2] = {
+            (int16_t)std::min(std::max(base_x + (i & 1), -32767.0f), 32767.0f),
+            (int16_t)std::min(std::max(base_y + (i >> 1), -32767.0f), 32767.0f),
+        };
+        float decoded[3];
+        ta_mesh_quant_octahedral_decode(candidate, decoded);
+        float dot = (decoded[0] * vector[0] + decoded[1] * vector[1] + decoded[2] * vector[2]) / length;
+        if (dot > best_dot) {
+            best_dot = dot;
+            encoded[0] = candidate[0];
+            encoded[1] = candidate[1];
+        }
+    }
+}
+
+// Positions are stored as UNORM16 fractions of the AABB
+ta_mesh_decode ta_mesh_quant_decode(const ta_mesh_bounds &bounds)
+{
+    ta_mesh_decode decode = {};
+    for (int axis = 0; axis < 3; ++axis) {
+        decode.position_scale[axis] = bounds.max[axis] - bounds.min[axis];
+        decode.position_offset[axis] = bounds.min[axis];
+    }
+    return decode;
+}
+
+void ta_mesh_quant_vertex(const ta_mesh_vertex &vertex, const ta_mesh_decode &decode,
+    ta_mesh_vertex_quantized &quantized)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        float scale = decode.position_scale[axis];
+        float unorm = scale > 0.0f ? (vertex.position[axis] - decode.position_offset[axis]) / scale : 0.0f;
+        unorm = std::min(std::max(unorm, 0.0f), 1.0f);
+        quantized.position[axis] = (uint16_t)(unorm * 65535.0f + 0.5f);
+    }
+    quantized.position[3] = vertex.tangent[3] < 0.0f ? 0 : 65535;
+    ta_mesh_quant_octahedral(vertex.normal, quantized.normal);
+    ta_mesh_quant_octahedral(vertex.tangent, quantized.tangent);
+    quantized.uv[0] = ta_mesh_quant_half(vertex.uv[0]);
+    quantized.uv[1] = ta_mesh_quant_half(vertex.uv[1]);
+}
+
+// What the vertex shader sees, back on the CPU
+void ta_mesh_quant_vertex_decode(const ta_mesh_vertex_quantized &quantized, const ta_mesh_decode &decode,
+    ta_mesh_vertex &vertex)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        vertex.position[axis] = decode.position_offset[axis] +
+            (float)quantized.position[axis] / 65535.0f * decode.position_scale[axis];
+    }
+    ta_mesh_quant_octahedral_decode(quantized.normal, vertex.normal);
+    ta_mesh_quant_octahedral_decode(quantized.tangent, vertex.tangent);
+    vertex.tangent[3] = (float)quantized.position[3] / 65535.0f * 2.0f - 1.0f;
+    vertex.uv[0] = ta_mesh_quant_half_decode(quantized.uv[0]);
+    vertex.uv[1] = ta_mesh_quant_half_decode(quantized.uv[1]);
+}
+
+// atan2 of cross and dot rather than acos, which has no precision left at the small angles we're measuring
+static float quant_angle_degrees(const float a[3], const float b[3])
+{
+    double cross[3] = {
+        (double)a[1] * b[2] - (double)a[2] * b[1],
+        (double)a[2] * b[0] - (double)a[0] * b[2],
+        (double)a[0] * b[1] - (double)a[1] * b[0],
+    };
+    double dot = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+    double sine = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+    if (sine == 0.0 && dot == 0.0) {
+        return 0.0f;
+    }
+    return (float)(atan2(sine, dot) * QUANT_RADIANS_TO_DEGREES);
+}
+
+// Quantizes every vertex and decodes it again to measure the worst case error of each attribute. False if any of
+// them is over tolerance. Tangents that haven't been generated (zero) aren't measured.
+bool ta_mesh_quantize(const std::vector<ta_mesh_vertex> &vertices, const ta_mesh_bounds &bounds,
+    const ta_mesh_quant_tolerance &tolerance, std::vector<ta_mesh_vertex_quantized> &quantized,
+    ta_mesh_decode &decode, ta_mesh_quant_error &error)
+{
+    decode = ta_mesh_quant_decode(bounds);
+    quantized.resize(vertices.size());
+    error = {};
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const ta_mesh_vertex &vertex = vertices[i];
+        ta_mesh_quant_vertex(vertex, decode, quantized[i]);
+        ta_mesh_vertex decoded = {};
+        ta_mesh_quant_vertex_decode(quantized[i], decode, decoded);
+
+        float dx = decoded.position[0] - vertex.position[0];
+        float dy = decoded.position[1] - vertex.position[1];
+        float dz = decoded.position[2] - vertex.position[2];
+        error.position = std::max(error.position, sqrtf(dx * dx + dy * dy + dz * dz));
+        error.normal_degrees = std::max(error.normal_degrees, quant_angle_degrees(vertex.normal, decoded.normal));
+        if (vertex.tangent[0] != 0.0f || vertex.tangent[1] != 0.0f || vertex.tangent[2] != 0.0f) {
+            error.tangent_degrees = std::max(error.tangent_degrees,
+                quant_angle_degrees(vertex.tangent, decoded.tangent));
+        }
+        error.uv = std::max(error.uv, std::max(fabsf(decoded.uv[0] - vertex.uv[0]),
+            fabsf(decoded.uv[1] - vertex.uv[1])));
+    }
+    return error.position <= tolerance.position && error.normal_degrees <= tolerance.normal_degrees &&
+        error.tangent_degrees <= tolerance.normal_degrees && error.uv <= tolerance.uv;
+}
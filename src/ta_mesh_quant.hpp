@@ -0,0 +1,36 @@
+#pragma once
+#include "ta_mesh.hpp"
+#include <cstdint>
+#include <vector>
+
+// Default worst case error allowed per attribute before the cooker keeps a mesh at full precision
+#define TA_MESH_QUANT_POSITION_TOLERANCE    0.001f              // mesh units
+#define TA_MESH_QUANT_NORMAL_TOLERANCE      0.1f                // degrees, normals and tangents
+#define TA_MESH_QUANT_UV_TOLERANCE          (1.0f / 2048.0f)    // half a texel at 1024
+
+typedef struct ta_mesh_quant_tolerance {
+    float position;
+    float normal_degrees;
+    float uv;
+} ta_mesh_quant_tolerance;
+
+typedef struct ta_mesh_quant_error {
+    float position;
+    float normal_degrees;
+    float tangent_degrees;
+    float uv;
+} ta_mesh_quant_error;
+
+uint16_t ta_mesh_quant_half             (float value);
+float ta_mesh_quant_half_decode         (uint16_t half);
+void ta_mesh_quant_octahedral           (const float vector[3], int16_t encoded[2]);
+void ta_mesh_quant_octahedral_decode    (const int16_t encoded[2], float vector[3]);
+ta_mesh_decode ta_mesh_quant_decode     (const ta_mesh_bounds &bounds);
+void ta_mesh_quant_vertex               (const ta_mesh_vertex &vertex, const ta_mesh_decode &decode,
+                                         ta_mesh_vertex_quantized &quantized);
+void ta_mesh_quant_vertex_decode        (const ta_mesh_vertex_quantized &quantized, const ta_mesh_decode &decode,
+                                         ta_mesh_vertex &vertex);
+bool ta_mesh_quantize                   (const std::vector<ta_mesh_vertex> &vertices, const ta_mesh_bounds &bounds,
+                                         const ta_mesh_quant_tolerance &tolerance,
+                                         std::vector<ta_mesh_vertex_quantized> &quantized, ta_mesh_decode &decode,
+                                         ta_mesh_quant_error &error);
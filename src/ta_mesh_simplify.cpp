@@ -0,0 +1,442 @@
+#include "ta_mesh_simplify.hpp"
+#include "ta_mesh_opt.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#define SIMPLIFY_NONE UINT32_MAX
+// Open borders are held in place by a plane through each border edge, perpendicular to its triangle, weighted this
+// much more than an ordinary triangle plane
+#define SIMPLIFY_BORDER_WEIGHT 10.0
+// A collapse that turns any remaining triangle's normal further than acos(this) is rejected, which also catches flips
+#define SIMPLIFY_FLIP_DOT 0.25
+
+// Symmetric 4x4 error quadric (Garland-Heckbert), v'Qv is the sum of squared distances from v to a set of planes
+typedef struct simplify_quadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+} simplify_quadric;
+
+// Collapse of one position into a neighbouring one. Costs go stale as the mesh changes, the versions tell.
+typedef struct simplify_collapse {
+    double   cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_version;
+    uint32_t to_version;
+} simplify_collapse;
+
+// Works on positions rather than vertices: every vertex at one position (a wedge, they differ in normal or uv) is
+// represented by the first of them, and collapses move whole positions. Triangles keep pointing at actual vertices,
+// a corner that moves picks the wedge at its new position closest to its old attributes.
+typedef struct simplify_context {
+    const ta_mesh_vertex               *vertices;
+    const uint8_t                      *locked;
+    std::vector<uint32_t>              position;            // vertex -> representative, SIMPLIFY_NONE if unused
+    std::vector<std::vector<uint32_t>> wedges;              // representative -> vertices at its position
+    std::vector<simplify_quadric>      quadrics;            // per representative
+    std::vector<std::vector<uint32_t>> vertex_triangles;    // per representative, may include dead triangles
+    std::vector<uint32_t>              version;
+    std::vector<uint8_t>               removed;
+    std::vector<uint32_t>              triangles;
+    std::vector<uint8_t>               triangle_dead;
+    uint32_t                           live_triangles;
+    std::vector<simplify_collapse>     heap;
+} simplify_context;
+
+static void simplify_quadric_add_plane(simplify_quadric &q, double a, double b, double c, double d, double weight)
+{
+    q.a2 += weight * a * a;
+    q.ab += weight * a * b;
+    q.ac += weight * a * c;
+    q.ad += weight * a * d;
+    q.b2 += weight * b * b;
+    q.bc += weight * b * c;
+    q.bd += weight * b * d;
+    q.c2 += weight * c * c;
+    q.cd += weight * c * d;
+    q.d2 += weight * d * d;
+}
+
+static void simplify_quadric_add(simplify_quadric &q, const simplify_quadric &r)
+{
+    q.a2 += r.a2;
+    q.ab += r.ab;
+    q.ac += r.ac;
+    q.ad += r.ad;
+    q.b2 += r.b2;
+    q.bc += r.bc;
+    q.bd += r.bd;
+    q.c2 += r.c2;
+    q.cd += r.cd;
+    q.d2 += r.d2;
+}
+
+static double simplify_quadric_error(const simplify_quadric &q, const float p[3])
+{
+    double x = p[0];
+    double y = p[1];
+    double z = p[2];
+    double error = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x +
+        q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y +
+        q.c2 * z * z + 2.0 * q.cd * z + q.d2;
+    return std::max(error, 0.0);
+}
+
+static void simplify_cross(const float *a, const float *b, const float *c, double normal[3])
+{
+    double ab[3] = { (double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2] };
+    double ac[3] = { (double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2] };
+    normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+// Groups the given vertices by position, position[v] = first vertex (in `used` order after sorting) at v's position
+static void simplify_positions(const ta_mesh_vertex *vertices, std::vector<uint32_t> &used,
+    std::vector<uint32_t> &position)
+{
+    std::sort(used.begin(), used.end(), [vertices](uint32_t a, uint32_t b) {
+        const float *pa = vertices[a].position;
+        const float *pb = vertices[b].position;
+        if (pa[0] != pb[0]) return pa[0] < pb[0];
+        if (pa[1] != pb[1]) return pa[1] < pb[1];
+        if (pa[2] != pb[2]) return pa[2] < pb[2];
+        return a < b;
+    });
+    for (size_t i = 0; i < used.size(); ++i) {
+        bool same = i && !memcmp(vertices[used[i]].position, vertices[used[i - 1]].position,
+            sizeof(vertices[0].position));
+        position[used[i]] = same ? position[used[i - 1]] : used[i];
+    }
+}
+
+static void simplify_push(simplify_context &ctx, uint32_t from, uint32_t to)
+{
+    if (ctx.locked && ctx.locked[from]) {
+        return;
+    }
+    simplify_quadric quadric = ctx.quadrics[from];
+    simplify_quadric_add(quadric, ctx.quadrics[to]);
+    simplify_collapse collapse = {};
+    collapse.cost = simplify_quadric_error(quadric, ctx.vertices[to].position);
+    collapse.from = from;
+    collapse.to = to;
+    collapse.from_version = ctx.version[from];
+    collapse.to_version = ctx.version[to];
+    ctx.heap.push_back(collapse);
+    std::push_heap(ctx.heap.begin(), ctx.heap.end(), [](const simplify_collapse &a, const simplify_collapse &b) {
+        return a.cost > b.cost;
+    });
+}
+
+// False if moving `from` onto `to` would fold over or squash any triangle that survives the collapse
+static bool simplify_collapse_valid(const simplify_context &ctx, uint32_t from, uint32_t to)
+{
+    const float *target = ctx.vertices[to].position;
+    for (uint32_t t : ctx.vertex_triangles[from]) {
+        if (ctx.triangle_dead[t]) {
+            continue;
+        }
+        const uint32_t *corners = &ctx.triangles[t * 3];
+        const float *before[3];
+        const float *after[3];
+        bool dies = false;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t position = ctx.position[corners[k]];
+            dies |= position == to;
+            before[k] = ctx.vertices[position].position;
+            after[k] = position == from ? target : before[k];
+        }
+        if (dies) {
+            continue;
+        }
+        double n0[3];
+        double n1[3];
+        simplify_cross(before[0], before[1], before[2], n0);
+        simplify_cross(after[0], after[1], after[2], n1);
+        double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        double lengths = sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]) *
+            sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+        if (dot <= SIMPLIFY_FLIP_DOT * lengths) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The wedge at `to` a corner that was `vertex` should become: closest normal, then closest uv
+static uint32_t simplify_wedge(const simplify_context &ctx, uint32_t to, uint32_t vertex)
+{
+    const ta_mesh_vertex &source = ctx.vertices[vertex];
+    uint32_t best = to;
+    float best_score = -FLT_MAX;
+    for (uint32_t wedge : ctx.wedges[to]) {
+        const ta_mesh_vertex &candidate = ctx.vertices[wedge];
+        float score = source.normal[0] * candidate.normal[0] + source.normal[1] * candidate.normal[1] +
+            source.normal[2] * candidate.normal[2] - fabsf(source.uv[0] - candidate.uv[0]) -
+            fabsf(source.uv[1] - candidate.uv[1]);
+        if (score > best_score) {
+            best_score = score;
+            best = wedge;
+        }
+    }
+    return best;
+}
+
+static void simplify_collapse_apply(simplify_context &ctx, uint32_t from, uint32_t to)
+{
+    for (uint32_t t : ctx.vertex_triangles[from]) {
+        if (ctx.triangle_dead[t]) {
+            continue;
+        }
+        uint32_t *corners = &ctx.triangles[t * 3];
+        if (ctx.position[corners[0]] == to || ctx.position[corners[1]] == to || ctx.position[corners[2]] == to) {
+            ctx.triangle_dead[t] = 1;
+            ctx.live_triangles--;
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            if (ctx.position[corners[k]] == from) {
+                corners[k] = simplify_wedge(ctx, to, corners[k]);
+            }
+        }
+        ctx.vertex_triangles[to].push_back(t);
+    }
+    std::vector<uint32_t>().swap(ctx.vertex_triangles[from]);
+    ctx.removed[from] = 1;
+    simplify_quadric_add(ctx.quadrics[to], ctx.quadrics[from]);
+    ctx.version[to]++;
+
+    // Every collapse into or out of `to` now has a different cost
+    std::vector<uint32_t> &around = ctx.vertex_triangles[to];
+    around.erase(std::remove_if(around.begin(), around.end(), [&ctx](uint32_t t) {
+        return ctx.triangle_dead[t] != 0;
+    }), around.end());
+    for (uint32_t t : around) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t neighbour = ctx.position[ctx.triangles[t * 3 + k]];
+            if (neighbour != to) {
+                simplify_push(ctx, to, neighbour);
+                simplify_push(ctx, neighbour, to);
+            }
+        }
+    }
+}
+
+static void simplify_emit(const simplify_context &ctx, std::vector<uint32_t> &indices)
+{
+    indices.clear();
+    indices.reserve(ctx.live_triangles * 3);
+    for (size_t t = 0; t < ctx.triangle_dead.size(); ++t) {
+        if (!ctx.triangle_dead[t]) {
+            indices.insert(indices.end(), &ctx.triangles[t * 3], &ctx.triangles[t * 3 + 3]);
+        }
+    }
+}
+
+// Edge collapse simplification with quadric error metrics, one run producing a chain of levels: a level is taken
+// every time the triangle count halves, until max_lods or until the cheapest remaining collapse would move the
+// surface by more than target_error (mesh units). Collapses only ever move a position onto a neighbouring one, so
+// LODs reuse the mesh's vertices. Vertices with `locked` set (optional) don't move. Returns the number of levels
+// written to lod_indices/lod_errors, full detail not included.
+uint32_t ta_mesh_simplify_lods(const ta_mesh_vertex *vertices, uint32_t vertex_count, const uint32_t *indices,
+    size_t index_count, const uint8_t *locked, float target_error, uint32_t max_lods,
+    std::vector<uint32_t> *lod_indices, float *lod_errors)
+{
+    simplify_context ctx = {};
+    ctx.vertices = vertices;
+    ctx.locked = locked;
+    ctx.position.assign(vertex_count, SIMPLIFY_NONE);
+    std::vector<uint32_t> used(indices, indices + index_count);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+    simplify_positions(vertices, used, ctx.position);
+
+    ctx.wedges.resize(vertex_count);
+    ctx.quadrics.resize(vertex_count);
+    ctx.vertex_triangles.resize(vertex_count);
+    ctx.version.assign(vertex_count, 0);
+    ctx.removed.assign(vertex_count, 0);
+    for (uint32_t vertex : used) {
+        ctx.wedges[ctx.position[vertex]].push_back(vertex);
+    }
+
+    // Triangle planes, and how many triangles use each edge to find the open borders
+    size_t triangle_count = index_count / 3;
+    ctx.triangles.assign(indices, indices + triangle_count * 3);
+    ctx.triangle_dead.assign(triangle_count, 0);
+    std::unordered_map<uint64_t, uint32_t> edges;
+    edges.reserve(index_count);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        uint32_t p[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = ctx.position[ctx.triangles[t * 3 + k]];
+        }
+        double normal[3];
+        simplify_cross(vertices[p[0]].position, vertices[p[1]].position, vertices[p[2]].position, normal);
+        double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2] || length == 0.0) {
+            ctx.triangle_dead[t] = 1;
+            continue;
+        }
+        ctx.live_triangles++;
+        const float *origin = vertices[p[0]].position;
+        double a = normal[0] / length;
+        double b = normal[1] / length;
+        double c = normal[2] / length;
+        double d = -(a * origin[0] + b * origin[1] + c * origin[2]);
+        for (int k = 0; k < 3; ++k) {
+            simplify_quadric_add_plane(ctx.quadrics[p[k]], a, b, c, d, 1.0);
+            ctx.vertex_triangles[p[k]].push_back((uint32_t)t);
+            uint32_t e0 = std::min(p[k], p[(k + 1) % 3]);
+            uint32_t e1 = std::max(p[k], p[(k + 1) % 3]);
+            edges[((uint64_t)e0 << 32) | e1]++;
+        }
+    }
+    for (size_t t = 0; t < triangle_count; ++t) {
+        if (ctx.triangle_dead[t]) {
+            continue;
+        }
+        uint32_t p[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = ctx.position[ctx.triangles[t * 3 + k]];
+        }
+        double normal[3];
+        simplify_cross(vertices[p[0]].position, vertices[p[1]].position, vertices[p[2]].position, normal);
+        for (int k = 0; k < 3; ++k) {
+            uint32_t e0 = std::min(p[k], p[(k + 1) % 3]);
+            uint32_t e1 = std::max(p[k], p[(k + 1) % 3]);
+            if (edges[((uint64_t)e0 << 32) | e1] != 1) {
+                continue;
+            }
+            const float *start = vertices[p[k]].position;
+            const float *end = vertices[p[(k + 1) % 3]].position;
+            double edge[3] = { (double)end[0] - start[0], (double)end[1] - start[1], (double)end[2] - start[2] };
+            double plane[3] = {
+                edge[1] * normal[2] - edge[2] * normal[1],
+                edge[2] * normal[0] - edge[0] * normal[2],
+                edge[0] * normal[1] - edge[1] * normal[0],
+            };
+            double length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            if (length == 0.0) {
+                continue;
+            }
+            double a = plane[0] / length;
+            double b = plane[1] / length;
+            double c = plane[2] / length;
+            double d = -(a * start[0] + b * start[1] + c * start[2]);
+            simplify_quadric_add_plane(ctx.quadrics[p[k]], a, b, c, d, SIMPLIFY_BORDER_WEIGHT);
+            simplify_quadric_add_plane(ctx.quadrics[p[(k + 1) % 3]], a, b, c, d, SIMPLIFY_BORDER_WEIGHT);
+        }
+    }
+
+    for (size_t t = 0; t < triangle_count; ++t) {
+        if (ctx.triangle_dead[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = ctx.position[ctx.triangles[t * 3 + k]];
+            uint32_t b = ctx.position[ctx.triangles[t * 3 + (k + 1) % 3]];
+            simplify_push(ctx, a, b);
+            simplify_push(ctx, b, a);
+        }
+    }
+
+    uint32_t lods = 0;
+    uint32_t previous = ctx.live_triangles;
+    uint32_t target = (uint32_t)(previous * TA_MESH_SIMPLIFY_REDUCTION);
+    double max_cost = (double)target_error * target_error;
+    float error = 0.0f;
+    while (!ctx.heap.empty() && lods < max_lods) {
+        std::pop_heap(ctx.heap.begin(), ctx.heap.end(), [](const simplify_collapse &a, const simplify_collapse &b) {
+            return a.cost > b.cost;
+        });
+        simplify_collapse collapse = ctx.heap.back();
+        ctx.heap.pop_back();
+        if (ctx.removed[collapse.from] || ctx.removed[collapse.to] ||
+            ctx.version[collapse.from] != collapse.from_version || ctx.version[collapse.to] != collapse.to_version)
+        {
+            continue;
+        }
+        if (collapse.cost > max_cost) {
+            break;
+        }
+        if (!simplify_collapse_valid(ctx, collapse.from, collapse.to)) {
+            continue;
+        }
+        simplify_collapse_apply(ctx, collapse.from, collapse.to);
+        // NOTE: sqrt of the summed squared plane distances, never less than the distance to any one plane
+        error = std::max(error, (float)sqrt(collapse.cost));
+        if (ctx.live_triangles <= target) {
+            simplify_emit(ctx, lod_indices[lods]);
+            lod_errors[lods++] = error;
+            previous = ctx.live_triangles;
+            target = (uint32_t)(previous * TA_MESH_SIMPLIFY_REDUCTION);
+        }
+    }
+    // Out of budget between two levels, keep what it got to if that's still a real reduction
+    if (lods < max_lods && ctx.live_triangles && ctx.live_triangles <= previous * TA_MESH_SIMPLIFY_MIN_REDUCTION) {
+        simplify_emit(ctx, lod_indices[lods]);
+        lod_errors[lods++] = error;
+    }
+    return lods;
+}
+
+// Cooker stage, after ta_mesh_optimize: appends each submesh's LODs to the end of the index buffer (vertex cache
+// ordered) and fills in its LOD table. target_error is a fraction of the mesh's bounding radius. Positions shared by
+// more than one submesh are locked so neighbouring submeshes at different LODs don't crack apart.
+ta_mesh_simplify_stats ta_mesh_simplify(ta_mesh_data &data, float target_error)
+{
+    ta_mesh_simplify_stats stats = {};
+    const uint32_t vertex_count = (uint32_t)data.vertices.size();
+    std::vector<uint8_t> locked(vertex_count, 0);
+    if (data.submeshes.size() > 1) {
+        std::vector<uint32_t> all(vertex_count);
+        for (uint32_t v = 0; v < vertex_count; ++v) {
+            all[v] = v;
+        }
+        std::vector<uint32_t> position(vertex_count, SIMPLIFY_NONE);
+        simplify_positions(data.vertices.data(), all, position);
+        std::vector<uint32_t> owner(vertex_count, SIMPLIFY_NONE);
+        for (uint32_t s = 0; s < data.submeshes.size(); ++s) {
+            const ta_mesh_submesh &submesh = data.submeshes[s];
+            for (uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; ++i) {
+                uint32_t &slot = owner[position[data.indices[i]]];
+                slot = slot == SIMPLIFY_NONE || slot == s ? s : SIMPLIFY_NONE - 1;
+            }
+        }
+        for (uint32_t v = 0; v < vertex_count; ++v) {
+            locked[v] = owner[position[v]] == SIMPLIFY_NONE - 1;
+        }
+    }
+
+    float error = target_error * data.bounds.radius;
+    std::vector<uint32_t> lod_indices[TA_MESH_MAX_LODS - 1];
+    float lod_errors[TA_MESH_MAX_LODS - 1] = {};
+    for (ta_mesh_submesh &submesh : data.submeshes) {
+        submesh.lod_count = 1 + ta_mesh_simplify_lods(data.vertices.data(), vertex_count,
+            &data.indices[submesh.first_index], submesh.index_count, locked.data(), error, TA_MESH_MAX_LODS - 1,
+            lod_indices, lod_errors);
+        submesh.lods[0].first_index = submesh.first_index;
+        submesh.lods[0].index_count = submesh.index_count;
+        submesh.lods[0].error = 0.0f;
+        for (uint32_t lod = 1; lod < submesh.lod_count; ++lod) {
+            const std::vector<uint32_t> &indices = lod_indices[lod - 1];
+            submesh.lods[lod].first_index = (uint32_t)data.indices.size();
+            submesh.lods[lod].index_count = (uint32_t)indices.size();
+            submesh.lods[lod].error = lod_errors[lod - 1];
+            data.indices.insert(data.indices.end(), indices.begin(), indices.end());
+            ta_mesh_opt_vertex_cache(&data.indices[submesh.lods[lod].first_index], indices.size(), vertex_count);
+        }
+
+        stats.lod_count = std::max(stats.lod_count, submesh.lod_count);
+        for (uint32_t lod = 0; lod < TA_MESH_MAX_LODS; ++lod) {
+            const ta_mesh_lod &level = submesh.lods[std::min(lod, submesh.lod_count - 1)];
+            stats.triangles[lod] += level.index_count / 3;
+            stats.error[lod] = std::max(stats.error[lod], level.error);
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "ta_mesh_cook.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Default error allowed for the coarsest LOD, as a fraction of the mesh's bounding radius
+#define TA_MESH_SIMPLIFY_ERROR          0.25f
+// Each LOD aims for this fraction of the previous level's triangles
+#define TA_MESH_SIMPLIFY_REDUCTION      0.5f
+// A last level that keeps more than this fraction of the previous one's triangles isn't worth an index range
+#define TA_MESH_SIMPLIFY_MIN_REDUCTION  0.8f
+
+typedef struct ta_mesh_simplify_stats {
+    uint32_t lod_count;                     // most levels of any submesh, full detail included
+    uint32_t triangles[TA_MESH_MAX_LODS];   // over all submeshes, ones with fewer levels count their coarsest
+    float    error[TA_MESH_MAX_LODS];       // worst of any submesh, mesh units
+} ta_mesh_simplify_stats;
+
+uint32_t ta_mesh_simplify_lods          (const ta_mesh_vertex *vertices, uint32_t vertex_count,
+                                         const uint32_t *indices, size_t index_count, const uint8_t *locked,
+                                         float target_error, uint32_t max_lods, std::vector<uint32_t> *lod_indices,
+                                         float *lod_errors);
+ta_mesh_simplify_stats ta_mesh_simplify (ta_mesh_data &data, float target_error);
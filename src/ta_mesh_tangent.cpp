@@ -0,0 +1,516 @@
+#include "ta_mesh_tangent.hpp"
+#include "ta_log.hpp"
+#include "ta_obj.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+
+#define TANGENT_NONE UINT32_MAX
+
+typedef enum tangent_flag {
+    TANGENT_ORIENT_PRESERVING = 1,  // positive UV area, handedness +1
+    TANGENT_GROUP_WITH_ANY    = 2,  // no UV area, takes its orientation (and tangents) from its neighbors
+    TANGENT_DEGENERATE        = 4,  // repeats a vertex, its corners copy the vertex's first group
+} tangent_flag;
+
+// Passes over triangles or vertices, each chunk is a job. Every output is a function of the inputs alone, so the
+// result is the same however the jobs are scheduled.
+typedef struct tangent_context {
+    ta_mesh_vertex        *vertices;
+    uint32_t              *indices;
+    uint32_t              vertex_count;
+    uint32_t              triangle_count;
+    std::vector<float>    face_tangents;    // per triangle, xyz, unit length or zero
+    std::vector<uint8_t>  flags;            // per triangle, tangent_flag
+    std::vector<uint32_t> neighbors;        // per corner, the triangle across the edge from it to the next corner
+    std::vector<uint32_t> vertex_first;     // corners around each vertex, in triangle order
+    std::vector<uint32_t> vertex_corners;
+    std::vector<uint32_t> corner_groups;    // per corner, numbered per vertex in order of first corner
+    std::vector<float>    corner_tangents;  // per corner, xyzw, its group's
+    std::vector<uint32_t> group_counts;     // per vertex, then the first split vertex of each
+    std::vector<uint32_t> fallback;         // per chunk
+} tangent_context;
+
+static uint32_t tangent_chunks(uint32_t count)
+{
+    return (count + TA_MESH_TANGENT_CHUNK - 1) / TA_MESH_TANGENT_CHUNK;
+}
+
+static void tangent_run(ta_jobs *jobs, uint32_t count, ta_job_fn fn, tangent_context &ctx)
+{
+    uint32_t chunk_count = tangent_chunks(count);
+    if (jobs && chunk_count > 1) {
+        ta_jobs_parallel_for(*jobs, chunk_count, fn, &ctx);
+    } else {
+        for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+            fn(&ctx, chunk, 0);
+        }
+    }
+}
+
+static float tangent_dot(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Unit length if it has any, else left as is (MikkTSpace's NormalizeSafe)
+static void tangent_normalize(float v[3])
+{
+    float length = sqrtf(tangent_dot(v, v));
+    if (length > FLT_MIN) {
+        float scale = 1.0f / length;
+        v[0] *= scale;
+        v[1] *= scale;
+        v[2] *= scale;
+    }
+}
+
+// v minus its component along the normal
+static void tangent_project(const float normal[3], const float v[3], float out[3])
+{
+    float d = tangent_dot(normal, v);
+    for (int axis = 0; axis < 3; ++axis) {
+        out[axis] = v[axis] - d * normal[axis];
+    }
+}
+
+// Per triangle direction of increasing u, 4 triangles at a time. Padding lanes repeat the last triangle, so every
+// triangle goes through the same instructions. Only IEEE exact operations (no rsqrt), so the result doesn't depend
+// on the CPU either.
+// NOTE: v is negated to get OBJ's v back, which is what the tangent spaces of bakers are relative to
+static void tangent_face_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    tangent_context &ctx = *(tangent_context *)userdata;
+    uint32_t begin = index * TA_MESH_TANGENT_CHUNK;
+    uint32_t end = std::min(begin + TA_MESH_TANGENT_CHUNK, ctx.triangle_count);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 tiny = _mm_set1_ps(FLT_MIN);
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    for (uint32_t first = begin; first < end; first += 4) {
+        float p[3][3][4];   // corner, axis, lane
+        float t[3][2][4];
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            uint32_t triangle = std::min(first + lane, end - 1);
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                const ta_mesh_vertex &vertex = ctx.vertices[ctx.indices[triangle * 3 + corner]];
+                for (int axis = 0; axis < 3; ++axis) {
+                    p[corner][axis][lane] = vertex.position[axis];
+                }
+                t[corner][0][lane] = vertex.uv[0];
+                t[corner][1][lane] = -vertex.uv[1];
+            }
+        }
+        __m128 d1[3];
+        __m128 d2[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            __m128 p0 = _mm_loadu_ps(p[0][axis]);
+            d1[axis] = _mm_sub_ps(_mm_loadu_ps(p[1][axis]), p0);
+            d2[axis] = _mm_sub_ps(_mm_loadu_ps(p[2][axis]), p0);
+        }
+        __m128 t21x = _mm_sub_ps(_mm_loadu_ps(t[1][0]), _mm_loadu_ps(t[0][0]));
+        __m128 t21y = _mm_sub_ps(_mm_loadu_ps(t[1][1]), _mm_loadu_ps(t[0][1]));
+        __m128 t31x = _mm_sub_ps(_mm_loadu_ps(t[2][0]), _mm_loadu_ps(t[0][0]));
+        __m128 t31y = _mm_sub_ps(_mm_loadu_ps(t[2][1]), _mm_loadu_ps(t[0][1]));
+        __m128 area = _mm_sub_ps(_mm_mul_ps(t21x, t31y), _mm_mul_ps(t21y, t31x));
+        __m128 os[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            os[axis] = _mm_sub_ps(_mm_mul_ps(t31y, d1[axis]), _mm_mul_ps(t21y, d2[axis]));
+        }
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(os[0], os[0]), _mm_mul_ps(os[1], os[1])),
+            _mm_mul_ps(os[2], os[2])));
+        __m128 preserving = _mm_cmpgt_ps(area, zero);
+        __m128 has_area = _mm_cmpgt_ps(_mm_andnot_ps(sign_mask, area), tiny);
+        __m128 has_length = _mm_cmpgt_ps(length, tiny);
+        // Flipped along with the UVs, so the tangent always points towards increasing u
+        __m128 sign = _mm_or_ps(_mm_andnot_ps(preserving, sign_mask), one);
+        __m128 scale = _mm_and_ps(_mm_and_ps(has_area, has_length),
+            _mm_div_ps(sign, _mm_or_ps(_mm_and_ps(has_length, length), _mm_andnot_ps(has_length, one))));
+        float tangent[3][4];
+        for (int axis = 0; axis < 3; ++axis) {
+            _mm_storeu_ps(tangent[axis], _mm_mul_ps(os[axis], scale));
+        }
+        int preserving_bits = _mm_movemask_ps(preserving);
+        int area_bits = _mm_movemask_ps(has_area);
+        for (uint32_t lane = 0; lane < 4 && first + lane < end; ++lane) {
+            uint32_t triangle = first + lane;
+            for (int axis = 0; axis < 3; ++axis) {
+                ctx.face_tangents[triangle * 3 + axis] = tangent[axis][lane];
+            }
+            const uint32_t *corners = &ctx.indices[triangle * 3];
+            uint8_t flags = 0;
+            flags |= (preserving_bits >> lane) & 1 ? TANGENT_ORIENT_PRESERVING : 0;
+            flags |= (area_bits >> lane) & 1 ? 0 : TANGENT_GROUP_WITH_ANY;
+            if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0]) {
+                flags |= TANGENT_DEGENERATE;
+            }
+            ctx.flags[triangle] = flags;
+        }
+    }
+}
+
+// Triangle sharing the edge from corner to the next corner, wound the other way. First in triangle order when the
+// edge is non-manifold.
+static void tangent_neighbor_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    tangent_context &ctx = *(tangent_context *)userdata;
+    uint32_t begin = index * TA_MESH_TANGENT_CHUNK;
+    uint32_t end = std::min(begin + TA_MESH_TANGENT_CHUNK, ctx.triangle_count);
+    for (uint32_t triangle = begin; triangle < end; ++triangle) {
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            uint32_t a = ctx.indices[triangle * 3 + corner];
+            uint32_t b = ctx.indices[triangle * 3 + (corner + 1) % 3];
+            uint32_t neighbor = TANGENT_NONE;
+            for (uint32_t i = ctx.vertex_first[a]; i < ctx.vertex_first[a + 1]; ++i) {
+                uint32_t other = ctx.vertex_corners[i];
+                uint32_t other_triangle = other / 3;
+                if (other_triangle != triangle &&
+                    ctx.indices[other_triangle * 3 + (other % 3 + 2) % 3] == b &&
+                    !(ctx.flags[other_triangle] & TANGENT_DEGENERATE))
+                {
+                    neighbor = other_triangle;
+                    break;
+                }
+            }
+            ctx.neighbors[triangle * 3 + corner] = neighbor;
+        }
+    }
+}
+
+static uint32_t tangent_find(uint32_t *parents, uint32_t i)
+{
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+// Per vertex, its corners are grouped like MikkTSpace does: triangles joined by an edge through the vertex with the
+// same orientation share a tangent. Each group's tangent is the sum of its triangles' tangents projected into the
+// normal's plane and weighted by the corner's angle, the handedness is the group's orientation.
+static void tangent_vertex_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    tangent_context &ctx = *(tangent_context *)userdata;
+    uint32_t begin = index * TA_MESH_TANGENT_CHUNK;
+    uint32_t end = std::min(begin + TA_MESH_TANGENT_CHUNK, ctx.vertex_count);
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> roots;
+    std::vector<float> sums;
+    uint32_t fallback = 0;
+    for (uint32_t vertex = begin; vertex < end; ++vertex) {
+        uint32_t first = ctx.vertex_first[vertex];
+        uint32_t count = ctx.vertex_first[vertex + 1] - first;
+        const uint32_t *corners = &ctx.vertex_corners[first];
+        const ta_mesh_vertex &v = ctx.vertices[vertex];
+        if (!count) {
+            ctx.group_counts[vertex] = 0;
+            continue;
+        }
+
+        // Union find over the corners, the lowest corner is always the root
+        parents.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            parents[i] = i;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t triangle = corners[i] / 3;
+            uint32_t corner = corners[i] % 3;
+            uint8_t flags = ctx.flags[triangle];
+            if (flags & TANGENT_DEGENERATE) {
+                continue;
+            }
+            uint32_t edge_neighbors[2] = {
+                ctx.neighbors[triangle * 3 + corner], ctx.neighbors[triangle * 3 + (corner + 2) % 3]
+            };
+            for (uint32_t neighbor : edge_neighbors) {
+                if (neighbor == TANGENT_NONE || ((ctx.flags[neighbor] ^ flags) & TANGENT_ORIENT_PRESERVING)) {
+                    continue;
+                }
+                // Corners are in triangle order, the neighbor's corner at this vertex is found by bisection
+                const uint32_t *found = std::lower_bound(corners, corners + count, neighbor * 3);
+                if (found == corners + count || *found / 3 != neighbor) {
+                    continue;
+                }
+                uint32_t a = tangent_find(parents.data(), i);
+                uint32_t b = tangent_find(parents.data(), (uint32_t)(found - corners));
+                if (a != b) {
+                    parents[std::max(a, b)] = std::min(a, b);
+                }
+            }
+        }
+
+        // Number the groups in order of their first corner, degenerate corners join the first one
+        roots.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t &group = ctx.corner_groups[first + i];
+            if (ctx.flags[corners[i] / 3] & TANGENT_DEGENERATE) {
+                group = 0;
+                continue;
+            }
+            uint32_t root = tangent_find(parents.data(), i);
+            if (root == i) {
+                group = (uint32_t)roots.size();
+                roots.push_back(i);
+            } else {
+                group = ctx.corner_groups[first + root];
+            }
+        }
+        if (roots.empty()) {
+            roots.push_back(0);
+        }
+        uint32_t group_count = (uint32_t)roots.size();
+
+        sums.assign(group_count * 4, 0.0f);
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t triangle = corners[i] / 3;
+            uint32_t corner = corners[i] % 3;
+            if (ctx.flags[triangle] & TANGENT_DEGENERATE) {
+                continue;
+            }
+            float tangent[3] = {};
+            tangent_project(v.normal, &ctx.face_tangents[triangle * 3], tangent);
+            tangent_normalize(tangent);
+            const float *previous = ctx.vertices[ctx.indices[triangle * 3 + (corner + 2) % 3]].position;
+            const float *next = ctx.vertices[ctx.indices[triangle * 3 + (corner + 1) % 3]].position;
+            float e1[3] = { previous[0] - v.position[0], previous[1] - v.position[1], previous[2] - v.position[2] };
+            float e2[3] = { next[0] - v.position[0], next[1] - v.position[1], next[2] - v.position[2] };
+            float p1[3] = {};
+            float p2[3] = {};
+            tangent_project(v.normal, e1, p1);
+            tangent_project(v.normal, e2, p2);
+            tangent_normalize(p1);
+            tangent_normalize(p2);
+            float angle = acosf(std::min(std::max(tangent_dot(p1, p2), -1.0f), 1.0f));
+            float *sum = &sums[ctx.corner_groups[first + i] * 4];
+            for (int axis = 0; axis < 3; ++axis) {
+                sum[axis] += angle * tangent[axis];
+            }
+        }
+        for (uint32_t group = 0; group < group_count; ++group) {
+            float *sum = &sums[group * 4];
+            tangent_normalize(sum);
+            if (tangent_dot(sum, sum) < 0.5f) {
+                // Nothing to go by, any tangent in the normal's plane keeps shaders away from NaNs
+                float axis[3] = {};
+                axis[fabsf(v.normal[0]) < 0.5f ? 0 : 1] = 1.0f;
+                tangent_project(v.normal, axis, sum);
+                tangent_normalize(sum);
+                fallback++;
+            }
+            sum[3] = ctx.flags[corners[roots[group]] / 3] & TANGENT_ORIENT_PRESERVING ? 1.0f : -1.0f;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            memcpy(&ctx.corner_tangents[(size_t)(first + i) * 4], &sums[ctx.corner_groups[first + i] * 4],
+                4 * sizeof(float));
+        }
+        ctx.group_counts[vertex] = group_count;
+    }
+    ctx.fallback[index] = fallback;
+}
+
+// Group 0 keeps the vertex, every other group gets a copy at its slot past the original vertices
+static void tangent_write_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    tangent_context &ctx = *(tangent_context *)userdata;
+    uint32_t begin = index * TA_MESH_TANGENT_CHUNK;
+    uint32_t end = std::min(begin + TA_MESH_TANGENT_CHUNK, ctx.vertex_count);
+    for (uint32_t vertex = begin; vertex < end; ++vertex) {
+        uint32_t first = ctx.vertex_first[vertex];
+        uint32_t count = ctx.vertex_first[vertex + 1] - first;
+        uint32_t split_first = ctx.group_counts[vertex];
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t group = ctx.corner_groups[first + i];
+            uint32_t target = vertex;
+            if (group) {
+                target = split_first + group - 1;
+                ctx.vertices[target] = ctx.vertices[vertex];
+                ctx.indices[ctx.vertex_corners[first + i]] = target;
+            }
+            memcpy(ctx.vertices[target].tangent, &ctx.corner_tangents[(size_t)(first + i) * 4],
+                sizeof(ctx.vertices[target].tangent));
+        }
+    }
+}
+
+ta_mesh_tangent_stats ta_mesh_tangent_generate(std::vector<ta_mesh_vertex> &vertices, uint32_t *indices,
+    uint32_t index_count, ta_jobs *jobs)
+{
+    double start_ms = ta_timer_elapsed_ms();
+    ta_mesh_tangent_stats stats = {};
+    tangent_context ctx = {};
+    ctx.vertices = vertices.data();
+    ctx.indices = indices;
+    ctx.vertex_count = (uint32_t)vertices.size();
+    ctx.triangle_count = index_count / 3;
+    stats.triangles = ctx.triangle_count;
+    uint32_t corner_count = ctx.triangle_count * 3;
+
+    ctx.face_tangents.resize((size_t)ctx.triangle_count * 3);
+    ctx.flags.resize(ctx.triangle_count);
+    tangent_run(jobs, ctx.triangle_count, tangent_face_job, ctx);
+
+    // Corners around each vertex by counting sort, which keeps them in triangle order
+    ctx.vertex_first.assign(ctx.vertex_count + 1, 0);
+    for (uint32_t i = 0; i < corner_count; ++i) {
+        ctx.vertex_first[indices[i] + 1]++;
+    }
+    for (uint32_t vertex = 0; vertex < ctx.vertex_count; ++vertex) {
+        ctx.vertex_first[vertex + 1] += ctx.vertex_first[vertex];
+    }
+    ctx.vertex_corners.resize(corner_count);
+    {
+        std::vector<uint32_t> cursor(ctx.vertex_first.begin(), ctx.vertex_first.end() - 1);
+        for (uint32_t i = 0; i < corner_count; ++i) {
+            ctx.vertex_corners[cursor[indices[i]]++] = i;
+        }
+    }
+    ctx.neighbors.resize(corner_count);
+    tangent_run(jobs, ctx.triangle_count, tangent_neighbor_job, ctx);
+
+    // Triangles without UV area take the orientation of the first neighbor that has one (or already took one), in
+    // triangle order. MikkTSpace does the same when its group search first reaches them.
+    for (uint32_t triangle = 0; triangle < ctx.triangle_count; ++triangle) {
+        uint8_t &flags = ctx.flags[triangle];
+        if (!(flags & TANGENT_GROUP_WITH_ANY) || (flags & TANGENT_DEGENERATE)) {
+            continue;
+        }
+        stats.no_uv_area++;
+        flags |= TANGENT_ORIENT_PRESERVING;
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            uint32_t neighbor = ctx.neighbors[triangle * 3 + corner];
+            if (neighbor != TANGENT_NONE && (!(ctx.flags[neighbor] & TANGENT_GROUP_WITH_ANY) || neighbor < triangle)) {
+                flags = (flags & ~TANGENT_ORIENT_PRESERVING) | (ctx.flags[neighbor] & TANGENT_ORIENT_PRESERVING);
+                break;
+            }
+        }
+    }
+
+    ctx.corner_groups.resize(corner_count);
+    ctx.corner_tangents.resize((size_t)corner_count * 4);
+    ctx.group_counts.resize(ctx.vertex_count);
+    ctx.fallback.assign(tangent_chunks(ctx.vertex_count), 0);
+    tangent_run(jobs, ctx.vertex_count, tangent_vertex_job, ctx);
+
+    // Extra groups become new vertices, in vertex order
+    uint32_t next = ctx.vertex_count;
+    for (uint32_t vertex = 0; vertex < ctx.vertex_count; ++vertex) {
+        uint32_t group_count = ctx.group_counts[vertex];
+        ctx.group_counts[vertex] = next;
+        next += group_count > 1 ? group_count - 1 : 0;
+    }
+    stats.split_vertices = next - ctx.vertex_count;
+    vertices.resize(next);
+    ctx.vertices = vertices.data();
+    tangent_run(jobs, ctx.vertex_count, tangent_write_job, ctx);
+    for (uint32_t fallback : ctx.fallback) {
+        stats.fallback += fallback;
+    }
+    stats.ms = ta_timer_elapsed_ms() - start_ms;
+    return stats;
+}
+
+// Cooker side, over every index. Runs before anything reorders or simplifies, so LODs share the tangents.
+ta_mesh_tangent_stats ta_mesh_tangents(ta_mesh_data &data, ta_jobs *jobs)
+{
+    return ta_mesh_tangent_generate(data.vertices, data.indices.data(), (uint32_t)data.indices.size(), jobs);
+}
+
+static void tangent_benchmark_mesh(ta_jobs &jobs, const char *name, const ta_mesh_data &data)
+{
+    const int runs = 3;
+    double single_ms = 0.0;
+    double parallel_ms = 0.0;
+    ta_mesh_tangent_stats stats = {};
+    std::vector<ta_mesh_vertex> single_vertices;
+    std::vector<uint32_t> single_indices;
+    std::vector<ta_mesh_vertex> parallel_vertices;
+    std::vector<uint32_t> parallel_indices;
+    for (int run = 0; run < runs; ++run) {
+        single_vertices = data.vertices;
+        single_indices = data.indices;
+        stats = ta_mesh_tangent_generate(single_vertices, single_indices.data(), (uint32_t)single_indices.size(),
+            NULL);
+        single_ms = run ? std::min(single_ms, stats.ms) : stats.ms;
+        parallel_vertices = data.vertices;
+        parallel_indices = data.indices;
+        stats = ta_mesh_tangent_generate(parallel_vertices, parallel_indices.data(),
+            (uint32_t)parallel_indices.size(), &jobs);
+        parallel_ms = run ? std::min(parallel_ms, stats.ms) : stats.ms;
+    }
+    bool identical = single_vertices.size() == parallel_vertices.size() && single_indices == parallel_indices &&
+        !memcmp(single_vertices.data(), parallel_vertices.data(), single_vertices.size() * sizeof(ta_mesh_vertex));
+
+    ta_log_write(tg_debug_log, SRC_FILE, "%-24s %9u tris  1 thread %8.2fms %7.2fM tris/s  %u threads %8.2fms "
+        "%7.2fM tris/s (%5.2fx)  %u split vertices, %u without UV area, %u fallbacks\n", name, stats.triangles,
+        single_ms, stats.triangles / (single_ms * 1000.0), jobs.worker_count + 1, parallel_ms,
+        stats.triangles / (parallel_ms * 1000.0), parallel_ms > 0.0 ? single_ms / parallel_ms : 0.0,
+        stats.split_vertices, stats.no_uv_area, stats.fallback);
+    if (!identical) {
+        ta_log_write(tg_debug_log, SRC_FILE, "    MISMATCH: tangents differ between 1 and %u threads\n",
+            jobs.worker_count + 1);
+    }
+}
+
+// Tangent throughput (best of 3) on each mesh, then on the last one (the level) tiled in a 3D grid until it has
+// synthetic_triangles. Checks that every thread count gives the same bytes.
+void ta_mesh_tangent_benchmark(ta_jobs &jobs, const char *const *paths, uint32_t path_count,
+    uint32_t synthetic_triangles)
+{
+    ta_log_write(tg_debug_log, SRC_FILE, "Tangent benchmark:\n");
+    ta_log_indent(tg_debug_log);
+    ta_mesh_data level = {};
+    for (uint32_t i = 0; i < path_count; ++i) {
+        ta_obj obj = {};
+        if (!ta_obj_load(obj, paths[i], &jobs)) {
+            continue;
+        }
+        ta_mesh_data data = {};
+        ta_mesh_cook_from_obj(data, obj);
+        if (data.indices.empty()) {
+            continue;
+        }
+        const char *name = strrchr(paths[i], '/');
+        tangent_benchmark_mesh(jobs, name ? name + 1 : paths[i], data);
+        if (i == path_count - 1) {
+            level = data;
+        }
+    }
+    if (synthetic_triangles && !level.indices.empty()) {
+        uint32_t triangles = (uint32_t)level.indices.size() / 3;
+        uint32_t side = (uint32_t)ceil(cbrt((double)synthetic_triangles / triangles));
+        float spacing[3] = {};
+        for (int axis = 0; axis < 3; ++axis) {
+            spacing[axis] = (level.bounds.max[axis] - level.bounds.min[axis]) * 1.1f;
+        }
+        ta_mesh_data scene = {};
+        scene.vertices.reserve(level.vertices.size() * side * side * side);
+        scene.indices.reserve(level.indices.size() * side * side * side);
+        for (uint32_t copy = 0; copy < side * side * side; ++copy) {
+            uint32_t cell[3] = { copy % side, copy / side % side, copy / (side * side) };
+            uint32_t base = (uint32_t)scene.vertices.size();
+            for (ta_mesh_vertex vertex : level.vertices) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    vertex.position[axis] += cell[axis] * spacing[axis];
+                }
+                scene.vertices.push_back(vertex);
+            }
+            for (uint32_t i = 0; i < triangles * 3; ++i) {
+                scene.indices.push_back(base + level.indices[i]);
+            }
+        }
+        const char *name = strrchr(paths[path_count - 1], '/');
+        char scene_name[64] = {};
+        snprintf(scene_name, sizeof(scene_name), "%s x%u", name ? name + 1 : paths[path_count - 1],
+            side * side * side);
+        tangent_benchmark_mesh(jobs, scene_name, scene);
+    }
+    ta_log_unindent(tg_debug_log);
+}
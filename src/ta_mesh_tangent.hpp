@@ -0,0 +1,27 @@
+#pragma once
+#include "ta_jobs.hpp"
+#include "ta_mesh.hpp"
+#include "ta_mesh_cook.hpp"
+#include <cstdint>
+#include <vector>
+
+// Triangles (or vertices) per job
+#define TA_MESH_TANGENT_CHUNK   16384
+
+typedef struct ta_mesh_tangent_stats {
+    uint32_t triangles;
+    uint32_t split_vertices;    // added where one vertex's corners needed different tangents (mirrored UVs)
+    uint32_t no_uv_area;        // triangles whose tangents come from their neighbors
+    uint32_t fallback;          // vertices with no tangent to take at all, given one perpendicular to the normal
+    double   ms;
+} ta_mesh_tangent_stats;
+
+// MikkTSpace-compatible tangents for an indexed triangle list, so normal maps baked by the usual tools (which use
+// MikkTSpace) come out right. Results don't depend on jobs, the cooker and the runtime get identical tangents.
+// The bitangent is tangent.w * cross(normal, tangent.xyz) and points towards increasing OBJ v, which is decreasing
+// ta_mesh_vertex::uv[1].
+ta_mesh_tangent_stats ta_mesh_tangent_generate(std::vector<ta_mesh_vertex> &vertices, uint32_t *indices,
+                                               uint32_t index_count, ta_jobs *jobs);
+ta_mesh_tangent_stats ta_mesh_tangents        (ta_mesh_data &data, ta_jobs *jobs);
+void ta_mesh_tangent_benchmark                (ta_jobs &jobs, const char *const *paths, uint32_t path_count,
+                                               uint32_t synthetic_triangles);
@@ -0,0 +1,444 @@
+#include "ta_meshlet.hpp"
+#include "ta_log.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#define MESHLET_LOCAL_NONE 0xff
+
+static void meshlet_normalize(float v[3])
+{
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    v[0] *= scale;
+    v[1] *= scale;
+    v[2] *= scale;
+}
+
+static void meshlet_triangle_normal(const ta_mesh_data &data, const uint32_t *triangle, float normal[3])
+{
+    const float *a = data.vertices[triangle[0]].position;
+    const float *b = data.vertices[triangle[1]].position;
+    const float *c = data.vertices[triangle[2]].position;
+    float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    meshlet_normalize(normal);
+}
+
+// Bounding sphere around the meshlet's vertices (AABB center, so not minimal but cheap and stable) and the normal
+// cone of its triangles. The cone is only usable with the sphere test in ta_meshlet_visible, which doesn't need an
+// apex: cutoff = sin of the widest triangle's angle to the axis.
+static void meshlet_bounds(const ta_mesh_data &data, ta_mesh_meshlet &meshlet)
+{
+    const uint32_t *vertices = &data.meshlet_vertices[meshlet.vertex_offset];
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+        const float *position = data.vertices[vertices[i]].position;
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], position[axis]);
+            max[axis] = std::max(max[axis], position[axis]);
+        }
+    }
+    float radius_squared = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        meshlet.center[axis] = (min[axis] + max[axis]) * 0.5f;
+    }
+    for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+        const float *position = data.vertices[vertices[i]].position;
+        float dx = position[0] - meshlet.center[0];
+        float dy = position[1] - meshlet.center[1];
+        float dz = position[2] - meshlet.center[2];
+        radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+    }
+    meshlet.radius = sqrtf(radius_squared);
+
+    // Unit face normals, degenerate triangles have none and don't constrain the cone
+    float normals[TA_MESHLET_MAX_TRIANGLES][3];
+    uint32_t normal_count = 0;
+    float axis[3] = {};
+    for (uint32_t t = 0; t < meshlet.triangle_count; ++t) {
+        float *normal = normals[normal_count];
+        meshlet_triangle_normal(data, &data.indices[meshlet.first_index + t * 3], normal);
+        if (normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f) {
+            continue;
+        }
+        axis[0] += normal[0];
+        axis[1] += normal[1];
+        axis[2] += normal[2];
+        normal_count++;
+    }
+    meshlet_normalize(axis);
+
+    float min_dot = normal_count ? 1.0f : -1.0f;
+    for (uint32_t i = 0; i < normal_count; ++i) {
+        min_dot = std::min(min_dot, normals[i][0] * axis[0] + normals[i][1] * axis[1] + normals[i][2] * axis[2]);
+    }
+    meshlet.cone_axis[0] = axis[0];
+    meshlet.cone_axis[1] = axis[1];
+    meshlet.cone_axis[2] = axis[2];
+    meshlet.cone_cutoff = min_dot <= TA_MESHLET_CONE_MIN_DOT ? 1.0f : sqrtf(1.0f - min_dot * min_dot);
+}
+
+static void meshlet_finish(ta_mesh_data &data, ta_mesh_meshlet &meshlet, std::vector<uint8_t> &local)
+{
+    meshlet_bounds(data, meshlet);
+    for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+        local[data.meshlet_vertices[meshlet.vertex_offset + i]] = MESHLET_LOCAL_NONE;
+    }
+    data.meshlets.push_back(meshlet);
+}
+
+// Splits each submesh's triangles into meshlets in index order, starting a new one whenever the next triangle would
+// go over either limit or turns too far away from the meshlet's average facing. Run after ta_mesh_optimize: its cache
+// order is what keeps meshlets spatially tight and their vertex counts low, and it doesn't reorder anything here, so
+// every meshlet stays a contiguous index range.
+ta_meshlet_stats ta_meshlet_build(ta_mesh_data &data)
+{
+    static_assert(TA_MESHLET_MAX_VERTICES < MESHLET_LOCAL_NONE, "meshlet local indices are uint8");
+    data.meshlets.clear();
+    data.meshlet_vertices.clear();
+    data.meshlet_triangles.assign(data.indices.size(), 0);
+    std::vector<uint8_t> local(data.vertices.size(), MESHLET_LOCAL_NONE);
+
+    for (ta_mesh_submesh &submesh : data.submeshes) {
+        submesh.first_meshlet = (uint32_t)data.meshlets.size();
+        ta_mesh_meshlet meshlet = {};
+        float axis[3] = {};
+        meshlet.first_index = submesh.first_index;
+        meshlet.vertex_offset = (uint32_t)data.meshlet_vertices.size();
+        for (uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; i += 3) {
+            const uint32_t *triangle = &data.indices[i];
+            uint32_t new_vertices = (local[triangle[0]] == MESHLET_LOCAL_NONE) +
+                (local[triangle[1]] == MESHLET_LOCAL_NONE && triangle[1] != triangle[0]) +
+                (local[triangle[2]] == MESHLET_LOCAL_NONE && triangle[2] != triangle[0] && triangle[2] != triangle[1]);
+            float normal[3];
+            meshlet_triangle_normal(data, triangle, normal);
+            float facing = normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2];
+            float axis_length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            bool cone_split = meshlet.triangle_count >= TA_MESHLET_CONE_SPLIT_TRIANGLES &&
+                facing < TA_MESHLET_CONE_SPLIT_DOT * axis_length;
+            if (meshlet.vertex_count + new_vertices > TA_MESHLET_MAX_VERTICES ||
+                meshlet.triangle_count == TA_MESHLET_MAX_TRIANGLES || cone_split)
+            {
+                meshlet_finish(data, meshlet, local);
+                meshlet = {};
+                meshlet.first_index = i;
+                meshlet.vertex_offset = (uint32_t)data.meshlet_vertices.size();
+                axis[0] = axis[1] = axis[2] = 0.0f;
+            }
+            axis[0] += normal[0];
+            axis[1] += normal[1];
+            axis[2] += normal[2];
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                uint32_t vertex = triangle[corner];
+                if (local[vertex] == MESHLET_LOCAL_NONE) {
+                    local[vertex] = (uint8_t)meshlet.vertex_count++;
+                    data.meshlet_vertices.push_back(vertex);
+                }
+                data.meshlet_triangles[i + corner] = local[vertex];
+            }
+            meshlet.triangle_count++;
+        }
+        if (meshlet.triangle_count) {
+            meshlet_finish(data, meshlet, local);
+        }
+        submesh.meshlet_count = (uint32_t)data.meshlets.size() - submesh.first_meshlet;
+    }
+
+    ta_meshlet_stats stats = {};
+    stats.meshlets = (uint32_t)data.meshlets.size();
+    for (const ta_mesh_meshlet &meshlet : data.meshlets) {
+        stats.cone_cullable += meshlet.cone_cutoff < 1.0f;
+    }
+    if (stats.meshlets) {
+        stats.triangles_per_meshlet = (float)data.indices.size() / 3.0f / stats.meshlets;
+        stats.vertices_per_meshlet = (float)data.meshlet_vertices.size() / stats.meshlets;
+    }
+    return stats;
+}
+
+// Gribb/Hartmann plane extraction from a column major view projection with Vulkan's 0..1 depth range
+ta_meshlet_cull_constants ta_meshlet_cull_setup(const float view_projection[16], const float camera_position[3])
+{
+    const float *m = view_projection;
+    ta_meshlet_cull_constants constants = {};
+    for (int i = 0; i < 4; ++i) {
+        float row0 = m[i * 4 + 0];
+        float row1 = m[i * 4 + 1];
+        float row2 = m[i * 4 + 2];
+        float row3 = m[i * 4 + 3];
+        constants.frustum[0][i] = row3 + row0;  // left
+        constants.frustum[1][i] = row3 - row0;  // right
+        constants.frustum[2][i] = row3 + row1;  // top (y down)
+        constants.frustum[3][i] = row3 - row1;  // bottom
+        constants.frustum[4][i] = row2;         // near
+        constants.frustum[5][i] = row3 - row2;  // far
+    }
+    for (float *plane : constants.frustum) {
+        float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int i = 0; i < 4; ++i) {
+            plane[i] *= scale;
+        }
+    }
+    constants.camera_position[0] = camera_position[0];
+    constants.camera_position[1] = camera_position[1];
+    constants.camera_position[2] = camera_position[2];
+    return constants;
+}
+
+static bool meshlet_sphere_in_frustum(const float center[3], float radius, const ta_meshlet_cull_constants &constants)
+{
+    for (const float *plane : constants.frustum) {
+        float distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+        if (distance < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Same test as meshlet_cull.comp. Backfacing assumes counter-clockwise front faces, which is how the OBJs come in.
+bool ta_meshlet_visible(const ta_mesh_meshlet &meshlet, const ta_meshlet_cull_constants &constants)
+{
+    if (!meshlet_sphere_in_frustum(meshlet.center, meshlet.radius, constants)) {
+        return false;
+    }
+    float view[3] = {
+        meshlet.center[0] - constants.camera_position[0],
+        meshlet.center[1] - constants.camera_position[1],
+        meshlet.center[2] - constants.camera_position[2],
+    };
+    float distance = sqrtf(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+    float facing = view[0] * meshlet.cone_axis[0] + view[1] * meshlet.cone_axis[1] + view[2] * meshlet.cone_axis[2];
+    return facing < meshlet.cone_cutoff * distance + meshlet.radius;
+}
+
+// Loads the cull shader. Nothing is allocated until ta_meshlet_culler_reserve.
+void ta_meshlet_culler_init(ta_meshlet_culler &culler, VkDevice device,
+    const VkPhysicalDeviceMemoryProperties &memory_properties, ta_shader_library &shaders,
+    ta_descriptor_allocator &descriptors, bool draw_indirect_count, bool multi_draw_indirect)
+{
+    culler = {};
+    culler.device = device;
+    culler.memory_properties = &memory_properties;
+    culler.shaders = &shaders;
+    culler.descriptors = &descriptors;
+    culler.multi_draw_indirect = multi_draw_indirect;
+    // NOTE: The dispatch table leaves it NULL if the extension wasn't enabled on the device
+    culler.draw_indirect_count = draw_indirect_count && vkCmdDrawIndexedIndirectCountKHR;
+    culler.pipeline = TA_SHADER_INVALID;
+    ta_shader_handle shader = ta_shader_load(shaders, "meshlet_cull.comp.spv");
+    if (shader != TA_SHADER_INVALID) {
+        culler.pipeline = ta_shader_pipeline_compute(shaders, shader, NULL);
+    }
+    if (culler.pipeline == TA_SHADER_INVALID) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "No meshlet cull pipeline, meshlets will be culled on the CPU.\n");
+    }
+}
+
+// Grows the draw buffer to hold a draw for every meshlet of the largest mesh that will be culled
+VkResult ta_meshlet_culler_reserve(ta_meshlet_culler &culler, uint32_t max_draws, ta_deletion_queue &deletion_queue,
+    uint64_t frame)
+{
+    if (max_draws <= culler.max_draws) {
+        return VK_SUCCESS;
+    }
+    if (culler.draws.buffer) {
+        ta_vk_buffer_destroy(culler.draws, deletion_queue, frame);
+    }
+    culler.max_draws = 0;
+    culler.culled = NULL;
+    VkDeviceSize size = TA_MESHLET_DRAW_OFFSET + (VkDeviceSize)max_draws * sizeof(VkDrawIndexedIndirectCommand);
+    VkResult err = ta_vk_buffer_create(culler.draws, culler.device, *culler.memory_properties, size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create meshlet draw buffer.\n", err);
+        return err;
+    }
+    culler.max_draws = max_draws;
+    return VK_SUCCESS;
+}
+
+static void meshlet_barrier(VkCommandBuffer command_buffer, VkBuffer buffer, VkPipelineStageFlags src_stages,
+    VkAccessFlags src_access, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, NULL, 1, &barrier, 0, NULL);
+}
+
+// Culls meshlets [first, first + count) into the draw buffer. Every dispatch appends to the same count, so each one
+// after the first waits for the one before.
+static void meshlet_dispatch(VkCommandBuffer command_buffer, const ta_spirv_layout &layout, VkBuffer draws,
+    const ta_meshlet_cull_constants &constants, uint32_t first, uint32_t count, uint32_t &dispatches)
+{
+    if (!count) {
+        return;
+    }
+    if (dispatches++) {
+        meshlet_barrier(command_buffer, draws, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+    ta_meshlet_cull_constants push = constants;
+    push.first_meshlet = first;
+    push.meshlet_count = count;
+    vkCmdPushConstants(command_buffer, layout.layout, layout.push_constants.stageFlags, 0, sizeof(push), &push);
+    vkCmdDispatch(command_buffer, (count + TA_MESHLET_CULL_GROUP_SIZE - 1) / TA_MESHLET_CULL_GROUP_SIZE, 1, 1);
+}
+
+// Records the cull dispatches into a compute pass, one thread per meshlet of every submesh at full detail
+// (lods[submesh] == 0, or all of them without lods) and one dispatch per run of neighbouring ones. False if it
+// couldn't (no pipeline yet, mesh not loaded, draw buffer too small), in which case ta_meshlet_draw culls on the CPU
+// instead. The draw buffer is owned by the culler rather than the render graph, so it brings its own barriers.
+bool ta_meshlet_cull(ta_meshlet_culler &culler, const ta_mesh &mesh, VkCommandBuffer command_buffer,
+    const ta_meshlet_cull_constants &constants, const uint32_t *lods)
+{
+    culler.culled = NULL;
+    uint32_t meshlet_count = (uint32_t)mesh.meshlets.size();
+    if (culler.pipeline == TA_SHADER_INVALID || !meshlet_count || meshlet_count > culler.max_draws) {
+        return false;
+    }
+    const ta_spirv_layout *layout = NULL;
+    VkPipeline pipeline = ta_shader_pipeline_get(*culler.shaders, culler.pipeline, &layout);
+    if (!pipeline) {
+        return false;
+    }
+
+    VkDeviceSize draw_bytes = TA_MESHLET_DRAW_OFFSET +
+        (VkDeviceSize)meshlet_count * sizeof(VkDrawIndexedIndirectCommand);
+    ta_descriptor_write writes[2] = {};
+    writes[0].binding = 0;
+    writes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[0].buffer.buffer = mesh.buffer.buffer;
+    writes[0].buffer.offset = mesh.meshlet_offset;
+    writes[0].buffer.range = meshlet_count * sizeof(ta_mesh_meshlet);
+    writes[1].binding = 1;
+    writes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[1].buffer.buffer = culler.draws.buffer;
+    writes[1].buffer.range = draw_bytes;
+    VkDescriptorSet set = ta_descriptor_set_get(*culler.descriptors, layout->sets[0], writes, 2, true);
+    if (!set) {
+        return false;
+    }
+
+    // Zero the count and every slot, so without a count buffer the unused tail is empty draws. The previous frame's
+    // indirect reads have to be done first.
+    meshlet_barrier(command_buffer, culler.draws.buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(command_buffer, culler.draws.buffer, 0, draw_bytes, 0);
+    meshlet_barrier(command_buffer, culler.draws.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout->layout, 0, 1, &set, 0, NULL);
+    uint32_t dispatches = 0;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    for (size_t i = 0; i < mesh.submeshes.size(); ++i) {
+        const ta_mesh_submesh &submesh = mesh.submeshes[i];
+        if ((lods && lods[i]) || !submesh.meshlet_count) {
+            continue;
+        }
+        if (count && first + count == submesh.first_meshlet) {
+            count += submesh.meshlet_count;
+            continue;
+        }
+        meshlet_dispatch(command_buffer, *layout, culler.draws.buffer, constants, first, count, dispatches);
+        first = submesh.first_meshlet;
+        count = submesh.meshlet_count;
+    }
+    meshlet_dispatch(command_buffer, *layout, culler.draws.buffer, constants, first, count, dispatches);
+
+    meshlet_barrier(command_buffer, culler.draws.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    culler.culled = &mesh;
+    return true;
+}
+
+// CPU path: tests meshlets [first, first + count) and merges consecutive visible ones into one indexed draw
+static void meshlet_draw_visible(const ta_mesh &mesh, VkCommandBuffer command_buffer,
+    const ta_meshlet_cull_constants &constants, uint32_t first, uint32_t count)
+{
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    for (uint32_t i = first; i < first + count; ++i) {
+        const ta_mesh_meshlet &meshlet = mesh.meshlets[i];
+        if (!ta_meshlet_visible(meshlet, constants)) {
+            continue;
+        }
+        if (index_count && first_index + index_count == meshlet.first_index) {
+            index_count += meshlet.triangle_count * 3;
+            continue;
+        }
+        if (index_count) {
+            vkCmdDrawIndexed(command_buffer, index_count, 1, first_index, 0, 0);
+        }
+        first_index = meshlet.first_index;
+        index_count = meshlet.triangle_count * 3;
+    }
+    if (index_count) {
+        vkCmdDrawIndexed(command_buffer, index_count, 1, first_index, 0, 0);
+    }
+}
+
+// Draws submeshes [first_submesh, first_submesh + submesh_count) of a bound mesh (ta_mesh_bind) with whatever
+// pipeline is bound: the meshlets that survived culling, and each submesh at a simplified LOD whose bounding sphere
+// is in the frustum. lods has to be the same as for ta_meshlet_cull. GPU culled meshlets are one indirect call for
+// the whole mesh, made by the range that has submesh 0, sized by the shader's count if the device has
+// draw_indirect_count. Otherwise the visibility test runs here and consecutive visible meshlets are merged into one
+// indexed draw. Only reads the culler, so ranges can be recorded on different threads.
+void ta_meshlet_draw(const ta_meshlet_culler &culler, const ta_mesh &mesh, VkCommandBuffer command_buffer,
+    const ta_meshlet_cull_constants &constants, const uint32_t *lods, uint32_t first_submesh, uint32_t submesh_count)
+{
+    assert(first_submesh + submesh_count <= mesh.submeshes.size());
+    bool gpu_culled = culler.culled == &mesh;
+    if (gpu_culled && first_submesh == 0 && submesh_count) {
+        uint32_t meshlet_count = (uint32_t)mesh.meshlets.size();
+        uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        VkBuffer draws = culler.draws.buffer;
+        if (culler.draw_indirect_count) {
+            vkCmdDrawIndexedIndirectCountKHR(command_buffer, draws, TA_MESHLET_DRAW_OFFSET, draws, 0, meshlet_count,
+                stride);
+        } else if (culler.multi_draw_indirect) {
+            vkCmdDrawIndexedIndirect(command_buffer, draws, TA_MESHLET_DRAW_OFFSET, meshlet_count, stride);
+        } else {
+            for (uint32_t i = 0; i < meshlet_count; ++i) {
+                vkCmdDrawIndexedIndirect(command_buffer, draws, TA_MESHLET_DRAW_OFFSET + i * stride, 1, stride);
+            }
+        }
+    }
+
+    for (uint32_t i = first_submesh; i < first_submesh + submesh_count; ++i) {
+        const ta_mesh_submesh &submesh = mesh.submeshes[i];
+        uint32_t lod = lods ? lods[i] : 0;
+        if (!lod) {
+            if (!gpu_culled) {
+                meshlet_draw_visible(mesh, command_buffer, constants, submesh.first_meshlet, submesh.meshlet_count);
+            }
+        } else if (meshlet_sphere_in_frustum(submesh.bounds.center, submesh.bounds.radius, constants)) {
+            ta_mesh_draw_submesh(mesh, command_buffer, i, lod);
+        }
+    }
+}
+
+void ta_meshlet_culler_free(ta_meshlet_culler &culler, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    if (culler.draws.buffer) {
+        ta_vk_buffer_destroy(culler.draws, deletion_queue, frame);
+    }
+    culler = {};
+}
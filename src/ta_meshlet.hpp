@@ -0,0 +1,76 @@
+#pragma once
+#include "ta_descriptor.hpp"
+#include "ta_mesh.hpp"
+#include "ta_mesh_cook.hpp"
+#include "ta_shader.hpp"
+#include "ta_vk_buffer.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+
+// Meshlet size limits, NVIDIA's recommended mesh shader outputs
+#define TA_MESHLET_MAX_VERTICES     64
+#define TA_MESHLET_MAX_TRIANGLES    124
+// A meshlet whose normals spread past this (min dot with the cone axis) is only backfacing from nowhere useful
+#define TA_MESHLET_CONE_MIN_DOT     0.1f
+// A meshlet with at least this many triangles is closed early when the next triangle faces away from the rest by
+// more than acos(SPLIT_DOT). Costs a few more, smaller meshlets for cones narrow enough to be culled.
+#define TA_MESHLET_CONE_SPLIT_TRIANGLES 8
+#define TA_MESHLET_CONE_SPLIT_DOT       0.7f
+// Must match local_size_x in meshlet_cull.comp
+#define TA_MESHLET_CULL_GROUP_SIZE  64
+// Draw buffer written by the cull shader: uint count at 0, compacted VkDrawIndexedIndirectCommands from here on
+#define TA_MESHLET_DRAW_OFFSET      16
+
+// meshlet_cull.comp push constants, 116 bytes. Everything is in mesh space.
+typedef struct ta_meshlet_cull_constants {
+    float    frustum[6][4];         // normalized planes, xyz inward normal, w distance
+    float    camera_position[3];
+    uint32_t meshlet_count;         // range of the mesh's meshlets one dispatch culls, set by ta_meshlet_cull
+    uint32_t first_meshlet;
+} ta_meshlet_cull_constants;
+
+typedef struct ta_meshlet_stats {
+    uint32_t meshlets;
+    uint32_t cone_cullable;         // meshlets with a cone narrow enough to ever be backface culled
+    float    triangles_per_meshlet;
+    float    vertices_per_meshlet;
+} ta_meshlet_stats;
+
+// Meshlet culling for one mesh at a time. A compute pass tests every meshlet's bounding sphere against the frustum
+// and its normal cone against the camera, appends a draw for each survivor, and the draws go out in one indirect
+// call. Until the cull pipeline exists (or if its SPIR-V is missing) the same test runs on the CPU and runs of
+// visible meshlets are drawn as plain indexed draws.
+// Meshlets are full detail only. A submesh far enough away for a simplified LOD (ta_mesh_lod_select, one per
+// submesh) skips culling and is drawn as that LOD's index range if its bounding sphere is in the frustum.
+// NOTE: Meshlets are drawn through the regular vertex pipeline. The file carries meshlet vertex and micro-index
+// tables for a mesh shader path, which needs VK_NV_mesh_shader and newer headers than we have.
+typedef struct ta_meshlet_culler {
+    VkDevice                               device;
+    const VkPhysicalDeviceMemoryProperties *memory_properties;
+    ta_shader_library                      *shaders;
+    ta_descriptor_allocator                *descriptors;
+    ta_shader_pipeline_handle              pipeline;                // TA_SHADER_INVALID without the cull shader
+    bool                                   draw_indirect_count;     // VK_KHR_draw_indirect_count enabled
+    bool                                   multi_draw_indirect;
+    ta_vk_buffer                           draws;
+    uint32_t                               max_draws;
+    const ta_mesh                          *culled;                 // mesh the draw buffer holds draws for, if any
+} ta_meshlet_culler;
+
+ta_meshlet_stats ta_meshlet_build       (ta_mesh_data &data);
+ta_meshlet_cull_constants ta_meshlet_cull_setup(const float view_projection[16], const float camera_position[3]);
+bool ta_meshlet_visible                 (const ta_mesh_meshlet &meshlet, const ta_meshlet_cull_constants &constants);
+void ta_meshlet_culler_init             (ta_meshlet_culler &culler, VkDevice device,
+                                         const VkPhysicalDeviceMemoryProperties &memory_properties,
+                                         ta_shader_library &shaders, ta_descriptor_allocator &descriptors,
+                                         bool draw_indirect_count, bool multi_draw_indirect);
+VkResult ta_meshlet_culler_reserve      (ta_meshlet_culler &culler, uint32_t max_draws,
+                                         ta_deletion_queue &deletion_queue, uint64_t frame);
+bool ta_meshlet_cull                    (ta_meshlet_culler &culler, const ta_mesh &mesh,
+                                         VkCommandBuffer command_buffer, const ta_meshlet_cull_constants &constants,
+                                         const uint32_t *lods);
+void ta_meshlet_draw                    (const ta_meshlet_culler &culler, const ta_mesh &mesh,
+                                         VkCommandBuffer command_buffer, const ta_meshlet_cull_constants &constants,
+                                         const uint32_t *lods, uint32_t first_submesh, uint32_t submesh_count);
+void ta_meshlet_culler_free             (ta_meshlet_culler &culler, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame);
@@ -0,0 +1,666 @@
+#include "ta_obj.hpp"
+#include "ta_file_map.hpp"
+#include "ta_log.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#if _MSC_VER
+#include <intrin.h>
+#endif
+
+// Only for the benchmark
+#define TINYOBJ_LOADER_C_IMPLEMENTATION
+#include "misc/tinyobj_loader_c.h"
+
+// Smaller chunks aren't worth a job
+#define OBJ_CHUNK_MIN_BYTES (64 * 1024)
+// Chunks per thread, so one slow chunk (e.g. all faces) doesn't hold up the whole parse
+#define OBJ_CHUNKS_PER_THREAD 4
+// A uint64_t holds any 19 digit number
+#define OBJ_MAX_MANTISSA_DIGITS 19
+
+typedef enum obj_event_type {
+    OBJ_EVENT_NAME,         // o or g
+    OBJ_EVENT_MATERIAL,     // usemtl
+} obj_event_type;
+
+typedef struct obj_event {
+    obj_event_type type;
+    std::string    value;
+    uint32_t       triangle;    // first triangle it applies to, chunk-local until the merge
+} obj_event;
+
+// Parse results of one line-aligned slice of the file
+typedef struct obj_chunk {
+    const char                *begin;
+    const char                *end;
+    const char                *limit;       // end of the whole buffer, 8-byte reads may run past end but not this
+    std::vector<float>        positions;
+    std::vector<float>        texcoords;
+    std::vector<float>        normals;
+    std::vector<ta_obj_index> indices;
+    std::vector<uint32_t>     relative;     // index slots * 3 + component holding chunk-relative (negative) indices
+    std::vector<obj_event>    events;
+    uint32_t                  lines;
+    uint32_t                  error_line;   // chunk-local, 1-based, 0 if none
+    // Merge
+    uint32_t                  first_position;
+    uint32_t                  first_texcoord;
+    uint32_t                  first_normal;
+    uint32_t                  first_index;
+    uint32_t                  invalid_indices;
+} obj_chunk;
+
+typedef struct obj_merge {
+    ta_obj                 *obj;
+    std::vector<obj_chunk> *chunks;
+} obj_merge;
+
+static const double obj_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const uint64_t obj_pow10_u64[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull
+};
+
+static inline uint32_t obj_ctz64(uint64_t x)
+{
+#if _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward64(&index, x);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(x);
+#endif
+}
+
+// NOTE: The number parsing works on 8 characters at a time in a uint64_t (SWAR). chars holds them as loaded from
+// memory on a little-endian machine, so the first character is in the low byte.
+
+// How many of the 8 characters, from the first, are ASCII digits
+static inline uint32_t obj_digit_count8(uint64_t chars)
+{
+    // 0x33 in every byte that was '0'-'9': high nibble of c is 3, and so is the high nibble of c + 6
+    uint64_t classified = (chars & 0xF0F0F0F0F0F0F0F0ull) |
+        (((chars + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4);
+    uint64_t non_digits = classified ^ 0x3333333333333333ull;
+    return non_digits ? obj_ctz64(non_digits) / 8 : 8;
+}
+
+// Value of 8 ASCII digits, combining neighbors pairwise: 1-digit -> 2-digit -> 4-digit -> 8-digit lanes
+static inline uint32_t obj_parse_digits8(uint64_t chars)
+{
+    chars -= 0x3030303030303030ull;
+    chars = (chars * 10) + (chars >> 8);
+    chars = (((chars & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+        (((chars >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return (uint32_t)chars;
+}
+
+// Appends a run of digits to mantissa. Past OBJ_MAX_MANTISSA_DIGITS digits are counted in dropped instead.
+static const char *obj_parse_digits(const char *p, const char *limit, uint64_t &mantissa, uint32_t &digits,
+    uint32_t &dropped)
+{
+    while (limit - p >= 8) {
+        uint64_t chars = 0;
+        memcpy(&chars, p, sizeof(chars));
+        uint32_t count = obj_digit_count8(chars);
+        if (!count) {
+            return p;
+        }
+        if (digits + count > OBJ_MAX_MANTISSA_DIGITS) {
+            break;
+        }
+        if (count < 8) {
+            // Shift the digits to the top and fill the bottom with '0', i.e. leading zeros
+            chars = (chars << (8 * (8 - count))) | (0x3030303030303030ull >> (8 * count));
+        }
+        mantissa = mantissa * obj_pow10_u64[count] + obj_parse_digits8(chars);
+        digits += count;
+        p += count;
+        if (count < 8) {
+            return p;
+        }
+    }
+
+    // End of the buffer, or too many digits
+    while (p < limit && (uint32_t)(*p - '0') < 10) {
+        if (digits < OBJ_MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+            digits++;
+        } else {
+            dropped++;
+        }
+        p++;
+    }
+    return p;
+}
+
+// [+-]digits[.digits][(e|E)[+-]digits]. Returns NULL if there are no digits.
+static const char *obj_parse_float(const char *p, const char *limit, float *value)
+{
+    bool negative = false;
+    if (p < limit && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    uint32_t digits = 0;
+    uint32_t dropped = 0;
+    const char *start = p;
+    p = obj_parse_digits(p, limit, mantissa, digits, dropped);
+    int32_t exponent = (int32_t)dropped;
+    bool any_digits = p != start;
+    if (p < limit && *p == '.') {
+        p++;
+        uint32_t integer_digits = digits;
+        const char *fraction = p;
+        p = obj_parse_digits(p, limit, mantissa, digits, dropped);
+        exponent -= (int32_t)(digits - integer_digits);
+        any_digits |= p != fraction;
+    }
+    if (!any_digits) {
+        return NULL;
+    }
+
+    if (p < limit && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        bool negative_exponent = false;
+        if (e < limit && (*e == '-' || *e == '+')) {
+            negative_exponent = *e == '-';
+            e++;
+        }
+        int32_t e_value = 0;
+        const char *e_start = e;
+        while (e < limit && (uint32_t)(*e - '0') < 10) {
+            e_value = std::min(e_value * 10 + (*e - '0'), 1000);
+            e++;
+        }
+        if (e != e_start) {
+            exponent += negative_exponent ? -e_value : e_value;
+            p = e;
+        }
+    }
+
+    // NOTE: Powers of 10 up to 22 are exact in a double, so this is correctly rounded for everything a mesh exporter
+    // writes. Floats only need the result to be good to ~1e-9 relative anyway.
+    double result = (double)mantissa;
+    if (exponent < 0) {
+        result = exponent >= -22 ? result / obj_pow10[-exponent] : result * pow(10.0, exponent);
+    } else if (exponent > 0) {
+        result = exponent <= 22 ? result * obj_pow10[exponent] : result * pow(10.0, exponent);
+    }
+    *value = (float)(negative ? -result : result);
+    return p;
+}
+
+static const char *obj_parse_int(const char *p, const char *end, int32_t *value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    const char *start = p;
+    int64_t result = 0;
+    while (p < end && (uint32_t)(*p - '0') < 10) {
+        result = std::min(result * 10 + (*p - '0'), (int64_t)INT32_MAX);
+        p++;
+    }
+    if (p == start) {
+        return NULL;
+    }
+    *value = (int32_t)(negative ? -result : result);
+    return p;
+}
+
+static inline const char *obj_skip_space(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+static bool obj_parse_floats(obj_chunk &chunk, const char *p, const char *end, std::vector<float> &out,
+    uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        p = obj_skip_space(p, end);
+        float value = 0.0f;
+        // NOTE: Reads may go past the line end, the parse stops at the newline like at any other non-digit
+        p = p < end ? obj_parse_float(p, chunk.limit, &value) : NULL;
+        if (!p) {
+            return false;
+        }
+        out.push_back(value);
+    }
+    return true;
+}
+
+// 1-based absolute, or negative relative to the end of the attribute list so far
+static bool obj_resolve_index(int32_t value, uint32_t local_count, int32_t *index, bool *relative)
+{
+    if (value > 0) {
+        *index = value - 1;
+        *relative = false;
+        return true;
+    } else if (value < 0) {
+        *index = (int32_t)local_count + value;
+        *relative = true;
+        return true;
+    }
+    return false;
+}
+
+// v, v/vt, v//vn or v/vt/vn. relative gets a bit per component that is chunk-relative.
+static const char *obj_parse_corner(obj_chunk &chunk, const char *p, const char *end, ta_obj_index &corner,
+    uint32_t &relative)
+{
+    corner.v = corner.vt = corner.vn = TA_OBJ_NONE;
+    relative = 0;
+
+    int32_t value = 0;
+    bool is_relative = false;
+    p = obj_parse_int(p, end, &value);
+    if (!p || !obj_resolve_index(value, (uint32_t)chunk.positions.size() / 3, &corner.v, &is_relative)) {
+        return NULL;
+    }
+    relative |= is_relative ? 1 : 0;
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            p = obj_parse_int(p, end, &value);
+            if (!p || !obj_resolve_index(value, (uint32_t)chunk.texcoords.size() / 2, &corner.vt, &is_relative)) {
+                return NULL;
+            }
+            relative |= is_relative ? 2 : 0;
+        }
+        if (p < end && *p == '/') {
+            p++;
+            p = obj_parse_int(p, end, &value);
+            if (!p || !obj_resolve_index(value, (uint32_t)chunk.normals.size() / 3, &corner.vn, &is_relative)) {
+                return NULL;
+            }
+            relative |= is_relative ? 4 : 0;
+        }
+    }
+    return p;
+}
+
+static void obj_push_corner(obj_chunk &chunk, const ta_obj_index &corner, uint32_t relative)
+{
+    uint32_t slot = (uint32_t)chunk.indices.size() * 3;
+    for (uint32_t component = 0; component < 3; ++component) {
+        if (relative & (1u << component)) {
+            chunk.relative.push_back(slot + component);
+        }
+    }
+    chunk.indices.push_back(corner);
+}
+
+// Polygons become triangle fans around the first corner
+static bool obj_parse_face(obj_chunk &chunk, const char *p, const char *end)
+{
+    ta_obj_index first = {};
+    ta_obj_index previous = {};
+    uint32_t first_relative = 0;
+    uint32_t previous_relative = 0;
+    uint32_t count = 0;
+    for (;;) {
+        p = obj_skip_space(p, end);
+        if (p >= end || *p == '\r' || *p == '#') {
+            break;
+        }
+        ta_obj_index corner = {};
+        uint32_t relative = 0;
+        p = obj_parse_corner(chunk, p, end, corner, relative);
+        if (!p) {
+            return false;
+        }
+        if (count >= 2) {
+            obj_push_corner(chunk, first, first_relative);
+            obj_push_corner(chunk, previous, previous_relative);
+            obj_push_corner(chunk, corner, relative);
+        } else if (!count) {
+            first = corner;
+            first_relative = relative;
+        }
+        previous = corner;
+        previous_relative = relative;
+        count++;
+    }
+    return count >= 3;
+}
+
+static void obj_push_event(obj_chunk &chunk, obj_event_type type, const char *p, const char *end)
+{
+    p = obj_skip_space(p, end);
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        end--;
+    }
+    obj_event event = {};
+    event.type = type;
+    event.value.assign(p, end);
+    event.triangle = (uint32_t)chunk.indices.size() / 3;
+    chunk.events.push_back(event);
+}
+
+static inline bool obj_keyword(const char *p, const char *end, const char *keyword, size_t length)
+{
+    return (size_t)(end - p) > length && !memcmp(p, keyword, length) && (p[length] == ' ' || p[length] == '\t');
+}
+
+static void obj_parse_chunk(obj_chunk &chunk)
+{
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        const char *line_end = (const char *)memchr(p, '\n', (size_t)(chunk.end - p));
+        if (!line_end) {
+            line_end = chunk.end;
+        }
+        chunk.lines++;
+
+        p = obj_skip_space(p, line_end);
+        bool ok = true;
+        if (obj_keyword(p, line_end, "v", 1)) {
+            ok = obj_parse_floats(chunk, p + 2, line_end, chunk.positions, 3);
+        } else if (obj_keyword(p, line_end, "vt", 2)) {
+            ok = obj_parse_floats(chunk, p + 3, line_end, chunk.texcoords, 2);
+        } else if (obj_keyword(p, line_end, "vn", 2)) {
+            ok = obj_parse_floats(chunk, p + 3, line_end, chunk.normals, 3);
+        } else if (obj_keyword(p, line_end, "f", 1)) {
+            ok = obj_parse_face(chunk, p + 2, line_end);
+        } else if (obj_keyword(p, line_end, "o", 1) || obj_keyword(p, line_end, "g", 1)) {
+            obj_push_event(chunk, OBJ_EVENT_NAME, p + 2, line_end);
+        } else if (obj_keyword(p, line_end, "usemtl", 6)) {
+            obj_push_event(chunk, OBJ_EVENT_MATERIAL, p + 7, line_end);
+        }
+        // Everything else (comments, s, mtllib, l, p, ...) is ignored
+        if (!ok && !chunk.error_line) {
+            chunk.error_line = chunk.lines;
+        }
+        p = line_end + 1;
+    }
+}
+
+static void obj_parse_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    std::vector<obj_chunk> &chunks = *(std::vector<obj_chunk> *)userdata;
+    obj_parse_chunk(chunks[index]);
+}
+
+// Copies one chunk into the merged arrays at its offsets, rebasing relative indices and range checking all of them
+static void obj_merge_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    obj_merge &merge = *(obj_merge *)userdata;
+    ta_obj &obj = *merge.obj;
+    obj_chunk &chunk = (*merge.chunks)[index];
+
+    std::copy(chunk.positions.begin(), chunk.positions.end(), obj.positions.begin() + chunk.first_position * 3);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), obj.texcoords.begin() + chunk.first_texcoord * 2);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), obj.normals.begin() + chunk.first_normal * 3);
+
+    ta_obj_index *indices = obj.indices.data() + chunk.first_index;
+    std::copy(chunk.indices.begin(), chunk.indices.end(), indices);
+    const int32_t bases[3] = { (int32_t)chunk.first_position, (int32_t)chunk.first_texcoord,
+        (int32_t)chunk.first_normal };
+    for (uint32_t slot : chunk.relative) {
+        int32_t *components = &indices[slot / 3].v;
+        components[slot % 3] += bases[slot % 3];
+    }
+
+    const int32_t position_count = (int32_t)(obj.positions.size() / 3);
+    const int32_t texcoord_count = (int32_t)(obj.texcoords.size() / 2);
+    const int32_t normal_count = (int32_t)(obj.normals.size() / 3);
+    for (size_t i = 0; i < chunk.indices.size(); ++i) {
+        const ta_obj_index &corner = indices[i];
+        bool valid = corner.v >= 0 && corner.v < position_count &&
+            (corner.vt == TA_OBJ_NONE || (corner.vt >= 0 && corner.vt < texcoord_count)) &&
+            (corner.vn == TA_OBJ_NONE || (corner.vn >= 0 && corner.vn < normal_count));
+        if (!valid) {
+            chunk.invalid_indices++;
+        }
+    }
+}
+
+// Parses an OBJ held in memory. With jobs, the buffer is split into line-aligned chunks that are parsed in parallel
+// and then copied into place in parallel. Without, it's one chunk on the calling thread.
+// NOTE: Line continuations ('\' at the end of a line) aren't supported.
+bool ta_obj_parse(ta_obj &obj, const char *data, size_t size, ta_jobs *jobs)
+{
+    obj = {};
+    double start_ms = ta_timer_elapsed_ms();
+
+    uint32_t chunk_count = 1;
+    if (jobs) {
+        size_t max_chunks = (size_t)(jobs->worker_count + 1) * OBJ_CHUNKS_PER_THREAD;
+        chunk_count = (uint32_t)std::max((size_t)1, std::min(size / OBJ_CHUNK_MIN_BYTES, max_chunks));
+    }
+
+    std::vector<obj_chunk> chunks(chunk_count);
+    const char *end = data + size;
+    const char *begin = data;
+    for (uint32_t i = 0; i < chunk_count; ++i) {
+        const char *chunk_end = i + 1 < chunk_count ? data + size / chunk_count * (i + 1) : end;
+        if (chunk_end < begin) {
+            chunk_end = begin;
+        }
+        // Extend to the end of the line, so no line is split between chunks
+        const char *newline = (const char *)memchr(chunk_end, '\n', (size_t)(end - chunk_end));
+        chunk_end = newline ? newline + 1 : end;
+        if (i + 1 == chunk_count) {
+            chunk_end = end;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = chunk_end;
+        chunks[i].limit = end;
+        begin = chunk_end;
+    }
+
+    if (jobs) {
+        ta_jobs_parallel_for(*jobs, chunk_count, obj_parse_job, &chunks);
+    } else {
+        obj_parse_chunk(chunks[0]);
+    }
+    double parsed_ms = ta_timer_elapsed_ms();
+
+    uint32_t positions = 0;
+    uint32_t texcoords = 0;
+    uint32_t normals = 0;
+    uint32_t indices = 0;
+    uint32_t lines = 0;
+    for (obj_chunk &chunk : chunks) {
+        if (chunk.error_line) {
+            ta_log_write(tg_debug_log, SRC_FILE, "Failed to parse OBJ, line %u is malformed.\n",
+                lines + chunk.error_line);
+            return false;
+        }
+        chunk.first_position = positions;
+        chunk.first_texcoord = texcoords;
+        chunk.first_normal = normals;
+        chunk.first_index = indices;
+        positions += (uint32_t)chunk.positions.size() / 3;
+        texcoords += (uint32_t)chunk.texcoords.size() / 2;
+        normals += (uint32_t)chunk.normals.size() / 3;
+        indices += (uint32_t)chunk.indices.size();
+        lines += chunk.lines;
+    }
+    obj.positions.resize((size_t)positions * 3);
+    obj.texcoords.resize((size_t)texcoords * 2);
+    obj.normals.resize((size_t)normals * 3);
+    obj.indices.resize(indices);
+
+    obj_merge merge = {};
+    merge.obj = &obj;
+    merge.chunks = &chunks;
+    if (jobs) {
+        ta_jobs_parallel_for(*jobs, chunk_count, obj_merge_job, &merge);
+    } else {
+        obj_merge_job(&merge, 0, 0);
+    }
+
+    uint32_t invalid_indices = 0;
+    for (obj_chunk &chunk : chunks) {
+        invalid_indices += chunk.invalid_indices;
+    }
+    if (invalid_indices) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to parse OBJ, %u face indices are out of range.\n",
+            invalid_indices);
+        obj = {};
+        return false;
+    }
+
+    // Groups: every o/g/usemtl starts a new run, keeping the other half of the state
+    ta_obj_group group = {};
+    for (obj_chunk &chunk : chunks) {
+        for (obj_event &event : chunk.events) {
+            uint32_t triangle = chunk.first_index / 3 + event.triangle;
+            group.triangle_count = triangle - group.first_triangle;
+            if (group.triangle_count) {
+                obj.groups.push_back(group);
+            }
+            group.first_triangle = triangle;
+            if (event.type == OBJ_EVENT_NAME) {
+                group.name = event.value;
+            } else {
+                group.material = event.value;
+            }
+        }
+    }
+    group.triangle_count = indices / 3 - group.first_triangle;
+    if (group.triangle_count) {
+        obj.groups.push_back(group);
+    }
+
+    obj.chunk_count = chunk_count;
+    obj.parse_ms = parsed_ms - start_ms;
+    obj.merge_ms = ta_timer_elapsed_ms() - parsed_ms;
+    return true;
+}
+
+// Maps the file instead of reading it, the parse reads straight out of the page cache
+bool ta_obj_load(ta_obj &obj, const char *path, ta_jobs *jobs)
+{
+    ta_file_map map = {};
+    if (!ta_file_map_open(map, path)) {
+        return false;
+    }
+    bool ok = ta_obj_parse(obj, (const char *)map.data, map.size, jobs);
+    ta_file_map_close(map);
+    if (!ok) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to load '%s'.\n", path);
+    }
+    return ok;
+}
+
+// A (n+1)^2 vertex grid with v/vt/vn, written the way Blender writes floats
+static void obj_synthetic(std::string &text, uint32_t triangles)
+{
+    uint32_t n = std::max(1u, (uint32_t)sqrt(triangles / 2.0));
+    text.clear();
+    text.reserve((size_t)(n + 1) * (n + 1) * 96 + (size_t)n * n * 2 * 48);
+    char line[256];
+    for (uint32_t y = 0; y <= n; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            float u = (float)x / n;
+            float v = (float)y / n;
+            float height = 0.1f * sinf(u * 17.0f) * cosf(v * 13.0f);
+            int length = snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn %f %f %f\n", u * 2.0f - 1.0f, height,
+                v * 2.0f - 1.0f, u, v, 0.0f, 1.0f, 0.0f);
+            text.append(line, (size_t)length);
+        }
+    }
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            uint32_t a = y * (n + 1) + x + 1;
+            uint32_t b = a + 1;
+            uint32_t c = a + n + 1;
+            uint32_t d = c + 1;
+            int length = snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                a, a, a, c, c, c, b, b, b, b, b, b, c, c, c, d, d, d);
+            text.append(line, (size_t)length);
+        }
+    }
+}
+
+static void obj_benchmark_buffer(ta_jobs &jobs, const char *name, const char *data, size_t size)
+{
+    const int runs = 3;
+    double tinyobj_ms = 0.0;
+    double single_ms = 0.0;
+    double parallel_ms = 0.0;
+    uint32_t tinyobj_triangles = 0;
+    uint32_t tinyobj_positions = 0;
+    ta_obj obj = {};
+    for (int run = 0; run < runs; ++run) {
+        tinyobj_attrib_t attrib = {};
+        tinyobj_shape_t *shapes = NULL;
+        size_t shape_count = 0;
+        tinyobj_material_t *materials = NULL;
+        size_t material_count = 0;
+        double start_ms = ta_timer_elapsed_ms();
+        tinyobj_parse_obj(&attrib, &shapes, &shape_count, &materials, &material_count, data, size,
+            TINYOBJ_FLAG_TRIANGULATE);
+        double ms = ta_timer_elapsed_ms() - start_ms;
+        tinyobj_ms = run ? std::min(tinyobj_ms, ms) : ms;
+        tinyobj_triangles = attrib.num_face_num_verts;
+        tinyobj_positions = attrib.num_vertices;
+        tinyobj_attrib_free(&attrib);
+        tinyobj_shapes_free(shapes, shape_count);
+        tinyobj_materials_free(materials, material_count);
+
+        start_ms = ta_timer_elapsed_ms();
+        ta_obj_parse(obj, data, size, NULL);
+        ms = ta_timer_elapsed_ms() - start_ms;
+        single_ms = run ? std::min(single_ms, ms) : ms;
+
+        start_ms = ta_timer_elapsed_ms();
+        ta_obj_parse(obj, data, size, &jobs);
+        ms = ta_timer_elapsed_ms() - start_ms;
+        parallel_ms = run ? std::min(parallel_ms, ms) : ms;
+    }
+
+    double mb = size / (1024.0 * 1024.0);
+    ta_log_write(tg_debug_log, SRC_FILE, "%-24s %8.2fMB %9u tris  tinyobj %9.2fms  1 thread %9.2fms (%5.2fx)  "
+        "%u threads %9.2fms (%5.2fx, %6.0fMB/s)\n", name, mb, (uint32_t)obj.indices.size() / 3, tinyobj_ms, single_ms,
+        single_ms > 0.0 ? tinyobj_ms / single_ms : 0.0, jobs.worker_count + 1, parallel_ms,
+        parallel_ms > 0.0 ? tinyobj_ms / parallel_ms : 0.0, parallel_ms > 0.0 ? mb * 1000.0 / parallel_ms : 0.0);
+    if (tinyobj_triangles != obj.indices.size() / 3 || tinyobj_positions != obj.positions.size() / 3) {
+        ta_log_write(tg_debug_log, SRC_FILE, "    MISMATCH: tinyobj has %u triangles, %u positions\n",
+            tinyobj_triangles, tinyobj_positions);
+    }
+}
+
+// Best of 3 parses of each file (already mapped, so it's parse time only) and of a synthetic grid with the given
+// number of triangles, generated in memory. Speedups are relative to tinyobj.
+void ta_obj_benchmark(ta_jobs &jobs, const char *const *paths, uint32_t path_count, uint32_t synthetic_triangles)
+{
+    ta_log_write(tg_debug_log, SRC_FILE, "OBJ benchmark, best of 3:\n");
+    ta_log_indent(tg_debug_log);
+    for (uint32_t i = 0; i < path_count; ++i) {
+        ta_file_map map = {};
+        if (!ta_file_map_open(map, paths[i])) {
+            continue;
+        }
+        const char *name = strrchr(paths[i], '/');
+        obj_benchmark_buffer(jobs, name ? name + 1 : paths[i], (const char *)map.data, map.size);
+        ta_file_map_close(map);
+    }
+    if (synthetic_triangles) {
+        std::string text;
+        obj_synthetic(text, synthetic_triangles);
+        char name[32] = {};
+        snprintf(name, sizeof(name), "synthetic %uk", synthetic_triangles / 1000);
+        obj_benchmark_buffer(jobs, name, text.data(), text.size());
+    }
+    ta_log_unindent(tg_debug_log);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "ta_jobs.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TA_OBJ_NONE -1
+
+// One corner of a triangle. 0-based, vt/vn are TA_OBJ_NONE when the face didn't have them.
+typedef struct ta_obj_index {
+    int32_t v;
+    int32_t vt;
+    int32_t vn;
+} ta_obj_index;
+
+// A run of triangles with the same object/group name and material (o, g, usemtl)
+typedef struct ta_obj_group {
+    std::string name;
+    std::string material;
+    uint32_t    first_triangle;
+    uint32_t    triangle_count;
+} ta_obj_group;
+
+// Wavefront OBJ geometry, polygons triangulated as fans. mtllib isn't followed, materials are just names.
+typedef struct ta_obj {
+    std::vector<float>        positions;    // xyz
+    std::vector<float>        texcoords;    // uv
+    std::vector<float>        normals;      // xyz
+    std::vector<ta_obj_index> indices;      // 3 per triangle
+    std::vector<ta_obj_group> groups;       // in file order, empty ones dropped
+    // Stats
+    uint32_t                  chunk_count;
+    double                    parse_ms;
+    double                    merge_ms;
+} ta_obj;
+
+bool ta_obj_parse                       (ta_obj &obj, const char *data, size_t size, ta_jobs *jobs);
+bool ta_obj_load                        (ta_obj &obj, const char *path, ta_jobs *jobs);
+void ta_obj_benchmark                   (ta_jobs &jobs, const char *const *paths, uint32_t path_count,
+                                         uint32_t synthetic_triangles);
@@ -0,0 +1,439 @@
+#include "ta_pipeline_cache.hpp"
+#include "ta_hash.hpp"
+#include "ta_timer.hpp"
+#include "SDL/SDL_mutex.h"
+#include <algorithm>
+#include <cassert>
+
+// NOTE: The Vulkan structs hashed with ta_hash_bytes below are all 4-byte fields (VkSpecializationMapEntry ends in a
+// size_t, which still leaves no padding), so hashing them raw doesn't pick up garbage.
+static uint64_t pipeline_hash_shader(uint64_t hash, const ta_pipeline_shader &shader)
+{
+    hash = ta_hash_u64(hash, shader.stage);
+    hash = ta_hash_u64(hash, shader.code_hash ? shader.code_hash : TA_VK_HANDLE(shader.module));
+    hash = ta_hash_str(hash, shader.entry_point.c_str());
+    hash = ta_hash_bytes(hash, shader.spec_entries.data(),
+        shader.spec_entries.size() * sizeof(VkSpecializationMapEntry));
+    hash = ta_hash_bytes(hash, shader.spec_data.data(), shader.spec_data.size());
+    return hash;
+}
+
+uint64_t ta_pipeline_hash_graphics(const ta_graphics_pipeline_desc &desc)
+{
+    uint64_t hash = ta_hash_u64(TA_HASH_SEED, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    for (const ta_pipeline_shader &shader : desc.shaders) {
+        hash = pipeline_hash_shader(hash, shader);
+    }
+    hash = ta_hash_bytes(hash, desc.vertex_bindings.data(),
+        desc.vertex_bindings.size() * sizeof(VkVertexInputBindingDescription));
+    hash = ta_hash_bytes(hash, desc.vertex_attributes.data(),
+        desc.vertex_attributes.size() * sizeof(VkVertexInputAttributeDescription));
+    hash = ta_hash_u64(hash, desc.topology);
+    hash = ta_hash_u64(hash, desc.polygon_mode);
+    hash = ta_hash_u64(hash, desc.cull_mode);
+    hash = ta_hash_u64(hash, desc.front_face);
+    hash = ta_hash_u64(hash, desc.depth_test);
+    hash = ta_hash_u64(hash, desc.depth_write);
+    hash = ta_hash_u64(hash, desc.depth_compare);
+    hash = ta_hash_u64(hash, desc.samples);
+    hash = ta_hash_bytes(hash, desc.blend_attachments.data(),
+        desc.blend_attachments.size() * sizeof(VkPipelineColorBlendAttachmentState));
+    hash = ta_hash_u64(hash, TA_VK_HANDLE(desc.layout));
+    hash = ta_hash_u64(hash, TA_VK_HANDLE(desc.render_pass));
+    hash = ta_hash_u64(hash, desc.subpass);
+    return hash;
+}
+
+uint64_t ta_pipeline_hash_compute(const ta_compute_pipeline_desc &desc)
+{
+    uint64_t hash = ta_hash_u64(TA_HASH_SEED, VK_PIPELINE_BIND_POINT_COMPUTE);
+    hash = pipeline_hash_shader(hash, desc.shader);
+    hash = ta_hash_u64(hash, TA_VK_HANDLE(desc.layout));
+    return hash;
+}
+
+// Opaque triangles, back face culling, depth test + write, one color attachment
+void ta_graphics_pipeline_desc_init(ta_graphics_pipeline_desc &desc, VkPipelineLayout layout, VkRenderPass render_pass)
+{
+    desc = {};
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.polygon_mode = VK_POLYGON_MODE_FILL;
+    desc.cull_mode = VK_CULL_MODE_BACK_BIT;
+    desc.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    desc.depth_test = true;
+    desc.depth_write = true;
+    desc.depth_compare = VK_COMPARE_OP_LESS;
+    desc.samples = VK_SAMPLE_COUNT_1_BIT;
+    desc.layout = layout;
+    desc.render_pass = render_pass;
+
+    VkPipelineColorBlendAttachmentState blend = {};
+    blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+        VK_COLOR_COMPONENT_A_BIT;
+    desc.blend_attachments.push_back(blend);
+}
+
+VkResult ta_pipeline_cache_init(ta_pipeline_cache &cache, VkDevice device, ta_jobs &jobs)
+{
+    cache.device = device;
+    cache.jobs = &jobs;
+    cache.own_jobs = NULL;
+    // NOTE: ta_jobs_background runs inline without workers (e.g. "--threads 0" or a single core), which would
+    // compile on the render thread. Keep one worker of our own around for that case.
+    if (!jobs.worker_count) {
+        cache.own_jobs = new ta_jobs();
+        ta_jobs_init(*cache.own_jobs, 1);
+        if (!cache.own_jobs->worker_count) {
+            ta_log_write_level(tg_debug_log, SRC_VULKAN, LEVEL_WARN, "No pipeline compile worker, pipeline cache "
+                "misses will stall the frame.\n");
+        }
+        cache.jobs = cache.own_jobs;
+    }
+    cache.entries.clear();
+    cache.in_flight = 0;
+    cache.shutting_down = false;
+    cache.hits = 0;
+    cache.misses = 0;
+    cache.not_ready = 0;
+    cache.compiled = 0;
+    cache.failed = 0;
+    cache.compile_ms_total = 0.0;
+    cache.compile_ms_max = 0.0;
+    cache.mutex = SDL_CreateMutex();
+    cache.idle = SDL_CreateCond();
+    assert(cache.mutex && cache.idle);
+
+    VkPipelineCacheCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    VkResult err = vkCreatePipelineCache(device, &create_info, NULL, &cache.driver_cache);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create pipeline cache.\n", err);
+    }
+    return err;
+}
+
+static void pipeline_shader_stage(const ta_pipeline_shader &shader, VkSpecializationInfo &spec_info,
+    VkPipelineShaderStageCreateInfo &stage)
+{
+    spec_info = {};
+    spec_info.mapEntryCount = (uint32_t)shader.spec_entries.size();
+    spec_info.pMapEntries = shader.spec_entries.data();
+    spec_info.dataSize = shader.spec_data.size();
+    spec_info.pData = shader.spec_data.data();
+
+    stage = {};
+    stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage.stage = shader.stage;
+    stage.module = shader.module;
+    stage.pName = shader.entry_point.empty() ? "main" : shader.entry_point.c_str();
+    stage.pSpecializationInfo = spec_info.mapEntryCount ? &spec_info : NULL;
+}
+
+static VkResult pipeline_create_graphics(ta_pipeline_cache &cache, const ta_graphics_pipeline_desc &desc,
+    VkPipeline *pipeline)
+{
+    std::vector<VkSpecializationInfo> spec_infos(desc.shaders.size());
+    std::vector<VkPipelineShaderStageCreateInfo> stages(desc.shaders.size());
+    for (size_t i = 0; i < desc.shaders.size(); ++i) {
+        pipeline_shader_stage(desc.shaders[i], spec_infos[i], stages[i]);
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = (uint32_t)desc.vertex_bindings.size();
+    vertex_input.pVertexBindingDescriptions = desc.vertex_bindings.data();
+    vertex_input.vertexAttributeDescriptionCount = (uint32_t)desc.vertex_attributes.size();
+    vertex_input.pVertexAttributeDescriptions = desc.vertex_attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = desc.topology;
+
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = desc.polygon_mode;
+    rasterization.cullMode = desc.cull_mode;
+    rasterization.frontFace = desc.front_face;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = desc.samples;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = desc.depth_test;
+    depth_stencil.depthWriteEnable = desc.depth_write;
+    depth_stencil.depthCompareOp = desc.depth_compare;
+
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = (uint32_t)desc.blend_attachments.size();
+    blend.pAttachments = desc.blend_attachments.data();
+
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = sizeof(dynamic_states) / sizeof(dynamic_states[0]);
+    dynamic.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.stageCount = (uint32_t)stages.size();
+    create_info.pStages = stages.data();
+    create_info.pVertexInputState = &vertex_input;
+    create_info.pInputAssemblyState = &input_assembly;
+    create_info.pViewportState = &viewport;
+    create_info.pRasterizationState = &rasterization;
+    create_info.pMultisampleState = &multisample;
+    create_info.pDepthStencilState = &depth_stencil;
+    create_info.pColorBlendState = &blend;
+    create_info.pDynamicState = &dynamic;
+    create_info.layout = desc.layout;
+    create_info.renderPass = desc.render_pass;
+    create_info.subpass = desc.subpass;
+    return vkCreateGraphicsPipelines(cache.device, cache.driver_cache, 1, &create_info, NULL, pipeline);
+}
+
+static VkResult pipeline_create_compute(ta_pipeline_cache &cache, const ta_compute_pipeline_desc &desc,
+    VkPipeline *pipeline)
+{
+    VkSpecializationInfo spec_info = {};
+    VkComputePipelineCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_shader_stage(desc.shader, spec_info, create_info.stage);
+    create_info.layout = desc.layout;
+    return vkCreateComputePipelines(cache.device, cache.driver_cache, 1, &create_info, NULL, pipeline);
+}
+
+static void pipeline_compile_job(void *userdata, uint32_t index, uint32_t worker)
+{
+    (void)index;
+    (void)worker;
+    ta_pipeline_entry *entry = (ta_pipeline_entry *)userdata;
+    ta_pipeline_cache &cache = *entry->cache;
+
+    SDL_LockMutex(cache.mutex);
+    bool skip = cache.shutting_down || entry->evicted;
+    SDL_UnlockMutex(cache.mutex);
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult err = VK_SUCCESS;
+    double start_ms = ta_timer_elapsed_ms();
+    if (!skip) {
+        if (entry->bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+            err = pipeline_create_graphics(cache, entry->graphics, &pipeline);
+        } else {
+            err = pipeline_create_compute(cache, entry->compute, &pipeline);
+        }
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to compile pipeline %016llx.\n", err,
+                (unsigned long long)entry->hash);
+        }
+    }
+    double compile_ms = ta_timer_elapsed_ms() - start_ms;
+
+    SDL_LockMutex(cache.mutex);
+    if (entry->evicted) {
+        // Never handed out, so nothing can be using it
+        if (pipeline) {
+            vkDestroyPipeline(cache.device, pipeline, NULL);
+        }
+        delete entry;
+    } else {
+        entry->pipeline = pipeline;
+        entry->compile_ms = compile_ms;
+        entry->status = pipeline ? PIPELINE_STATUS_READY : PIPELINE_STATUS_FAILED;
+        entry->graphics = {};
+        entry->compute = {};
+        if (pipeline) {
+            cache.compiled++;
+            cache.compile_ms_total += compile_ms;
+            cache.compile_ms_max = std::max(cache.compile_ms_max, compile_ms);
+        } else if (!skip) {
+            cache.failed++;
+        }
+    }
+    assert(cache.in_flight);
+    cache.in_flight--;
+    if (!cache.in_flight) {
+        SDL_CondBroadcast(cache.idle);
+    }
+    SDL_UnlockMutex(cache.mutex);
+}
+
+// NOTE: Must be called with cache.mutex held. Counts the request as a hit or miss.
+static ta_pipeline_entry *pipeline_cache_find(ta_pipeline_cache &cache, uint64_t hash)
+{
+    auto it = cache.entries.find(hash);
+    if (it == cache.entries.end()) {
+        cache.misses++;
+        return NULL;
+    }
+    cache.hits++;
+    return it->second;
+}
+
+static VkPipeline pipeline_cache_result(ta_pipeline_cache &cache, const ta_pipeline_entry &entry, VkPipeline fallback)
+{
+    if (entry.status == PIPELINE_STATUS_READY) {
+        return entry.pipeline;
+    }
+    cache.not_ready++;
+    return fallback;
+}
+
+// NOTE: Called with cache.mutex held, releases it before queueing the job
+static void pipeline_cache_queue(ta_pipeline_cache &cache, ta_pipeline_entry *entry)
+{
+    cache.entries[entry->hash] = entry;
+    cache.in_flight++;
+    cache.not_ready++;
+    SDL_UnlockMutex(cache.mutex);
+    ta_jobs_background(*cache.jobs, pipeline_compile_job, entry);
+}
+
+// Returns the cached pipeline for desc. On a miss, or while it's still compiling, returns fallback instead; pass
+// VK_NULL_HANDLE to mean "skip the draw".
+VkPipeline ta_pipeline_cache_graphics(ta_pipeline_cache &cache, const ta_graphics_pipeline_desc &desc,
+    VkPipeline fallback)
+{
+    uint64_t hash = ta_pipeline_hash_graphics(desc);
+
+    SDL_LockMutex(cache.mutex);
+    ta_pipeline_entry *entry = pipeline_cache_find(cache, hash);
+    if (entry) {
+        VkPipeline pipeline = pipeline_cache_result(cache, *entry, fallback);
+        SDL_UnlockMutex(cache.mutex);
+        return pipeline;
+    }
+
+    entry = new ta_pipeline_entry();
+    entry->cache = &cache;
+    entry->hash = hash;
+    entry->bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    entry->status = PIPELINE_STATUS_PENDING;
+    entry->graphics = desc;
+    pipeline_cache_queue(cache, entry);
+    return fallback;
+}
+
+VkPipeline ta_pipeline_cache_compute(ta_pipeline_cache &cache, const ta_compute_pipeline_desc &desc,
+    VkPipeline fallback)
+{
+    uint64_t hash = ta_pipeline_hash_compute(desc);
+
+    SDL_LockMutex(cache.mutex);
+    ta_pipeline_entry *entry = pipeline_cache_find(cache, hash);
+    if (entry) {
+        VkPipeline pipeline = pipeline_cache_result(cache, *entry, fallback);
+        SDL_UnlockMutex(cache.mutex);
+        return pipeline;
+    }
+
+    entry = new ta_pipeline_entry();
+    entry->cache = &cache;
+    entry->hash = hash;
+    entry->bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+    entry->status = PIPELINE_STATUS_PENDING;
+    entry->compute = desc;
+    pipeline_cache_queue(cache, entry);
+    return fallback;
+}
+
+// FAILED if the hash was never requested. Doesn't count towards hits/misses. pipeline (optional) is set once READY.
+ta_pipeline_status ta_pipeline_cache_status(ta_pipeline_cache &cache, uint64_t hash, VkPipeline *pipeline)
+{
+    SDL_LockMutex(cache.mutex);
+    auto it = cache.entries.find(hash);
+    ta_pipeline_status status = it == cache.entries.end() ? PIPELINE_STATUS_FAILED : it->second->status;
+    if (pipeline) {
+        *pipeline = status == PIPELINE_STATUS_READY ? it->second->pipeline : VK_NULL_HANDLE;
+    }
+    SDL_UnlockMutex(cache.mutex);
+    return status;
+}
+
+// True when no compile jobs are queued or running, i.e. nothing is reading shader modules handed to the cache
+bool ta_pipeline_cache_idle(ta_pipeline_cache &cache)
+{
+    SDL_LockMutex(cache.mutex);
+    bool idle = cache.in_flight == 0;
+    SDL_UnlockMutex(cache.mutex);
+    return idle;
+}
+
+// Drops a pipeline so the next request recompiles it (e.g. its shader changed). A pipeline that's still compiling is
+// cleaned up by its job instead.
+void ta_pipeline_cache_evict(ta_pipeline_cache &cache, uint64_t hash, ta_deletion_queue &deletion_queue,
+    uint64_t frame)
+{
+    SDL_LockMutex(cache.mutex);
+    auto it = cache.entries.find(hash);
+    if (it != cache.entries.end()) {
+        ta_pipeline_entry *entry = it->second;
+        cache.entries.erase(it);
+        if (entry->status == PIPELINE_STATUS_PENDING) {
+            entry->evicted = true;
+        } else {
+            if (entry->pipeline) {
+                ta_deletion_queue_push(deletion_queue, DELETION_PIPELINE, TA_VK_HANDLE(entry->pipeline), frame);
+            }
+            delete entry;
+        }
+    }
+    SDL_UnlockMutex(cache.mutex);
+}
+
+void ta_pipeline_cache_report(ta_pipeline_cache &cache, ta_log &log)
+{
+    SDL_LockMutex(cache.mutex);
+    uint64_t requests = cache.hits + cache.misses;
+    ta_log_write(log, SRC_VULKAN, "Pipeline cache: %u pipelines, %llu requests, %llu hits (%.1f%%), %llu misses, "
+        "%llu answered with fallback\n", (uint32_t)cache.entries.size(), (unsigned long long)requests,
+        (unsigned long long)cache.hits, requests ? 100.0 * cache.hits / requests : 0.0,
+        (unsigned long long)cache.misses, (unsigned long long)cache.not_ready);
+    ta_log_write(log, SRC_VULKAN, "Pipeline cache: %u compiled (avg %.3fms, max %.3fms), %u failed, %u in flight\n",
+        cache.compiled, cache.compiled ? cache.compile_ms_total / cache.compiled : 0.0, cache.compile_ms_max,
+        cache.failed, cache.in_flight);
+    SDL_UnlockMutex(cache.mutex);
+}
+
+// Waits for in-flight compiles (queued ones bail out early), then hands every pipeline to the deletion queue
+void ta_pipeline_cache_free(ta_pipeline_cache &cache, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    ta_pipeline_cache_report(cache, tg_debug_log);
+
+    SDL_LockMutex(cache.mutex);
+    cache.shutting_down = true;
+    while (cache.in_flight) {
+        SDL_CondWait(cache.idle, cache.mutex);
+    }
+    for (auto &it : cache.entries) {
+        if (it.second->pipeline) {
+            ta_deletion_queue_push(deletion_queue, DELETION_PIPELINE, TA_VK_HANDLE(it.second->pipeline), frame);
+        }
+        delete it.second;
+    }
+    cache.entries.clear();
+    SDL_UnlockMutex(cache.mutex);
+
+    if (cache.own_jobs) {
+        ta_jobs_free(*cache.own_jobs);
+        delete cache.own_jobs;
+        cache.own_jobs = NULL;
+    }
+    cache.jobs = NULL;
+
+    vkDestroyPipelineCache(cache.device, cache.driver_cache, NULL);
+    cache.driver_cache = VK_NULL_HANDLE;
+    SDL_DestroyCond(cache.idle);
+    SDL_DestroyMutex(cache.mutex);
+    cache.idle = NULL;
+    cache.mutex = NULL;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_jobs.hpp"
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef struct SDL_mutex SDL_mutex;
+typedef struct SDL_cond SDL_cond;
+
+typedef struct ta_pipeline_shader {
+    VkShaderStageFlagBits                 stage;
+    VkShaderModule                        module;
+    uint64_t                              code_hash;    // hash of the SPIR-V, 0 to key on the module handle instead
+    std::string                           entry_point;
+    std::vector<VkSpecializationMapEntry> spec_entries;
+    std::vector<uint8_t>                  spec_data;
+} ta_pipeline_shader;
+
+// Everything that goes into a graphics pipeline. Viewport and scissor are always dynamic so they don't fragment the
+// cache.
+typedef struct ta_graphics_pipeline_desc {
+    std::vector<ta_pipeline_shader>                  shaders;
+    std::vector<VkVertexInputBindingDescription>     vertex_bindings;
+    std::vector<VkVertexInputAttributeDescription>   vertex_attributes;
+    VkPrimitiveTopology                              topology;
+    VkPolygonMode                                    polygon_mode;
+    VkCullModeFlags                                  cull_mode;
+    VkFrontFace                                      front_face;
+    bool                                             depth_test;
+    bool                                             depth_write;
+    VkCompareOp                                      depth_compare;
+    VkSampleCountFlagBits                            samples;
+    std::vector<VkPipelineColorBlendAttachmentState> blend_attachments;  // one per color attachment
+    VkPipelineLayout                                 layout;
+    VkRenderPass                                     render_pass;
+    uint32_t                                         subpass;
+} ta_graphics_pipeline_desc;
+
+typedef struct ta_compute_pipeline_desc {
+    ta_pipeline_shader shader;
+    VkPipelineLayout   layout;
+} ta_compute_pipeline_desc;
+
+typedef enum ta_pipeline_status {
+    PIPELINE_STATUS_PENDING,    // queued or compiling on a worker
+    PIPELINE_STATUS_READY,
+    PIPELINE_STATUS_FAILED,
+} ta_pipeline_status;
+
+struct ta_pipeline_cache;
+
+typedef struct ta_pipeline_entry {
+    struct ta_pipeline_cache  *cache;
+    uint64_t                  hash;
+    VkPipelineBindPoint       bind_point;
+    ta_pipeline_status        status;       // protected by cache mutex
+    VkPipeline                pipeline;     // valid once READY
+    double                    compile_ms;
+    bool                      evicted;      // removed from the cache while compiling, the job cleans it up
+    // Owned copy of the description, only needed until the compile job is done
+    ta_graphics_pipeline_desc graphics;
+    ta_compute_pipeline_desc  compute;
+} ta_pipeline_entry;
+
+// Pipelines keyed by a 64-bit hash of their full state. A miss never compiles on the calling thread: it queues a
+// background job and returns the caller's fallback (or VK_NULL_HANDLE, meaning skip the draw) until the pipeline is
+// ready, so a frame never blocks on vkCreate*Pipelines.
+// NOTE: Entries are keyed on the hash alone, a 64-bit collision would hand back the wrong pipeline. With the number
+// of pipelines we have that's not worth a full compare.
+typedef struct ta_pipeline_cache {
+    VkDevice                                          device;
+    VkPipelineCache                                   driver_cache;     // shared by all workers, internally synced
+    ta_jobs                                           *jobs;
+    ta_jobs                                           *own_jobs;        // one worker of our own if jobs has none
+    SDL_mutex                                         *mutex;
+    SDL_cond                                          *idle;            // signaled when in_flight drops to 0
+    std::unordered_map<uint64_t, ta_pipeline_entry *> entries;
+    uint32_t                                          in_flight;
+    bool                                              shutting_down;
+    // Stats
+    uint64_t                                          hits;
+    uint64_t                                          misses;
+    uint64_t                                          not_ready;        // requests answered with the fallback
+    uint32_t                                          compiled;
+    uint32_t                                          failed;
+    double                                            compile_ms_total;
+    double                                            compile_ms_max;
+} ta_pipeline_cache;
+
+uint64_t ta_pipeline_hash_graphics      (const ta_graphics_pipeline_desc &desc);
+uint64_t ta_pipeline_hash_compute       (const ta_compute_pipeline_desc &desc);
+void ta_graphics_pipeline_desc_init     (ta_graphics_pipeline_desc &desc, VkPipelineLayout layout,
+                                         VkRenderPass render_pass);
+VkResult ta_pipeline_cache_init         (ta_pipeline_cache &cache, VkDevice device, ta_jobs &jobs);
+VkPipeline ta_pipeline_cache_graphics   (ta_pipeline_cache &cache, const ta_graphics_pipeline_desc &desc,
+                                         VkPipeline fallback);
+VkPipeline ta_pipeline_cache_compute    (ta_pipeline_cache &cache, const ta_compute_pipeline_desc &desc,
+                                         VkPipeline fallback);
+ta_pipeline_status ta_pipeline_cache_status(ta_pipeline_cache &cache, uint64_t hash, VkPipeline *pipeline);
+bool ta_pipeline_cache_idle             (ta_pipeline_cache &cache);
+void ta_pipeline_cache_evict            (ta_pipeline_cache &cache, uint64_t hash, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame);
+void ta_pipeline_cache_report           (ta_pipeline_cache &cache, ta_log &log);
+void ta_pipeline_cache_free             (ta_pipeline_cache &cache, ta_deletion_queue &deletion_queue, uint64_t frame);
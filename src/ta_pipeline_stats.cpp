@@ -0,0 +1,299 @@
+#include "ta_pipeline_stats.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#define PIPELINE_STATS_FLAGS (VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT)
+// Values the statistics query writes per scope, everything but SAMPLES_PASSED
+#define PIPELINE_STATS_VALUES PIPELINE_STAT_SAMPLES_PASSED
+
+const char *ta_pipeline_stat_str(ta_pipeline_stat stat) {
+    switch (stat) {
+        case PIPELINE_STAT_IA_VERTICES:      return "ia_vertices";
+        case PIPELINE_STAT_IA_PRIMITIVES:    return "ia_primitives";
+        case PIPELINE_STAT_VS_INVOCATIONS:   return "vs_invocations";
+        case PIPELINE_STAT_CLIP_INVOCATIONS: return "clip_invocations";
+        case PIPELINE_STAT_CLIP_PRIMITIVES:  return "clip_primitives";
+        case PIPELINE_STAT_FS_INVOCATIONS:   return "fs_invocations";
+        case PIPELINE_STAT_CS_INVOCATIONS:   return "cs_invocations";
+        case PIPELINE_STAT_SAMPLES_PASSED:   return "samples_passed";
+        default:                             return "UNKNOWN";
+    }
+}
+
+// Needs VkPhysicalDeviceFeatures::pipelineStatisticsQuery enabled on the device. When disabled every call is a no-op,
+// so callers don't have to check.
+VkResult ta_pipeline_stats_init(ta_pipeline_stats &stats, VkDevice device, bool enabled, uint32_t frames_in_flight,
+    uint32_t window_frames)
+{
+    assert(frames_in_flight);
+    assert(window_frames);
+    stats.device = device;
+    stats.enabled = enabled;
+    stats.window_frames = window_frames;
+    stats.window_count = 0;
+    stats.windows_published = 0;
+    stats.current = 0;
+    stats.slots.clear();
+    stats.accumulating.clear();
+    stats.published.clear();
+    if (!enabled) {
+        return VK_SUCCESS;
+    }
+
+    stats.results.resize(TA_PIPELINE_STATS_MAX_SCOPES * PIPELINE_STAT_COUNT);
+    stats.slots.resize(frames_in_flight);
+    for (ta_pipeline_stats_slot &slot : stats.slots) {
+        slot.scopes.reserve(TA_PIPELINE_STATS_MAX_SCOPES);
+
+        VkQueryPoolCreateInfo query_pool_create_info = {};
+        query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_pool_create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        query_pool_create_info.queryCount = TA_PIPELINE_STATS_MAX_SCOPES;
+        query_pool_create_info.pipelineStatistics = PIPELINE_STATS_FLAGS;
+        VkResult err = vkCreateQueryPool(device, &query_pool_create_info, NULL, &slot.statistics_pool);
+        if (!err) {
+            query_pool_create_info.queryType = VK_QUERY_TYPE_OCCLUSION;
+            query_pool_create_info.pipelineStatistics = 0;
+            err = vkCreateQueryPool(device, &query_pool_create_info, NULL, &slot.occlusion_pool);
+        }
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_GPU, "[%u] Failed to create pipeline statistics query pools.\n", err);
+            return err;
+        }
+    }
+    ta_log_write(tg_debug_log, SRC_GPU, "Pipeline statistics: enabled, averaged over %u frames\n", window_frames);
+    return VK_SUCCESS;
+}
+
+static ta_pipeline_stats_pass *pipeline_stats_pass_get(std::vector<ta_pipeline_stats_pass> &passes,
+    const std::string &name)
+{
+    for (ta_pipeline_stats_pass &pass : passes) {
+        if (pass.name == name) {
+            return &pass;
+        }
+    }
+    ta_pipeline_stats_pass pass = {};
+    pass.name = name;
+    passes.push_back(pass);
+    return &passes.back();
+}
+
+static void pipeline_stats_read(ta_pipeline_stats &stats, ta_pipeline_stats_slot &slot)
+{
+    uint32_t query_count = (uint32_t)slot.scopes.size();
+    if (!query_count) {
+        return;
+    }
+
+    // Same deal as the timestamp profiler: the slot's fence has been waited on, so don't ask the driver to wait
+    uint64_t *statistics = stats.results.data();
+    uint64_t *occlusion = statistics + query_count * PIPELINE_STATS_VALUES;
+    VkDeviceSize stride = PIPELINE_STATS_VALUES * sizeof(uint64_t);
+    VkResult err = vkGetQueryPoolResults(stats.device, slot.statistics_pool, 0, query_count, query_count * stride,
+        statistics, stride, VK_QUERY_RESULT_64_BIT);
+    if (!err) {
+        err = vkGetQueryPoolResults(stats.device, slot.occlusion_pool, 0, query_count,
+            query_count * sizeof(uint64_t), occlusion, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    }
+    if (err) {
+        if (err != VK_NOT_READY) {
+            ta_log_write(tg_debug_log, SRC_GPU, "[%u] Failed to read pipeline statistics queries.\n", err);
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < query_count; ++i) {
+        if (!slot.scopes[i].closed) {
+            continue;
+        }
+        ta_pipeline_stats_pass *pass = pipeline_stats_pass_get(stats.accumulating, slot.scopes[i].name);
+        for (int stat = 0; stat < PIPELINE_STATS_VALUES; ++stat) {
+            pass->counters[stat] += (double)statistics[i * PIPELINE_STATS_VALUES + stat];
+        }
+        pass->counters[PIPELINE_STAT_SAMPLES_PASSED] += (double)occlusion[i];
+        pass->frames++;
+    }
+    stats.window_count++;
+}
+
+static void pipeline_stats_publish(ta_pipeline_stats &stats)
+{
+    for (ta_pipeline_stats_pass &pass : stats.accumulating) {
+        for (double &counter : pass.counters) {
+            counter /= pass.frames;
+        }
+    }
+    stats.published.swap(stats.accumulating);
+    stats.accumulating.clear();
+    stats.window_count = 0;
+    stats.windows_published++;
+}
+
+// Call right after vkBeginCommandBuffer, once this frame slot's fence has been waited on. Returns true if a new
+// window of averages was just published.
+bool ta_pipeline_stats_begin_frame(ta_pipeline_stats &stats, VkCommandBuffer command_buffer, uint64_t frame_number)
+{
+    if (!stats.enabled) {
+        return false;
+    }
+
+    stats.current = (uint32_t)(frame_number % stats.slots.size());
+    ta_pipeline_stats_slot &slot = stats.slots[stats.current];
+    bool published = false;
+    if (slot.pending) {
+        pipeline_stats_read(stats, slot);
+        slot.pending = false;
+        if (stats.window_count >= stats.window_frames) {
+            pipeline_stats_publish(stats);
+            published = true;
+        }
+    }
+    slot.scopes.clear();
+
+    vkCmdResetQueryPool(command_buffer, slot.statistics_pool, 0, TA_PIPELINE_STATS_MAX_SCOPES);
+    vkCmdResetQueryPool(command_buffer, slot.occlusion_pool, 0, TA_PIPELINE_STATS_MAX_SCOPES);
+    return published;
+}
+
+// Must be called outside a render pass, and scopes can't nest (one active query per type)
+uint32_t ta_pipeline_stats_scope_begin(ta_pipeline_stats &stats, VkCommandBuffer command_buffer, const char *name)
+{
+    assert(name);
+    if (!stats.enabled) {
+        return TA_PIPELINE_STATS_INVALID;
+    }
+    ta_pipeline_stats_slot &slot = stats.slots[stats.current];
+    if (slot.scopes.size() >= TA_PIPELINE_STATS_MAX_SCOPES) {
+        return TA_PIPELINE_STATS_INVALID;
+    }
+    assert(slot.scopes.empty() || slot.scopes.back().closed);
+
+    uint32_t query = (uint32_t)slot.scopes.size();
+    slot.scopes.push_back({ name, false });
+    vkCmdBeginQuery(command_buffer, slot.statistics_pool, query, 0);
+    vkCmdBeginQuery(command_buffer, slot.occlusion_pool, query, 0);
+    return query;
+}
+
+void ta_pipeline_stats_scope_end(ta_pipeline_stats &stats, VkCommandBuffer command_buffer, uint32_t scope)
+{
+    if (scope == TA_PIPELINE_STATS_INVALID) {
+        return;
+    }
+    ta_pipeline_stats_slot &slot = stats.slots[stats.current];
+    assert(scope < slot.scopes.size());
+    vkCmdEndQuery(command_buffer, slot.occlusion_pool, scope);
+    vkCmdEndQuery(command_buffer, slot.statistics_pool, scope);
+    slot.scopes[scope].closed = true;
+}
+
+// Secondaries executed inside a scope have to declare the queries active around them, which needs the
+// inheritedQueries feature on top of pipelineStatisticsQuery
+void ta_pipeline_stats_inheritance(const ta_pipeline_stats &stats, VkCommandBufferInheritanceInfo &inheritance)
+{
+    if (!stats.enabled) {
+        return;
+    }
+    inheritance.occlusionQueryEnable = VK_TRUE;
+    inheritance.pipelineStatistics = PIPELINE_STATS_FLAGS;
+}
+
+// Call after vkQueueSubmit
+void ta_pipeline_stats_end_frame(ta_pipeline_stats &stats)
+{
+    if (!stats.enabled) {
+        return;
+    }
+    stats.slots[stats.current].pending = true;
+}
+
+// Per-frame averages for a pass from the last published window, NULL if there isn't one yet
+const ta_pipeline_stats_pass *ta_pipeline_stats_find(const ta_pipeline_stats &stats, const char *name)
+{
+    assert(name);
+    for (const ta_pipeline_stats_pass &pass : stats.published) {
+        if (pass.name == name) {
+            return &pass;
+        }
+    }
+    return NULL;
+}
+
+static void pipeline_stats_format_count(double count, char *buffer, size_t size)
+{
+    if (count >= 1000000.0) {
+        snprintf(buffer, size, "%.1fM", count / 1000000.0);
+    } else if (count >= 1000.0) {
+        snprintf(buffer, size, "%.1fK", count / 1000.0);
+    } else {
+        snprintf(buffer, size, "%.0f", count);
+    }
+}
+
+// One line per window, short enough for a window title
+void ta_pipeline_stats_summary(const ta_pipeline_stats &stats, char *buffer, size_t size)
+{
+    assert(buffer);
+    assert(size);
+    buffer[0] = 0;
+    size_t len = 0;
+    for (const ta_pipeline_stats_pass &pass : stats.published) {
+        char vs[16], clip[16], fs[16], samples[16];
+        pipeline_stats_format_count(pass.counters[PIPELINE_STAT_VS_INVOCATIONS], vs, sizeof(vs));
+        pipeline_stats_format_count(pass.counters[PIPELINE_STAT_CLIP_PRIMITIVES], clip, sizeof(clip));
+        pipeline_stats_format_count(pass.counters[PIPELINE_STAT_FS_INVOCATIONS], fs, sizeof(fs));
+        pipeline_stats_format_count(pass.counters[PIPELINE_STAT_SAMPLES_PASSED], samples, sizeof(samples));
+        int written = snprintf(buffer + len, size - len, "%s%s: vs %s, prims %s, fs %s, samples %s", len ? " | " : "",
+            pass.name.c_str(), vs, clip, fs, samples);
+        if (written < 0 || (size_t)written >= size - len) {
+            break;
+        }
+        len += written;
+    }
+}
+
+void ta_pipeline_stats_report(const ta_pipeline_stats &stats, ta_log &log)
+{
+    if (!stats.enabled) {
+        return;
+    }
+    ta_log_write(log, SRC_GPU, "Pipeline statistics (window %u, per-frame averages over %u frames):\n",
+        stats.windows_published, stats.window_frames);
+    ta_log_indent(log);
+    for (const ta_pipeline_stats_pass &pass : stats.published) {
+        ta_log_write(log, SRC_GPU, "%s\n", pass.name.c_str());
+        ta_log_indent(log);
+        for (int stat = 0; stat < PIPELINE_STAT_COUNT; ++stat) {
+            ta_log_write(log, SRC_GPU, "%-16s %14.1f\n", ta_pipeline_stat_str((ta_pipeline_stat)stat),
+                pass.counters[stat]);
+        }
+        double vs = pass.counters[PIPELINE_STAT_VS_INVOCATIONS];
+        if (vs > 0.0) {
+            ta_log_write(log, SRC_GPU, "%-16s %14.2f\n", "fs_per_vs",
+                pass.counters[PIPELINE_STAT_FS_INVOCATIONS] / vs);
+        }
+        ta_log_unindent(log);
+    }
+    ta_log_unindent(log);
+}
+
+void ta_pipeline_stats_free(ta_pipeline_stats &stats, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    ta_pipeline_stats_report(stats, tg_debug_log);
+    for (ta_pipeline_stats_slot &slot : stats.slots) {
+        ta_deletion_queue_push(deletion_queue, DELETION_QUERY_POOL, TA_VK_HANDLE(slot.statistics_pool), frame);
+        ta_deletion_queue_push(deletion_queue, DELETION_QUERY_POOL, TA_VK_HANDLE(slot.occlusion_pool), frame);
+    }
+    stats.slots.clear();
+    stats.accumulating.clear();
+    stats.published.clear();
+    stats.enabled = false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TA_PIPELINE_STATS_MAX_SCOPES 32
+#define TA_PIPELINE_STATS_INVALID UINT32_MAX
+
+// Order matches the bit order of the VkQueryPipelineStatisticFlagBits we request, which is the order the driver
+// writes them in. SAMPLES_PASSED comes from a separate occlusion query.
+typedef enum ta_pipeline_stat {
+    PIPELINE_STAT_IA_VERTICES,
+    PIPELINE_STAT_IA_PRIMITIVES,
+    PIPELINE_STAT_VS_INVOCATIONS,
+    PIPELINE_STAT_CLIP_INVOCATIONS,     // primitives entering the clipper
+    PIPELINE_STAT_CLIP_PRIMITIVES,      // primitives leaving it, i.e. not culled/clipped away
+    PIPELINE_STAT_FS_INVOCATIONS,
+    PIPELINE_STAT_CS_INVOCATIONS,
+    PIPELINE_STAT_SAMPLES_PASSED,
+    PIPELINE_STAT_COUNT
+} ta_pipeline_stat;
+
+typedef struct ta_pipeline_stats_pass {
+    std::string name;
+    uint32_t    frames;                         // frames this pass ran in during the window
+    double      counters[PIPELINE_STAT_COUNT];  // per-frame average over the window once published, sums before
+} ta_pipeline_stats_pass;
+
+typedef struct ta_pipeline_stats_scope {
+    std::string name;
+    bool        closed;
+} ta_pipeline_stats_scope;
+
+typedef struct ta_pipeline_stats_slot {
+    VkQueryPool                          statistics_pool;
+    VkQueryPool                          occlusion_pool;
+    std::vector<ta_pipeline_stats_scope> scopes;
+    bool                                 pending;
+} ta_pipeline_stats_slot;
+
+// Optional per-pass pipeline statistics + occlusion counters. Sums are collected over a window of N frames, then
+// published as per-frame averages, which is what the stats API and the overlay read. Comparing fragment invocations
+// to vertex invocations is usually enough to tell a fill bound regression from a geometry bound one.
+typedef struct ta_pipeline_stats {
+    VkDevice                            device;
+    bool                                enabled;
+    uint32_t                            window_frames;
+    uint32_t                            window_count;       // frames accumulated in the current window
+    uint32_t                            windows_published;
+    uint32_t                            current;
+    std::vector<ta_pipeline_stats_slot> slots;
+    std::vector<ta_pipeline_stats_pass> accumulating;
+    std::vector<ta_pipeline_stats_pass> published;
+    std::vector<uint64_t>               results;
+} ta_pipeline_stats;
+
+const char *ta_pipeline_stat_str            (ta_pipeline_stat stat);
+VkResult ta_pipeline_stats_init             (ta_pipeline_stats &stats, VkDevice device, bool enabled,
+                                             uint32_t frames_in_flight, uint32_t window_frames);
+bool ta_pipeline_stats_begin_frame          (ta_pipeline_stats &stats, VkCommandBuffer command_buffer,
+                                             uint64_t frame_number);
+uint32_t ta_pipeline_stats_scope_begin      (ta_pipeline_stats &stats, VkCommandBuffer command_buffer,
+                                             const char *name);
+void ta_pipeline_stats_scope_end            (ta_pipeline_stats &stats, VkCommandBuffer command_buffer, uint32_t scope);
+void ta_pipeline_stats_inheritance          (const ta_pipeline_stats &stats,
+                                             VkCommandBufferInheritanceInfo &inheritance);
+void ta_pipeline_stats_end_frame            (ta_pipeline_stats &stats);
+const ta_pipeline_stats_pass *ta_pipeline_stats_find(const ta_pipeline_stats &stats, const char *name);
+void ta_pipeline_stats_summary              (const ta_pipeline_stats &stats, char *buffer, size_t size);
+void ta_pipeline_stats_report               (const ta_pipeline_stats &stats, ta_log &log);
+void ta_pipeline_stats_free                 (ta_pipeline_stats &stats, ta_deletion_queue &deletion_queue,
+                                             uint64_t frame);
@@ -0,0 +1,147 @@
+#include "ta_present.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+const char *ta_present_policy_str(ta_present_policy policy) {
+    switch (policy) {
+        case PRESENT_POLICY_LOW_LATENCY:  return "low_latency";
+        case PRESENT_POLICY_POWER_SAVING: return "power_saving";
+        case PRESENT_POLICY_FIFO_RELAXED: return "fifo_relaxed";
+        default:                          return "UNKNOWN";
+    }
+}
+
+const char *ta_present_mode_str(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR:      return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR:         return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+        default:                               return "UNKNOWN";
+    }
+}
+
+bool ta_present_policy_parse(const char *str, ta_present_policy *policy)
+{
+    assert(str);
+    assert(policy);
+    for (int i = 0; i < PRESENT_POLICY_COUNT; ++i) {
+        if (!strcmp(str, ta_present_policy_str((ta_present_policy)i))) {
+            *policy = (ta_present_policy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool present_mode_available(const std::vector<VkPresentModeKHR> &available, VkPresentModeKHR mode)
+{
+    return std::find(available.begin(), available.end(), mode) != available.end();
+}
+
+VkPresentModeKHR ta_present_mode_select(ta_present_policy policy, const std::vector<VkPresentModeKHR> &available)
+{
+    // Modes in order of preference for each policy. FIFO is the only mode the spec guarantees, so it's always the
+    // last resort.
+    VkPresentModeKHR preferred[3] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    switch (policy) {
+        case PRESENT_POLICY_LOW_LATENCY:
+            preferred[0] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            preferred[1] = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case PRESENT_POLICY_FIFO_RELAXED:
+            preferred[0] = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        default:
+            break;
+    }
+
+    for (VkPresentModeKHR mode : preferred) {
+        if (present_mode_available(available, mode)) {
+            return mode;
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t ta_present_image_count(ta_present_policy policy, const VkSurfaceCapabilitiesKHR &capabilities)
+{
+    // NOTE: Low latency and power saving both want as few images as possible queued up ahead of the display. Relaxed
+    // FIFO gets a third image so a late frame has somewhere to go instead of stalling the CPU.
+    uint32_t image_count = 2;
+    if (policy == PRESENT_POLICY_FIFO_RELAXED) {
+        image_count = 3;
+    }
+
+    image_count = std::max(image_count, capabilities.minImageCount);
+    if (capabilities.maxImageCount) {
+        image_count = std::min(image_count, capabilities.maxImageCount);
+    }
+    return image_count;
+}
+
+void ta_present_latency_init(ta_present_latency &latency)
+{
+    latency.pending_input_ms = -1.0;
+    for (ta_present_latency_stats &stats : latency.stats) {
+        stats.count = 0;
+        stats.total_ms = 0.0;
+        stats.min_ms = 0.0;
+        stats.max_ms = 0.0;
+    }
+}
+
+void ta_present_latency_input(ta_present_latency &latency, double now_ms)
+{
+    // Only the oldest unpresented input matters, anything after it is presented by the same frame
+    if (latency.pending_input_ms < 0.0) {
+        latency.pending_input_ms = now_ms;
+    }
+}
+
+void ta_present_latency_presented(ta_present_latency &latency, ta_present_policy policy, double now_ms)
+{
+    if (latency.pending_input_ms < 0.0) {
+        return;
+    }
+    assert(policy < PRESENT_POLICY_COUNT);
+
+    double sample_ms = now_ms - latency.pending_input_ms;
+    latency.pending_input_ms = -1.0;
+
+    ta_present_latency_stats &stats = latency.stats[policy];
+    if (!stats.count || sample_ms < stats.min_ms) stats.min_ms = sample_ms;
+    if (!stats.count || sample_ms > stats.max_ms) stats.max_ms = sample_ms;
+    stats.total_ms += sample_ms;
+    stats.samples[stats.count % TA_PRESENT_LATENCY_SAMPLES] = sample_ms;
+    stats.count++;
+}
+
+void ta_present_latency_report(ta_present_latency &latency, ta_log &log, ta_present_policy policy)
+{
+    assert(policy < PRESENT_POLICY_COUNT);
+    ta_present_latency_stats &stats = latency.stats[policy];
+    if (!stats.count) {
+        ta_log_write(log, SRC_VULKAN, "Input-to-present latency [%s]: no samples\n", ta_present_policy_str(policy));
+        return;
+    }
+
+    uint32_t sample_count = std::min(stats.count, (uint32_t)TA_PRESENT_LATENCY_SAMPLES);
+    std::vector<double> sorted(stats.samples, stats.samples + sample_count);
+    std::sort(sorted.begin(), sorted.end());
+    double p50_ms = sorted[(sample_count - 1) / 2];
+    double p99_ms = sorted[(sample_count - 1) * 99 / 100];
+
+    ta_log_write(log, SRC_VULKAN,
+        "Input-to-present latency [%s]: samples %u, avg %.3fms, min %.3fms, p50 %.3fms, p99 %.3fms, max %.3fms\n",
+        ta_present_policy_str(policy), stats.count, stats.total_ms / stats.count, stats.min_ms, p50_ms, p99_ms,
+        stats.max_ms);
+}
+
+void ta_present_latency_report_all(ta_present_latency &latency, ta_log &log)
+{
+    for (int i = 0; i < PRESENT_POLICY_COUNT; ++i) {
+        ta_present_latency_report(latency, log, (ta_present_policy)i);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <vector>
+
+#define TA_PRESENT_LATENCY_SAMPLES 1024
+
+typedef enum ta_present_policy {
+    PRESENT_POLICY_LOW_LATENCY,     // IMMEDIATE (or MAILBOX) with 2 images, tears if IMMEDIATE
+    PRESENT_POLICY_POWER_SAVING,    // FIFO, vsync locked, CPU blocks instead of spinning
+    PRESENT_POLICY_FIFO_RELAXED,    // FIFO_RELAXED, vsync unless we miss a vblank, then tear
+    PRESENT_POLICY_COUNT
+} ta_present_policy;
+
+typedef struct ta_present_latency_stats {
+    uint32_t count;                                 // total samples recorded
+    double   total_ms;
+    double   min_ms;
+    double   max_ms;
+    double   samples[TA_PRESENT_LATENCY_SAMPLES];   // ring buffer of the most recent samples, for percentiles
+} ta_present_latency_stats;
+
+// Measures input-to-present latency: from the moment an input event is pulled off the SDL queue to the moment
+// vkQueuePresentKHR returns for the first frame recorded after it. Queueing delay from FIFO / extra swap chain
+// images shows up in the fence + acquire waits, which land inside this window.
+// NOTE: This does not include scanout. We'd need VK_GOOGLE_display_timing for that.
+typedef struct ta_present_latency {
+    double pending_input_ms;        // timestamp of the oldest input not yet presented, < 0 if none
+    ta_present_latency_stats stats[PRESENT_POLICY_COUNT];
+} ta_present_latency;
+
+const char *ta_present_policy_str       (ta_present_policy policy);
+const char *ta_present_mode_str         (VkPresentModeKHR mode);
+bool ta_present_policy_parse            (const char *str, ta_present_policy *policy);
+VkPresentModeKHR ta_present_mode_select (ta_present_policy policy, const std::vector<VkPresentModeKHR> &available);
+uint32_t ta_present_image_count         (ta_present_policy policy, const VkSurfaceCapabilitiesKHR &capabilities);
+
+void ta_present_latency_init            (ta_present_latency &latency);
+void ta_present_latency_input           (ta_present_latency &latency, double now_ms);
+void ta_present_latency_presented       (ta_present_latency &latency, ta_present_policy policy, double now_ms);
+void ta_present_latency_report          (ta_present_latency &latency, ta_log &log, ta_present_policy policy);
+void ta_present_latency_report_all      (ta_present_latency &latency, ta_log &log);
@@ -0,0 +1,1229 @@
+#include "ta_render_graph.hpp"
+#include "ta_vk_buffer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+static const char *rg_usage_str(ta_rg_usage usage) {
+    switch (usage) {
+        case RG_USAGE_COLOR_ATTACHMENT: return "color_attachment";
+        case RG_USAGE_DEPTH_ATTACHMENT: return "depth_attachment";
+        case RG_USAGE_DEPTH_READ:       return "depth_read";
+        case RG_USAGE_SAMPLED:          return "sampled";
+        case RG_USAGE_STORAGE_READ:     return "storage_read";
+        case RG_USAGE_STORAGE_WRITE:    return "storage_write";
+        case RG_USAGE_TRANSFER_SRC:     return "transfer_src";
+        case RG_USAGE_TRANSFER_DST:     return "transfer_dst";
+        case RG_USAGE_VERTEX_BUFFER:    return "vertex_buffer";
+        case RG_USAGE_INDEX_BUFFER:     return "index_buffer";
+        case RG_USAGE_INDIRECT_BUFFER:  return "indirect_buffer";
+        case RG_USAGE_UNIFORM_BUFFER:   return "uniform_buffer";
+        case RG_USAGE_PRESENT:          return "present";
+        default:                        return "UNKNOWN";
+    }
+}
+
+static const char *rg_pass_type_str(ta_rg_pass_type type) {
+    switch (type) {
+        case RG_PASS_GRAPHICS: return "graphics";
+        case RG_PASS_COMPUTE:  return "compute";
+        case RG_PASS_TRANSFER: return "transfer";
+        default:               return "UNKNOWN";
+    }
+}
+
+static const char *rg_layout_str(VkImageLayout layout) {
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:                        return "UNDEFINED";
+        case VK_IMAGE_LAYOUT_GENERAL:                          return "GENERAL";
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:         return "COLOR_ATTACHMENT";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "DEPTH_STENCIL_ATTACHMENT";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:  return "DEPTH_STENCIL_READ_ONLY";
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:         return "SHADER_READ_ONLY";
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:             return "TRANSFER_SRC";
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:             return "TRANSFER_DST";
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:                  return "PRESENT_SRC";
+        default:                                               return "UNKNOWN";
+    }
+}
+
+static bool rg_format_is_depth(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool rg_format_has_stencil(VkFormat format)
+{
+    return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+        format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+// NOTE: Only used to pick which transients share an alias slot before we have a device to ask. Real sizes come from
+// vkGet*MemoryRequirements in realize.
+static uint32_t rg_format_bytes(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+            return 1;
+        case VK_FORMAT_R16_SFLOAT:
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_R8G8_UNORM:
+            return 2;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+static bool rg_usage_writes(ta_rg_usage usage)
+{
+    return usage == RG_USAGE_COLOR_ATTACHMENT || usage == RG_USAGE_DEPTH_ATTACHMENT ||
+        usage == RG_USAGE_STORAGE_WRITE || usage == RG_USAGE_TRANSFER_DST;
+}
+
+// Shader stages a sampled/storage/uniform access can come from depend on what kind of pass is doing it
+static VkPipelineStageFlags rg_shader_stages(ta_rg_pass_type type)
+{
+    switch (type) {
+        case RG_PASS_COMPUTE:
+            return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        case RG_PASS_GRAPHICS:
+            return VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        default:
+            return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+}
+
+static ta_rg_state rg_usage_state(ta_rg_usage usage, ta_rg_pass_type type)
+{
+    ta_rg_state state = {};
+    switch (usage) {
+        case RG_USAGE_COLOR_ATTACHMENT:
+            state.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            state.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            state.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            break;
+        case RG_USAGE_DEPTH_ATTACHMENT:
+            state.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            state.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            state.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            break;
+        case RG_USAGE_DEPTH_READ:
+            state.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                rg_shader_stages(type);
+            state.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            state.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            break;
+        case RG_USAGE_SAMPLED:
+            state.stages = rg_shader_stages(type);
+            state.access = VK_ACCESS_SHADER_READ_BIT;
+            state.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            break;
+        case RG_USAGE_STORAGE_READ:
+            state.stages = rg_shader_stages(type);
+            state.access = VK_ACCESS_SHADER_READ_BIT;
+            state.layout = VK_IMAGE_LAYOUT_GENERAL;
+            break;
+        case RG_USAGE_STORAGE_WRITE:
+            state.stages = rg_shader_stages(type);
+            state.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            state.layout = VK_IMAGE_LAYOUT_GENERAL;
+            break;
+        case RG_USAGE_TRANSFER_SRC:
+            state.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            state.access = VK_ACCESS_TRANSFER_READ_BIT;
+            state.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            break;
+        case RG_USAGE_TRANSFER_DST:
+            state.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            state.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+            state.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            break;
+        case RG_USAGE_VERTEX_BUFFER:
+            state.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            state.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+            break;
+        case RG_USAGE_INDEX_BUFFER:
+            state.stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            state.access = VK_ACCESS_INDEX_READ_BIT;
+            break;
+        case RG_USAGE_INDIRECT_BUFFER:
+            state.stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+            state.access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+            break;
+        case RG_USAGE_UNIFORM_BUFFER:
+            state.stages = rg_shader_stages(type);
+            state.access = VK_ACCESS_UNIFORM_READ_BIT;
+            break;
+        case RG_USAGE_PRESENT:
+            // Presentation engine synchronizes via the semaphore, nothing to make visible
+            state.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            state.access = 0;
+            state.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            break;
+        default:
+            assert(!"Unknown render graph usage");
+            break;
+    }
+    return state;
+}
+
+static void rg_add_usage_flags(ta_rg_resource_desc &resource, ta_rg_usage usage)
+{
+    switch (usage) {
+        case RG_USAGE_COLOR_ATTACHMENT: resource.image_usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+        case RG_USAGE_DEPTH_ATTACHMENT: resource.image_usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+        case RG_USAGE_DEPTH_READ:
+            // Depth test, or sampled as read-only depth (e.g. SSAO after the prepass). Doesn't say which, allow both.
+            resource.image_usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            break;
+        case RG_USAGE_SAMPLED:          resource.image_usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+        case RG_USAGE_STORAGE_READ:
+        case RG_USAGE_STORAGE_WRITE:
+            resource.image_usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+            resource.buffer_usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            break;
+        case RG_USAGE_TRANSFER_SRC:
+            resource.image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            resource.buffer_usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            break;
+        case RG_USAGE_TRANSFER_DST:
+            resource.image_usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            resource.buffer_usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            break;
+        case RG_USAGE_VERTEX_BUFFER:    resource.buffer_usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT; break;
+        case RG_USAGE_INDEX_BUFFER:     resource.buffer_usage |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT; break;
+        case RG_USAGE_INDIRECT_BUFFER:  resource.buffer_usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT; break;
+        case RG_USAGE_UNIFORM_BUFFER:   resource.buffer_usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT; break;
+        default: break;
+    }
+}
+
+void ta_render_graph_init(ta_render_graph &graph)
+{
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.order.clear();
+    graph.final_barriers = {};
+    graph.alias_slots.clear();
+    graph.dirty = true;
+    graph.realized = false;
+    graph.compile_count = 0;
+}
+
+static ta_rg_resource rg_resource_add(ta_render_graph &graph, const char *name, ta_rg_resource_kind kind)
+{
+    assert(name);
+    ta_rg_resource_desc resource = {};
+    resource.name = name;
+    resource.kind = kind;
+    resource.format = VK_FORMAT_UNDEFINED;
+    resource.final_usage = RG_USAGE_COUNT;
+    resource.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.first_pass = TA_RG_INVALID;
+    resource.last_pass = TA_RG_INVALID;
+    resource.alias_slot = TA_RG_INVALID;
+    graph.resources.push_back(resource);
+    graph.dirty = true;
+    return (ta_rg_resource)(graph.resources.size() - 1);
+}
+
+ta_rg_resource ta_render_graph_create_image(ta_render_graph &graph, const char *name, VkFormat format,
+    VkExtent2D extent)
+{
+    assert(format != VK_FORMAT_UNDEFINED);
+    assert(extent.width && extent.height);
+    ta_rg_resource resource = rg_resource_add(graph, name, RG_RESOURCE_IMAGE);
+    graph.resources[resource].format = format;
+    graph.resources[resource].extent = extent;
+    return resource;
+}
+
+ta_rg_resource ta_render_graph_create_buffer(ta_render_graph &graph, const char *name, VkDeviceSize size)
+{
+    assert(size);
+    ta_rg_resource resource = rg_resource_add(graph, name, RG_RESOURCE_BUFFER);
+    graph.resources[resource].size = size;
+    return resource;
+}
+
+// Imported images are owned elsewhere and rebound every frame with ta_render_graph_bind_image. If final_usage is
+// not RG_USAGE_COUNT the image is treated as a graph output: passes writing it are never culled, and it's
+// transitioned to final_usage after the last pass.
+ta_rg_resource ta_render_graph_import_image(ta_render_graph &graph, const char *name, VkFormat format,
+    VkImageLayout initial_layout, ta_rg_usage final_usage)
+{
+    ta_rg_resource resource = rg_resource_add(graph, name, RG_RESOURCE_IMAGE);
+    ta_rg_resource_desc &desc = graph.resources[resource];
+    desc.imported = true;
+    desc.output = final_usage != RG_USAGE_COUNT;
+    desc.format = format;
+    desc.initial_layout = initial_layout;
+    desc.final_usage = final_usage;
+    return resource;
+}
+
+// Doesn't dirty the graph, barriers only reference resources by index
+void ta_render_graph_bind_image(ta_render_graph &graph, ta_rg_resource resource, VkImage image, VkImageView view,
+    VkExtent2D extent)
+{
+    assert(resource < graph.resources.size());
+    ta_rg_resource_desc &desc = graph.resources[resource];
+    assert(desc.imported);
+    desc.image = image;
+    desc.view = view;
+    desc.extent = extent;
+}
+
+ta_rg_pass ta_render_graph_add_pass(ta_render_graph &graph, const char *name, ta_rg_pass_type type,
+    ta_rg_pass_fn fn, void *userdata)
+{
+    assert(name);
+    ta_rg_pass_desc pass = {};
+    pass.name = name;
+    pass.type = type;
+    pass.fn = fn;
+    pass.userdata = userdata;
+    graph.passes.push_back(pass);
+    graph.dirty = true;
+    return (ta_rg_pass)(graph.passes.size() - 1);
+}
+
+// NOTE: One usage per resource per pass. If a pass needs e.g. to sample and write the same image, split it.
+void ta_render_graph_use(ta_render_graph &graph, ta_rg_pass pass, ta_rg_resource resource, ta_rg_usage usage)
+{
+    assert(pass < graph.passes.size());
+    assert(resource < graph.resources.size());
+    assert(usage < RG_USAGE_PRESENT);
+    ta_rg_pass_desc &desc = graph.passes[pass];
+    for (const ta_rg_access &access : desc.accesses) {
+        assert(access.resource != resource);
+    }
+    desc.accesses.push_back({ resource, usage });
+    graph.dirty = true;
+}
+
+void ta_render_graph_side_effects(ta_render_graph &graph, ta_rg_pass pass)
+{
+    assert(pass < graph.passes.size());
+    graph.passes[pass].side_effects = true;
+    graph.dirty = true;
+}
+
+// Walk backwards from the outputs. Passes are declared in submission order, so a single reverse sweep sees every
+// consumer of a resource before its producers.
+static void rg_cull(ta_render_graph &graph)
+{
+    std::vector<bool> needed(graph.resources.size(), false);
+    for (size_t i = 0; i < graph.resources.size(); ++i) {
+        needed[i] = graph.resources[i].output;
+    }
+
+    for (size_t i = graph.passes.size(); i-- > 0;) {
+        ta_rg_pass_desc &pass = graph.passes[i];
+        pass.live = pass.side_effects;
+        for (const ta_rg_access &access : pass.accesses) {
+            if (rg_usage_writes(access.usage) && needed[access.resource]) {
+                pass.live = true;
+                break;
+            }
+        }
+        if (!pass.live) {
+            continue;
+        }
+        // Writes count too: attachments are loaded, and a partial write still depends on whatever came before
+        for (const ta_rg_access &access : pass.accesses) {
+            needed[access.resource] = true;
+        }
+    }
+
+    graph.order.clear();
+    for (size_t i = 0; i < graph.passes.size(); ++i) {
+        if (graph.passes[i].live) {
+            graph.order.push_back((ta_rg_pass)i);
+        }
+    }
+}
+
+static void rg_lifetimes(ta_render_graph &graph)
+{
+    for (ta_rg_resource_desc &resource : graph.resources) {
+        resource.first_pass = TA_RG_INVALID;
+        resource.last_pass = TA_RG_INVALID;
+        resource.alias_slot = TA_RG_INVALID;
+        resource.image_usage = 0;
+        resource.buffer_usage = 0;
+    }
+    for (uint32_t i = 0; i < graph.order.size(); ++i) {
+        for (const ta_rg_access &access : graph.passes[graph.order[i]].accesses) {
+            ta_rg_resource_desc &resource = graph.resources[access.resource];
+            if (resource.first_pass == TA_RG_INVALID) {
+                resource.first_pass = i;
+            }
+            resource.last_pass = i;
+            rg_add_usage_flags(resource, access.usage);
+        }
+    }
+}
+
+static bool rg_lifetimes_overlap(const ta_rg_resource_desc &a, const ta_rg_resource_desc &b)
+{
+    return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+}
+
+static VkDeviceSize rg_estimated_size(const ta_rg_resource_desc &resource)
+{
+    if (resource.kind == RG_RESOURCE_BUFFER) {
+        return resource.size;
+    }
+    return (VkDeviceSize)resource.extent.width * resource.extent.height * rg_format_bytes(resource.format);
+}
+
+// Greedy interval packing, biggest first, so small transients fill in behind big ones instead of the other way
+// around. A slot ends up as big as its biggest member.
+static void rg_alias(ta_render_graph &graph)
+{
+    graph.alias_slots.clear();
+
+    std::vector<ta_rg_resource> transients;
+    for (uint32_t i = 0; i < graph.resources.size(); ++i) {
+        const ta_rg_resource_desc &resource = graph.resources[i];
+        if (!resource.imported && resource.first_pass != TA_RG_INVALID) {
+            transients.push_back(i);
+        }
+    }
+    std::stable_sort(transients.begin(), transients.end(), [&](ta_rg_resource a, ta_rg_resource b) {
+        return rg_estimated_size(graph.resources[a]) > rg_estimated_size(graph.resources[b]);
+    });
+
+    for (ta_rg_resource index : transients) {
+        ta_rg_resource_desc &resource = graph.resources[index];
+        for (uint32_t slot_index = 0; slot_index < graph.alias_slots.size(); ++slot_index) {
+            ta_rg_alias_slot &slot = graph.alias_slots[slot_index];
+            if (slot.kind != resource.kind) {
+                continue;
+            }
+            bool overlaps = false;
+            for (ta_rg_resource other : slot.resources) {
+                if (rg_lifetimes_overlap(resource, graph.resources[other])) {
+                    overlaps = true;
+                    break;
+                }
+            }
+            if (!overlaps) {
+                resource.alias_slot = slot_index;
+                slot.resources.push_back(index);
+                break;
+            }
+        }
+        if (resource.alias_slot == TA_RG_INVALID) {
+            ta_rg_alias_slot slot = {};
+            slot.kind = resource.kind;
+            slot.estimated_size = rg_estimated_size(resource);
+            slot.resources.push_back(index);
+            resource.alias_slot = (uint32_t)graph.alias_slots.size();
+            graph.alias_slots.push_back(slot);
+        }
+    }
+}
+
+// What we know about a resource while walking the passes in order
+typedef struct rg_track {
+    ta_rg_state          write;          // last write, stages == 0 if none yet
+    VkPipelineStageFlags read_stages;    // reads since the last write, a later write has to wait for them
+    VkPipelineStageFlags visible_stages; // stages the last write has been made visible to
+    VkAccessFlags        visible_access;
+    VkImageLayout        layout;
+    bool                 imported;       // untouched imported resource, see rg_transition
+} rg_track;
+
+static void rg_batch_add(ta_rg_barrier_batch &batch, ta_rg_resource resource, const ta_rg_state &src,
+    const ta_rg_state &dst)
+{
+    ta_rg_barrier barrier = {};
+    barrier.resource = resource;
+    barrier.src = src;
+    barrier.dst = dst;
+    batch.src_stages |= src.stages;
+    batch.dst_stages |= dst.stages;
+    batch.barriers.push_back(barrier);
+}
+
+// Emits a barrier only when something actually needs one:
+//   - layout transitions (always, including the first use of a transient out of UNDEFINED)
+//   - read/write after write (RAW/WAW), unless the write is already visible to these stages
+//   - write after read (WAR), execution dependency only
+// Read after read in the same layout is free.
+static void rg_transition(ta_rg_barrier_batch &batch, ta_rg_resource resource, bool is_image, rg_track &track,
+    const ta_rg_state &state, bool writes)
+{
+    bool layout_change = is_image && track.layout != state.layout;
+    ta_rg_state src = {};
+    src.layout = track.layout;
+
+    if (writes || layout_change) {
+        // Anything that touched it since the last write has to finish first, and the last write has to be
+        // available. Readers only need an execution dependency.
+        src.stages = track.write.stages | track.read_stages;
+        src.access = track.write.access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+        // Imported images (swap chain) are usually guarded by a semaphore wait at the stage of their first use.
+        // Waiting on that same stage chains the layout transition after the wait; TOP_OF_PIPE would not.
+        if (!src.stages && track.imported) {
+            src.stages = state.stages;
+        }
+        track.imported = false;
+        if (layout_change || src.stages) {
+            ta_rg_state dst = state;
+            if (!is_image) {
+                dst.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+            rg_batch_add(batch, resource, src, dst);
+        }
+
+        if (writes) {
+            track.write = state;
+            track.visible_stages = 0;
+            track.visible_access = 0;
+        } else {
+            // Layout transition is itself a write that completes before the barrier's dst stages. Anyone else
+            // who wants to see it has to chain off those stages.
+            track.write.stages = state.stages;
+            track.write.access = 0;
+            track.visible_stages = state.stages;
+            track.visible_access = state.access;
+        }
+        track.read_stages = writes ? 0 : state.stages;
+        track.layout = state.layout;
+        return;
+    }
+
+    if (track.write.stages && ((state.stages & ~track.visible_stages) || (state.access & ~track.visible_access))) {
+        src.stages = track.write.stages;
+        src.access = track.write.access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+        ta_rg_state dst = state;
+        dst.layout = track.layout;
+        rg_batch_add(batch, resource, src, dst);
+        track.visible_stages |= state.stages;
+        track.visible_access |= state.access;
+    }
+    track.read_stages |= state.stages;
+}
+
+static void rg_tracks_init(const ta_render_graph &graph, std::vector<rg_track> &tracks)
+{
+    tracks.resize(graph.resources.size());
+    for (size_t i = 0; i < graph.resources.size(); ++i) {
+        rg_track &track = tracks[i];
+        track = {};
+        track.layout = graph.resources[i].imported ? graph.resources[i].initial_layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        track.imported = graph.resources[i].imported;
+    }
+}
+
+static void rg_walk(ta_render_graph &graph, std::vector<rg_track> &tracks)
+{
+    for (ta_rg_pass pass_index : graph.order) {
+        ta_rg_pass_desc &pass = graph.passes[pass_index];
+        pass.barriers = {};
+        for (const ta_rg_access &access : pass.accesses) {
+            const ta_rg_resource_desc &resource = graph.resources[access.resource];
+            ta_rg_state state = rg_usage_state(access.usage, pass.type);
+            rg_transition(pass.barriers, access.resource, resource.kind == RG_RESOURCE_IMAGE,
+                tracks[access.resource], state, rg_usage_writes(access.usage));
+        }
+    }
+}
+
+static void rg_barriers(ta_render_graph &graph)
+{
+    // Transients are realized once and reused by every frame in flight, so the first use of a slot's memory has to
+    // wait for whatever the previous frame's graph did to it last. Walk once to find out how a frame leaves each
+    // resource, then seed the first occupant of every slot with everything its members were left with.
+    std::vector<rg_track> tracks;
+    rg_tracks_init(graph, tracks);
+    rg_walk(graph, tracks);
+    std::vector<rg_track> end = tracks;
+    rg_tracks_init(graph, tracks);
+    for (const ta_rg_alias_slot &slot : graph.alias_slots) {
+        ta_rg_resource first = slot.resources[0];
+        rg_track previous = {};
+        for (ta_rg_resource index : slot.resources) {
+            if (graph.resources[index].first_pass < graph.resources[first].first_pass) {
+                first = index;
+            }
+            previous.write.stages |= end[index].write.stages;
+            previous.write.access |= end[index].write.access;
+            previous.read_stages |= end[index].read_stages;
+        }
+        tracks[first].write = previous.write;
+        tracks[first].read_stages = previous.read_stages;
+    }
+
+    // Aliased transients: the first use of a resource has to wait for everything that touched the previous
+    // occupant of its memory. Contents are garbage either way, so the layout stays UNDEFINED.
+    // NOTE: ALL_COMMANDS is conservative. We could take the previous occupant's real last stages from the first
+    // walk, but aliasing boundaries are rare (a few per frame).
+    for (const ta_rg_alias_slot &slot : graph.alias_slots) {
+        for (ta_rg_resource index : slot.resources) {
+            for (ta_rg_resource other : slot.resources) {
+                if (graph.resources[other].last_pass < graph.resources[index].first_pass) {
+                    tracks[index].read_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                    break;
+                }
+            }
+        }
+    }
+
+    rg_walk(graph, tracks);
+
+    graph.final_barriers = {};
+    for (uint32_t i = 0; i < graph.resources.size(); ++i) {
+        const ta_rg_resource_desc &resource = graph.resources[i];
+        if (!resource.output || resource.first_pass == TA_RG_INVALID) {
+            continue;
+        }
+        ta_rg_state state = rg_usage_state(resource.final_usage, RG_PASS_GRAPHICS);
+        rg_transition(graph.final_barriers, i, resource.kind == RG_RESOURCE_IMAGE, tracks[i], state, false);
+    }
+}
+
+// Cheap to call every frame, only does work when the topology changed
+bool ta_render_graph_compile(ta_render_graph &graph)
+{
+    if (!graph.dirty) {
+        return false;
+    }
+
+    rg_cull(graph);
+    rg_lifetimes(graph);
+    rg_alias(graph);
+    rg_barriers(graph);
+
+    graph.dirty = false;
+    graph.realized = false;
+    graph.compile_count++;
+    return true;
+}
+
+// Releases transient GPU resources, e.g. before a recompile changes what they should look like
+void ta_render_graph_release(ta_render_graph &graph, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    for (ta_rg_resource_desc &resource : graph.resources) {
+        if (resource.imported) {
+            continue;
+        }
+        if (resource.view) {
+            ta_deletion_queue_push(deletion_queue, DELETION_IMAGE_VIEW, TA_VK_HANDLE(resource.view), frame);
+        }
+        if (resource.image) {
+            ta_deletion_queue_push(deletion_queue, DELETION_IMAGE, TA_VK_HANDLE(resource.image), frame);
+        }
+        if (resource.buffer) {
+            ta_deletion_queue_push(deletion_queue, DELETION_BUFFER, TA_VK_HANDLE(resource.buffer), frame);
+        }
+        resource.image = VK_NULL_HANDLE;
+        resource.view = VK_NULL_HANDLE;
+        resource.buffer = VK_NULL_HANDLE;
+    }
+    for (ta_rg_alias_slot &slot : graph.alias_slots) {
+        if (slot.memory) {
+            ta_deletion_queue_push(deletion_queue, DELETION_MEMORY, TA_VK_HANDLE(slot.memory), frame);
+            slot.memory = VK_NULL_HANDLE;
+        }
+    }
+    graph.realized = false;
+}
+
+static VkResult rg_resource_create(VkDevice device, ta_rg_resource_desc &resource, VkMemoryRequirements &requirements)
+{
+    VkResult err = VK_SUCCESS;
+    if (resource.kind == RG_RESOURCE_BUFFER) {
+        VkBufferCreateInfo buffer_create_info = {};
+        buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_create_info.size = resource.size;
+        buffer_create_info.usage = resource.buffer_usage;
+        buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        err = vkCreateBuffer(device, &buffer_create_info, NULL, &resource.buffer);
+        if (!err) {
+            vkGetBufferMemoryRequirements(device, resource.buffer, &requirements);
+        }
+        return err;
+    }
+
+    VkImageCreateInfo image_create_info = {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = resource.format;
+    image_create_info.extent = { resource.extent.width, resource.extent.height, 1 };
+    image_create_info.mipLevels = 1;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = resource.image_usage;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    err = vkCreateImage(device, &image_create_info, NULL, &resource.image);
+    if (!err) {
+        vkGetImageMemoryRequirements(device, resource.image, &requirements);
+    }
+    return err;
+}
+
+static VkResult rg_view_create(VkDevice device, ta_rg_resource_desc &resource)
+{
+    VkImageViewCreateInfo view_create_info = {};
+    view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_create_info.image = resource.image;
+    view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_create_info.format = resource.format;
+    view_create_info.subresourceRange.aspectMask = rg_format_is_depth(resource.format) ?
+        VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    view_create_info.subresourceRange.levelCount = 1;
+    view_create_info.subresourceRange.layerCount = 1;
+    return vkCreateImageView(device, &view_create_info, NULL, &resource.view);
+}
+
+// Creates transient images/buffers for the current compile and binds every member of an alias slot to offset 0 of
+// one shared allocation. Members whose memory requirements can't share (no common memory type) get bumped into a
+// slot of their own.
+VkResult ta_render_graph_realize(ta_render_graph &graph, VkDevice device,
+    const VkPhysicalDeviceMemoryProperties &memory_properties, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    assert(!graph.dirty);
+    if (graph.realized) {
+        return VK_SUCCESS;
+    }
+    ta_render_graph_release(graph, deletion_queue, frame);
+
+    std::vector<VkMemoryRequirements> requirements(graph.resources.size());
+    for (uint32_t i = 0; i < graph.resources.size(); ++i) {
+        ta_rg_resource_desc &resource = graph.resources[i];
+        if (resource.alias_slot == TA_RG_INVALID) {
+            continue;
+        }
+        VkResult err = rg_resource_create(device, resource, requirements[i]);
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create render graph resource '%s'.\n", err,
+                resource.name.c_str());
+            return err;
+        }
+    }
+
+    for (uint32_t slot_index = 0; slot_index < graph.alias_slots.size(); ++slot_index) {
+        VkDeviceSize size = 0;
+        uint32_t type_bits = UINT32_MAX;
+        std::vector<ta_rg_resource> bumped;
+        std::vector<ta_rg_resource> &members = graph.alias_slots[slot_index].resources;
+        for (size_t m = 0; m < members.size(); ++m) {
+            const VkMemoryRequirements &req = requirements[members[m]];
+            if (!(type_bits & req.memoryTypeBits)) {
+                bumped.push_back(members[m]);
+                members.erase(members.begin() + m--);
+                continue;
+            }
+            type_bits &= req.memoryTypeBits;
+            size = std::max(size, req.size);
+        }
+        // Appended slots get picked up by the outer loop
+        for (ta_rg_resource index : bumped) {
+            ta_rg_alias_slot slot = {};
+            slot.kind = graph.resources[index].kind;
+            slot.estimated_size = rg_estimated_size(graph.resources[index]);
+            slot.resources.push_back(index);
+            graph.resources[index].alias_slot = (uint32_t)graph.alias_slots.size();
+            graph.alias_slots.push_back(slot);
+        }
+
+        int32_t memory_type = ta_vk_memory_type_find(memory_properties, type_bits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (memory_type < 0) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to find device local memory for render graph slot %u.\n",
+                slot_index);
+            return VK_ERROR_FEATURE_NOT_PRESENT;
+        }
+
+        ta_rg_alias_slot &slot = graph.alias_slots[slot_index];
+        VkMemoryAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate_info.allocationSize = size;
+        allocate_info.memoryTypeIndex = (uint32_t)memory_type;
+        VkResult err = vkAllocateMemory(device, &allocate_info, NULL, &slot.memory);
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to allocate render graph slot %u (%llu bytes).\n",
+                err, slot_index, (unsigned long long)size);
+            return err;
+        }
+
+        for (ta_rg_resource index : slot.resources) {
+            ta_rg_resource_desc &resource = graph.resources[index];
+            if (resource.kind == RG_RESOURCE_BUFFER) {
+                err = vkBindBufferMemory(device, resource.buffer, slot.memory, 0);
+            } else {
+                err = vkBindImageMemory(device, resource.image, slot.memory, 0);
+                if (!err) {
+                    err = rg_view_create(device, resource);
+                }
+            }
+            if (err) {
+                ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to bind render graph resource '%s'.\n", err,
+                    resource.name.c_str());
+                return err;
+            }
+        }
+    }
+
+    graph.realized = true;
+    return VK_SUCCESS;
+}
+
+static void rg_batch_emit(ta_render_graph &graph, VkCommandBuffer command_buffer, const ta_rg_barrier_batch &batch)
+{
+    if (batch.barriers.empty()) {
+        return;
+    }
+
+    graph.image_barriers.clear();
+    graph.buffer_barriers.clear();
+    for (const ta_rg_barrier &barrier : batch.barriers) {
+        const ta_rg_resource_desc &resource = graph.resources[barrier.resource];
+        if (resource.kind == RG_RESOURCE_BUFFER) {
+            VkBufferMemoryBarrier buffer_barrier = {};
+            buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            buffer_barrier.srcAccessMask = barrier.src.access;
+            buffer_barrier.dstAccessMask = barrier.dst.access;
+            buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier.buffer = resource.buffer;
+            buffer_barrier.size = VK_WHOLE_SIZE;
+            graph.buffer_barriers.push_back(buffer_barrier);
+            continue;
+        }
+
+        VkImageMemoryBarrier image_barrier = {};
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        image_barrier.srcAccessMask = barrier.src.access;
+        image_barrier.dstAccessMask = barrier.dst.access;
+        image_barrier.oldLayout = barrier.src.layout;
+        image_barrier.newLayout = barrier.dst.layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = resource.image;
+        if (rg_format_is_depth(resource.format)) {
+            image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            if (rg_format_has_stencil(resource.format)) {
+                image_barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+            }
+        } else {
+            image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+        image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        graph.image_barriers.push_back(image_barrier);
+    }
+
+    VkPipelineStageFlags src_stages = batch.src_stages;
+    VkPipelineStageFlags dst_stages = batch.dst_stages;
+    if (!src_stages) src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (!dst_stages) dst_stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, NULL,
+        (uint32_t)graph.buffer_barriers.size(), graph.buffer_barriers.data(),
+        (uint32_t)graph.image_barriers.size(), graph.image_barriers.data());
+}
+
+// Profiler, pipeline stats and debug are optional. If given, each pass (including its barriers) gets a GPU timestamp
+// scope, a statistics + occlusion query and/or a debug label named after the pass.
+void ta_render_graph_execute(ta_render_graph &graph, VkCommandBuffer command_buffer, ta_gpu_profiler *profiler,
+    ta_pipeline_stats *pipeline_stats, ta_vk_debug *debug)
+{
+    assert(!graph.dirty);
+    for (ta_rg_pass pass_index : graph.order) {
+        ta_rg_pass_desc &pass = graph.passes[pass_index];
+        uint32_t scope = TA_GPU_SCOPE_INVALID;
+        uint32_t stats_scope = TA_PIPELINE_STATS_INVALID;
+        if (debug) {
+            ta_vk_debug_label_begin(*debug, command_buffer, pass.name.c_str());
+        }
+        if (profiler) {
+            scope = ta_gpu_profiler_scope_begin(*profiler, command_buffer, pass.name.c_str());
+        }
+        if (pipeline_stats) {
+            stats_scope = ta_pipeline_stats_scope_begin(*pipeline_stats, command_buffer, pass.name.c_str());
+        }
+        rg_batch_emit(graph, command_buffer, pass.barriers);
+        if (pass.fn) {
+            pass.fn(command_buffer, graph, pass_index, pass.userdata);
+        }
+        if (pipeline_stats) {
+            ta_pipeline_stats_scope_end(*pipeline_stats, command_buffer, stats_scope);
+        }
+        if (profiler) {
+            ta_gpu_profiler_scope_end(*profiler, command_buffer, scope);
+        }
+        if (debug) {
+            ta_vk_debug_label_end(*debug, command_buffer);
+        }
+    }
+    rg_batch_emit(graph, command_buffer, graph.final_barriers);
+}
+
+static void rg_dump_batch(ta_render_graph &graph, ta_log &log, const ta_rg_barrier_batch &batch)
+{
+    if (batch.barriers.empty()) {
+        return;
+    }
+    ta_log_write(log, SRC_VULKAN, "barrier stages 0x%x -> 0x%x\n", batch.src_stages, batch.dst_stages);
+    ta_log_indent(log);
+    for (const ta_rg_barrier &barrier : batch.barriers) {
+        const ta_rg_resource_desc &resource = graph.resources[barrier.resource];
+        if (resource.kind == RG_RESOURCE_IMAGE) {
+            ta_log_write(log, SRC_VULKAN, "%-16s %s -> %s, access 0x%x -> 0x%x\n", resource.name.c_str(),
+                rg_layout_str(barrier.src.layout), rg_layout_str(barrier.dst.layout), barrier.src.access,
+                barrier.dst.access);
+        } else {
+            ta_log_write(log, SRC_VULKAN, "%-16s access 0x%x -> 0x%x\n", resource.name.c_str(),
+                barrier.src.access, barrier.dst.access);
+        }
+    }
+    ta_log_unindent(log);
+}
+
+void ta_render_graph_dump(ta_render_graph &graph, ta_log &log)
+{
+    ta_log_write(log, SRC_VULKAN, "Render graph (compile #%u): %u/%u passes live, %u resources, %u alias slots\n",
+        graph.compile_count, (uint32_t)graph.order.size(), (uint32_t)graph.passes.size(),
+        (uint32_t)graph.resources.size(), (uint32_t)graph.alias_slots.size());
+    ta_log_indent(log);
+
+    for (const ta_rg_pass_desc &pass : graph.passes) {
+        ta_log_write(log, SRC_VULKAN, "pass '%s' [%s]%s\n", pass.name.c_str(), rg_pass_type_str(pass.type),
+            pass.live ? "" : " CULLED");
+        if (!pass.live) {
+            continue;
+        }
+        ta_log_indent(log);
+        rg_dump_batch(graph, log, pass.barriers);
+        for (const ta_rg_access &access : pass.accesses) {
+            ta_log_write(log, SRC_VULKAN, "%s %-16s as %s\n", rg_usage_writes(access.usage) ? "write" : "read ",
+                graph.resources[access.resource].name.c_str(), rg_usage_str(access.usage));
+        }
+        ta_log_unindent(log);
+    }
+    if (!graph.final_barriers.barriers.empty()) {
+        ta_log_write(log, SRC_VULKAN, "final\n");
+        ta_log_indent(log);
+        rg_dump_batch(graph, log, graph.final_barriers);
+        ta_log_unindent(log);
+    }
+
+    for (uint32_t i = 0; i < graph.alias_slots.size(); ++i) {
+        const ta_rg_alias_slot &slot = graph.alias_slots[i];
+        std::string members;
+        for (ta_rg_resource index : slot.resources) {
+            const ta_rg_resource_desc &resource = graph.resources[index];
+            char member[128] = { 0 };
+            snprintf(member, sizeof(member), " '%s' [%u, %u]", resource.name.c_str(), resource.first_pass,
+                resource.last_pass);
+            members += member;
+        }
+        ta_log_write(log, SRC_VULKAN, "slot %u (~%llu bytes):%s\n", i, (unsigned long long)slot.estimated_size,
+            members.c_str());
+    }
+    ta_log_unindent(log);
+}
+
+void ta_render_graph_free(ta_render_graph &graph, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    ta_render_graph_release(graph, deletion_queue, frame);
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.order.clear();
+    graph.alias_slots.clear();
+    graph.final_barriers = {};
+}
+
+// Self-test, CPU only
+typedef struct rg_test {
+    ta_log   *log;
+    uint32_t checks;
+    uint32_t failed;
+} rg_test;
+
+static void rg_test_expect(rg_test &test, bool condition, const char *graph, const char *what)
+{
+    test.checks++;
+    if (!condition) {
+        test.failed++;
+        ta_log_write_level(*test.log, SRC_VULKAN, LEVEL_ERROR, "Render graph self-test '%s': expected %s\n", graph,
+            what);
+    }
+}
+
+// NULL if the batch has no barrier for the resource
+static const ta_rg_barrier *rg_test_barrier(const ta_rg_barrier_batch &batch, ta_rg_resource resource)
+{
+    for (const ta_rg_barrier &barrier : batch.barriers) {
+        if (barrier.resource == resource) {
+            return &barrier;
+        }
+    }
+    return NULL;
+}
+
+static bool rg_test_layouts(const ta_rg_barrier *barrier, VkImageLayout src, VkImageLayout dst)
+{
+    return barrier && barrier->src.layout == src && barrier->dst.layout == dst;
+}
+
+// Compiles small graphs without a device and checks what compile inferred: culling, layout transitions, RAW/WAR/WAW
+// hazards, read after read (no barrier), alias hand-off, hazards with the previous frame and the final PRESENT
+// transition.
+bool ta_render_graph_self_test(ta_log &log)
+{
+    rg_test test = {};
+    test.log = &log;
+    const VkExtent2D extent = { 256, 256 };
+
+    {
+        const char *name = "culling";
+        ta_render_graph graph = {};
+        ta_render_graph_init(graph);
+        ta_rg_resource backbuffer = ta_render_graph_import_image(graph, "backbuffer", VK_FORMAT_B8G8R8A8_UNORM,
+            VK_IMAGE_LAYOUT_UNDEFINED, RG_USAGE_PRESENT);
+        ta_rg_resource unused = ta_render_graph_create_image(graph, "unused", VK_FORMAT_R8G8B8A8_UNORM, extent);
+        ta_rg_resource readback = ta_render_graph_create_buffer(graph, "readback", 4096);
+        ta_rg_pass dead = ta_render_graph_add_pass(graph, "dead", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, dead, unused, RG_USAGE_COLOR_ATTACHMENT);
+        ta_rg_pass dump = ta_render_graph_add_pass(graph, "dump", RG_PASS_TRANSFER, NULL, NULL);
+        ta_render_graph_use(graph, dump, readback, RG_USAGE_TRANSFER_DST);
+        ta_render_graph_side_effects(graph, dump);
+        ta_rg_pass draw = ta_render_graph_add_pass(graph, "draw", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, draw, backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+
+        rg_test_expect(test, ta_render_graph_compile(graph), name, "a dirty graph to compile");
+        rg_test_expect(test, !ta_render_graph_compile(graph), name, "a clean graph not to recompile");
+        rg_test_expect(test, !graph.passes[dead].live, name, "a pass writing nothing needed to be culled");
+        rg_test_expect(test, graph.passes[dump].live, name, "a pass with side effects to survive");
+        rg_test_expect(test, graph.passes[draw].live, name, "a pass writing an output to survive");
+        rg_test_expect(test, graph.order.size() == 2, name, "two live passes");
+        rg_test_expect(test, graph.resources[unused].first_pass == TA_RG_INVALID, name,
+            "a resource only culled passes use to have no lifetime");
+        rg_test_expect(test, graph.resources[unused].alias_slot == TA_RG_INVALID, name,
+            "a resource only culled passes use to get no memory");
+    }
+
+    {
+        // gbuffer and depth drawn, then sampled by lighting, which draws into the swap chain image
+        const char *name = "layouts";
+        ta_render_graph graph = {};
+        ta_render_graph_init(graph);
+        ta_rg_resource backbuffer = ta_render_graph_import_image(graph, "backbuffer", VK_FORMAT_B8G8R8A8_UNORM,
+            VK_IMAGE_LAYOUT_UNDEFINED, RG_USAGE_PRESENT);
+        ta_rg_resource gbuffer = ta_render_graph_create_image(graph, "gbuffer", VK_FORMAT_R8G8B8A8_UNORM, extent);
+        ta_rg_resource depth = ta_render_graph_create_image(graph, "depth", VK_FORMAT_D32_SFLOAT, extent);
+        ta_rg_pass geometry = ta_render_graph_add_pass(graph, "geometry", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, geometry, gbuffer, RG_USAGE_COLOR_ATTACHMENT);
+        ta_render_graph_use(graph, geometry, depth, RG_USAGE_DEPTH_ATTACHMENT);
+        ta_rg_pass lighting = ta_render_graph_add_pass(graph, "lighting", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, lighting, gbuffer, RG_USAGE_SAMPLED);
+        ta_render_graph_use(graph, lighting, depth, RG_USAGE_DEPTH_READ);
+        ta_render_graph_use(graph, lighting, backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+        ta_render_graph_compile(graph);
+
+        const ta_rg_barrier_batch &first = graph.passes[geometry].barriers;
+        rg_test_expect(test, rg_test_layouts(rg_test_barrier(first, gbuffer), VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), name, "gbuffer UNDEFINED -> COLOR_ATTACHMENT");
+        rg_test_expect(test, rg_test_layouts(rg_test_barrier(first, depth), VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL), name, "depth UNDEFINED -> DEPTH_STENCIL_ATTACHMENT");
+
+        const ta_rg_barrier_batch &second = graph.passes[lighting].barriers;
+        const ta_rg_barrier *sampled = rg_test_barrier(second, gbuffer);
+        rg_test_expect(test, rg_test_layouts(sampled, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), name, "gbuffer COLOR_ATTACHMENT -> SHADER_READ_ONLY");
+        rg_test_expect(test, sampled && sampled->src.access == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT &&
+            (sampled->dst.access & VK_ACCESS_SHADER_READ_BIT), name, "gbuffer writes made visible to sampling");
+        rg_test_expect(test, rg_test_layouts(rg_test_barrier(second, depth),
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL), name,
+            "depth DEPTH_STENCIL_ATTACHMENT -> DEPTH_STENCIL_READ_ONLY");
+        // First use of the swap chain image waits on the stage the acquire semaphore is waited at
+        const ta_rg_barrier *acquired = rg_test_barrier(second, backbuffer);
+        rg_test_expect(test, rg_test_layouts(acquired, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) &&
+            acquired->src.stages == VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, name,
+            "backbuffer transition chained after the acquire wait");
+
+        rg_test_expect(test, (graph.resources[gbuffer].image_usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT)) == (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT),
+            name, "gbuffer usage COLOR_ATTACHMENT | SAMPLED");
+        rg_test_expect(test, (graph.resources[depth].image_usage & (VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT)) == (VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT), name, "depth usage DEPTH_STENCIL_ATTACHMENT | SAMPLED");
+
+        const ta_rg_barrier *present = rg_test_barrier(graph.final_barriers, backbuffer);
+        rg_test_expect(test, rg_test_layouts(present, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR), name, "backbuffer COLOR_ATTACHMENT -> PRESENT_SRC after the last pass");
+        rg_test_expect(test, present && present->src.access == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT &&
+            present->dst.access == 0, name, "present barrier to make the color writes available");
+        rg_test_expect(test, graph.final_barriers.barriers.size() == 1, name, "only the output in the final batch");
+    }
+
+    {
+        // Compute skins into a buffer, two draws read it, compute writes it again, then a copy overwrites it twice
+        const char *name = "hazards";
+        ta_render_graph graph = {};
+        ta_render_graph_init(graph);
+        ta_rg_resource backbuffer = ta_render_graph_import_image(graph, "backbuffer", VK_FORMAT_B8G8R8A8_UNORM,
+            VK_IMAGE_LAYOUT_UNDEFINED, RG_USAGE_PRESENT);
+        ta_rg_resource vertices = ta_render_graph_create_buffer(graph, "vertices", 65536);
+        ta_rg_pass skin = ta_render_graph_add_pass(graph, "skin", RG_PASS_COMPUTE, NULL, NULL);
+        ta_render_graph_use(graph, skin, vertices, RG_USAGE_STORAGE_WRITE);
+        ta_rg_pass draw = ta_render_graph_add_pass(graph, "draw", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, draw, vertices, RG_USAGE_VERTEX_BUFFER);
+        ta_render_graph_use(graph, draw, backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+        ta_rg_pass draw_again = ta_render_graph_add_pass(graph, "draw_again", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, draw_again, vertices, RG_USAGE_VERTEX_BUFFER);
+        ta_render_graph_use(graph, draw_again, backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+        ta_rg_pass reskin = ta_render_graph_add_pass(graph, "reskin", RG_PASS_COMPUTE, NULL, NULL);
+        ta_render_graph_use(graph, reskin, vertices, RG_USAGE_STORAGE_WRITE);
+        ta_rg_pass upload = ta_render_graph_add_pass(graph, "upload", RG_PASS_TRANSFER, NULL, NULL);
+        ta_render_graph_use(graph, upload, vertices, RG_USAGE_TRANSFER_DST);
+        ta_rg_pass reupload = ta_render_graph_add_pass(graph, "reupload", RG_PASS_TRANSFER, NULL, NULL);
+        ta_render_graph_use(graph, reupload, vertices, RG_USAGE_TRANSFER_DST);
+        ta_rg_pass final_draw = ta_render_graph_add_pass(graph, "final_draw", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, final_draw, vertices, RG_USAGE_VERTEX_BUFFER);
+        ta_render_graph_use(graph, final_draw, backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+        ta_render_graph_compile(graph);
+        rg_test_expect(test, graph.order.size() == 7, name, "every pass live");
+
+        // The previous frame left it written by reupload and read by final_draw
+        const ta_rg_barrier *previous = rg_test_barrier(graph.passes[skin].barriers, vertices);
+        rg_test_expect(test, previous &&
+            previous->src.stages == (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT) &&
+            previous->src.access == VK_ACCESS_TRANSFER_WRITE_BIT, name,
+            "the first write to wait for the previous frame's last write and reads");
+
+        const ta_rg_barrier *raw = rg_test_barrier(graph.passes[draw].barriers, vertices);
+        rg_test_expect(test, raw && raw->src.stages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT &&
+            raw->src.access == VK_ACCESS_SHADER_WRITE_BIT && raw->dst.stages == VK_PIPELINE_STAGE_VERTEX_INPUT_BIT &&
+            raw->dst.access == VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, name,
+            "RAW: compute write -> vertex input read");
+
+        rg_test_expect(test, !rg_test_barrier(graph.passes[draw_again].barriers, vertices), name,
+            "read after read: no barrier");
+        // Same color attachment written twice in a row is ordered by the render passes themselves
+        const ta_rg_barrier *color_waw = rg_test_barrier(graph.passes[draw_again].barriers, backbuffer);
+        rg_test_expect(test, color_waw && color_waw->src.stages == VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT &&
+            color_waw->src.access == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, name, "WAW on the backbuffer");
+
+        const ta_rg_barrier *war = rg_test_barrier(graph.passes[reskin].barriers, vertices);
+        rg_test_expect(test, war && (war->src.stages & VK_PIPELINE_STAGE_VERTEX_INPUT_BIT) &&
+            war->dst.stages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, name,
+            "WAR: compute write waits for the vertex input reads");
+
+        const ta_rg_barrier *waw_upload = rg_test_barrier(graph.passes[upload].barriers, vertices);
+        rg_test_expect(test, waw_upload && waw_upload->src.stages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT &&
+            waw_upload->src.access == VK_ACCESS_SHADER_WRITE_BIT &&
+            waw_upload->dst.access == VK_ACCESS_TRANSFER_WRITE_BIT, name, "WAW: compute write -> transfer write");
+        const ta_rg_barrier *waw = rg_test_barrier(graph.passes[reupload].barriers, vertices);
+        rg_test_expect(test, waw && waw->src.stages == VK_PIPELINE_STAGE_TRANSFER_BIT &&
+            waw->src.access == VK_ACCESS_TRANSFER_WRITE_BIT && waw->dst.stages == VK_PIPELINE_STAGE_TRANSFER_BIT,
+            name, "WAW: transfer write -> transfer write");
+
+        rg_test_expect(test, rg_test_barrier(graph.passes[final_draw].barriers, vertices) != NULL, name,
+            "RAW after the transfer, the earlier vertex reads don't cover it");
+        rg_test_expect(test, graph.resources[vertices].buffer_usage == (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT), name,
+            "vertices usage STORAGE | VERTEX | TRANSFER_DST");
+    }
+
+    {
+        // a -> c -> b chain: a and b never live at the same time, c overlaps both
+        const char *name = "aliasing";
+        ta_render_graph graph = {};
+        ta_render_graph_init(graph);
+        ta_rg_resource backbuffer = ta_render_graph_import_image(graph, "backbuffer", VK_FORMAT_B8G8R8A8_UNORM,
+            VK_IMAGE_LAYOUT_UNDEFINED, RG_USAGE_PRESENT);
+        ta_rg_resource a = ta_render_graph_create_image(graph, "a", VK_FORMAT_R16G16B16A16_SFLOAT, extent);
+        ta_rg_resource c = ta_render_graph_create_image(graph, "c", VK_FORMAT_R16G16B16A16_SFLOAT, extent);
+        ta_rg_resource b = ta_render_graph_create_image(graph, "b", VK_FORMAT_R16G16B16A16_SFLOAT, extent);
+        ta_rg_pass pass_a = ta_render_graph_add_pass(graph, "write_a", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, pass_a, a, RG_USAGE_COLOR_ATTACHMENT);
+        ta_rg_pass pass_c = ta_render_graph_add_pass(graph, "a_to_c", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, pass_c, a, RG_USAGE_SAMPLED);
+        ta_render_graph_use(graph, pass_c, c, RG_USAGE_COLOR_ATTACHMENT);
+        ta_rg_pass pass_b = ta_render_graph_add_pass(graph, "c_to_b", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, pass_b, c, RG_USAGE_SAMPLED);
+        ta_render_graph_use(graph, pass_b, b, RG_USAGE_COLOR_ATTACHMENT);
+        ta_rg_pass resolve = ta_render_graph_add_pass(graph, "resolve", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, resolve, b, RG_USAGE_SAMPLED);
+        ta_render_graph_use(graph, resolve, backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+        ta_render_graph_compile(graph);
+
+        rg_test_expect(test, graph.alias_slots.size() == 2, name, "three transients packed into two slots");
+        rg_test_expect(test, graph.resources[a].alias_slot == graph.resources[b].alias_slot, name,
+            "a and b to share a slot");
+        rg_test_expect(test, graph.resources[c].alias_slot != graph.resources[a].alias_slot, name,
+            "c in a slot of its own");
+        rg_test_expect(test, graph.resources[backbuffer].alias_slot == TA_RG_INVALID, name,
+            "imported images not to be aliased");
+
+        const ta_rg_barrier *handoff = rg_test_barrier(graph.passes[pass_b].barriers, b);
+        rg_test_expect(test, rg_test_layouts(handoff, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) && handoff->src.stages == VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            name, "b's first use to wait for everything that touched a");
+        // The previous frame last sampled b in resolve, whose barrier already waited for c_to_b's writes
+        ta_rg_state sampled = rg_usage_state(RG_USAGE_SAMPLED, RG_PASS_GRAPHICS);
+        const ta_rg_barrier *first = rg_test_barrier(graph.passes[pass_a].barriers, a);
+        rg_test_expect(test, first && first->src.stages == sampled.stages, name,
+            "the first occupant of a slot to wait for the previous frame's last occupant");
+    }
+
+    {
+        // The level pass: a transient depth buffer cleared and drawn every frame, with frames in flight sharing it
+        const char *name = "frames";
+        ta_render_graph graph = {};
+        ta_render_graph_init(graph);
+        ta_rg_resource backbuffer = ta_render_graph_import_image(graph, "backbuffer", VK_FORMAT_B8G8R8A8_UNORM,
+            VK_IMAGE_LAYOUT_UNDEFINED, RG_USAGE_PRESENT);
+        ta_rg_resource depth = ta_render_graph_create_image(graph, "depth", VK_FORMAT_D32_SFLOAT, extent);
+        ta_rg_pass level = ta_render_graph_add_pass(graph, "level", RG_PASS_GRAPHICS, NULL, NULL);
+        ta_render_graph_use(graph, level, backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+        ta_render_graph_use(graph, level, depth, RG_USAGE_DEPTH_ATTACHMENT);
+        ta_render_graph_compile(graph);
+
+        ta_rg_state depth_state = rg_usage_state(RG_USAGE_DEPTH_ATTACHMENT, RG_PASS_GRAPHICS);
+        const ta_rg_barrier *clear = rg_test_barrier(graph.passes[level].barriers, depth);
+        rg_test_expect(test, rg_test_layouts(clear, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL), name, "depth UNDEFINED -> DEPTH_STENCIL_ATTACHMENT");
+        rg_test_expect(test, clear && clear->src.stages == depth_state.stages &&
+            clear->src.access == VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, name,
+            "the clear to wait for the previous frame's depth writes");
+        rg_test_expect(test, (graph.passes[level].barriers.src_stages & depth_state.stages) == depth_state.stages,
+            name, "the batch to wait on the depth test stages, not TOP_OF_PIPE");
+    }
+
+    if (test.failed) {
+        ta_log_write_level(log, SRC_VULKAN, LEVEL_ERROR, "Render graph self-test: %u of %u checks failed\n",
+            test.failed, test.checks);
+    } else {
+        ta_log_write(log, SRC_VULKAN, "Render graph self-test: %u checks passed\n", test.checks);
+    }
+    return test.failed == 0;
+}
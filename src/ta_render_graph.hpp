@@ -0,0 +1,157 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_gpu_profiler.hpp"
+#include "ta_pipeline_stats.hpp"
+#include "ta_vk_debug.hpp"
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef uint32_t ta_rg_resource;
+typedef uint32_t ta_rg_pass;
+#define TA_RG_INVALID UINT32_MAX
+
+struct ta_render_graph;
+typedef void (*ta_rg_pass_fn)(VkCommandBuffer command_buffer, ta_render_graph &graph, ta_rg_pass pass,
+    void *userdata);
+
+typedef enum ta_rg_pass_type {
+    RG_PASS_GRAPHICS,
+    RG_PASS_COMPUTE,
+    RG_PASS_TRANSFER,
+} ta_rg_pass_type;
+
+// How a pass touches a resource. Determines the pipeline stage, access mask and image layout the graph
+// transitions the resource to before the pass runs, and whether the access counts as a write.
+typedef enum ta_rg_usage {
+    RG_USAGE_COLOR_ATTACHMENT,      // write
+    RG_USAGE_DEPTH_ATTACHMENT,      // write (depth test + write)
+    RG_USAGE_DEPTH_READ,            // depth test only, or sampled as read-only depth
+    RG_USAGE_SAMPLED,               // texture read
+    RG_USAGE_STORAGE_READ,
+    RG_USAGE_STORAGE_WRITE,         // write
+    RG_USAGE_TRANSFER_SRC,
+    RG_USAGE_TRANSFER_DST,          // write
+    RG_USAGE_VERTEX_BUFFER,
+    RG_USAGE_INDEX_BUFFER,
+    RG_USAGE_INDIRECT_BUFFER,
+    RG_USAGE_UNIFORM_BUFFER,
+    RG_USAGE_PRESENT,               // only valid as the final usage of an imported output
+    RG_USAGE_COUNT
+} ta_rg_usage;
+
+typedef enum ta_rg_resource_kind {
+    RG_RESOURCE_IMAGE,
+    RG_RESOURCE_BUFFER,
+} ta_rg_resource_kind;
+
+typedef struct ta_rg_state {
+    VkPipelineStageFlags stages;
+    VkAccessFlags        access;
+    VkImageLayout        layout;
+} ta_rg_state;
+
+typedef struct ta_rg_barrier {
+    ta_rg_resource resource;
+    ta_rg_state    src;
+    ta_rg_state    dst;
+} ta_rg_barrier;
+
+// Everything that has to happen before a pass, emitted as a single vkCmdPipelineBarrier
+typedef struct ta_rg_barrier_batch {
+    VkPipelineStageFlags       src_stages;
+    VkPipelineStageFlags       dst_stages;
+    std::vector<ta_rg_barrier> barriers;
+} ta_rg_barrier_batch;
+
+typedef struct ta_rg_access {
+    ta_rg_resource resource;
+    ta_rg_usage    usage;
+} ta_rg_access;
+
+typedef struct ta_rg_resource_desc {
+    std::string         name;
+    ta_rg_resource_kind kind;
+    bool                imported;       // owned by someone else (e.g. swap chain image), bound every frame
+    bool                output;         // consumed outside the graph, keeps its writers alive
+    VkFormat            format;
+    VkExtent2D          extent;
+    VkDeviceSize        size;           // buffers only
+    ta_rg_usage         final_usage;    // imported outputs: state to leave the resource in after the last pass
+    VkImageLayout       initial_layout; // imported only: layout the resource is in when the graph starts
+    // Filled in by compile
+    VkImageUsageFlags   image_usage;
+    VkBufferUsageFlags  buffer_usage;
+    uint32_t            first_pass;     // index into compiled order, TA_RG_INVALID if unused
+    uint32_t            last_pass;
+    uint32_t            alias_slot;     // transient memory slot, TA_RG_INVALID for imported/unused
+    // Physical resources, filled in by realize (transient) or bind (imported)
+    VkImage             image;
+    VkImageView         view;
+    VkBuffer            buffer;
+} ta_rg_resource_desc;
+
+typedef struct ta_rg_pass_desc {
+    std::string               name;
+    ta_rg_pass_type           type;
+    std::vector<ta_rg_access> accesses;
+    ta_rg_pass_fn             fn;
+    void                      *userdata;
+    bool                      side_effects;     // never culled, e.g. writes to something outside the graph
+    // Filled in by compile
+    bool                      live;
+    ta_rg_barrier_batch       barriers;
+} ta_rg_pass_desc;
+
+// Transient resources with disjoint lifetimes share one of these
+typedef struct ta_rg_alias_slot {
+    ta_rg_resource_kind         kind;
+    VkDeviceSize                estimated_size;
+    std::vector<ta_rg_resource> resources;
+    VkDeviceMemory              memory;
+} ta_rg_alias_slot;
+
+// Frame graph. Passes declare which resources they use and how; compile (CPU only, no device needed) culls passes
+// that don't contribute to an output, infers and batches every barrier and image layout transition, and assigns
+// transient resources with non-overlapping lifetimes to shared memory slots. Compile only reruns when the topology
+// changes (passes/resources added or removed); binding a different swap chain image every frame does not count.
+typedef struct ta_render_graph {
+    std::vector<ta_rg_resource_desc> resources;
+    std::vector<ta_rg_pass_desc>     passes;
+    std::vector<ta_rg_pass>          order;             // live passes, in execution order
+    ta_rg_barrier_batch              final_barriers;    // transitions outputs to their final usage
+    std::vector<ta_rg_alias_slot>    alias_slots;
+    bool                             dirty;             // topology changed since the last compile
+    bool                             realized;          // transient resources exist for the current compile
+    uint32_t                         compile_count;
+    // Scratch for execute
+    std::vector<VkImageMemoryBarrier>  image_barriers;
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+} ta_render_graph;
+
+void ta_render_graph_init               (ta_render_graph &graph);
+ta_rg_resource ta_render_graph_create_image (ta_render_graph &graph, const char *name, VkFormat format,
+                                         VkExtent2D extent);
+ta_rg_resource ta_render_graph_create_buffer(ta_render_graph &graph, const char *name, VkDeviceSize size);
+ta_rg_resource ta_render_graph_import_image (ta_render_graph &graph, const char *name, VkFormat format,
+                                         VkImageLayout initial_layout, ta_rg_usage final_usage);
+void ta_render_graph_bind_image         (ta_render_graph &graph, ta_rg_resource resource, VkImage image,
+                                         VkImageView view, VkExtent2D extent);
+ta_rg_pass ta_render_graph_add_pass     (ta_render_graph &graph, const char *name, ta_rg_pass_type type,
+                                         ta_rg_pass_fn fn, void *userdata);
+void ta_render_graph_use                (ta_render_graph &graph, ta_rg_pass pass, ta_rg_resource resource,
+                                         ta_rg_usage usage);
+void ta_render_graph_side_effects       (ta_render_graph &graph, ta_rg_pass pass);
+bool ta_render_graph_compile            (ta_render_graph &graph);
+VkResult ta_render_graph_realize        (ta_render_graph &graph, VkDevice device,
+                                         const VkPhysicalDeviceMemoryProperties &memory_properties,
+                                         ta_deletion_queue &deletion_queue, uint64_t frame);
+void ta_render_graph_execute            (ta_render_graph &graph, VkCommandBuffer command_buffer,
+                                         ta_gpu_profiler *profiler, ta_pipeline_stats *pipeline_stats,
+                                         ta_vk_debug *debug);
+void ta_render_graph_dump               (ta_render_graph &graph, ta_log &log);
+void ta_render_graph_release            (ta_render_graph &graph, ta_deletion_queue &deletion_queue, uint64_t frame);
+void ta_render_graph_free               (ta_render_graph &graph, ta_deletion_queue &deletion_queue, uint64_t frame);
+bool ta_render_graph_self_test          (ta_log &log);
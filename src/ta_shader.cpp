@@ -0,0 +1,321 @@
+#include "ta_shader.hpp"
+#include "ta_log.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+static bool shader_read(ta_shader_library &library, const std::string &name, std::vector<uint32_t> &code)
+{
+    std::string path = library.directory + "/" + name;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to open shader '%s'.\n", path.c_str());
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0 || size % sizeof(uint32_t)) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to read shader '%s', %ld bytes isn't SPIR-V.\n", path.c_str(),
+            size);
+        fclose(file);
+        return false;
+    }
+    code.resize((size_t)size / sizeof(uint32_t));
+    size_t read = fread(code.data(), 1, (size_t)size, file);
+    fclose(file);
+    if (read != (size_t)size) {
+        ta_log_write(tg_debug_log, SRC_FILE, "Failed to read shader '%s'.\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Reads, reflects and creates the module for name. The reflection is cached, so an unchanged file costs a read + hash.
+static bool shader_create(ta_shader_library &library, const std::string &name, VkShaderModule *module,
+    const ta_spirv_module **reflection)
+{
+    std::vector<uint32_t> code;
+    if (!shader_read(library, name, code)) {
+        return false;
+    }
+    *reflection = ta_spirv_cache_reflect(*library.spirv_cache, code.data(), code.size() * sizeof(uint32_t));
+    if (!*reflection) {
+        return false;
+    }
+
+    VkShaderModuleCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = code.size() * sizeof(uint32_t);
+    create_info.pCode = code.data();
+    VkResult err = vkCreateShaderModule(library.device, &create_info, NULL, module);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create shader module '%s'.\n", err, name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Queues a compile of the pipeline against the current version of its shaders
+static bool shader_pipeline_request(ta_shader_library &library, ta_shader_pipeline &pipeline,
+    ta_deletion_queue *deletion_queue, uint64_t frame)
+{
+    std::vector<const ta_spirv_module *> modules;
+    for (ta_shader_handle handle : pipeline.shaders) {
+        modules.push_back(library.shaders[handle].reflection);
+    }
+    const ta_spirv_layout *layout = ta_spirv_cache_layout(*library.spirv_cache, modules.data(),
+        (uint32_t)modules.size(), pipeline.set_overrides);
+    if (!layout) {
+        return false;
+    }
+
+    uint64_t hash = 0;
+    if (pipeline.bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+        pipeline.graphics.shaders.resize(pipeline.shaders.size());
+        for (size_t i = 0; i < pipeline.shaders.size(); ++i) {
+            const ta_shader &shader = library.shaders[pipeline.shaders[i]];
+            ta_spirv_pipeline_shader(*shader.reflection, shader.module, pipeline.graphics.shaders[i]);
+        }
+        pipeline.graphics.layout = layout->layout;
+        hash = ta_pipeline_hash_graphics(pipeline.graphics);
+        ta_pipeline_cache_graphics(*library.pipeline_cache, pipeline.graphics, VK_NULL_HANDLE);
+    } else {
+        const ta_shader &shader = library.shaders[pipeline.shaders[0]];
+        ta_spirv_pipeline_shader(*shader.reflection, shader.module, pipeline.compute.shader);
+        pipeline.compute.layout = layout->layout;
+        hash = ta_pipeline_hash_compute(pipeline.compute);
+        ta_pipeline_cache_compute(*library.pipeline_cache, pipeline.compute, VK_NULL_HANDLE);
+    }
+
+    // A newer edit supersedes a rebuild that hasn't finished yet
+    bool superseded = pipeline.pending_hash && pipeline.pending_hash != hash && pipeline.pending_hash != pipeline.hash;
+    if (deletion_queue && superseded) {
+        ta_pipeline_cache_evict(*library.pipeline_cache, pipeline.pending_hash, *deletion_queue, frame);
+    }
+    pipeline.pending_hash = hash;
+    pipeline.pending_layout = layout;
+    return true;
+}
+
+static void shader_reload(ta_shader_library &library, ta_shader_handle handle, ta_deletion_queue &deletion_queue,
+    uint64_t frame)
+{
+    ta_shader &shader = library.shaders[handle];
+    double start_ms = ta_timer_elapsed_ms();
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    const ta_spirv_module *reflection = NULL;
+    if (!shader_create(library, shader.name, &module, &reflection)) {
+        // Half-written files land here too, the next change event retries
+        ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to reload shader '%s', keeping v%u.\n", shader.name.c_str(),
+            shader.version);
+        library.reload_failures++;
+        return;
+    }
+    if (reflection == shader.reflection) {
+        // Touched, but the SPIR-V is the same
+        library.retired_modules.push_back(module);
+        return;
+    }
+
+    library.retired_modules.push_back(shader.module);
+    shader.module = module;
+    shader.reflection = reflection;
+    shader.version++;
+    library.reloads++;
+
+    uint32_t rebuilt = 0;
+    for (ta_shader_pipeline &pipeline : library.pipelines) {
+        if (std::find(pipeline.shaders.begin(), pipeline.shaders.end(), handle) == pipeline.shaders.end()) {
+            continue;
+        }
+        if (shader_pipeline_request(library, pipeline, &deletion_queue, frame)) {
+            rebuilt++;
+        }
+    }
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Reloaded shader '%s' v%u in %.3fms, rebuilding %u pipelines\n",
+        shader.name.c_str(), shader.version, ta_timer_elapsed_ms() - start_ms, rebuilt);
+}
+
+void ta_shader_library_init(ta_shader_library &library, VkDevice device, const char *directory,
+    ta_spirv_cache &spirv_cache, ta_pipeline_cache &pipeline_cache, bool hot_reload)
+{
+    library.device = device;
+    library.directory = directory;
+    library.spirv_cache = &spirv_cache;
+    library.pipeline_cache = &pipeline_cache;
+    library.shaders.clear();
+    library.by_name.clear();
+    library.pipelines.clear();
+    library.changed.clear();
+    library.retired_modules.clear();
+    library.reloads = 0;
+    library.reload_failures = 0;
+    library.swaps = 0;
+    library.watch = {};
+
+    library.hot_reload = hot_reload && ta_file_watch_init(library.watch, directory);
+    if (hot_reload && !library.hot_reload) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "Shader hot reload unavailable, shaders in '%s' load once.\n",
+            directory);
+    }
+}
+
+// Loading the same name twice returns the same handle
+ta_shader_handle ta_shader_load(ta_shader_library &library, const char *name)
+{
+    auto it = library.by_name.find(name);
+    if (it != library.by_name.end()) {
+        return it->second;
+    }
+
+    ta_shader shader = {};
+    shader.name = name;
+    if (!shader_create(library, shader.name, &shader.module, &shader.reflection)) {
+        return TA_SHADER_INVALID;
+    }
+    ta_shader_handle handle = (ta_shader_handle)library.shaders.size();
+    library.shaders.push_back(shader);
+    library.by_name[shader.name] = handle;
+    return handle;
+}
+
+static ta_shader_pipeline_handle shader_pipeline_add(ta_shader_library &library, ta_shader_pipeline &pipeline,
+    const VkDescriptorSetLayout *set_overrides)
+{
+    for (ta_shader_handle handle : pipeline.shaders) {
+        if (handle >= library.shaders.size()) {
+            return TA_SHADER_INVALID;
+        }
+    }
+    for (uint32_t set = 0; set < TA_SPIRV_MAX_SETS; ++set) {
+        pipeline.set_overrides[set] = set_overrides ? set_overrides[set] : VK_NULL_HANDLE;
+    }
+    if (!shader_pipeline_request(library, pipeline, NULL, 0)) {
+        return TA_SHADER_INVALID;
+    }
+    ta_shader_pipeline_handle handle = (ta_shader_pipeline_handle)library.pipelines.size();
+    library.pipelines.push_back(pipeline);
+    return handle;
+}
+
+// desc supplies the fixed-function state and, optionally, spec constants per stage (in shader order). Stage, module,
+// entry point and layout come from the shaders. set_overrides is TA_SPIRV_MAX_SETS entries or NULL.
+ta_shader_pipeline_handle ta_shader_pipeline_graphics(ta_shader_library &library,
+    const ta_graphics_pipeline_desc &desc, const ta_shader_handle *shaders, uint32_t shader_count,
+    const VkDescriptorSetLayout *set_overrides)
+{
+    ta_shader_pipeline pipeline = {};
+    pipeline.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    pipeline.shaders.assign(shaders, shaders + shader_count);
+    pipeline.graphics = desc;
+    return shader_pipeline_add(library, pipeline, set_overrides);
+}
+
+ta_shader_pipeline_handle ta_shader_pipeline_compute(ta_shader_library &library, ta_shader_handle shader,
+    const VkDescriptorSetLayout *set_overrides)
+{
+    ta_shader_pipeline pipeline = {};
+    pipeline.bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+    pipeline.shaders.push_back(shader);
+    return shader_pipeline_add(library, pipeline, set_overrides);
+}
+
+// VK_NULL_HANDLE until the first compile finishes, skip the draw/dispatch until then. layout (optional) is the layout
+// matching the returned pipeline, which can change on reload.
+VkPipeline ta_shader_pipeline_get(ta_shader_library &library, ta_shader_pipeline_handle handle,
+    const ta_spirv_layout **layout)
+{
+    assert(handle < library.pipelines.size());
+    const ta_shader_pipeline &pipeline = library.pipelines[handle];
+    if (layout) {
+        *layout = pipeline.layout;
+    }
+    return pipeline.pipeline;
+}
+
+// Call once per frame, before recording. Reloads shaders that changed and swaps in rebuilt pipelines, so a frame never
+// sees a pipeline change halfway through.
+void ta_shader_library_begin_frame(ta_shader_library &library, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    if (library.hot_reload) {
+        double now_ms = ta_timer_elapsed_ms();
+        library.scratch_names.clear();
+        if (!ta_file_watch_poll(library.watch, library.scratch_names)) {
+            for (const ta_shader &shader : library.shaders) {
+                library.changed[shader.name] = now_ms;
+            }
+        }
+        for (const std::string &name : library.scratch_names) {
+            if (library.by_name.count(name)) {
+                library.changed[name] = now_ms;
+            }
+        }
+        for (auto it = library.changed.begin(); it != library.changed.end();) {
+            if (now_ms - it->second < TA_SHADER_RELOAD_DELAY_MS) {
+                ++it;
+                continue;
+            }
+            shader_reload(library, library.by_name[it->first], deletion_queue, frame);
+            it = library.changed.erase(it);
+        }
+    }
+
+    for (ta_shader_pipeline &pipeline : library.pipelines) {
+        if (!pipeline.pending_hash) {
+            continue;
+        }
+        VkPipeline ready = VK_NULL_HANDLE;
+        ta_pipeline_status status = ta_pipeline_cache_status(*library.pipeline_cache, pipeline.pending_hash, &ready);
+        if (status == PIPELINE_STATUS_PENDING) {
+            continue;
+        }
+        if (status == PIPELINE_STATUS_READY) {
+            if (pipeline.hash && pipeline.hash != pipeline.pending_hash) {
+                // Recorded command buffers may still reference it, the deletion queue waits them out
+                ta_pipeline_cache_evict(*library.pipeline_cache, pipeline.hash, deletion_queue, frame);
+                library.swaps++;
+            }
+            pipeline.hash = pipeline.pending_hash;
+            pipeline.pipeline = ready;
+            pipeline.layout = pipeline.pending_layout;
+        } else {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Pipeline %016llx failed to compile, keeping the previous one.\n",
+                (unsigned long long)pipeline.pending_hash);
+            // Don't keep the failure cached, reverting the edit should compile again
+            ta_pipeline_cache_evict(*library.pipeline_cache, pipeline.pending_hash, deletion_queue, frame);
+        }
+        pipeline.pending_hash = 0;
+        pipeline.pending_layout = NULL;
+    }
+
+    // Replaced modules can go once no compile job could still be reading them
+    if (!library.retired_modules.empty() && ta_pipeline_cache_idle(*library.pipeline_cache)) {
+        for (VkShaderModule module : library.retired_modules) {
+            ta_deletion_queue_push(deletion_queue, DELETION_SHADER_MODULE, TA_VK_HANDLE(module), frame);
+        }
+        library.retired_modules.clear();
+    }
+}
+
+// Pipelines belong to the pipeline cache and are freed with it
+void ta_shader_library_free(ta_shader_library &library, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Shader library: %u shaders, %u pipelines, %u reloads (%u failed), "
+        "%u pipelines swapped\n", (uint32_t)library.shaders.size(), (uint32_t)library.pipelines.size(),
+        library.reloads, library.reload_failures, library.swaps);
+
+    ta_file_watch_free(library.watch);
+    for (const ta_shader &shader : library.shaders) {
+        ta_deletion_queue_push(deletion_queue, DELETION_SHADER_MODULE, TA_VK_HANDLE(shader.module), frame);
+    }
+    for (VkShaderModule module : library.retired_modules) {
+        ta_deletion_queue_push(deletion_queue, DELETION_SHADER_MODULE, TA_VK_HANDLE(module), frame);
+    }
+    library.shaders.clear();
+    library.by_name.clear();
+    library.pipelines.clear();
+    library.retired_modules.clear();
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_file_watch.hpp"
+#include "ta_pipeline_cache.hpp"
+#include "ta_spirv.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t ta_shader_handle;
+typedef uint32_t ta_shader_pipeline_handle;
+#define TA_SHADER_INVALID UINT32_MAX
+
+// Editors and shader compilers write a file in several steps, wait for it to go quiet before reloading
+#define TA_SHADER_RELOAD_DELAY_MS 100.0
+
+typedef struct ta_shader {
+    std::string           name;         // file name, relative to the library's directory
+    VkShaderModule        module;
+    const ta_spirv_module *reflection;  // owned by the spirv cache
+    uint32_t              version;      // bumped on every reload that changed the SPIR-V
+} ta_shader;
+
+// A pipeline built from library shaders. Its layout is generated from the shaders' reflection.
+typedef struct ta_shader_pipeline {
+    VkPipelineBindPoint           bind_point;
+    std::vector<ta_shader_handle> shaders;
+    ta_graphics_pipeline_desc     graphics;         // shader module/hash/layout fields are filled in on every build
+    ta_compute_pipeline_desc      compute;
+    VkDescriptorSetLayout         set_overrides[TA_SPIRV_MAX_SETS];
+    // In use
+    uint64_t                      hash;
+    VkPipeline                    pipeline;         // VK_NULL_HANDLE until the first compile finishes
+    const ta_spirv_layout         *layout;
+    // Rebuild in flight, swapped in by begin_frame once it has compiled
+    uint64_t                      pending_hash;     // 0 if none
+    const ta_spirv_layout         *pending_layout;
+} ta_shader_pipeline;
+
+// Owns the shader modules loaded from one directory and the pipelines built from them. With hot reload on, changed
+// SPIR-V is re-reflected at the next frame boundary and only the pipelines using it are recompiled, in the background
+// through the pipeline cache. The old pipeline stays in use until the new one is ready, then goes to the deletion
+// queue.
+// NOTE: The directory watch isn't recursive, shader names are plain file names.
+typedef struct ta_shader_library {
+    VkDevice                                          device;
+    std::string                                       directory;
+    ta_spirv_cache                                    *spirv_cache;
+    ta_pipeline_cache                                 *pipeline_cache;
+    bool                                              hot_reload;
+    ta_file_watch                                     watch;
+    std::vector<ta_shader>                            shaders;
+    std::unordered_map<std::string, ta_shader_handle> by_name;
+    std::vector<ta_shader_pipeline>                   pipelines;
+    std::unordered_map<std::string, double>           changed;          // name -> time of the last change event
+    std::vector<VkShaderModule>                       retired_modules;  // replaced, compile jobs may still read them
+    std::vector<std::string>                          scratch_names;
+    // Stats
+    uint32_t                                          reloads;
+    uint32_t                                          reload_failures;
+    uint32_t                                          swaps;
+} ta_shader_library;
+
+void ta_shader_library_init             (ta_shader_library &library, VkDevice device, const char *directory,
+                                         ta_spirv_cache &spirv_cache, ta_pipeline_cache &pipeline_cache,
+                                         bool hot_reload);
+ta_shader_handle ta_shader_load         (ta_shader_library &library, const char *name);
+ta_shader_pipeline_handle ta_shader_pipeline_graphics(ta_shader_library &library,
+                                         const ta_graphics_pipeline_desc &desc, const ta_shader_handle *shaders,
+                                         uint32_t shader_count, const VkDescriptorSetLayout *set_overrides);
+ta_shader_pipeline_handle ta_shader_pipeline_compute(ta_shader_library &library, ta_shader_handle shader,
+                                         const VkDescriptorSetLayout *set_overrides);
+VkPipeline ta_shader_pipeline_get       (ta_shader_library &library, ta_shader_pipeline_handle handle,
+                                         const ta_spirv_layout **layout);
+void ta_shader_library_begin_frame      (ta_shader_library &library, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame);
+void ta_shader_library_free             (ta_shader_library &library, ta_deletion_queue &deletion_queue,
+                                         uint64_t frame);
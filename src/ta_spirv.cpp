@@ -0,0 +1,709 @@
+#include "ta_spirv.hpp"
+#include "ta_hash.hpp"
+#include "ta_timer.hpp"
+#include "vulkan/spirv.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+typedef enum spirv_decoration_flag {
+    SPIRV_HAS_SET          = 0x01,
+    SPIRV_HAS_BINDING      = 0x02,
+    SPIRV_HAS_LOCATION     = 0x04,
+    SPIRV_HAS_SPEC_ID      = 0x08,
+    SPIRV_HAS_BUILTIN      = 0x10,
+    SPIRV_BLOCK            = 0x20,
+    SPIRV_BUFFER_BLOCK     = 0x40,
+} spirv_decoration_flag;
+
+// Everything we care about for one result id. Which fields mean anything depends on opcode.
+typedef struct spirv_id {
+    uint32_t              opcode;           // instruction that defined the id, 0 if not (yet) defined
+    uint32_t              type;             // result type of values, pointee/element/component type of types
+    uint32_t              storage_class;
+    uint32_t              count;            // vector components, matrix columns, array length
+    uint32_t              width;            // int/float bits
+    bool                  is_signed;
+    uint32_t              image_dim;
+    uint32_t              image_sampled;
+    uint32_t              flags;            // spirv_decoration_flag
+    uint32_t              set;
+    uint32_t              binding;
+    uint32_t              location;
+    uint32_t              spec_id;
+    uint32_t              builtin;
+    uint32_t              array_stride;
+    uint64_t              value;            // constants
+    std::string           name;
+    std::vector<uint32_t> members;          // struct member types, composite constituents
+    std::vector<uint32_t> member_offsets;
+    std::vector<uint32_t> member_matrix_strides;
+} spirv_id;
+
+static const char *spirv_string(const uint32_t *words, uint32_t word_count)
+{
+    // NOTE: Literal strings are nul-terminated and padded to a word, make sure the nul is actually in there
+    if (!word_count || memchr(words, 0, word_count * sizeof(uint32_t)) == NULL) {
+        return NULL;
+    }
+    return (const char *)words;
+}
+
+static void spirv_member_resize(spirv_id &id, uint32_t member)
+{
+    if (id.member_offsets.size() <= member) {
+        id.member_offsets.resize(member + 1, 0);
+        id.member_matrix_strides.resize(member + 1, 0);
+    }
+}
+
+static uint32_t spirv_type_size(const std::vector<spirv_id> &ids, uint32_t type_id, uint32_t matrix_stride)
+{
+    const spirv_id &type = ids[type_id];
+    switch (type.opcode) {
+        case spv::OpTypeBool:
+            return sizeof(VkBool32);
+        case spv::OpTypeInt:
+        case spv::OpTypeFloat:
+            return type.width / 8;
+        case spv::OpTypeVector:
+            return type.count * spirv_type_size(ids, type.type, 0);
+        case spv::OpTypeMatrix:
+            // NOTE: Assumes column major, which is what glslang emits unless told otherwise
+            return type.count * (matrix_stride ? matrix_stride : spirv_type_size(ids, type.type, 0));
+        case spv::OpTypeArray:
+            return type.count * (type.array_stride ? type.array_stride : spirv_type_size(ids, type.type, 0));
+        case spv::OpTypeStruct: {
+            uint32_t size = 0;
+            for (size_t i = 0; i < type.members.size(); ++i) {
+                uint32_t offset = i < type.member_offsets.size() ? type.member_offsets[i] : 0;
+                uint32_t stride = i < type.member_matrix_strides.size() ? type.member_matrix_strides[i] : 0;
+                size = std::max(size, offset + spirv_type_size(ids, type.members[i], stride));
+            }
+            return size;
+        }
+        default:
+            // Runtime arrays, opaque types
+            return 0;
+    }
+}
+
+static bool spirv_stage(uint32_t execution_model, VkShaderStageFlagBits *stage)
+{
+    switch (execution_model) {
+        case spv::ExecutionModelVertex:                 *stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+        case spv::ExecutionModelTessellationControl:    *stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break;
+        case spv::ExecutionModelTessellationEvaluation: *stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break;
+        case spv::ExecutionModelGeometry:               *stage = VK_SHADER_STAGE_GEOMETRY_BIT; break;
+        case spv::ExecutionModelFragment:               *stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+        case spv::ExecutionModelGLCompute:              *stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+        default:                                        return false;
+    }
+    return true;
+}
+
+// Descriptor type of a variable's pointee, with any array stripped off. Returns false for types we don't reflect.
+static bool spirv_descriptor_type(const spirv_id &type, uint32_t storage_class, VkDescriptorType *descriptor_type)
+{
+    switch (type.opcode) {
+        case spv::OpTypeSampler:
+            *descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+            return true;
+        case spv::OpTypeSampledImage:
+            *descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            return true;
+        case spv::OpTypeImage:
+            if (type.image_dim == spv::DimSubpassData) {
+                *descriptor_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            } else if (type.image_dim == spv::DimBuffer) {
+                *descriptor_type = type.image_sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                                           : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            } else {
+                *descriptor_type = type.image_sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                                                           : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            return true;
+        case spv::OpTypeStruct:
+            if (storage_class == spv::StorageClassStorageBuffer || (type.flags & SPIRV_BUFFER_BLOCK)) {
+                *descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                return true;
+            }
+            if (storage_class == spv::StorageClassUniform) {
+                *descriptor_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static VkFormat spirv_input_format(const std::vector<spirv_id> &ids, const spirv_id &type)
+{
+    static const VkFormat float_formats[] = {
+        VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+    };
+    static const VkFormat sint_formats[] = {
+        VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+    };
+    static const VkFormat uint_formats[] = {
+        VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+    };
+
+    uint32_t components = 1;
+    const spirv_id *scalar = &type;
+    if (type.opcode == spv::OpTypeVector) {
+        components = type.count;
+        scalar = &ids[type.type];
+    }
+    if (components < 1 || components > 4 || scalar->width != 32) {
+        return VK_FORMAT_UNDEFINED;
+    }
+    if (scalar->opcode == spv::OpTypeFloat) {
+        return float_formats[components - 1];
+    }
+    if (scalar->opcode == spv::OpTypeInt) {
+        return scalar->is_signed ? sint_formats[components - 1] : uint_formats[components - 1];
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+static bool binding_less(const ta_spirv_binding &a, const ta_spirv_binding &b)
+{
+    return a.set < b.set || (a.set == b.set && a.binding < b.binding);
+}
+
+bool ta_spirv_reflect(const uint32_t *code, size_t size, ta_spirv_module &module)
+{
+    module = {};
+    module.hash = ta_hash_bytes(TA_HASH_SEED, code, size);
+    for (int i = 0; i < 3; ++i) {
+        module.workgroup_spec_ids[i] = TA_SPIRV_NO_SPEC_ID;
+    }
+
+    size_t word_count = size / sizeof(uint32_t);
+    if (size % sizeof(uint32_t) || word_count < 5 || code[0] != spv::MagicNumber) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to reflect SPIR-V, not a SPIR-V module.\n");
+        return false;
+    }
+
+    uint32_t bound = code[3];
+    std::vector<spirv_id> ids(bound);
+    std::vector<uint32_t> variables;
+    uint32_t entry_point_id = 0;
+    uint32_t local_size_ids[3] = {};
+    bool have_entry_point = false;
+
+    // NOTE: Decorations and names come before the types they refer to, and types before constants and variables, so
+    // one pass collects everything and the interface is resolved afterwards.
+    size_t i = 5;
+    while (i < word_count) {
+        const uint32_t *op = &code[i];
+        uint32_t opcode = op[0] & spv::OpCodeMask;
+        uint32_t count = op[0] >> spv::WordCountShift;
+        if (!count || i + count > word_count) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to reflect SPIR-V, truncated instruction at word %u.\n",
+                (uint32_t)i);
+            return false;
+        }
+        i += count;
+
+        // Every id operand we read below is checked against bound before use
+        uint32_t target = count > 1 ? op[1] : 0;
+        uint32_t result = count > 2 ? op[2] : 0;
+
+        switch (opcode) {
+            case spv::OpEntryPoint: {
+                const char *name = count > 3 ? spirv_string(op + 3, count - 3) : NULL;
+                if (have_entry_point || !name || result >= bound) {
+                    // NOTE: Multiple entry points per module aren't supported, we only reflect the first
+                    break;
+                }
+                if (!spirv_stage(op[1], &module.stage)) {
+                    ta_log_write(tg_debug_log, SRC_VULKAN,
+                        "Failed to reflect SPIR-V, unsupported execution model %u.\n", op[1]);
+                    return false;
+                }
+                module.entry_point = name;
+                entry_point_id = result;
+                have_entry_point = true;
+                break;
+            }
+            case spv::OpExecutionMode:
+                if (count >= 6 && target == entry_point_id && op[2] == spv::ExecutionModeLocalSize) {
+                    module.workgroup_size[0] = op[3];
+                    module.workgroup_size[1] = op[4];
+                    module.workgroup_size[2] = op[5];
+                }
+                break;
+            case spv::OpExecutionModeId:
+                if (count >= 6 && target == entry_point_id && op[2] == spv::ExecutionModeLocalSizeId) {
+                    local_size_ids[0] = op[3];
+                    local_size_ids[1] = op[4];
+                    local_size_ids[2] = op[5];
+                }
+                break;
+            case spv::OpName:
+                if (target < bound) {
+                    const char *name = spirv_string(op + 2, count - 2);
+                    ids[target].name = name ? name : "";
+                }
+                break;
+            case spv::OpDecorate: {
+                if (count < 3 || target >= bound) {
+                    break;
+                }
+                spirv_id &id = ids[target];
+                uint32_t literal = count > 3 ? op[3] : 0;
+                switch (op[2]) {
+                    case spv::DecorationDescriptorSet: id.set = literal;      id.flags |= SPIRV_HAS_SET; break;
+                    case spv::DecorationBinding:       id.binding = literal;  id.flags |= SPIRV_HAS_BINDING; break;
+                    case spv::DecorationLocation:      id.location = literal; id.flags |= SPIRV_HAS_LOCATION; break;
+                    case spv::DecorationSpecId:        id.spec_id = literal;  id.flags |= SPIRV_HAS_SPEC_ID; break;
+                    case spv::DecorationBuiltIn:       id.builtin = literal;  id.flags |= SPIRV_HAS_BUILTIN; break;
+                    case spv::DecorationBlock:         id.flags |= SPIRV_BLOCK; break;
+                    case spv::DecorationBufferBlock:   id.flags |= SPIRV_BUFFER_BLOCK; break;
+                    case spv::DecorationArrayStride:   id.array_stride = literal; break;
+                }
+                break;
+            }
+            case spv::OpMemberDecorate: {
+                if (count < 5 || target >= bound) {
+                    break;
+                }
+                spirv_id &id = ids[target];
+                uint32_t member = op[2];
+                if (op[3] == spv::DecorationOffset) {
+                    spirv_member_resize(id, member);
+                    id.member_offsets[member] = op[4];
+                } else if (op[3] == spv::DecorationMatrixStride) {
+                    spirv_member_resize(id, member);
+                    id.member_matrix_strides[member] = op[4];
+                }
+                break;
+            }
+            case spv::OpTypeBool:
+            case spv::OpTypeSampler:
+                if (target < bound) {
+                    ids[target].opcode = opcode;
+                }
+                break;
+            case spv::OpTypeInt:
+            case spv::OpTypeFloat:
+                if (count >= 3 && target < bound) {
+                    ids[target].opcode = opcode;
+                    ids[target].width = op[2];
+                    ids[target].is_signed = opcode == spv::OpTypeInt && count >= 4 && op[3];
+                }
+                break;
+            case spv::OpTypeVector:
+            case spv::OpTypeMatrix:
+                if (count >= 4 && target < bound && op[2] < bound) {
+                    ids[target].opcode = opcode;
+                    ids[target].type = op[2];
+                    ids[target].count = op[3];
+                }
+                break;
+            case spv::OpTypeImage:
+                if (count >= 9 && target < bound) {
+                    ids[target].opcode = opcode;
+                    ids[target].type = op[2];
+                    ids[target].image_dim = op[3];
+                    ids[target].image_sampled = op[7];
+                }
+                break;
+            case spv::OpTypeSampledImage:
+            case spv::OpTypeRuntimeArray:
+                if (count >= 3 && target < bound && op[2] < bound) {
+                    ids[target].opcode = opcode;
+                    ids[target].type = op[2];
+                }
+                break;
+            case spv::OpTypeArray:
+                if (count >= 4 && target < bound && op[2] < bound && op[3] < bound) {
+                    ids[target].opcode = opcode;
+                    ids[target].type = op[2];
+                    ids[target].count = (uint32_t)ids[op[3]].value;
+                }
+                break;
+            case spv::OpTypeStruct:
+                if (target < bound) {
+                    ids[target].opcode = opcode;
+                    for (uint32_t m = 2; m < count; ++m) {
+                        if (op[m] >= bound) {
+                            ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to reflect SPIR-V, id %u out of bounds.\n",
+                                op[m]);
+                            return false;
+                        }
+                        ids[target].members.push_back(op[m]);
+                    }
+                }
+                break;
+            case spv::OpTypePointer:
+                if (count >= 4 && target < bound && op[3] < bound) {
+                    ids[target].opcode = opcode;
+                    ids[target].storage_class = op[2];
+                    ids[target].type = op[3];
+                }
+                break;
+            case spv::OpConstant:
+            case spv::OpSpecConstant:
+                if (count >= 4 && result < bound) {
+                    ids[result].opcode = opcode;
+                    ids[result].type = target;
+                    ids[result].value = op[3];
+                    if (count >= 5) {
+                        ids[result].value |= (uint64_t)op[4] << 32;
+                    }
+                }
+                break;
+            case spv::OpConstantTrue:
+            case spv::OpConstantFalse:
+            case spv::OpSpecConstantTrue:
+            case spv::OpSpecConstantFalse:
+                if (count >= 3 && result < bound) {
+                    ids[result].opcode = opcode;
+                    ids[result].type = target;
+                    ids[result].value = opcode == spv::OpConstantTrue || opcode == spv::OpSpecConstantTrue;
+                }
+                break;
+            case spv::OpConstantComposite:
+            case spv::OpSpecConstantComposite:
+                if (count >= 3 && result < bound) {
+                    ids[result].opcode = opcode;
+                    ids[result].type = target;
+                    for (uint32_t m = 3; m < count; ++m) {
+                        if (op[m] >= bound) {
+                            ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to reflect SPIR-V, id %u out of bounds.\n",
+                                op[m]);
+                            return false;
+                        }
+                        ids[result].members.push_back(op[m]);
+                    }
+                }
+                break;
+            case spv::OpVariable:
+                if (count >= 4 && result < bound && target < bound) {
+                    ids[result].opcode = opcode;
+                    ids[result].type = target;
+                    ids[result].storage_class = op[3];
+                    variables.push_back(result);
+                }
+                break;
+            case spv::OpFunction:
+                // Types, constants and globals are all declared before the first function, nothing left to find
+                i = word_count;
+                break;
+        }
+    }
+
+    if (!have_entry_point) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to reflect SPIR-V, module has no entry point.\n");
+        return false;
+    }
+
+    for (uint32_t variable_id : variables) {
+        const spirv_id &variable = ids[variable_id];
+        const spirv_id &pointer = ids[variable.type];
+        if (pointer.opcode != spv::OpTypePointer) {
+            continue;
+        }
+        const spirv_id *type = &ids[pointer.type];
+
+        switch (variable.storage_class) {
+            case spv::StorageClassUniformConstant:
+            case spv::StorageClassUniform:
+            case spv::StorageClassStorageBuffer: {
+                ta_spirv_binding binding = {};
+                binding.set = variable.set;
+                binding.binding = variable.binding;
+                binding.count = 1;
+                binding.stages = module.stage;
+                binding.name = variable.name.empty() ? ids[pointer.type].name : variable.name;
+                if (type->opcode == spv::OpTypeArray) {
+                    binding.count = type->count;
+                    type = &ids[type->type];
+                } else if (type->opcode == spv::OpTypeRuntimeArray) {
+                    binding.count = 0;
+                    type = &ids[type->type];
+                }
+                if (!spirv_descriptor_type(*type, variable.storage_class, &binding.type)) {
+                    break;
+                }
+                if (!(variable.flags & SPIRV_HAS_BINDING)) {
+                    ta_log_write(tg_debug_log, SRC_VULKAN, "SPIR-V resource '%s' has no binding, skipping.\n",
+                        binding.name.c_str());
+                    break;
+                }
+                module.bindings.push_back(binding);
+                break;
+            }
+            case spv::StorageClassPushConstant: {
+                uint32_t offset = UINT32_MAX;
+                for (uint32_t member_offset : type->member_offsets) {
+                    offset = std::min(offset, member_offset);
+                }
+                if (offset == UINT32_MAX) {
+                    offset = 0;
+                }
+                uint32_t end = spirv_type_size(ids, pointer.type, 0);
+                if (end > offset) {
+                    module.push_constants.stageFlags = module.stage;
+                    module.push_constants.offset = offset;
+                    module.push_constants.size = end - offset;
+                }
+                break;
+            }
+            case spv::StorageClassInput: {
+                if (module.stage != VK_SHADER_STAGE_VERTEX_BIT || (variable.flags & SPIRV_HAS_BUILTIN) ||
+                    !(variable.flags & SPIRV_HAS_LOCATION)) {
+                    break;
+                }
+                // Matrices take one location per column
+                uint32_t columns = 1;
+                if (type->opcode == spv::OpTypeMatrix) {
+                    columns = type->count;
+                    type = &ids[type->type];
+                }
+                for (uint32_t c = 0; c < columns; ++c) {
+                    ta_spirv_input input = {};
+                    input.location = variable.location + c;
+                    input.format = spirv_input_format(ids, *type);
+                    input.name = variable.name;
+                    module.inputs.push_back(input);
+                }
+                break;
+            }
+        }
+    }
+
+    for (uint32_t id = 0; id < bound; ++id) {
+        const spirv_id &constant = ids[id];
+        if ((constant.flags & SPIRV_HAS_SPEC_ID) && (constant.opcode == spv::OpSpecConstant ||
+            constant.opcode == spv::OpSpecConstantTrue || constant.opcode == spv::OpSpecConstantFalse)) {
+            ta_spirv_spec_constant spec = {};
+            spec.id = constant.spec_id;
+            spec.size = spirv_type_size(ids, constant.type, 0);
+            spec.default_value = constant.value;
+            spec.name = constant.name;
+            module.spec_constants.push_back(spec);
+        }
+    }
+
+    // Workgroup size: LocalSizeId overrides LocalSize, and a WorkgroupSize builtin overrides both
+    for (int axis = 0; axis < 3; ++axis) {
+        if (local_size_ids[axis] && local_size_ids[axis] < bound) {
+            const spirv_id &constant = ids[local_size_ids[axis]];
+            module.workgroup_size[axis] = (uint32_t)constant.value;
+            if (constant.flags & SPIRV_HAS_SPEC_ID) {
+                module.workgroup_spec_ids[axis] = constant.spec_id;
+            }
+        }
+    }
+    for (uint32_t id = 0; id < bound; ++id) {
+        const spirv_id &composite = ids[id];
+        if ((composite.flags & SPIRV_HAS_BUILTIN) && composite.builtin == spv::BuiltInWorkgroupSize &&
+            composite.members.size() == 3) {
+            for (int axis = 0; axis < 3; ++axis) {
+                const spirv_id &constant = ids[composite.members[axis]];
+                module.workgroup_size[axis] = (uint32_t)constant.value;
+                if (constant.flags & SPIRV_HAS_SPEC_ID) {
+                    module.workgroup_spec_ids[axis] = constant.spec_id;
+                }
+            }
+        }
+    }
+
+    std::sort(module.bindings.begin(), module.bindings.end(), binding_less);
+    std::sort(module.inputs.begin(), module.inputs.end(),
+        [](const ta_spirv_input &a, const ta_spirv_input &b) { return a.location < b.location; });
+    std::sort(module.spec_constants.begin(), module.spec_constants.end(),
+        [](const ta_spirv_spec_constant &a, const ta_spirv_spec_constant &b) { return a.id < b.id; });
+    return true;
+}
+
+void ta_spirv_pipeline_shader(const ta_spirv_module &module, VkShaderModule shader_module, ta_pipeline_shader &shader)
+{
+    shader.stage = module.stage;
+    shader.module = shader_module;
+    shader.code_hash = module.hash;
+    shader.entry_point = module.entry_point;
+}
+
+void ta_spirv_cache_init(ta_spirv_cache &cache, VkDevice device, ta_descriptor_layout_cache &descriptor_layouts)
+{
+    cache.device = device;
+    cache.descriptor_layouts = &descriptor_layouts;
+    cache.modules.clear();
+    cache.layouts.clear();
+    cache.module_hits = 0;
+    cache.module_misses = 0;
+    cache.layout_hits = 0;
+    cache.layout_misses = 0;
+    cache.reflect_ms = 0.0;
+}
+
+// Returns NULL if the module couldn't be reflected. The result lives until the cache is freed.
+const ta_spirv_module *ta_spirv_cache_reflect(ta_spirv_cache &cache, const uint32_t *code, size_t size)
+{
+    uint64_t hash = ta_hash_bytes(TA_HASH_SEED, code, size);
+    auto it = cache.modules.find(hash);
+    if (it != cache.modules.end()) {
+        cache.module_hits++;
+        return it->second;
+    }
+    cache.module_misses++;
+
+    double start_ms = ta_timer_elapsed_ms();
+    ta_spirv_module *module = new ta_spirv_module();
+    if (!ta_spirv_reflect(code, size, *module)) {
+        delete module;
+        return NULL;
+    }
+    cache.reflect_ms += ta_timer_elapsed_ms() - start_ms;
+    cache.modules[hash] = module;
+    return module;
+}
+
+// Merges the interfaces of the given stages into one pipeline layout. set_overrides (TA_SPIRV_MAX_SETS entries, or
+// NULL) replaces reflected sets with existing layouts, e.g. for runtime arrays, whose size isn't in the SPIR-V.
+// Returns NULL if the stages disagree about a binding.
+const ta_spirv_layout *ta_spirv_cache_layout(ta_spirv_cache &cache, const ta_spirv_module *const *modules,
+    uint32_t module_count, const VkDescriptorSetLayout *set_overrides)
+{
+    std::vector<ta_spirv_binding> merged;
+    VkPushConstantRange push_constants = {};
+    uint32_t push_end = 0;
+    for (uint32_t m = 0; m < module_count; ++m) {
+        const ta_spirv_module &module = *modules[m];
+        for (const ta_spirv_binding &binding : module.bindings) {
+            if (binding.set >= TA_SPIRV_MAX_SETS) {
+                ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to build pipeline layout, '%s' uses set %u (max %u).\n",
+                    binding.name.c_str(), binding.set, TA_SPIRV_MAX_SETS - 1);
+                return NULL;
+            }
+            auto existing = std::find_if(merged.begin(), merged.end(), [&](const ta_spirv_binding &b) {
+                return b.set == binding.set && b.binding == binding.binding;
+            });
+            if (existing == merged.end()) {
+                merged.push_back(binding);
+                merged.back().name.clear();
+                continue;
+            }
+            if (existing->type != binding.type || existing->count != binding.count) {
+                ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to build pipeline layout, stages disagree on set %u "
+                    "binding %u ('%s').\n", binding.set, binding.binding, binding.name.c_str());
+                return NULL;
+            }
+            existing->stages |= binding.stages;
+        }
+        if (module.push_constants.size) {
+            if (!push_constants.stageFlags) {
+                push_constants.offset = module.push_constants.offset;
+            }
+            push_constants.stageFlags |= module.push_constants.stageFlags;
+            push_constants.offset = std::min(push_constants.offset, module.push_constants.offset);
+            push_end = std::max(push_end, module.push_constants.offset + module.push_constants.size);
+        }
+    }
+    if (push_constants.stageFlags) {
+        push_constants.size = push_end - push_constants.offset;
+    }
+    std::sort(merged.begin(), merged.end(), binding_less);
+
+    uint32_t set_count = merged.empty() ? 0 : merged.back().set + 1;
+    for (uint32_t set = 0; set_overrides && set < TA_SPIRV_MAX_SETS; ++set) {
+        if (set_overrides[set]) {
+            set_count = std::max(set_count, set + 1);
+        }
+    }
+
+    uint64_t hash = ta_hash_u64(TA_HASH_SEED, set_count);
+    for (const ta_spirv_binding &binding : merged) {
+        if (set_overrides && set_overrides[binding.set]) {
+            continue;
+        }
+        hash = ta_hash_u64(hash, binding.set);
+        hash = ta_hash_u64(hash, binding.binding);
+        hash = ta_hash_u64(hash, binding.type);
+        hash = ta_hash_u64(hash, binding.count);
+        hash = ta_hash_u64(hash, binding.stages);
+    }
+    for (uint32_t set = 0; set_overrides && set < set_count; ++set) {
+        hash = ta_hash_u64(hash, TA_VK_HANDLE(set_overrides[set]));
+    }
+    hash = ta_hash_bytes(hash, &push_constants, sizeof(push_constants));
+
+    auto it = cache.layouts.find(hash);
+    if (it != cache.layouts.end()) {
+        cache.layout_hits++;
+        return &it->second;
+    }
+    cache.layout_misses++;
+
+    ta_spirv_layout layout = {};
+    layout.set_count = set_count;
+    layout.push_constants = push_constants;
+    std::vector<VkDescriptorSetLayoutBinding> set_bindings;
+    for (uint32_t set = 0; set < set_count; ++set) {
+        if (set_overrides && set_overrides[set]) {
+            layout.sets[set] = set_overrides[set];
+            continue;
+        }
+        set_bindings.clear();
+        for (const ta_spirv_binding &binding : merged) {
+            if (binding.set != set) {
+                continue;
+            }
+            if (!binding.count) {
+                ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to build pipeline layout, set %u binding %u is a "
+                    "runtime array, pass a set override for it.\n", set, binding.binding);
+                return NULL;
+            }
+            VkDescriptorSetLayoutBinding layout_binding = {};
+            layout_binding.binding = binding.binding;
+            layout_binding.descriptorType = binding.type;
+            layout_binding.descriptorCount = binding.count;
+            layout_binding.stageFlags = binding.stages;
+            set_bindings.push_back(layout_binding);
+        }
+        // Gaps in the set numbering still need a (empty) layout
+        layout.sets[set] = ta_descriptor_layout_get(*cache.descriptor_layouts, set_bindings.data(),
+            (uint32_t)set_bindings.size(), 0);
+        if (!layout.sets[set]) {
+            return NULL;
+        }
+    }
+
+    VkPipelineLayoutCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    create_info.setLayoutCount = set_count;
+    create_info.pSetLayouts = layout.sets;
+    create_info.pushConstantRangeCount = push_constants.size ? 1 : 0;
+    create_info.pPushConstantRanges = &push_constants;
+    VkResult err = vkCreatePipelineLayout(cache.device, &create_info, NULL, &layout.layout);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create pipeline layout.\n", err);
+        return NULL;
+    }
+
+    ta_spirv_layout &entry = cache.layouts[hash];
+    entry = layout;
+    return &entry;
+}
+
+void ta_spirv_cache_free(ta_spirv_cache &cache, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    ta_log_write(tg_debug_log, SRC_VULKAN, "SPIR-V cache: %u modules reflected in %.3fms, %u module hits, "
+        "%u pipeline layouts, %u layout hits\n", (uint32_t)cache.modules.size(), cache.reflect_ms, cache.module_hits,
+        (uint32_t)cache.layouts.size(), cache.layout_hits);
+
+    for (auto &it : cache.layouts) {
+        ta_deletion_queue_push(deletion_queue, DELETION_PIPELINE_LAYOUT, TA_VK_HANDLE(it.second.layout), frame);
+    }
+    cache.layouts.clear();
+    for (auto &it : cache.modules) {
+        delete it.second;
+    }
+    cache.modules.clear();
+}
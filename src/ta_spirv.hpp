@@ -0,0 +1,86 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_descriptor.hpp"
+#include "ta_log.hpp"
+#include "ta_pipeline_cache.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// maxBoundDescriptorSets is only guaranteed to be 4
+#define TA_SPIRV_MAX_SETS 4
+#define TA_SPIRV_NO_SPEC_ID UINT32_MAX
+
+typedef struct ta_spirv_binding {
+    uint32_t           set;
+    uint32_t           binding;
+    VkDescriptorType   type;
+    uint32_t           count;      // 0 for runtime arrays
+    VkShaderStageFlags stages;
+    std::string        name;
+} ta_spirv_binding;
+
+typedef struct ta_spirv_input {
+    uint32_t    location;
+    VkFormat    format;         // VK_FORMAT_UNDEFINED for types we don't map (e.g. 64-bit)
+    std::string name;
+} ta_spirv_input;
+
+typedef struct ta_spirv_spec_constant {
+    uint32_t    id;
+    uint32_t    size;           // bytes, booleans are VkBool32
+    uint64_t    default_value;
+    std::string name;
+} ta_spirv_spec_constant;
+
+// Interface of one entry point of a SPIR-V module
+// NOTE: Pre-1.4 SPIR-V doesn't list descriptors in the entry point interface, so every resource declared in the module
+// is reflected, whether the entry point uses it or not. glslang strips unused ones anyway.
+typedef struct ta_spirv_module {
+    uint64_t                            hash;               // of the SPIR-V words
+    VkShaderStageFlagBits               stage;
+    std::string                         entry_point;
+    std::vector<ta_spirv_binding>       bindings;           // sorted by set, then binding
+    VkPushConstantRange                 push_constants;     // size 0 if the module has none
+    std::vector<ta_spirv_input>         inputs;             // vertex stage only, sorted by location
+    std::vector<ta_spirv_spec_constant> spec_constants;     // sorted by id
+    uint32_t                            workgroup_size[3];  // compute only
+    uint32_t                            workgroup_spec_ids[3];
+} ta_spirv_module;
+
+// Pipeline layout generated from a set of stages. Descriptor set layouts belong to the ta_descriptor_layout_cache.
+typedef struct ta_spirv_layout {
+    VkPipelineLayout      layout;
+    uint32_t              set_count;
+    VkDescriptorSetLayout sets[TA_SPIRV_MAX_SETS];
+    VkPushConstantRange   push_constants;   // merged across stages, use its stageFlags for vkCmdPushConstants
+} ta_spirv_layout;
+
+// Reflection results keyed by module hash, and pipeline layouts keyed by the merged interface, so after a shader's
+// first load reflection and layout creation are just lookups.
+// NOTE: Reflection can't tell a dynamic uniform/storage buffer from a plain one, bindings come back as the plain type.
+typedef struct ta_spirv_cache {
+    VkDevice                                        device;
+    ta_descriptor_layout_cache                      *descriptor_layouts;
+    std::unordered_map<uint64_t, ta_spirv_module *> modules;
+    std::unordered_map<uint64_t, ta_spirv_layout>   layouts;
+    // Stats
+    uint32_t                                        module_hits;
+    uint32_t                                        module_misses;
+    uint32_t                                        layout_hits;
+    uint32_t                                        layout_misses;
+    double                                          reflect_ms;
+} ta_spirv_cache;
+
+bool ta_spirv_reflect                   (const uint32_t *code, size_t size, ta_spirv_module &module);
+void ta_spirv_pipeline_shader           (const ta_spirv_module &module, VkShaderModule shader_module,
+                                         ta_pipeline_shader &shader);
+
+void ta_spirv_cache_init                (ta_spirv_cache &cache, VkDevice device,
+                                         ta_descriptor_layout_cache &descriptor_layouts);
+const ta_spirv_module *ta_spirv_cache_reflect(ta_spirv_cache &cache, const uint32_t *code, size_t size);
+const ta_spirv_layout *ta_spirv_cache_layout(ta_spirv_cache &cache, const ta_spirv_module *const *modules,
+                                         uint32_t module_count, const VkDescriptorSetLayout *set_overrides);
+void ta_spirv_cache_free                (ta_spirv_cache &cache, ta_deletion_queue &deletion_queue, uint64_t frame);
@@ -44,6 +44,15 @@ double ta_timer_elapsed_sec()
     return elapsed_sec;
 }
 
+// Converts a raw performance counter value (same clock as SDL_GetPerformanceCounter, e.g. one sampled by the driver)
+// to the ta_timer_elapsed_ms timeline
+double ta_timer_counter_to_ms(uint64_t counter)
+{
+    int64_t elapsed_ticks = (int64_t)(counter - perf_epoch);
+    double elapsed_ms = elapsed_ticks / perf_frequency_ms;
+    return elapsed_ms;
+}
+
 // Number of milliseconds since last second (modulo)
 uint64_t ta_timer_only_ms()
 {
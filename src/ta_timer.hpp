@@ -5,4 +5,5 @@ void ta_timer_init              ();
 uint64_t ta_timer_elapsed_ticks ();
 double ta_timer_elapsed_ms      ();
 double ta_timer_elapsed_sec     ();
+double ta_timer_counter_to_ms   (uint64_t counter);
 uint64_t ta_timer_only_ms       ();
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "ta_vk_buffer.hpp"
+#include <cassert>
+
+// Returns index of the first memory type allowed by type_bits that has all of the requested flags, or -1
+int32_t ta_vk_memory_type_find(const VkPhysicalDeviceMemoryProperties &memory_properties, uint32_t type_bits,
+    VkMemoryPropertyFlags flags)
+{
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+        if ((type_bits & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & flags) == flags) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+// NOTE: One allocation per buffer. Fine for the handful of long-lived buffers we have, but anything created per
+// draw should be suballocated instead (see ta_frame_alloc).
+VkResult ta_vk_buffer_create(ta_vk_buffer &buffer, VkDevice device,
+    const VkPhysicalDeviceMemoryProperties &memory_properties, VkDeviceSize size, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags flags)
+{
+    assert(size);
+    buffer = {};
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = size;
+    buffer_create_info.usage = usage;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult err = vkCreateBuffer(device, &buffer_create_info, NULL, &buffer.buffer);
+    if (err) {
+        return err;
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &requirements);
+    int32_t memory_type = ta_vk_memory_type_find(memory_properties, requirements.memoryTypeBits, flags);
+    if (memory_type < 0) {
+        vkDestroyBuffer(device, buffer.buffer, NULL);
+        buffer = {};
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = (uint32_t)memory_type;
+    err = vkAllocateMemory(device, &allocate_info, NULL, &buffer.memory);
+    if (err) {
+        vkDestroyBuffer(device, buffer.buffer, NULL);
+        buffer = {};
+        return err;
+    }
+
+    err = vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+    if (!err && (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        err = vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped);
+    }
+    if (err) {
+        vkDestroyBuffer(device, buffer.buffer, NULL);
+        vkFreeMemory(device, buffer.memory, NULL);
+        buffer = {};
+        return err;
+    }
+
+    buffer.size = size;
+    return VK_SUCCESS;
+}
+
+// Buffer may still be in use by frames in flight, so hand it off to the deletion queue. Freeing the memory implicitly
+// unmaps it.
+void ta_vk_buffer_destroy(ta_vk_buffer &buffer, ta_deletion_queue &deletion_queue, uint64_t frame)
+{
+    ta_deletion_queue_push(deletion_queue, DELETION_BUFFER, TA_VK_HANDLE(buffer.buffer), frame);
+    ta_deletion_queue_push(deletion_queue, DELETION_MEMORY, TA_VK_HANDLE(buffer.memory), frame);
+    buffer = {};
+}
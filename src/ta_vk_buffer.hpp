@@ -0,0 +1,18 @@
+#pragma once
+#include "ta_deletion_queue.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+
+typedef struct ta_vk_buffer {
+    VkBuffer       buffer;
+    VkDeviceMemory memory;
+    VkDeviceSize   size;
+    void           *mapped;     // persistently mapped pointer, NULL if memory isn't host visible
+} ta_vk_buffer;
+
+int32_t ta_vk_memory_type_find  (const VkPhysicalDeviceMemoryProperties &memory_properties, uint32_t type_bits,
+                                 VkMemoryPropertyFlags flags);
+VkResult ta_vk_buffer_create    (ta_vk_buffer &buffer, VkDevice device,
+                                 const VkPhysicalDeviceMemoryProperties &memory_properties, VkDeviceSize size,
+                                 VkBufferUsageFlags usage, VkMemoryPropertyFlags flags);
+void ta_vk_buffer_destroy       (ta_vk_buffer &buffer, ta_deletion_queue &deletion_queue, uint64_t frame);
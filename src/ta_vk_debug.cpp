@@ -0,0 +1,274 @@
+#include "ta_vk_debug.hpp"
+#include "SDL/SDL_mutex.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+static bool vk_debug_has_extension(const char *layer, const char *name)
+{
+    uint32_t count = 0;
+    if (vkEnumerateInstanceExtensionProperties(layer, &count, NULL)) {
+        return false;
+    }
+    std::vector<VkExtensionProperties> properties(count);
+    if (vkEnumerateInstanceExtensionProperties(layer, &count, properties.data())) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!strcmp(properties[i].extensionName, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool vk_debug_has_layer(const char *name)
+{
+    uint32_t count = 0;
+    if (vkEnumerateInstanceLayerProperties(&count, NULL)) {
+        return false;
+    }
+    std::vector<VkLayerProperties> properties(count);
+    if (vkEnumerateInstanceLayerProperties(&count, properties.data())) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!strcmp(properties[i].layerName, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static ta_log_level vk_debug_level(VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+{
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        return LEVEL_ERROR;
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        return LEVEL_WARN;
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+        return LEVEL_INFO;
+    }
+    return LEVEL_DEBUG;
+}
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    VkDebugUtilsMessageTypeFlagsEXT types, const VkDebugUtilsMessengerCallbackDataEXT *data, void *userdata)
+{
+    ta_vk_debug &debug = *(ta_vk_debug *)userdata;
+
+    bool log_it = false;
+    bool last_one = false;
+    TA_LOCK(debug.mutex);
+    ta_vk_debug_message &message = debug.messages[data->messageIdNumber];
+    if (!message.count && data->pMessageIdName) {
+        message.name = data->pMessageIdName;
+    }
+    message.count++;
+    if (debug.muted.count(data->messageIdNumber) || message.count > debug.repeat_limit) {
+        debug.suppressed++;
+    } else {
+        log_it = true;
+        last_one = message.count == debug.repeat_limit;
+        debug.last_id = data->messageIdNumber;
+        debug.logged++;
+    }
+    TA_UNLOCK(debug.mutex);
+
+    if (log_it) {
+        const char *type = (types & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) ? "validation" :
+                           (types & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) ? "performance" : "general";
+        // Innermost label of the command buffer the message is about, i.e. which render graph pass
+        const char *label = data->cmdBufLabelCount ? data->pCmdBufLabels[data->cmdBufLabelCount - 1].pLabelName : NULL;
+        ta_log_write_level(tg_debug_log, SRC_VULKAN, vk_debug_level(severity), "[%s 0x%08x] %s%s%s%s%s\n", type,
+            (uint32_t)data->messageIdNumber, data->pMessage, label ? " (in '" : "", label ? label : "",
+            label ? "')" : "", last_one ? " (repeat limit reached, further occurrences are only counted)" : "");
+    }
+
+    // NOTE: Never abort the call that triggered the message, the spec reserves VK_TRUE for layer development
+    return VK_FALSE;
+}
+
+// Picks the layers and extensions for the instance. With validation on the messenger info is chained into
+// instance_info, so vkCreateInstance/vkDestroyInstance get reported too. Returns false if validation was asked for
+// but the layer isn't installed, the instance is still usable without it.
+bool ta_vk_debug_init(ta_vk_debug &debug, bool validation, std::vector<const char *> &layers,
+    std::vector<const char *> &extensions, VkInstanceCreateInfo &instance_info)
+{
+    debug.repeat_limit = TA_VK_DEBUG_REPEAT_LIMIT;
+    debug.mutex = SDL_CreateMutex();
+
+    bool ok = true;
+    if (validation) {
+        if (vk_debug_has_layer(TA_VK_DEBUG_VALIDATION_LAYER)) {
+            layers.push_back(TA_VK_DEBUG_VALIDATION_LAYER);
+            debug.validation = true;
+        } else {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "Validation layer %s not found, running without validation.\n",
+                TA_VK_DEBUG_VALIDATION_LAYER);
+            ok = false;
+        }
+    }
+
+    // The loader normally implements debug utils itself, the validation layer provides it as well
+    debug.utils = vk_debug_has_extension(NULL, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) ||
+        (debug.validation && vk_debug_has_extension(TA_VK_DEBUG_VALIDATION_LAYER, VK_EXT_DEBUG_UTILS_EXTENSION_NAME));
+    if (debug.utils) {
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    } else if (debug.validation) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "%s not available, validation messages won't be logged.\n",
+            VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+
+    // Don't pay for messages the log would drop anyway
+    VkDebugUtilsMessengerCreateInfoEXT &info = debug.messenger_info;
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+        VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (tg_debug_log.level_filter & LEVEL_INFO) {
+        info.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    }
+    if (tg_debug_log.level_filter & LEVEL_DEBUG) {
+        info.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    }
+    info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+        VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    info.pfnUserCallback = vk_debug_callback;
+    info.pUserData = &debug;
+    if (debug.validation && debug.utils) {
+        info.pNext = instance_info.pNext;
+        instance_info.pNext = &info;
+    }
+    return ok;
+}
+
+void ta_vk_debug_create(ta_vk_debug &debug, VkInstance instance)
+{
+    debug.instance = instance;
+    if (!debug.utils) {
+        return;
+    }
+
+#define TA_VK_DEBUG_LOAD(member, name) debug.member = (PFN_##name)vkGetInstanceProcAddr(instance, #name);
+    TA_VK_DEBUG_LOAD(create_messenger,  vkCreateDebugUtilsMessengerEXT)
+    TA_VK_DEBUG_LOAD(destroy_messenger, vkDestroyDebugUtilsMessengerEXT)
+    TA_VK_DEBUG_LOAD(set_object_name,   vkSetDebugUtilsObjectNameEXT)
+    TA_VK_DEBUG_LOAD(cmd_begin_label,   vkCmdBeginDebugUtilsLabelEXT)
+    TA_VK_DEBUG_LOAD(cmd_end_label,     vkCmdEndDebugUtilsLabelEXT)
+#undef TA_VK_DEBUG_LOAD
+
+    if (debug.validation && debug.create_messenger) {
+        VkDebugUtilsMessengerCreateInfoEXT info = debug.messenger_info;
+        info.pNext = NULL;
+        VkResult err = debug.create_messenger(instance, &info, NULL, &debug.messenger);
+        if (err) {
+            ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to create debug utils messenger.\n", err);
+        }
+    }
+}
+
+void ta_vk_debug_set_device(ta_vk_debug &debug, VkDevice device)
+{
+    debug.device = device;
+}
+
+// NOTE: Muting only affects messages from here on, it's for silencing a known issue while chasing another one
+void ta_vk_debug_mute(ta_vk_debug &debug, int32_t message_id, bool mute)
+{
+    TA_LOCK(debug.mutex);
+    if (mute) {
+        debug.muted.insert(message_id);
+    } else {
+        debug.muted.erase(message_id);
+    }
+    TA_UNLOCK(debug.mutex);
+    ta_log_write(tg_debug_log, SRC_VULKAN, "%s validation message 0x%08x\n", mute ? "Muted" : "Unmuted",
+        (uint32_t)message_id);
+}
+
+// 0 if nothing has been logged yet
+int32_t ta_vk_debug_last_id(ta_vk_debug &debug)
+{
+    TA_LOCK(debug.mutex);
+    int32_t id = debug.last_id;
+    TA_UNLOCK(debug.mutex);
+    return id;
+}
+
+// handle is the object cast with TA_VK_HANDLE. The name is copied by the implementation.
+void ta_vk_debug_name(ta_vk_debug &debug, VkObjectType type, uint64_t handle, const char *name)
+{
+    if (!debug.set_object_name || !debug.device || !handle) {
+        return;
+    }
+    VkDebugUtilsObjectNameInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    info.objectType = type;
+    info.objectHandle = handle;
+    info.pObjectName = name;
+    debug.set_object_name(debug.device, &info);
+}
+
+void ta_vk_debug_label_begin(ta_vk_debug &debug, VkCommandBuffer command_buffer, const char *name)
+{
+    if (!debug.cmd_begin_label) {
+        return;
+    }
+    VkDebugUtilsLabelEXT label = {};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    debug.cmd_begin_label(command_buffer, &label);
+}
+
+void ta_vk_debug_label_end(ta_vk_debug &debug, VkCommandBuffer command_buffer)
+{
+    if (!debug.cmd_end_label) {
+        return;
+    }
+    debug.cmd_end_label(command_buffer);
+}
+
+// Every message ID seen this run, most frequent first
+void ta_vk_debug_report(ta_vk_debug &debug, ta_log &log)
+{
+    if (!debug.validation) {
+        return;
+    }
+
+    TA_LOCK(debug.mutex);
+    std::vector<std::pair<int32_t, ta_vk_debug_message>> sorted(debug.messages.begin(), debug.messages.end());
+    uint32_t logged = debug.logged;
+    uint32_t suppressed = debug.suppressed;
+    TA_UNLOCK(debug.mutex);
+
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<int32_t, ta_vk_debug_message> &a,
+        const std::pair<int32_t, ta_vk_debug_message> &b) {
+        return a.second.count > b.second.count;
+    });
+
+    ta_log_write(log, SRC_VULKAN, "Validation: %u messages logged, %u suppressed, %u distinct IDs\n", logged,
+        suppressed, (uint32_t)sorted.size());
+    ta_log_indent(log);
+    for (auto &entry : sorted) {
+        ta_log_write(log, SRC_VULKAN, "0x%08x %6ux %s%s\n", (uint32_t)entry.first, entry.second.count,
+            entry.second.name.c_str(), debug.muted.count(entry.first) ? " (muted)" : "");
+    }
+    ta_log_unindent(log);
+}
+
+// Call before vkDestroyInstance.
+// NOTE: vkDestroyInstance still reports through the messenger info chained at creation. With the mutex gone
+// SDL_LockMutex just fails, that's fine on the one thread left.
+void ta_vk_debug_free(ta_vk_debug &debug)
+{
+    if (debug.messenger) {
+        debug.destroy_messenger(debug.instance, debug.messenger, NULL);
+        debug.messenger = VK_NULL_HANDLE;
+    }
+    if (debug.mutex) {
+        SDL_DestroyMutex(debug.mutex);
+        debug.mutex = NULL;
+    }
+    debug.messages.clear();
+    debug.muted.clear();
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "ta_log.hpp"
+#include "ta_vk_dispatch.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+typedef struct SDL_mutex SDL_mutex;
+
+#define TA_VK_DEBUG_VALIDATION_LAYER "VK_LAYER_KHRONOS_validation"
+// Messages with the same ID are logged this many times, later ones are only counted
+#define TA_VK_DEBUG_REPEAT_LIMIT 3
+
+typedef struct ta_vk_debug_message {
+    std::string name;       // pMessageIdName, e.g. the VUID
+    uint32_t    count;
+} ta_vk_debug_message;
+
+// VK_EXT_debug_utils: routes validation messages into tg_debug_log (SRC_VULKAN) and names objects / labels command
+// buffer regions for the layers and capture tools. Validation is opt-in per run, names and labels work without it
+// whenever the loader has the extension.
+// NOTE: The messenger callback can fire on any thread that calls into Vulkan, the message table is behind the mutex.
+typedef struct ta_vk_debug {
+    bool                                             validation;   // layer enabled and messenger installed
+    bool                                             utils;        // VK_EXT_debug_utils enabled on the instance
+    uint32_t                                         repeat_limit;
+    VkInstance                                       instance;
+    VkDevice                                         device;
+    VkDebugUtilsMessengerCreateInfoEXT               messenger_info;   // also chained into VkInstanceCreateInfo
+    VkDebugUtilsMessengerEXT                         messenger;
+    PFN_vkCreateDebugUtilsMessengerEXT               create_messenger;
+    PFN_vkDestroyDebugUtilsMessengerEXT              destroy_messenger;
+    PFN_vkSetDebugUtilsObjectNameEXT                 set_object_name;
+    PFN_vkCmdBeginDebugUtilsLabelEXT                 cmd_begin_label;
+    PFN_vkCmdEndDebugUtilsLabelEXT                   cmd_end_label;
+    SDL_mutex                                        *mutex;
+    std::unordered_map<int32_t, ta_vk_debug_message> messages;     // messageIdNumber -> stats
+    std::unordered_set<int32_t>                      muted;
+    int32_t                                          last_id;      // most recent message that was logged
+    // Stats
+    uint32_t                                         logged;
+    uint32_t                                         suppressed;   // over the repeat limit, or muted
+} ta_vk_debug;
+
+bool ta_vk_debug_init                   (ta_vk_debug &debug, bool validation, std::vector<const char *> &layers,
+                                         std::vector<const char *> &extensions, VkInstanceCreateInfo &instance_info);
+void ta_vk_debug_create                 (ta_vk_debug &debug, VkInstance instance);
+void ta_vk_debug_set_device             (ta_vk_debug &debug, VkDevice device);
+void ta_vk_debug_mute                   (ta_vk_debug &debug, int32_t message_id, bool mute);
+int32_t ta_vk_debug_last_id             (ta_vk_debug &debug);
+void ta_vk_debug_name                   (ta_vk_debug &debug, VkObjectType type, uint64_t handle, const char *name);
+void ta_vk_debug_label_begin            (ta_vk_debug &debug, VkCommandBuffer command_buffer, const char *name);
+void ta_vk_debug_label_end              (ta_vk_debug &debug, VkCommandBuffer command_buffer);
+void ta_vk_debug_report                 (ta_vk_debug &debug, ta_log &log);
+void ta_vk_debug_free                   (ta_vk_debug &debug);
@@ -0,0 +1,137 @@
+#include "ta_vk_dispatch.hpp"
+#include "ta_log.hpp"
+#include "ta_timer.hpp"
+#include <algorithm>
+#include <cassert>
+
+#ifdef VK_NO_PROTOTYPES
+#define TA_VK_DEFINE(name) PFN_##name name;
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+TA_VK_GLOBAL_FUNCTIONS(TA_VK_DEFINE)
+TA_VK_INSTANCE_FUNCTIONS(TA_VK_DEFINE)
+TA_VK_DEVICE_FUNCTIONS(TA_VK_DEFINE)
+#undef TA_VK_DEFINE
+
+// A 1.0 loader doesn't have vkEnumerateInstanceVersion, which means 1.0
+static VKAPI_ATTR VkResult VKAPI_CALL dispatch_instance_version_1_0(uint32_t *api_version)
+{
+    *api_version = VK_API_VERSION_1_0;
+    return VK_SUCCESS;
+}
+#endif
+
+// get_instance_proc_addr comes from the dynamically loaded loader, e.g. SDL_Vulkan_GetVkGetInstanceProcAddr()
+bool ta_vk_dispatch_init(PFN_vkGetInstanceProcAddr get_instance_proc_addr)
+{
+#ifdef VK_NO_PROTOTYPES
+    if (!get_instance_proc_addr) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to load the Vulkan loader.\n");
+        return false;
+    }
+    vkGetInstanceProcAddr = get_instance_proc_addr;
+#define TA_VK_LOAD(name) name = (PFN_##name)vkGetInstanceProcAddr(VK_NULL_HANDLE, #name);
+    TA_VK_GLOBAL_FUNCTIONS(TA_VK_LOAD)
+#undef TA_VK_LOAD
+    if (!vkEnumerateInstanceVersion) {
+        vkEnumerateInstanceVersion = dispatch_instance_version_1_0;
+    }
+    if (!vkCreateInstance) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "Failed to load vkCreateInstance from the Vulkan loader.\n");
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Everything, including device functions, which resolve to loader trampolines until ta_vk_dispatch_load_device
+void ta_vk_dispatch_load_instance(VkInstance instance)
+{
+#ifdef VK_NO_PROTOTYPES
+#define TA_VK_LOAD(name) name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);
+    TA_VK_INSTANCE_FUNCTIONS(TA_VK_LOAD)
+    TA_VK_DEVICE_FUNCTIONS(TA_VK_LOAD)
+#undef TA_VK_LOAD
+#endif
+}
+
+// NOTE: The table is global, so this only works with one VkDevice. Functions the device doesn't have (1.1 core on a
+// 1.0 device, disabled extensions) come back NULL.
+void ta_vk_dispatch_load_device(VkDevice device)
+{
+#ifdef VK_NO_PROTOTYPES
+#define TA_VK_LOAD(name) name = (PFN_##name)vkGetDeviceProcAddr(device, #name);
+    TA_VK_DEVICE_FUNCTIONS(TA_VK_LOAD)
+#undef TA_VK_LOAD
+#endif
+}
+
+static double dispatch_time_calls(VkDevice device, VkCommandPool command_pool, PFN_vkCmdSetViewport set_viewport,
+    uint32_t calls)
+{
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkResult err = vkAllocateCommandBuffers(device, &alloc_info, &command_buffer);
+    if (err) {
+        ta_log_write(tg_debug_log, SRC_VULKAN, "[%u] Failed to allocate command buffer.\n", err);
+        return 0.0;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+
+    VkViewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+    double start_ms = ta_timer_elapsed_ms();
+    for (uint32_t i = 0; i < calls; ++i) {
+        // Keep the driver from skipping redundant state
+        viewport.width = (float)(1 + (i & 1023));
+        set_viewport(command_buffer, 0, 1, &viewport);
+    }
+    double elapsed_ms = ta_timer_elapsed_ms() - start_ms;
+
+    vkEndCommandBuffer(command_buffer);
+    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+    return elapsed_ms;
+}
+
+// Records vkCmdSetViewport calls through the loader trampoline, the driver's entry point, and whatever vkCmdSetViewport
+// resolves to in this build. Cheap commands are where the extra indirection shows. Best of 3 runs each.
+void ta_vk_dispatch_benchmark(VkInstance instance, VkDevice device, VkCommandPool command_pool, uint32_t calls)
+{
+    struct {
+        const char           *name;
+        PFN_vkCmdSetViewport fn;
+        double               best_ms;
+    } variants[] = {
+        { "loader trampoline", (PFN_vkCmdSetViewport)vkGetInstanceProcAddr(instance, "vkCmdSetViewport"), 0.0 },
+        { "device direct",     (PFN_vkCmdSetViewport)vkGetDeviceProcAddr(device, "vkCmdSetViewport"),     0.0 },
+        { "this build",        vkCmdSetViewport,                                                          0.0 },
+    };
+
+    // Warm up: fault in the command pool's memory
+    dispatch_time_calls(device, command_pool, variants[1].fn, calls);
+
+    for (int run = 0; run < 3; ++run) {
+        for (auto &variant : variants) {
+            double ms = dispatch_time_calls(device, command_pool, variant.fn, calls);
+            variant.best_ms = run ? std::min(variant.best_ms, ms) : ms;
+        }
+    }
+
+    ta_log_write(tg_debug_log, SRC_VULKAN, "Dispatch benchmark, %u vkCmdSetViewport calls (best of 3):\n", calls);
+    ta_log_indent(tg_debug_log);
+    for (auto &variant : variants) {
+        double ns_per_call = variant.best_ms * 1000000.0 / calls;
+        ta_log_write(tg_debug_log, SRC_VULKAN, "%-18s %8.3fms %6.2fns/call\n", variant.name, variant.best_ms,
+            ns_per_call);
+    }
+    double saved_ns = (variants[0].best_ms - variants[1].best_ms) * 1000000.0 / calls;
+    ta_log_write(tg_debug_log, SRC_VULKAN, "direct dispatch saves %.2fns/call (%.1f%%)\n", saved_ns,
+        variants[0].best_ms > 0.0 ? 100.0 * (variants[0].best_ms - variants[1].best_ms) / variants[0].best_ms : 0.0);
+    ta_log_unindent(tg_debug_log);
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include "vulkan/vulkan.h"
+
+// Function lists for the dispatch table, kept by hand: every command of VK_VERSION_1_0, VK_VERSION_1_1, VK_KHR_surface
+// and VK_KHR_swapchain in vulkan_core.h order, plus the extension functions we call: VK_EXT_calibrated_timestamps,
+// VK_KHR_draw_indirect_count.
+#define TA_VK_GLOBAL_FUNCTIONS(X) \
+    X(vkCreateInstance) \
+    X(vkEnumerateInstanceExtensionProperties) \
+    X(vkEnumerateInstanceLayerProperties) \
+    X(vkEnumerateInstanceVersion)
+
+// First parameter is a VkInstance or VkPhysicalDevice
+#define TA_VK_INSTANCE_FUNCTIONS(X) \
+    X(vkDestroyInstance) \
+    X(vkEnumeratePhysicalDevices) \
+    X(vkGetPhysicalDeviceFeatures) \
+    X(vkGetPhysicalDeviceFormatProperties) \
+    X(vkGetPhysicalDeviceImageFormatProperties) \
+    X(vkGetPhysicalDeviceProperties) \
+    X(vkGetPhysicalDeviceQueueFamilyProperties) \
+    X(vkGetPhysicalDeviceMemoryProperties) \
+    X(vkGetDeviceProcAddr) \
+    X(vkCreateDevice) \
+    X(vkEnumerateDeviceExtensionProperties) \
+    X(vkEnumerateDeviceLayerProperties) \
+    X(vkGetPhysicalDeviceSparseImageFormatProperties) \
+    X(vkEnumeratePhysicalDeviceGroups) \
+    X(vkGetPhysicalDeviceFeatures2) \
+    X(vkGetPhysicalDeviceProperties2) \
+    X(vkGetPhysicalDeviceFormatProperties2) \
+    X(vkGetPhysicalDeviceImageFormatProperties2) \
+    X(vkGetPhysicalDeviceQueueFamilyProperties2) \
+    X(vkGetPhysicalDeviceMemoryProperties2) \
+    X(vkGetPhysicalDeviceSparseImageFormatProperties2) \
+    X(vkGetPhysicalDeviceExternalBufferProperties) \
+    X(vkGetPhysicalDeviceExternalFenceProperties) \
+    X(vkGetPhysicalDeviceExternalSemaphoreProperties) \
+    X(vkDestroySurfaceKHR) \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+    X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+    X(vkGetPhysicalDeviceSurfaceFormatsKHR) \
+    X(vkGetPhysicalDeviceSurfacePresentModesKHR) \
+    X(vkGetPhysicalDevicePresentRectanglesKHR) \
+    X(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+
+// First parameter is a VkDevice, VkQueue or VkCommandBuffer
+#define TA_VK_DEVICE_FUNCTIONS(X) \
+    X(vkDestroyDevice) \
+    X(vkGetDeviceQueue) \
+    X(vkQueueSubmit) \
+    X(vkQueueWaitIdle) \
+    X(vkDeviceWaitIdle) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkFlushMappedMemoryRanges) \
+    X(vkInvalidateMappedMemoryRanges) \
+    X(vkGetDeviceMemoryCommitment) \
+    X(vkBindBufferMemory) \
+    X(vkBindImageMemory) \
+    X(vkGetBufferMemoryRequirements) \
+    X(vkGetImageMemoryRequirements) \
+    X(vkGetImageSparseMemoryRequirements) \
+    X(vkQueueBindSparse) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkResetFences) \
+    X(vkGetFenceStatus) \
+    X(vkWaitForFences) \
+    X(vkCreateSemaphore) \
+    X(vkDestroySemaphore) \
+    X(vkCreateEvent) \
+    X(vkDestroyEvent) \
+    X(vkGetEventStatus) \
+    X(vkSetEvent) \
+    X(vkResetEvent) \
+    X(vkCreateQueryPool) \
+    X(vkDestroyQueryPool) \
+    X(vkGetQueryPoolResults) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkCreateBufferView) \
+    X(vkDestroyBufferView) \
+    X(vkCreateImage) \
+    X(vkDestroyImage) \
+    X(vkGetImageSubresourceLayout) \
+    X(vkCreateImageView) \
+    X(vkDestroyImageView) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreatePipelineCache) \
+    X(vkDestroyPipelineCache) \
+    X(vkGetPipelineCacheData) \
+    X(vkMergePipelineCaches) \
+    X(vkCreateGraphicsPipelines) \
+    X(vkCreateComputePipelines) \
+    X(vkDestroyPipeline) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCreateSampler) \
+    X(vkDestroySampler) \
+    X(vkCreateDescriptorSetLayout) \
+    X(vkDestroyDescriptorSetLayout) \
+    X(vkCreateDescriptorPool) \
+    X(vkDestroyDescriptorPool) \
+    X(vkResetDescriptorPool) \
+    X(vkAllocateDescriptorSets) \
+    X(vkFreeDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkCreateFramebuffer) \
+    X(vkDestroyFramebuffer) \
+    X(vkCreateRenderPass) \
+    X(vkDestroyRenderPass) \
+    X(vkGetRenderAreaGranularity) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkResetCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkFreeCommandBuffers) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkResetCommandBuffer) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdSetViewport) \
+    X(vkCmdSetScissor) \
+    X(vkCmdSetLineWidth) \
+    X(vkCmdSetDepthBias) \
+    X(vkCmdSetBlendConstants) \
+    X(vkCmdSetDepthBounds) \
+    X(vkCmdSetStencilCompareMask) \
+    X(vkCmdSetStencilWriteMask) \
+    X(vkCmdSetStencilReference) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdBindIndexBuffer) \
+    X(vkCmdBindVertexBuffers) \
+    X(vkCmdDraw) \
+    X(vkCmdDrawIndexed) \
+    X(vkCmdDrawIndirect) \
+    X(vkCmdDrawIndexedIndirect) \
+    X(vkCmdDispatch) \
+    X(vkCmdDispatchIndirect) \
+    X(vkCmdCopyBuffer) \
+    X(vkCmdCopyImage) \
+    X(vkCmdBlitImage) \
+    X(vkCmdCopyBufferToImage) \
+    X(vkCmdCopyImageToBuffer) \
+    X(vkCmdUpdateBuffer) \
+    X(vkCmdFillBuffer) \
+    X(vkCmdClearColorImage) \
+    X(vkCmdClearDepthStencilImage) \
+    X(vkCmdClearAttachments) \
+    X(vkCmdResolveImage) \
+    X(vkCmdSetEvent) \
+    X(vkCmdResetEvent) \
+    X(vkCmdWaitEvents) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCmdBeginQuery) \
+    X(vkCmdEndQuery) \
+    X(vkCmdResetQueryPool) \
+    X(vkCmdWriteTimestamp) \
+    X(vkCmdCopyQueryPoolResults) \
+    X(vkCmdPushConstants) \
+    X(vkCmdBeginRenderPass) \
+    X(vkCmdNextSubpass) \
+    X(vkCmdEndRenderPass) \
+    X(vkCmdExecuteCommands) \
+    X(vkBindBufferMemory2) \
+    X(vkBindImageMemory2) \
+    X(vkGetDeviceGroupPeerMemoryFeatures) \
+    X(vkCmdSetDeviceMask) \
+    X(vkCmdDispatchBase) \
+    X(vkGetImageMemoryRequirements2) \
+    X(vkGetBufferMemoryRequirements2) \
+    X(vkGetImageSparseMemoryRequirements2) \
+    X(vkTrimCommandPool) \
+    X(vkGetDeviceQueue2) \
+    X(vkCreateSamplerYcbcrConversion) \
+    X(vkDestroySamplerYcbcrConversion) \
+    X(vkCreateDescriptorUpdateTemplate) \
+    X(vkDestroyDescriptorUpdateTemplate) \
+    X(vkUpdateDescriptorSetWithTemplate) \
+    X(vkGetDescriptorSetLayoutSupport) \
+    X(vkCreateSwapchainKHR) \
+    X(vkDestroySwapchainKHR) \
+    X(vkGetSwapchainImagesKHR) \
+    X(vkAcquireNextImageKHR) \
+    X(vkQueuePresentKHR) \
+    X(vkGetDeviceGroupPresentCapabilitiesKHR) \
+    X(vkGetDeviceGroupSurfacePresentModesKHR) \
+    X(vkAcquireNextImage2KHR) \
+    X(vkGetCalibratedTimestampsEXT) \
+    X(vkCmdDrawIndexedIndirectCountKHR)
+
+// With VK_NO_PROTOTYPES (set in the project), every vk* function is a global function pointer filled in at runtime:
+// the loader is opened through SDL, and device functions come from vkGetDeviceProcAddr, so command recording calls
+// straight into the driver instead of going through the loader's trampoline. Include this instead of vulkan.h.
+// Without VK_NO_PROTOTYPES the load functions do nothing and the prototypes would need vulkan-1, which the project
+// doesn't link.
+#ifdef VK_NO_PROTOTYPES
+#define TA_VK_DECLARE(name) extern PFN_##name name;
+extern PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+TA_VK_GLOBAL_FUNCTIONS(TA_VK_DECLARE)
+TA_VK_INSTANCE_FUNCTIONS(TA_VK_DECLARE)
+TA_VK_DEVICE_FUNCTIONS(TA_VK_DECLARE)
+#undef TA_VK_DECLARE
+#endif
+
+bool ta_vk_dispatch_init                (PFN_vkGetInstanceProcAddr get_instance_proc_addr);
+void ta_vk_dispatch_load_instance       (VkInstance instance);
+void ta_vk_dispatch_load_device         (VkDevice device);
+void ta_vk_dispatch_benchmark           (VkInstance instance, VkDevice device, VkCommandPool command_pool,
+                                         uint32_t calls);